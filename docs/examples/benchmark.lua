@@ -0,0 +1,34 @@
+--- Benchmark a chain of volume nodes.
+-- Returns the nodes and connections of a test rig, in the same form
+-- Node:build takes. Run it without a GUI to time every node.
+-- @script benchmark
+-- @usage
+-- element --benchmark=benchmark.lua --blocks=2000 --block-size=256
+
+local length = 32
+local nodes = {
+    input  = { format = "Internal", identifier = "audio.input" },
+    output = { format = "Internal", identifier = "audio.output" }
+}
+local connections = {}
+
+local function connect (source, dest)
+    for channel = 0, 1 do
+        table.insert (connections, { source, channel, dest, channel, type = "audio" })
+    end
+end
+
+local previous = "input"
+for i = 1, length do
+    local key = "volume" .. i
+    nodes[key] = { identifier = "element.volume.stereo", name = "Volume " .. i }
+    connect (previous, key)
+    previous = key
+end
+
+connect (previous, "output")
+
+return {
+    nodes       = nodes,
+    connections = connections
+}
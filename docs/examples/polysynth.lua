@@ -0,0 +1,84 @@
+--- Polyphonic Synth Example.
+--
+-- Eight saw wave voices with a short attack and a fixed release. Element
+-- allocates the voices and mixes them, each voice only renders itself.
+--
+-- @script      examples.polysynth
+-- @kind        DSP
+-- @license     GPL v3
+
+local dsp = require ('el.dsp')
+
+local function layout()
+    return {
+        audio = { 0, 2 },
+        midi  = { 1, 0 }
+    }
+end
+
+local function parameters()
+    return {
+        {
+            name        = "Volume",
+            label       = "dB",
+            min         = -60.0,
+            max         = 6.0,
+            default     = -12.0,
+            smoothing   = 0.02
+        }
+    }
+end
+
+--- Create one voice.
+-- Called once for each voice when the script loads.
+local function voice()
+    local osc       = dsp.Oscillator()
+    local attack    = dsp.Gain (0)
+    local release   = dsp.Gain (1)
+    local rate      = 44100
+
+    osc:waveform ('saw')
+
+    return {
+        prepare = function (self, r, block)
+            rate = r
+            osc:prepare (rate)
+            attack:prepare (rate, 0.005)
+        end,
+
+        start = function (self, note, velocity)
+            if not self.stolen then osc:reset() end
+            release:prepare (rate, 0.0)
+            release:set (1.0)
+            attack:set (velocity)
+        end,
+
+        stop = function (self)
+            release:prepare (rate, 0.3)
+            release:set (0.0)
+        end,
+
+        render = function (self, a, params)
+            local semitones = self.note - 69 + self.bend * 2.0
+            osc:frequency (440.0 * 2.0 ^ (semitones / 12.0))
+            osc:render (a, nil, 0.25)
+            attack:process (a)
+            release:process (a)
+            return release:get() > 0.0001
+        end
+    }
+end
+
+--- Apply the volume to the mixed voices.
+local function process (a, m, params, ramps)
+    ramps:gaindb (1, a)
+end
+
+return {
+    type        = 'DSP',
+    layout      = layout,
+    parameters  = parameters,
+    polyphony   = 8,
+    voice       = voice,
+    process     = process
+}
@@ -3,6 +3,9 @@
 // @pragma nostrip
 
 #include "lua-kv.hpp"
+#include "controllers/EngineController.h"
+#include "scripting/LuaBindings.h"
+#include "session/GraphBuilder.h"
 #include "session/Node.h"
 
 LUAMOD_API int luaopen_el_Node (lua_State* L) {
@@ -111,6 +114,57 @@ LUAMOD_API int luaopen_el_Node (lua_State* L) {
         // @function Node:restorestate
         "restorestate",        &Node::restorePluginState,
 
+        /// Add nodes and connections to a graph in one go.
+        // The engine and the graph model are updated once, after everything
+        // was added, so this is much faster than adding nodes one by one.
+        // Only works on graphs running in the engine.
+        //
+        //     local nodes, errors = graph:build {
+        //         nodes = {
+        //             input  = { format = "Internal", identifier = "audio.input" },
+        //             volume = { identifier = "element.volume.stereo", name = "Gain" }
+        //         },
+        //         connections = {
+        //             { "input", 0, "volume", 0, type = "audio" },
+        //             { "input", 1, "volume", 1, type = "audio" }
+        //         }
+        //     }
+        //
+        // A node is a table with an `identifier`, a `format` ("Element" if not
+        // set) and an optional `name`, or a node already in this graph.
+        // Connections are `{ source, port, dest, port }` with port indexes, or
+        // channels of a port type when `type` is set.
+        // @function Node:build
+        // @tparam table spec Nodes and connections
+        // @treturn table The nodes, with the same keys as the spec
+        // @treturn string Errors, or nil
+        "build", [](Node& self, sol::table spec, sol::this_state L) -> std::tuple<sol::object, sol::object>
+        {
+            auto* engine = Lua::getEngineController (L);
+            if (engine == nullptr || ! self.isGraph())
+                return { sol::make_object (L, sol::lua_nil),
+                         sol::make_object (L, "not a graph running in the engine") };
+
+            GraphBuilder builder;
+            std::vector<sol::object> keys;
+            const auto error = Lua::fillGraphBuilder (spec, builder, keys);
+            if (error.isNotEmpty())
+                return { sol::make_object (L, sol::lua_nil),
+                         sol::make_object (L, error.toStdString()) };
+
+            const auto nodes = engine->buildGraph (self, builder);
+            sol::state_view view (L);
+            auto result = view.create_table();
+            for (int i = 0; i < nodes.size(); ++i)
+                if (nodes.getReference(i).isValid())
+                    result [keys [(size_t) i]] = std::make_shared<Node> (nodes.getReference(i).getValueTree(), false);
+
+            const auto& errors = builder.getErrors();
+            return { sol::make_object (L, result),
+                     errors.isEmpty() ? sol::make_object (L, sol::lua_nil)
+                                      : sol::make_object (L, errors.joinIntoString ("\n").toStdString()) };
+        },
+
         /// Write node to file.
         // @function Node:writefile
         // @string f Absolute file path to save to
@@ -1,20 +1,13 @@
 --- Stereo Amplifier in Lua.
 --
--- The code contained implements a simple stereo amplifier plugin. It does not
--- try to smooth the volume parameter and could cause zipper noise.
+-- The code contained implements a simple stereo amplifier plugin. Volume
+-- changes are ramped natively so they don't cause zipper noise.
 --
 -- @script      amp
 -- @kind        DSP
 -- @license     GPL v3
 -- @author      Michael Fisher
 
-local audio  = require ('kv.audio')
-
---- Gain parameters.
--- Used for fading between changes in volume
-local gain1 = 1.0
-local gain2 = 1.0
-
 --- Return a table of audio/midi inputs and outputs.
 -- This plugin supports stereo in/out with no MIDI
 local function amp_layout()
@@ -32,7 +25,8 @@ local function amp_parameters()
             label       = "dB",
             min         = -90.0,
             max         = 24.0,
-            default     = 0.0
+            default     = 0.0,
+            smoothing   = 0.02
         }
     }
 end
@@ -42,10 +36,9 @@ end
 -- @param a The source kv.AudioBuffer
 -- @param m The source el.MidiPipe
 -- @param params DSP parameters
-local function amp_process (a, m, params)
-    gain2 = audio.togain (params [1])
-    a:fade (gain1, gain2)
-    gain1 = gain2
+-- @param ramps Parameter ramps for this block
+local function amp_process (a, m, params, ramps)
+    ramps:gaindb (1, a)
 end
 
 return {
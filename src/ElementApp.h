@@ -101,6 +101,7 @@ namespace Tags
     const Identifier globalMidiPrograms = "globalMidiPrograms";
     const Identifier midiProgramsState  = "midiProgramsState";
     const Identifier renderMode         = "renderMode";
+    const Identifier sandboxed          = "sandboxed";
 
     const Identifier vertical           = "vertical";
     const Identifier staticPos          = "staticPos";
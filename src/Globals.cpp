@@ -38,6 +38,22 @@ static void buildCommandLine (CommandLine& cli, const String& c)
                       .upToFirstOccurrenceOf(" ", false, false);
     if (port.isInt() || port.isInt64())
         cli.port = (int) port;
+
+    auto option = [&c] (const char* name) {
+        return c.fromFirstOccurrenceOf (name, false, false)
+                .upToFirstOccurrenceOf (" ", false, false).unquoted();
+    };
+
+    cli.benchmarkScript = option ("--benchmark=");
+    if (option ("--blocks=").getIntValue() > 0)
+        cli.benchmarkBlocks = option ("--blocks=").getIntValue();
+    if (option ("--block-size=").getIntValue() > 0)
+        cli.benchmarkBlockSize = option ("--block-size=").getIntValue();
+    if (option ("--sample-rate=").getDoubleValue() > 0.0)
+        cli.benchmarkSampleRate = option ("--sample-rate=").getDoubleValue();
+
+    cli.convertSource = option ("--convert=");
+    cli.convertTarget = option ("--output=");
 }
 
 CommandLine::CommandLine (const String& c)
@@ -41,6 +41,21 @@ struct CommandLine
     explicit CommandLine (const String& cli = String());
     bool fullScreen;
     int port;
+
+    /** Lua script to benchmark without a GUI, --benchmark=<file> */
+    String benchmarkScript;
+    /** Blocks to render when benchmarking, --blocks=<n> */
+    int benchmarkBlocks = 1000;
+    /** Block size when benchmarking, --block-size=<n> */
+    int benchmarkBlockSize = 512;
+    /** Sample rate when benchmarking, --sample-rate=<hz> */
+    double benchmarkSampleRate = 44100.0;
+
+    /** Session, graph or preset file to convert, --convert=<file> */
+    String convertSource;
+    /** Where to write the converted file, --output=<file>. Replaces the
+        source if not given. See BinaryModel::convert() for the formats */
+    String convertTarget;
     
     const String commandLine;
 };
@@ -22,9 +22,12 @@
 #include "controllers/SessionController.h"
 #include "engine/InternalFormat.h"
 #include "engine/GraphProcessor.h"
+#include "scripting/ScriptBenchmark.h"
 #include "scripting/ScriptingEngine.h"
 #include "session/DeviceManager.h"
 #include "session/PluginManager.h"
+#include "session/BinaryModel.h"
+#include "session/PluginSandbox.h"
 #include "Commands.h"
 #include "DataPath.h"
 #include "Globals.h"
@@ -212,6 +215,18 @@ public:
         world = new Globals (commandLine);
         if (maybeLaunchSlave (commandLine))
             return;
+
+        if (world->cli.benchmarkScript.isNotEmpty())
+        {
+            runBenchmark();
+            return;
+        }
+
+        if (world->cli.convertSource.isNotEmpty())
+        {
+            runConvert();
+            return;
+        }
         
         if (sendCommandLineToPreexistingInstance())
         {
@@ -242,6 +257,7 @@ public:
         auto& settings (world->getSettings());
         auto& midi (world->getMidiEngine());
         auto* props = settings.getUserSettings();
+        plugins.setWatchingPluginPaths (false);
         plugins.setPropertiesFile (nullptr); // must be done before Settings is deleted
 
         controller->saveSettings();
@@ -375,7 +391,10 @@ public:
             return;
         
         if (world->getSettings().scanForPluginsOnStartup())
+        {
             world->getPluginManager().scanAudioPlugins();
+            world->getPluginManager().setWatchingPluginPaths (true);
+        }
     
         controller = startup->controller.release();
         startup = nullptr;
@@ -421,25 +440,71 @@ private:
     {
         slaves.clearQuick (true);
         slaves.add (world->getPluginManager().createAudioPluginScannerSlave());
-        StringArray processIds = { EL_PLUGIN_SCANNER_PROCESS_ID };
-        for (auto* slave : slaves)
+        slaves.add (PluginSandbox::createSlave());
+        StringArray processIds = { EL_PLUGIN_SCANNER_PROCESS_ID, EL_PLUGIN_SANDBOX_PROCESS_ID };
+        for (int i = 0; i < slaves.size(); ++i)
         {
-            for (const auto& pid : processIds)
+            if (slaves.getUnchecked(i)->initialiseFromCommandLine (commandLine, processIds[i]))
             {
-                if (slave->initialiseFromCommandLine (commandLine, pid))
-                {
-				   #if JUCE_MAC
-                    Process::setDockIconVisible (false);
-				   #endif
-                    juce::shutdownJuce_GUI();
-                    return true;
-                }
+			   #if JUCE_MAC
+                Process::setDockIconVisible (false);
+			   #endif
+                juce::shutdownJuce_GUI();
+                return true;
             }
         }
         
         return false;
     }
     
+    /** Renders the graph a script builds offline, prints the node timings
+        and quits without showing any windows */
+    void runBenchmark()
+    {
+        const auto& cli = world->cli;
+        ScriptBenchmark::Options options;
+        options.numBlocks   = cli.benchmarkBlocks;
+        options.blockSize   = cli.benchmarkBlockSize;
+        options.sampleRate  = cli.benchmarkSampleRate;
+
+        AudioEnginePtr engine = new AudioEngine (*world);
+        world->setEngine (engine);
+        auto& plugins (world->getPluginManager());
+        plugins.addDefaultFormats();
+        plugins.addFormat (new InternalFormat (*engine, world->getMidiEngine()));
+        plugins.addFormat (new ElementAudioPluginFormat (*world));
+        plugins.restoreUserPlugins (world->getSettings());
+        plugins.setPlayConfig (options.sampleRate, options.blockSize);
+
+        const auto script = File::getCurrentWorkingDirectory().getChildFile (cli.benchmarkScript);
+        ScriptBenchmark benchmark (*world);
+        const auto result = benchmark.run (script, options);
+        if (result.wasOk())
+            Logger::writeToLog (benchmark.createReport());
+        else
+            Logger::writeToLog ("benchmark failed: " + result.getErrorMessage());
+
+        engine = nullptr;
+        world->setEngine (nullptr);
+        setApplicationReturnValue (result.wasOk() && benchmark.getErrors().isEmpty() ? 0 : 1);
+        quit();
+    }
+
+    /** Converts a session, graph or preset file and quits */
+    void runConvert()
+    {
+        const auto& cli = world->cli;
+        const auto source = File::getCurrentWorkingDirectory().getChildFile (cli.convertSource);
+        const auto target = cli.convertTarget.isNotEmpty()
+            ? File::getCurrentWorkingDirectory().getChildFile (cli.convertTarget) : source;
+
+        const auto result = BinaryModel::convert (source, target);
+        Logger::writeToLog (result.wasOk() ? "converted: " + target.getFullPathName()
+                                           : "convert failed: " + result.getErrorMessage());
+        setApplicationReturnValue (result.wasOk() ? 0 : 1);
+        quit();
+    }
+
     void launchApplication()
     {
         if (nullptr != controller)
@@ -44,6 +44,7 @@ const char* Settings::oscHostEnabledKey         = "oscHostEnabledKey";
 const char* Settings::systrayKey                = "systrayKey";
 const char* Settings::midiOutLatencyKey         = "midiOutLatency";
 const char* Settings::desktopScaleKey           = "desktopScale";
+const char* Settings::autosaveIntervalKey       = "autosaveInterval";
 
 //=============================================================================
 enum OptionsMenuItemId
@@ -409,6 +410,22 @@ void Settings::setDesktopScale (double scale)
         p->setValue (desktopScaleKey, scale);
 }
 
+int Settings::getAutosaveInterval() const
+{
+    if (auto* p = getProps())
+        return p->getIntValue (autosaveIntervalKey, 5);
+    return 5;
+}
+
+void Settings::setAutosaveInterval (int minutes)
+{
+    minutes = jlimit (0, 120, minutes);
+    if (minutes == getAutosaveInterval())
+        return;
+    if (auto* p = getProps())
+        p->setValue (autosaveIntervalKey, minutes);
+}
+
 //=============================================================================
 void Settings::addItemsToMenu (Globals& world, PopupMenu& menu)
 {
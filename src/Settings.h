@@ -53,6 +53,7 @@ public:
     static const char* systrayKey;
     static const char* midiOutLatencyKey;
     static const char* desktopScaleKey;
+    static const char* autosaveIntervalKey;
 
     std::unique_ptr<XmlElement> getLastGraph() const;
     void setLastGraph (const ValueTree& data);
@@ -124,6 +125,10 @@ public:
     double getDesktopScale() const;
     void setDesktopScale (double);
 
+    /** Minutes between session autosaves, 0 if autosave is off */
+    int getAutosaveInterval() const;
+    void setAutosaveInterval (int minutes);
+
 private:
     PropertiesFile* getProps() const;
 };
@@ -25,6 +25,7 @@
 
 #include "engine/nodes/SubGraphProcessor.h"
 #include "session/DeviceManager.h"
+#include "session/GraphBuilder.h"
 #include "session/PluginManager.h"
 #include "session/Node.h"
 #include "Globals.h"
@@ -490,6 +491,13 @@ void EngineController::removeConnection (const uint32 s, const uint32 sp, const
         controller->removeConnection (s, sp, d, dp);
 }
 
+NodeArray EngineController::buildGraph (const Node& graph, GraphBuilder& builder)
+{
+    if (auto* controller = graphs->findGraphManagerFor (graph))
+        return builder.build (*controller);
+    return {};
+}
+
 Node EngineController::addNode (const Node& node, const Node& target,
                                 const ConnectionBuilder& builder)
 {
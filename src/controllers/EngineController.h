@@ -25,6 +25,7 @@
 namespace Element {
 
 struct ConnectionBuilder;
+class GraphBuilder;
 class GraphManager;
 class RootGraphManager;
     
@@ -103,6 +104,11 @@ public:
     /** Remove a connection on the specified graph */
     void removeConnection (const uint32, const uint32, const uint32, const uint32, const Node& target);
 
+    /** Adds the nodes and connections of a builder to a graph in one batch.
+        Returns the nodes, see GraphBuilder::build()
+     */
+    NodeArray buildGraph (const Node& graph, GraphBuilder& builder);
+
     /** Disconnect the provided node */
     void disconnectNode (const Node& node, const bool inputs = true, const bool outputs = true,
                                            const bool audio = true, const bool midi = true);
@@ -212,11 +212,12 @@ bool GraphManager::contains (const uint32 nodeId) const {
     return processor.getNodeForId (nodeId) != nullptr;
 }
 
-NodeObject* GraphManager::createFilter (const PluginDescription* desc, double x, double y, uint32 nodeId)
+NodeObject* GraphManager::createFilter (const PluginDescription* desc, double x, double y,
+                                        uint32 nodeId, bool sandboxed)
 {
     String errorMessage;
     auto node = std::unique_ptr<NodeObject> (
-        pluginManager.createGraphNode (*desc, errorMessage));
+        pluginManager.createGraphNode (*desc, errorMessage, sandboxed));
 
     if (errorMessage.isNotEmpty())
     {
@@ -245,15 +246,16 @@ uint32 GraphManager::addNode (const Node& newNode)
 {
     if (! newNode.isValid())
     {
-        AlertWindow::showMessageBox (AlertWindow::WarningIcon, TRANS ("Couldn't create Node"),
-                                     "Cannot instantiate node without a description");
+        if (! isBatching())
+            AlertWindow::showMessageBox (AlertWindow::WarningIcon, TRANS ("Couldn't create Node"),
+                                         "Cannot instantiate node without a description");
         return KV_INVALID_NODE;
     }
     
     uint32 nodeId = KV_INVALID_NODE;
     const PluginDescription desc (pluginManager.findDescriptionFor (newNode));
     if (auto* node = createFilter (&desc, 0, 0,
-        newNode.hasProperty(Tags::id) ? newNode.getNodeId() : 0))
+        newNode.hasProperty(Tags::id) ? newNode.getNodeId() : 0, newNode.isSandboxed()))
     {
         nodeId = node->nodeId;
         ValueTree data = newNode.getValueTree().createCopy();
@@ -276,8 +278,9 @@ uint32 GraphManager::addNode (const Node& newNode)
     else
     {
         nodeId = KV_INVALID_NODE;
-        AlertWindow::showMessageBox (AlertWindow::WarningIcon, "Couldn't create filter",
-                                     "The plugin could not be instantiated");
+        if (! isBatching())
+            AlertWindow::showMessageBox (AlertWindow::WarningIcon, "Couldn't create filter",
+                                         "The plugin could not be instantiated");
     }
     
     return nodeId;
@@ -360,7 +363,8 @@ uint32 GraphManager::addNode (const PluginDescription* desc, double rx, double r
     else
     {
         nodeId = KV_INVALID_NODE;
-        showFailedInstantiationAlert (*desc, true);
+        if (! isBatching())
+            showFailedInstantiationAlert (*desc, true);
     }
 
     return nodeId;
@@ -461,7 +465,12 @@ bool GraphManager::addConnection (uint32 sourceFilterUID, int sourceFilterChanne
     const bool result = processor.addConnection (sourceFilterUID, (uint32)sourceFilterChannel,
                                                  destFilterUID, (uint32)destFilterChannel);
     if (result)
-        processorArcsChanged();
+    {
+        if (isBatching())
+            arcsPending = true;
+        else
+            processorArcsChanged();
+    }
 
     return result;
 }
@@ -493,7 +502,7 @@ void GraphManager::setNodeModel (const Node& node)
     {
         Node node (nodes.getChild (i), false);
         const PluginDescription desc (pluginManager.findDescriptionFor (node));
-        if (NodeObjectPtr obj = createFilter (&desc, 0.0, 0.0, node.getNodeId()))
+        if (NodeObjectPtr obj = createFilter (&desc, 0.0, 0.0, node.getNodeId(), node.isSandboxed()))
         {
             setupNode (node.getValueTree(), obj);
             obj->setEnabled (node.isEnabled());
@@ -599,6 +608,25 @@ void GraphManager::clear()
     changed();
 }
 
+void GraphManager::beginBatch()
+{
+    ++batchDepth;
+}
+
+void GraphManager::endBatch()
+{
+    jassert (batchDepth > 0);
+    if (--batchDepth > 0)
+        return;
+
+    if (arcsPending)
+        processorArcsChanged();
+    else if (changePending)
+        changed();
+
+    arcsPending = changePending = false;
+}
+
 void GraphManager::processorArcsChanged()
 {
     ValueTree newArcs = ValueTree (Tags::arcs);
@@ -38,6 +38,23 @@ public:
     GraphManager (GraphProcessor&, PluginManager&);
     ~GraphManager();
 
+    /** Holds back arcs model rebuilds and change messages while many nodes
+        and connections are added. The model is synced once when the
+        outermost batch ends. Nodes that fail to load don't show alerts.
+     */
+    class ScopedBatch
+    {
+    public:
+        explicit ScopedBatch (GraphManager& m) : manager (m) { manager.beginBatch(); }
+        ~ScopedBatch() { manager.endBatch(); }
+    private:
+        GraphManager& manager;
+        JUCE_DECLARE_NON_COPYABLE (ScopedBatch)
+    };
+
+    /** Returns true while a ScopedBatch is active */
+    bool isBatching() const noexcept { return batchDepth > 0; }
+
     /** Returns the controlled graph */
     GraphProcessor& getGraph() noexcept { return processor; }
 
@@ -118,10 +135,22 @@ private:
     bool loaded = false;
     
     uint32 lastUID;
+    int batchDepth = 0;
+    bool arcsPending = false, changePending = false;
+
     uint32 getNextUID() noexcept;
-    inline void changed() { sendChangeMessage(); }
+    inline void changed()
+    {
+        if (batchDepth > 0)
+            changePending = true;
+        else
+            sendChangeMessage();
+    }
+
+    void beginBatch();
+    void endBatch();
     NodeObject* createFilter (const PluginDescription* desc, double x = 0.0f, double y = 0.0f,
-                             uint32 nodeId = 0);
+                             uint32 nodeId = 0, bool sandboxed = false);
     NodeObject* createPlaceholder (const Node& node);
     void setupNode (const ValueTree& data, NodeObjectPtr object);
     
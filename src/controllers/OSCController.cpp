@@ -18,6 +18,7 @@
 */
 
 #include "controllers/OSCController.h"
+#include "engine/OSCService.h"
 #include "session/CommandManager.h"
 #include "session/DeviceManager.h"
 #include "Commands.h"
@@ -114,21 +115,24 @@ public:
     {
         if (isServing())
             return true;
-        serving = receiver.connect (serverPort);
-        return serving;
+        port = service->getPort (serverPort);
+        if (port != nullptr && listenersReady)
+            addListeners();
+        return isServing();
     }
 
     bool stopServer()
     {
         if (! isServing())
             return true;
-        const auto result = receiver.disconnect();
-        if (result)
-            serving = false;
-        return result;
+        if (listenersReady)
+            removeListeners();
+        port = nullptr;
+        service->releaseUnused();
+        return true;
     }
 
-    bool isServing() const { return serving; }
+    bool isServing() const { return port != nullptr; }
 
     void setServerPort (int newPort)
     {
@@ -147,10 +151,9 @@ public:
             return;
         
         application.reset (new CommandOSCListener (owner.getWorld()));
-        receiver.addListener (application.get(), EL_OSC_ADDRESS_COMMAND);
-
         engine.reset (new EngineOSCListener (owner.getWorld()));
-        receiver.addListener (engine.get(), EL_OSC_ADDRESS_ENGINE);
+        if (port != nullptr)
+            addListeners();
 
         listenersReady = true;
     }
@@ -161,8 +164,8 @@ public:
             return;
         listenersReady = false;
 
-        receiver.removeListener (application.get());
-        receiver.removeListener (engine.get());
+        if (port != nullptr)
+            removeListeners();
 
         application.reset();
         engine.reset();
@@ -172,15 +175,26 @@ public:
 
 private:
     OSCController& owner;
-    OSCSender sender;
-    OSCReceiver receiver { "elosc" };
+    SharedResourcePointer<OSCService> service;
+    OSCService::PortPtr port;
 
     bool listenersReady = false;
-    bool serving { false };
     int serverPort { 9000 };
 
     std::unique_ptr<CommandOSCListener> application;
     std::unique_ptr<EngineOSCListener> engine;
+
+    void addListeners()
+    {
+        port->getReceiver().addListener (application.get(), EL_OSC_ADDRESS_COMMAND);
+        port->getReceiver().addListener (engine.get(), EL_OSC_ADDRESS_ENGINE);
+    }
+
+    void removeListeners()
+    {
+        port->getReceiver().removeListener (application.get());
+        port->getReceiver().removeListener (engine.get());
+    }
 };
 
 //=============================================================================
@@ -48,7 +48,9 @@ PresetsController::~PresetsController()
 }
 
 void PresetsController::activate()
-{ 
+{
+    // starts indexing and watching presets in the background
+    getWorld().getPresetCollection().refresh();
 }
 
 void PresetsController::deactivate()
@@ -17,13 +17,32 @@
     Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include "controllers/EngineController.h"
 #include "controllers/ScriptingController.h"
+#include "scripting/LuaBindings.h"
+#include "scripting/ScriptingEngine.h"
+#include "scripting/ScriptManager.h"
+#include "Globals.h"
 
 namespace Element {
 
 ScriptingController::ScriptingController() {}
 ScriptingController::~ScriptingController() {}
-void ScriptingController::activate() {}
-void ScriptingController::deactivate() {}
+
+void ScriptingController::activate()
+{
+    // lets Node:build reach the graphs running in the engine
+    Lua::setEngineController (getWorld().getScriptingEngine().getLuaState(),
+                              findSibling<EngineController>());
+
+    // pick up scripts added or edited while running
+    getWorld().getScriptingEngine().getScriptManager().setWatchingEnabled (true);
+}
+
+void ScriptingController::deactivate()
+{
+    getWorld().getScriptingEngine().getScriptManager().setWatchingEnabled (false);
+    Lua::setEngineController (getWorld().getScriptingEngine().getLuaState(), nullptr);
+}
 
 }
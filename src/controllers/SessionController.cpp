@@ -28,6 +28,8 @@
 #include "gui/ContentComponent.h"
 
 #include "session/Node.h"
+#include "session/SessionWriter.h"
+#include "DataPath.h"
 #include "Globals.h"
 #include "Settings.h"
 
@@ -49,6 +51,46 @@ private:
     SessionController& owner;
 };
 
+class SessionController::Autosaver : public Timer
+{
+public:
+    explicit Autosaver (SessionController& sc)
+        : owner (sc)
+    {
+        lastSaved = Time::getMillisecondCounter();
+        writer.onWritten = [](const File& file, const Result& result) {
+            if (result.failed())
+                DBG("[EL] autosave failed: " << file.getFullPathName() << ": " << result.getErrorMessage());
+        };
+        startTimer (10 * 1000);
+    }
+
+    ~Autosaver()
+    {
+        stopTimer();
+    }
+
+    void timerCallback() override
+    {
+        const int minutes = owner.getWorld().getSettings().getAutosaveInterval();
+        const auto now = Time::getMillisecondCounter();
+        if (minutes <= 0 || writer.isBusy() || now - lastSaved < (uint32) minutes * 60 * 1000)
+            return;
+        owner.autosave();
+    }
+
+    void write (const ValueTree& session, const File& file)
+    {
+        lastSaved = Time::getMillisecondCounter();
+        writer.write (session, file, true);
+    }
+
+private:
+    SessionController& owner;
+    SessionWriter writer;
+    uint32 lastSaved = 0;
+};
+
 SessionController::SessionController() { }
 SessionController::~SessionController() { }
 
@@ -58,6 +100,7 @@ void SessionController::activate()
     currentSession = app->getWorld().getSession();
     document.reset (new SessionDocument (currentSession));
     changeResetter.reset (new ChangeResetter (*this));
+    autosaver.reset (new Autosaver (*this));
 }
 
 void SessionController::deactivate()
@@ -73,6 +116,8 @@ void SessionController::deactivate()
         document = nullptr;
     }
 
+    // waits for an autosave in progress
+    autosaver.reset (nullptr);
     changeResetter->cancelPendingUpdate();
     changeResetter.reset (nullptr);
 
@@ -166,6 +211,25 @@ void SessionController::importGraph (const File& file)
     openFile (file);
 }
 
+void SessionController::autosave()
+{
+    if (! currentSession || ! autosaver)
+        return;
+
+    currentSession->saveGraphState (true);
+    const auto file = getAutosaveFile();
+    file.getParentDirectory().createDirectory();
+    autosaver->write (currentSession->getValueTree(), file);
+}
+
+File SessionController::getAutosaveFile() const
+{
+    const auto file = getSessionFile();
+    const auto name = file != File() ? file.getFileNameWithoutExtension() : String ("Untitled");
+    return DataPath::applicationDataDir().getChildFile ("Autosave")
+                                         .getChildFile (name + ".els");
+}
+
 void SessionController::closeSession()
 {
     DBG("[SC] close session");
@@ -244,9 +308,7 @@ void SessionController::loadNewSessionData()
 
     if (file.existsAsFile())
     {
-        ValueTree data;
-        if (auto xml = XmlDocument::parse (file))
-            data = ValueTree::fromXml (*xml);
+        const auto data = Session::readFromFile (file, true);
         if (data.isValid() && data.hasType (Tags::session))
             wasLoaded = currentSession->loadData (data);
     }
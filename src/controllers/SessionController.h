@@ -48,6 +48,13 @@ public:
     
     void exportGraph (const Node& node, const File& targetFile);
     void importGraph (const File& file);
+
+    /** Captures the states of nodes that changed and writes the session
+        to the autosave file in the background */
+    void autosave();
+
+    /** Where the current session is autosaved */
+    File getAutosaveFile() const;
     
     Signal<void()> sessionLoaded;
 
@@ -56,6 +63,8 @@ private:
     std::unique_ptr<SessionDocument> document;
     class ChangeResetter;
     std::unique_ptr<ChangeResetter> changeResetter;
+    class Autosaver;
+    std::unique_ptr<Autosaver> autosaver;
     void loadNewSessionData();
     void refreshOtherControllers();
 };
@@ -41,7 +41,7 @@ Result GraphDocument::loadDocument (const File& file)
     if (! session)
         return Result::fail ("Cannot load graph");
     
-    auto newData = Session::readFromFile (file);
+    auto newData = Session::readFromFile (file, true);
     if (newData.isValid() && newData.hasType (Tags::session))
     {
         if (! session->loadData (newData))
@@ -17,7 +17,9 @@
     Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include "session/BinaryModel.h"
 #include "session/Session.h"
+#include "session/SessionArchive.h"
 #include "documents/SessionDocument.h"
 
 namespace Element {
@@ -61,7 +63,27 @@ namespace Element {
             return Result::fail ("No session data target");
 
         String error;
-        if (auto e = XmlDocument::parse (file))
+        if (SessionArchive::isArchive (file))
+        {
+            // states stay compressed until their nodes are created
+            ValueTree newData;
+            SessionArchive archive;
+            archive.setLazyStates (true);
+            const auto result = archive.read (file, newData);
+            if (result.failed())
+                error = result.getErrorMessage();
+            else if (! session->loadData (newData))
+                error = "Could not load session data";
+        }
+        else if (BinaryModel::isBinaryModel (file))
+        {
+            const auto newData = BinaryModel::readFromFile (file, true);
+            if (! newData.hasType (Tags::session))
+                error = "Not a valid session file";
+            else if (! session->loadData (newData))
+                error = "Could not load session data";
+        }
+        else if (auto e = XmlDocument::parse (file))
         {
             ValueTree newData (ValueTree::fromXml (*e));
             if (! newData.isValid() && newData.hasType ("session"))
@@ -88,14 +110,8 @@ namespace Element {
             return Result::fail ("Nil session");
         
         session->saveGraphState();
-        if (auto e = session->createXml())
-        {
-            Result res (e->writeToFile (file, String())
-                    ? Result::ok() : Result::fail ("Error writing session file"));
-            return res;
-        }
-
-        return Result::fail ("Could not create session data");
+        SessionArchive archive;
+        return archive.write (session->getValueTree(), file);
     }
 
     File SessionDocument::getLastDocumentOpened() { return lastSession; }
@@ -18,6 +18,7 @@
 */
 
 #include "engine/AudioEngine.h"
+#include "engine/DiskRecorder.h"
 #include "engine/GraphProcessor.h"
 #include "engine/InternalFormat.h"
 #include "engine/MidiClock.h"
@@ -499,7 +500,6 @@ public:
             }
         }
 
-        const bool wasPlaying = transport.isPlaying();
         AudioSampleBuffer buffer (channels, totalNumChans, numSamples);
         processCurrentGraph (buffer, incomingMidi);
 
@@ -508,24 +508,8 @@ public:
             if (auto* const midiOut = engine.world.getMidiEngine().getDefaultMidiOutput())
             {
                #if defined (EL_PRO)
-                if (sendMidiClockToInput.get() != 1 && generateMidiClock.get() == 1)
-                {
-                    if (wasPlaying != transport.isPlaying())
-                    {
-                        if (transport.isPlaying())
-                        {
-                            incomingMidi.addEvent (transport.getPositionFrames() <= 0 
-                                ? MidiMessage::midiStart() : MidiMessage::midiContinue(), 0);
-                        }
-                        else
-                        {
-                            incomingMidi.addEvent (MidiMessage::midiStop(), 0);
-                        }
-                    }
-
-                    midiClockMaster.setTempo (transport.getTempo());
-                    midiClockMaster.render (incomingMidi, numSamples);
-                }
+                if (! midiClockBuffer.isEmpty())
+                    incomingMidi.addEvents (midiClockBuffer, 0, numSamples, 0);
                #endif
 
                 const double delayMs = midiOutLatency.get();
@@ -547,35 +531,32 @@ public:
         
         const ScopedLock sl (lock);
         const bool shouldProcess = shouldBeLocked.get() == 0;
-        const bool wasPlaying = transport.isPlaying();
         transport.preProcess (numSamples);
+        midiClockBuffer.clear();
+        recorder.beginBlock (shouldProcess && transport.isPlayingAndRecording(), numSamples);
 
         if (shouldProcess)
         {
            #if defined (EL_PRO)
-            if (generateMidiClock.get() == 1 && sendMidiClockToInput.get() == 1)
+            if (generateMidiClock.get() == 1)
             {
-                if (wasPlaying != transport.isPlaying())
-                {
-                    if (transport.isPlaying())
-                    {
-                        midi.addEvent (transport.getPositionFrames() <= 0 
-                            ? MidiMessage::midiStart() : MidiMessage::midiContinue(), 0);
-                    }
-                    else
-                    {
-                        midi.addEvent (MidiMessage::midiStop(), 0);
-                    }
-                }
                 midiClockMaster.setTempo (static_cast<double> (transport.getTempo()));
-                midiClockMaster.render (midi, numSamples);
+                midiClockMaster.sync (transport.isPlaying(), transport.getPositionFrames());
+                if (sendMidiClockToInput.get() == 1)
+                    midiClockMaster.render (midi, numSamples, midiClockToInput);
+                else
+                    midiClockMaster.render (midiClockBuffer, numSamples, midiClockToDevice);
+                midiClockMaster.advance (numSamples);
             }
            #endif
 
             if (currentGraph.get() != graphs.getCurrentGraphIndex())
                 graphs.setCurrentGraph (currentGraph.get());
+            recorder.pushChannels (DiskRecorder::GraphInputs, buffer, numSamples);
             graphs.renderGraphs (buffer, midi);  // user requested index can be cancelled by program changed
             currentGraph.set (graphs.getCurrentGraphIndex());
+            recorder.pushChannels (DiskRecorder::GraphOutputs, buffer, numSamples);
+            recorder.endBlock();
         }
         else
         {
@@ -630,6 +611,11 @@ public:
 
         prepareToPlay (sampleRate, blockSize);
         isPrepared = true;
+
+        recorder.release();
+        if (engine.getRunMode() == RunMode::Standalone)
+            armDefaultOutputTrack();
+        recorder.prepare (sampleRate, blockSize);
     }
     
     void audioDeviceStopped() override
@@ -639,6 +625,7 @@ public:
     
     void audioStopped()
     {
+        recorder.release();
         const ScopedLock sl (lock);
         keyboardState.removeListener (&messageCollector);
         if (isPrepared)
@@ -801,6 +788,8 @@ private:
 
     MidiClock midiClock;
     MidiClockMaster midiClockMaster;
+    MidiClockMaster::Output midiClockToInput, midiClockToDevice;
+    MidiBuffer midiClockBuffer;
     
     AudioPlayHead::CurrentPositionInfo hostPos, lastHostPos;
     
@@ -813,6 +802,30 @@ private:
 
     Atomic<double> midiOutLatency { 0.0 };
 
+    DiskRecorder recorder;
+    RecorderTrack::Ptr defaultOutputTrack;
+
+    /** Records the audio outputs when nothing else is armed, re-armed when
+        the device's output count changes. Call while the recorder is idle */
+    void armDefaultOutputTrack()
+    {
+        const int numTracks = recorder.getNumTracks();
+        if (numTracks == 1 && defaultOutputTrack != nullptr && recorder.getTrack (0) == defaultOutputTrack)
+        {
+            if (defaultOutputTrack->getNumChannels() == numOutputChans)
+                return;
+            recorder.disarmAll();
+        }
+        else if (numTracks > 0)
+        {
+            return;
+        }
+
+        defaultOutputTrack = nullptr;
+        if (recorder.armChannels (DiskRecorder::GraphOutputs, 0, numOutputChans, "Output"))
+            defaultOutputTrack = recorder.getTrack (0);
+    }
+
     void prepareGraph (RootGraph* graph, double sampleRate, int estimatedBlockSize)
     {
         graph->setPlayConfigDetails (numInputChans, numOutputChans,
@@ -821,10 +834,19 @@ private:
         graph->prepareToPlay (sampleRate, estimatedBlockSize);
     }
     
+    /** The clock to the MIDI output is rendered early by the MIDI output
+        latency. Call with the lock held */
+    void updateMidiClockLatency (double rate)
+    {
+        midiClockToDevice.latencySamples = roundToInt (midiOutLatency.get() * 0.001 * rate);
+    }
+
     void prepareToPlay (double sampleRate, int estimatedBlockSize)
     {
-        midiClockMaster.setSampleRate (sampleRate);
         midiClockMaster.setTempo (transport.getTempo());
+        midiClockMaster.setSampleRate (sampleRate);
+        updateMidiClockLatency (sampleRate);
+        midiClockBuffer.ensureSize (3 * 256);
         for (int i = 0; i < graphs.size(); ++i)
             prepareGraph (graphs.getGraph(i), sampleRate, estimatedBlockSize);
     }
@@ -887,6 +909,8 @@ void AudioEngine::applySettings (Settings& settings)
     priv->generateMidiClock.set (settings.generateMidiClock() ? 1 : 0);
     priv->sendMidiClockToInput.set (settings.sendMidiClockToInput() ? 1 : 0);
     priv->midiOutLatency.set (settings.getMidiOutLatency());
+    ScopedLock sl (priv->lock);
+    priv->updateMidiClockLatency (priv->sampleRate);
 }
 
 bool AudioEngine::removeGraph (RootGraph* graph)
@@ -946,6 +970,12 @@ Transport::MonitorPtr AudioEngine::getTransportMonitor() const
     return (priv != nullptr) ? priv->transport.getMonitor() : nullptr;
 }
 
+DiskRecorder& AudioEngine::getDiskRecorder()
+{
+    jassert(priv);
+    return priv->recorder;
+}
+
 void AudioEngine::setMeter (int beatsPerBar, int beatDivisor)
 {
     auto& transport (priv->transport);
@@ -31,6 +31,7 @@
 namespace Element {
 
 class Globals;
+class DiskRecorder;
 class ClipFactory;
 class EngineControl;
 class Settings;
@@ -175,6 +176,7 @@ public:
     
     MidiKeyboardState& getKeyboardState();
     Transport::MonitorPtr getTransportMonitor() const;
+    DiskRecorder& getDiskRecorder();
     AudioIODeviceCallback& getAudioIODeviceCallback() override;
     MidiInputCallback& getMidiInputCallback() override;
     
@@ -0,0 +1,712 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+namespace DSP {
+
+/** Block processors behind the el.dsp Lua module.
+
+    Everything here works on a whole channel at a time. Stateful kernels keep
+    separate state for up to maxChannels channels so one object can run over
+    a multichannel buffer. Apart from DelayLine nothing allocates.
+ */
+enum { maxChannels = 16 };
+
+//==============================================================================
+/** Adds src to dst with a linear gain ramp. The gain is computed from the
+    sample index rather than accumulated so the loop has no dependency
+    between iterations and vectorizes.
+ */
+inline void addWithRamp (float* dst, const float* src, int numSamples,
+                         float startGain, float endGain) noexcept
+{
+    if (numSamples <= 0)
+        return;
+
+    if (startGain == endGain)
+    {
+        FloatVectorOperations::addWithMultiply (dst, src, startGain, numSamples);
+        return;
+    }
+
+    const float step = (endGain - startGain) / (float) numSamples;
+    for (int i = 0; i < numSamples; ++i)
+        dst[i] += src[i] * (startGain + step * (float) i);
+}
+
+/** Multiplies data by a linear gain ramp */
+inline void applyRamp (float* data, int numSamples, float startGain, float endGain) noexcept
+{
+    if (numSamples <= 0)
+        return;
+
+    if (startGain == endGain)
+    {
+        FloatVectorOperations::multiply (data, startGain, numSamples);
+        return;
+    }
+
+    const float step = (endGain - startGain) / (float) numSamples;
+    for (int i = 0; i < numSamples; ++i)
+        data[i] *= startGain + step * (float) i;
+}
+
+/** Equal power pan gains, pan goes from -1 (left) to 1 (right) */
+inline void getPanGains (float pan, float& left, float& right) noexcept
+{
+    const float angle = (jlimit (-1.f, 1.f, pan) + 1.f) * MathConstants<float>::pi * 0.25f;
+    left  = std::cos (angle);
+    right = std::sin (angle);
+}
+
+//==============================================================================
+/** Waveshapers. Each scales by drive first */
+inline void hardClip (float* data, int numSamples, float drive = 1.f) noexcept
+{
+    if (drive != 1.f)
+        FloatVectorOperations::multiply (data, drive, numSamples);
+    FloatVectorOperations::clip (data, data, -1.f, 1.f, numSamples);
+}
+
+/** Cubic soft clipper, reaches full scale at an input of one */
+inline void softClip (float* data, int numSamples, float drive = 1.f) noexcept
+{
+    hardClip (data, numSamples, drive);
+    for (int i = 0; i < numSamples; ++i)
+        data[i] = 1.5f * data[i] - 0.5f * data[i] * data[i] * data[i];
+}
+
+inline void tanhShape (float* data, int numSamples, float drive = 1.f) noexcept
+{
+    for (int i = 0; i < numSamples; ++i)
+        data[i] = std::tanh (data[i] * drive);
+}
+
+//==============================================================================
+/** Biquad filter coefficients, normalized so a0 is one */
+struct BiquadCoefficients
+{
+    float b0 = 1.f, b1 = 0.f, b2 = 0.f, a1 = 0.f, a2 = 0.f;
+
+    enum Type
+    {
+        lowPass = 0,
+        highPass,
+        bandPass,
+        notch,
+        allPass,
+        peak,
+        lowShelf,
+        highShelf
+    };
+
+    /** Designs a filter from the RBJ cookbook formulas. gainDb is only used
+        by the peak and shelf types.
+     */
+    static BiquadCoefficients make (Type type, double sampleRate, double frequency,
+                                    double q = 0.7071, double gainDb = 0.0) noexcept
+    {
+        jassert (sampleRate > 0.0);
+        frequency = jlimit (1.0, sampleRate * 0.499, frequency);
+        q = jmax (0.01, q);
+
+        const double w0    = MathConstants<double>::twoPi * frequency / sampleRate;
+        const double cosw  = std::cos (w0);
+        const double alpha = std::sin (w0) / (2.0 * q);
+        const double A     = std::pow (10.0, gainDb / 40.0);
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a0 = 1.0, a1 = 0.0, a2 = 0.0;
+
+        switch (type)
+        {
+            case lowPass:
+                b0 = b2 = (1.0 - cosw) * 0.5;
+                b1 = 1.0 - cosw;
+                a0 = 1.0 + alpha; a1 = -2.0 * cosw; a2 = 1.0 - alpha;
+                break;
+            case highPass:
+                b0 = b2 = (1.0 + cosw) * 0.5;
+                b1 = -(1.0 + cosw);
+                a0 = 1.0 + alpha; a1 = -2.0 * cosw; a2 = 1.0 - alpha;
+                break;
+            case bandPass:
+                b0 = alpha; b1 = 0.0; b2 = -alpha;
+                a0 = 1.0 + alpha; a1 = -2.0 * cosw; a2 = 1.0 - alpha;
+                break;
+            case notch:
+                b0 = b2 = 1.0; b1 = -2.0 * cosw;
+                a0 = 1.0 + alpha; a1 = -2.0 * cosw; a2 = 1.0 - alpha;
+                break;
+            case allPass:
+                b0 = 1.0 - alpha; b1 = -2.0 * cosw; b2 = 1.0 + alpha;
+                a0 = 1.0 + alpha; a1 = -2.0 * cosw; a2 = 1.0 - alpha;
+                break;
+            case peak:
+                b0 = 1.0 + alpha * A; b1 = -2.0 * cosw; b2 = 1.0 - alpha * A;
+                a0 = 1.0 + alpha / A; a1 = -2.0 * cosw; a2 = 1.0 - alpha / A;
+                break;
+            case lowShelf:
+            {
+                const double s = 2.0 * std::sqrt (A) * alpha;
+                b0 = A * ((A + 1.0) - (A - 1.0) * cosw + s);
+                b1 = 2.0 * A * ((A - 1.0) - (A + 1.0) * cosw);
+                b2 = A * ((A + 1.0) - (A - 1.0) * cosw - s);
+                a0 = (A + 1.0) + (A - 1.0) * cosw + s;
+                a1 = -2.0 * ((A - 1.0) + (A + 1.0) * cosw);
+                a2 = (A + 1.0) + (A - 1.0) * cosw - s;
+                break;
+            }
+            case highShelf:
+            {
+                const double s = 2.0 * std::sqrt (A) * alpha;
+                b0 = A * ((A + 1.0) + (A - 1.0) * cosw + s);
+                b1 = -2.0 * A * ((A - 1.0) + (A + 1.0) * cosw);
+                b2 = A * ((A + 1.0) + (A - 1.0) * cosw - s);
+                a0 = (A + 1.0) - (A - 1.0) * cosw + s;
+                a1 = 2.0 * ((A - 1.0) - (A + 1.0) * cosw);
+                a2 = (A + 1.0) - (A - 1.0) * cosw - s;
+                break;
+            }
+        }
+
+        BiquadCoefficients c;
+        c.b0 = (float) (b0 / a0);
+        c.b1 = (float) (b1 / a0);
+        c.b2 = (float) (b2 / a0);
+        c.a1 = (float) (a1 / a0);
+        c.a2 = (float) (a2 / a0);
+        return c;
+    }
+};
+
+/** Transposed direct form II biquad */
+class Biquad
+{
+public:
+    Biquad() { reset(); }
+
+    void setCoefficients (const BiquadCoefficients& c) noexcept { coeffs = c; }
+    const BiquadCoefficients& getCoefficients() const noexcept  { return coeffs; }
+
+    void reset() noexcept
+    {
+        zeromem (z1, sizeof (z1));
+        zeromem (z2, sizeof (z2));
+    }
+
+    void process (float* data, int numSamples, int channel) noexcept
+    {
+        jassert (isPositiveAndBelow (channel, (int) maxChannels));
+        const auto c = coeffs;
+        float s1 = z1[channel], s2 = z2[channel];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float x = data[i];
+            const float y = c.b0 * x + s1;
+            s1 = c.b1 * x - c.a1 * y + s2;
+            s2 = c.b2 * x - c.a2 * y;
+            data[i] = y;
+        }
+
+        z1[channel] = snapToZero (s1);
+        z2[channel] = snapToZero (s2);
+    }
+
+private:
+    BiquadCoefficients coeffs;
+    float z1 [maxChannels], z2 [maxChannels];
+
+    static float snapToZero (float v) noexcept { return std::abs (v) < 1.0e-15f ? 0.f : v; }
+};
+
+//==============================================================================
+/** Topology preserving state variable filter. Unlike the biquad its cutoff
+    can be moved every block without zipper noise or blowing up.
+ */
+class StateVariableFilter
+{
+public:
+    enum Mode { lowPass = 0, highPass, bandPass, notch };
+
+    StateVariableFilter() { reset(); }
+
+    void setMode (Mode newMode) noexcept { mode = newMode; }
+    Mode getMode() const noexcept        { return mode; }
+
+    void setParameters (double sampleRate, double frequency, double q = 0.7071) noexcept
+    {
+        jassert (sampleRate > 0.0);
+        frequency = jlimit (1.0, sampleRate * 0.499, frequency);
+        const double g = std::tan (MathConstants<double>::pi * frequency / sampleRate);
+        k  = (float) (1.0 / jmax (0.01, q));
+        a1 = (float) (1.0 / (1.0 + g * (g + k)));
+        a2 = (float) g * a1;
+        a3 = (float) g * a2;
+    }
+
+    void reset() noexcept
+    {
+        zeromem (ic1, sizeof (ic1));
+        zeromem (ic2, sizeof (ic2));
+    }
+
+    void process (float* data, int numSamples, int channel) noexcept
+    {
+        jassert (isPositiveAndBelow (channel, (int) maxChannels));
+        float s1 = ic1[channel], s2 = ic2[channel];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float x  = data[i];
+            const float v3 = x - s2;
+            const float v1 = a1 * s1 + a2 * v3;
+            const float v2 = s2 + a2 * s1 + a3 * v3;
+            s1 = 2.f * v1 - s1;
+            s2 = 2.f * v2 - s2;
+
+            switch (mode)
+            {
+                case lowPass:  data[i] = v2; break;
+                case highPass: data[i] = x - k * v1 - v2; break;
+                case bandPass: data[i] = v1; break;
+                case notch:    data[i] = x - k * v1; break;
+            }
+        }
+
+        ic1[channel] = s1;
+        ic2[channel] = s2;
+    }
+
+private:
+    Mode mode = lowPass;
+    float k = 1.f, a1 = 1.f, a2 = 0.f, a3 = 0.f;
+    float ic1 [maxChannels], ic2 [maxChannels];
+};
+
+//==============================================================================
+/** A gain that moves linearly to its target over a fixed time */
+class SmoothedGain
+{
+public:
+    SmoothedGain() = default;
+
+    void prepare (double sampleRate, double rampSeconds = 0.02) noexcept
+    {
+        rampLength = jmax (1, roundToInt (sampleRate * rampSeconds));
+        setCurrentAndTarget (target);
+    }
+
+    void setTarget (float newTarget) noexcept
+    {
+        if (newTarget == target)
+            return;
+        target = newTarget;
+        remaining = rampLength;
+        step = (target - current) / (float) rampLength;
+    }
+
+    void setCurrentAndTarget (float gain) noexcept
+    {
+        current = target = gain;
+        remaining = 0;
+        step = 0.f;
+    }
+
+    float getCurrent() const noexcept { return current; }
+    float getTarget() const noexcept  { return target; }
+    bool isSmoothing() const noexcept { return remaining > 0; }
+
+    /** Applies the gain to every channel and advances it by numSamples */
+    void process (float* const* channels, int numChannels, int numSamples) noexcept
+    {
+        const int numRamped = jmin (remaining, numSamples);
+        const float end = numRamped == remaining ? target : current + step * (float) numRamped;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            applyRamp (channels[ch], numRamped, current, end);
+            if (numRamped < numSamples)
+                FloatVectorOperations::multiply (channels[ch] + numRamped, target, numSamples - numRamped);
+        }
+
+        current = end;
+        remaining -= numRamped;
+    }
+
+private:
+    float current = 1.f, target = 1.f, step = 0.f;
+    int remaining = 0, rampLength = 1;
+};
+
+//==============================================================================
+/** Turns parameter changes into a straight line per block.
+
+    Targets change whenever a parameter is set, in steps. advance() moves each
+    parameter towards its target once per block and records the ramp it made:
+    the value at the start of the block, the value it reached and the number
+    of samples it took, after which it stays put. With no smoothing time a
+    change is spread over the block it arrives in.
+ */
+class ParameterRamps
+{
+public:
+    enum { maxParameters = 128 };
+
+    struct Ramp
+    {
+        float start = 0.f;
+        float end = 0.f;
+        /** Samples from the start of the block until end is reached, zero
+            when the parameter didn't move */
+        int length = 0;
+    };
+
+    ParameterRamps() = default;
+
+    void prepare (double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+        for (int i = 0; i < numParameters; ++i)
+        {
+            updateRampLength (i);
+            reset (i, states[i].target);
+        }
+    }
+
+    void setNumParameters (int newNumParameters) noexcept
+    {
+        numParameters = jlimit (0, (int) maxParameters, newNumParameters);
+    }
+
+    int getNumParameters() const noexcept { return numParameters; }
+
+    /** Sets how long a change takes, zero spreads it over one block */
+    void setSmoothingTime (int index, double seconds) noexcept
+    {
+        if (! isPositiveAndBelow (index, numParameters))
+            return;
+        states[index].seconds = jmax (0.0, seconds);
+        updateRampLength (index);
+    }
+
+    /** Jumps to a value without a ramp */
+    void reset (int index, float value) noexcept
+    {
+        if (! isPositiveAndBelow (index, numParameters))
+            return;
+        auto& state = states[index];
+        state.current = state.target = value;
+        state.step = 0.f;
+        state.remaining = 0;
+        ramps[index] = { value, value, 0 };
+    }
+
+    /** Moves every parameter towards its target for a block */
+    void advance (const float* targets, int numSamples) noexcept
+    {
+        for (int i = 0; i < numParameters; ++i)
+        {
+            auto& state = states[i];
+            if (targets[i] != state.target)
+            {
+                state.target = targets[i];
+                state.remaining = state.rampLength > 0 ? state.rampLength : numSamples;
+                state.step = (state.target - state.current) / (float) jmax (1, state.remaining);
+            }
+
+            auto& ramp = ramps[i];
+            ramp.start = state.current;
+            ramp.length = jmin (state.remaining, numSamples);
+            if (ramp.length > 0)
+            {
+                state.remaining -= ramp.length;
+                state.current = state.remaining > 0
+                    ? state.current + state.step * (float) ramp.length
+                    : state.target;
+            }
+            ramp.end = state.current;
+        }
+    }
+
+    const Ramp& getRamp (int index) const noexcept
+    {
+        jassert (isPositiveAndBelow (index, numParameters));
+        return ramps[index];
+    }
+
+    /** Returns a parameter's value at a frame of the current block */
+    float getValue (int index, int frame) const noexcept
+    {
+        const auto& ramp = getRamp (index);
+        if (frame >= ramp.length)
+            return ramp.end;
+        return ramp.start + (ramp.end - ramp.start) * (float) frame / (float) ramp.length;
+    }
+
+    /** Multiplies samples by a parameter's ramp. When decibels is true the
+        parameter is converted to a gain at both ends of the ramp.
+     */
+    void applyGain (int index, float* data, int numSamples, bool decibels) const noexcept
+    {
+        const auto& ramp = getRamp (index);
+        const float start = decibels ? Decibels::decibelsToGain (ramp.start) : ramp.start;
+        const float end   = decibels ? Decibels::decibelsToGain (ramp.end)   : ramp.end;
+        const int numRamped = jmin (ramp.length, numSamples);
+
+        applyRamp (data, numRamped, start, end);
+        if (numRamped < numSamples && end != 1.f)
+            FloatVectorOperations::multiply (data + numRamped, end, numSamples - numRamped);
+    }
+
+private:
+    struct State
+    {
+        float current = 0.f, target = 0.f, step = 0.f;
+        int remaining = 0, rampLength = 0;
+        double seconds = 0.0;
+    };
+
+    State states [maxParameters];
+    Ramp ramps [maxParameters];
+    int numParameters = 0;
+    double sampleRate = 44100.0;
+
+    void updateRampLength (int index) noexcept
+    {
+        auto& state = states[index];
+        state.rampLength = state.seconds > 0.0 ? jmax (1, roundToInt (sampleRate * state.seconds)) : 0;
+    }
+};
+
+//==============================================================================
+/** Feedback delay with a linearly interpolated, fractional delay time.
+    The memory is allocated up front, create these outside of process().
+ */
+class DelayLine
+{
+public:
+    DelayLine (int maxDelaySamples, int numChannelsToAllocate)
+        : size (jmax (2, maxDelaySamples + 1)),
+          numChannels (jlimit (1, (int) maxChannels, numChannelsToAllocate))
+    {
+        lines.allocate ((size_t) (size * numChannels), true);
+        zeromem (writePos, sizeof (writePos));
+    }
+
+    int getMaxDelay() const noexcept    { return size - 1; }
+    int getNumChannels() const noexcept { return numChannels; }
+
+    void setDelay (float samples) noexcept    { delay = jlimit (0.f, (float) (size - 1), samples); }
+    float getDelay() const noexcept           { return delay; }
+    void setFeedback (float amount) noexcept  { feedback = jlimit (-0.999f, 0.999f, amount); }
+    float getFeedback() const noexcept        { return feedback; }
+    void setMix (float amount) noexcept       { mix = jlimit (0.f, 1.f, amount); }
+    float getMix() const noexcept             { return mix; }
+
+    void reset() noexcept
+    {
+        FloatVectorOperations::clear (lines.get(), size * numChannels);
+        zeromem (writePos, sizeof (writePos));
+    }
+
+    void process (float* data, int numSamples, int channel) noexcept
+    {
+        if (! isPositiveAndBelow (channel, numChannels))
+            return;
+
+        float* const line = lines + channel * size;
+        const int whole = (int) delay;
+        const float frac = delay - (float) whole;
+        const float dry = 1.f - mix;
+        int pos = writePos[channel];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            int r1 = pos - whole;
+            if (r1 < 0) r1 += size;
+            int r2 = r1 - 1;
+            if (r2 < 0) r2 += size;
+
+            // at zero delay r1 is the slot about to be written
+            const float a = whole == 0 ? data[i] : line[r1];
+            const float wet = a + frac * (line[r2] - a);
+            line[pos] = data[i] + wet * feedback;
+            data[i] = data[i] * dry + wet * mix;
+
+            if (++pos == size)
+                pos = 0;
+        }
+
+        writePos[channel] = pos;
+    }
+
+private:
+    const int size, numChannels;
+    HeapBlock<float> lines;
+    int writePos [maxChannels];
+    float delay = 0.f, feedback = 0.f, mix = 1.f;
+    JUCE_DECLARE_NON_COPYABLE (DelayLine)
+};
+
+//==============================================================================
+/** Peak envelope follower with separate attack and release times */
+class EnvelopeFollower
+{
+public:
+    EnvelopeFollower() { reset(); }
+
+    void prepare (double sampleRate, double attackSeconds, double releaseSeconds) noexcept
+    {
+        attack  = getCoefficient (sampleRate, attackSeconds);
+        release = getCoefficient (sampleRate, releaseSeconds);
+    }
+
+    void reset() noexcept { zeromem (envelope, sizeof (envelope)); }
+
+    float getEnvelope (int channel) const noexcept
+    {
+        return isPositiveAndBelow (channel, (int) maxChannels) ? envelope[channel] : 0.f;
+    }
+
+    /** Follows a block of input, writing the envelope to output if it isn't
+        null. Returns the envelope at the end of the block.
+     */
+    float process (const float* input, float* output, int numSamples, int channel) noexcept
+    {
+        jassert (isPositiveAndBelow (channel, (int) maxChannels));
+        float env = envelope[channel];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float x = std::abs (input[i]);
+            const float coeff = x > env ? attack : release;
+            env = x + coeff * (env - x);
+            if (output != nullptr)
+                output[i] = env;
+        }
+
+        return envelope[channel] = env < 1.0e-15f ? 0.f : env;
+    }
+
+private:
+    float attack = 0.f, release = 0.f;
+    float envelope [maxChannels];
+
+    static float getCoefficient (double sampleRate, double seconds) noexcept
+    {
+        return seconds <= 0.0 ? 0.f : (float) std::exp (-1.0 / (seconds * sampleRate));
+    }
+};
+
+//==============================================================================
+/** Sine, saw, square and triangle oscillator. Saw and square are band
+    limited with polyBLEP, the triangle isn't.
+ */
+class Oscillator
+{
+public:
+    enum Waveform { sine = 0, saw, square, triangle };
+
+    void setWaveform (Waveform newWaveform) noexcept { waveform = newWaveform; }
+    Waveform getWaveform() const noexcept            { return waveform; }
+
+    void setFrequency (double sampleRate, double frequency) noexcept
+    {
+        jassert (sampleRate > 0.0);
+        increment = jlimit (0.0, 0.5, frequency / sampleRate);
+    }
+
+    void reset (double newPhase = 0.0) noexcept { phase = newPhase - std::floor (newPhase); }
+    double getPhase() const noexcept            { return phase; }
+
+    /** Writes numSamples to output, scaled by gain */
+    void render (float* output, int numSamples, float gain = 1.f) noexcept
+    {
+        double p = phase;
+        const double dt = increment;
+
+        switch (waveform)
+        {
+            case sine:
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    output[i] = gain * (float) std::sin (MathConstants<double>::twoPi * p);
+                    p = wrap (p + dt);
+                }
+                break;
+
+            case saw:
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    output[i] = gain * (float) (2.0 * p - 1.0 - polyBlep (p, dt));
+                    p = wrap (p + dt);
+                }
+                break;
+
+            case square:
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    const double v = (p < 0.5 ? 1.0 : -1.0)
+                        + polyBlep (p, dt) - polyBlep (wrap (p + 0.5), dt);
+                    output[i] = gain * (float) v;
+                    p = wrap (p + dt);
+                }
+                break;
+
+            case triangle:
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    output[i] = gain * (float) (4.0 * std::abs (p - 0.5) - 1.0);
+                    p = wrap (p + dt);
+                }
+                break;
+        }
+
+        phase = p;
+    }
+
+private:
+    Waveform waveform = sine;
+    double phase = 0.0, increment = 0.0;
+
+    static double wrap (double p) noexcept { return p >= 1.0 ? p - 1.0 : p; }
+
+    static double polyBlep (double t, double dt) noexcept
+    {
+        if (dt <= 0.0)
+            return 0.0;
+        if (t < dt)
+        {
+            t /= dt;
+            return t + t - t * t - 1.0;
+        }
+        if (t > 1.0 - dt)
+        {
+            t = (t - 1.0) / dt;
+            return t * t + t + t + 1.0;
+        }
+        return 0.0;
+    }
+};
+
+}}
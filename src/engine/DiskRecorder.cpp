@@ -0,0 +1,509 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/DiskRecorder.h"
+#include "engine/NodeObject.h"
+#include "DataPath.h"
+
+#if JUCE_LINUX
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+
+namespace Element {
+
+// how often the writer drains the FIFOs
+static constexpr int writerIntervalMs       = 10;
+// how often files are flushed to disk
+static constexpr uint32 flushIntervalMs     = 2000;
+// seconds of audio disk space is reserved for at a time
+static constexpr int preallocateSeconds     = 30;
+static constexpr int fileBufferSize         = 1 << 20;
+static constexpr int bitsPerSample          = 32;
+
+/** Reserves disk space past the end of a file without changing its size,
+    so writing a long take doesn't fragment the file. Only on Linux, other
+    platforms can't keep the space once the file is closed and reopened */
+static void preallocate (const File& file, int64 offset, int64 numBytes)
+{
+   #if JUCE_LINUX
+    const int fd = ::open (file.getFullPathName().toRawUTF8(), O_WRONLY);
+    if (fd < 0)
+        return;
+    ::fallocate (fd, FALLOC_FL_KEEP_SIZE, (off_t) offset, (off_t) numBytes);
+    ::close (fd);
+   #else
+    ignoreUnused (file, offset, numBytes);
+   #endif
+}
+
+/** Gives back the space preallocate() reserved but the take didn't use */
+static void releasePreallocated (const File& file)
+{
+   #if JUCE_LINUX
+    if (file.existsAsFile())
+        ignoreUnused (::truncate (file.getFullPathName().toRawUTF8(), (off_t) file.getSize()));
+   #else
+    ignoreUnused (file);
+   #endif
+}
+
+//=============================================================================
+RecorderTrack::RecorderTrack (DiskRecorder& r, int type, int first, int numChans,
+                              NodeObject* n, const String& trackName)
+    : recorder (r), sourceType (type), firstChannel (first),
+      numChannels (jmax (1, numChans)), node (n), name (trackName)
+{
+    channels.malloc ((size_t) numChannels);
+}
+
+RecorderTrack::~RecorderTrack() { }
+
+File RecorderTrack::getFile() const
+{
+    ScopedLock sl (fileLock);
+    return file;
+}
+
+void RecorderTrack::allocate (int capacity)
+{
+    buffer.setSize (numChannels, capacity, false, true, false);
+    fifo.setTotalSize (capacity);
+    fifo.reset();
+}
+
+void RecorderTrack::push (const AudioSampleBuffer& source, int numSamples) noexcept
+{
+    if (! recorder.isCapturing() || pushed)
+        return;
+
+    pushed = true;
+    if (fifo.getFreeSpace() < numSamples)
+    {
+        ++recorder.numOverruns;
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (numSamples, start1, size1, start2, size2);
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const int sourceChannel = firstChannel + ch;
+        if (sourceChannel < source.getNumChannels())
+        {
+            const auto* data = source.getReadPointer (sourceChannel);
+            if (size1 > 0)
+                buffer.copyFrom (ch, start1, data, size1);
+            if (size2 > 0)
+                buffer.copyFrom (ch, start2, data + size1, size2);
+        }
+        else
+        {
+            if (size1 > 0)
+                buffer.clear (ch, start1, size1);
+            if (size2 > 0)
+                buffer.clear (ch, start2, size2);
+        }
+    }
+
+    fifo.finishedWrite (size1 + size2);
+    recorder.noteHeadroom ((float) fifo.getFreeSpace() / (float) fifo.getTotalSize());
+}
+
+void RecorderTrack::pushSilence (int numSamples) noexcept
+{
+    if (fifo.getFreeSpace() < numSamples)
+    {
+        ++recorder.numOverruns;
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (numSamples, start1, size1, start2, size2);
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        if (size1 > 0)
+            buffer.clear (ch, start1, size1);
+        if (size2 > 0)
+            buffer.clear (ch, start2, size2);
+    }
+    fifo.finishedWrite (size1 + size2);
+}
+
+bool RecorderTrack::write (const float* const* data, int numSamples)
+{
+    if (writer == nullptr || ! writer->writeFromFloatArrays (data, numChannels, numSamples))
+        return false;
+
+    framesWritten += numSamples;
+    bytesWritten += (int64) numSamples * numChannels * (bitsPerSample / 8);
+
+    // stay well ahead of the writes
+    const auto chunk = (int64) (writer->getSampleRate() * preallocateSeconds) * numChannels * (bitsPerSample / 8);
+    if (bytesWritten + chunk / 2 > bytesAllocated)
+    {
+        preallocate (file, bytesAllocated, chunk);
+        bytesAllocated += chunk;
+    }
+
+    return true;
+}
+
+//=============================================================================
+DiskRecorder::DiskRecorder()
+    : Thread ("Element Disk Recorder"),
+      directory (getDefaultDirectory())
+{
+}
+
+DiskRecorder::~DiskRecorder()
+{
+    release();
+}
+
+File DiskRecorder::getDefaultDirectory()
+{
+    return DataPath::defaultUserDataPath().getChildFile ("Recordings");
+}
+
+void DiskRecorder::setDirectory (const File& newDirectory)
+{
+    ScopedLock sl (directoryLock);
+    directory = newDirectory;
+}
+
+File DiskRecorder::getDirectory() const
+{
+    ScopedLock sl (directoryLock);
+    return directory;
+}
+
+void DiskRecorder::setBufferSeconds (double seconds)
+{
+    ScopedLock sl (lock);
+    bufferSeconds = jlimit (0.25, 60.0, seconds);
+}
+
+bool DiskRecorder::canChangeTracks() const
+{
+    return state.load() == Idle;
+}
+
+bool DiskRecorder::armChannels (SourceType type, int firstChannel, int numChannels, const String& name)
+{
+    jassert (type != NodeOutputs);
+    ScopedLock sl (lock);
+    if (! canChangeTracks() || type == NodeOutputs || numChannels <= 0)
+        return false;
+
+    RecorderTrack::Ptr track = new RecorderTrack (*this, type, jmax (0, firstChannel),
+                                                  numChannels, nullptr, name);
+    if (sampleRate > 0.0)
+        track->allocate (jmax (blockSize * 4, roundToInt (bufferSeconds * sampleRate)));
+    tracks.add (track);
+    return true;
+}
+
+bool DiskRecorder::armNode (NodeObject* node, const String& name)
+{
+    ScopedLock sl (lock);
+    const int numChannels = node != nullptr ? node->getNumPorts (PortType::Audio, false) : 0;
+    if (! canChangeTracks() || numChannels <= 0 || node->recordTrack.load() != nullptr)
+        return false;
+
+    RecorderTrack::Ptr track = new RecorderTrack (*this, NodeOutputs, 0, numChannels, node, name);
+    if (sampleRate > 0.0)
+        track->allocate (jmax (blockSize * 4, roundToInt (bufferSeconds * sampleRate)));
+    tracks.add (track);
+    node->recordTrack.store (track.get());
+    return true;
+}
+
+bool DiskRecorder::disarmAll()
+{
+    ScopedLock sl (lock);
+    if (! canChangeTracks())
+        return false;
+
+    for (auto* track : tracks)
+        if (track->node != nullptr)
+            track->node->recordTrack.store (nullptr);
+
+    // the audio thread might still hold a node's track, keep them until it stops
+    retired.addArray (tracks);
+    tracks.clear();
+    return true;
+}
+
+int DiskRecorder::getNumTracks() const
+{
+    ScopedLock sl (lock);
+    return tracks.size();
+}
+
+RecorderTrack::Ptr DiskRecorder::getTrack (int index) const
+{
+    ScopedLock sl (lock);
+    return tracks [index];
+}
+
+void DiskRecorder::prepare (double newSampleRate, int maxBlockSize)
+{
+    release();
+
+    {
+        ScopedLock sl (lock);
+        sampleRate  = newSampleRate;
+        blockSize   = maxBlockSize;
+        const int capacity = jmax (blockSize * 4, roundToInt (bufferSeconds * sampleRate));
+        for (auto* track : tracks)
+            track->allocate (capacity);
+        retired.clear();
+    }
+
+    resetStats();
+    startThread (7);
+}
+
+void DiskRecorder::release()
+{
+    capturing.store (false);
+    if (state.load() == Recording)
+        state.store (Stopping);
+
+    // the writer finishes the take before it exits
+    signalThreadShouldExit();
+    notify();
+    stopThread (10000);
+    state.store (Idle);
+
+    ScopedLock sl (lock);
+    retired.clear();
+}
+
+//=============================================================================
+void DiskRecorder::beginBlock (bool shouldRecord, int numSamples) noexcept
+{
+    blockSamples = numSamples;
+    int current = state.load();
+
+    if (current == Idle && shouldRecord)
+    {
+        // tracks are only armed while idle, this makes the change atomic
+        const ScopedTryLock sl (lock);
+        if (sl.isLocked() && sampleRate > 0.0 && ! tracks.isEmpty())
+        {
+            current = Recording;
+            state.store (current);
+        }
+    }
+    else if (current == Recording && ! shouldRecord)
+    {
+        current = Stopping;
+        state.store (current);
+    }
+
+    const bool capture = current == Recording;
+    if (capture)
+        for (auto* track : tracks)
+            track->pushed = false;
+    capturing.store (capture);
+}
+
+void DiskRecorder::pushChannels (SourceType type, const AudioSampleBuffer& buffer, int numSamples) noexcept
+{
+    if (! isCapturing())
+        return;
+    for (auto* track : tracks)
+        if (track->sourceType == type)
+            track->push (buffer, numSamples);
+}
+
+void DiskRecorder::endBlock() noexcept
+{
+    if (! isCapturing())
+        return;
+    for (auto* track : tracks)
+        if (! track->pushed)
+            track->pushSilence (blockSamples);
+    capturing.store (false);
+}
+
+void DiskRecorder::noteHeadroom (float headroom) noexcept
+{
+    auto lowest = minHeadroom.load();
+    while (headroom < lowest && ! minHeadroom.compare_exchange_weak (lowest, headroom)) { }
+}
+
+//=============================================================================
+bool DiskRecorder::waitUntilIdle (int timeoutMs)
+{
+    const auto started = Time::getMillisecondCounter();
+    while (isRecording())
+    {
+        if (timeoutMs >= 0 && Time::getMillisecondCounter() - started > (uint32) timeoutMs)
+            return false;
+        Thread::sleep (writerIntervalMs);
+    }
+    return true;
+}
+
+DiskRecorder::Stats DiskRecorder::getStats() const
+{
+    Stats stats;
+    {
+        ScopedLock sl (lock);
+        stats.numTracks = tracks.size();
+        for (const auto* track : tracks)
+            stats.numChannels += track->getNumChannels();
+    }
+
+    stats.recording         = isRecording();
+    stats.framesWritten     = framesWritten.load();
+    stats.throughputMBps    = throughput.load();
+    stats.bufferHeadroom    = (double) minHeadroom.load();
+    stats.numOverruns       = numOverruns.load();
+    return stats;
+}
+
+void DiskRecorder::resetStats()
+{
+    minHeadroom.store (1.f);
+    numOverruns.store (0);
+    throughput.store (0.0);
+}
+
+//=============================================================================
+void DiskRecorder::openTake()
+{
+    const auto dir = getDirectory();
+    dir.createDirectory();
+    const auto stamp = Time::getCurrentTime().formatted ("%Y-%m-%d %H-%M-%S");
+    WavAudioFormat wav;
+
+    // tracks don't change until the take is closed
+    for (auto* track : tracks)
+    {
+        const auto file = dir.getChildFile (stamp + " " + File::createLegalFileName (track->getName()))
+                             .withFileExtension ("wav").getNonexistentSibling();
+        std::unique_ptr<FileOutputStream> stream (new FileOutputStream (file, fileBufferSize));
+        if (stream->failedToOpen())
+        {
+            DBG("[EL] recorder couldn't create " << file.getFullPathName());
+            continue;
+        }
+
+        track->writer.reset (wav.createWriterFor (stream.get(), sampleRate,
+            (unsigned int) track->getNumChannels(), bitsPerSample, {}, 0));
+        if (track->writer != nullptr)
+            stream.release();
+
+        track->framesWritten = track->bytesWritten = track->bytesAllocated = 0;
+        ScopedLock sl (track->fileLock);
+        track->file = file;
+    }
+
+    framesWritten.store (0);
+    bytesSinceUpdate = 0;
+    lastUpdate = lastFlush = Time::getMillisecondCounter();
+    takeOpen = true;
+}
+
+void DiskRecorder::drain()
+{
+    int64 frames = 0;
+
+    for (auto* track : tracks)
+    {
+        const int ready = track->fifo.getNumReady();
+        if (ready > 0)
+        {
+            int start1, size1, start2, size2;
+            track->fifo.prepareToRead (ready, start1, size1, start2, size2);
+            for (const auto& region : { std::make_pair (start1, size1), std::make_pair (start2, size2) })
+            {
+                if (region.second <= 0)
+                    continue;
+                for (int ch = 0; ch < track->getNumChannels(); ++ch)
+                    track->channels[ch] = track->buffer.getReadPointer (ch, region.first);
+                if (track->write (track->channels, region.second))
+                    bytesSinceUpdate += (int64) region.second * track->getNumChannels() * (bitsPerSample / 8);
+            }
+            track->fifo.finishedRead (size1 + size2);
+        }
+
+        frames = jmax (frames, track->framesWritten);
+    }
+
+    framesWritten.store (frames);
+
+    const auto now = Time::getMillisecondCounter();
+    if (now - lastUpdate >= 1000)
+    {
+        throughput.store ((double) bytesSinceUpdate / (1024.0 * 1024.0) * 1000.0 / (double) (now - lastUpdate));
+        bytesSinceUpdate = 0;
+        lastUpdate = now;
+    }
+
+    if (now - lastFlush >= flushIntervalMs)
+    {
+        // a WAV writer's flush updates the header and syncs the file
+        for (auto* track : tracks)
+            if (track->writer != nullptr)
+                track->writer->flush();
+        lastFlush = now;
+    }
+}
+
+void DiskRecorder::closeTake()
+{
+    drain();
+    for (auto* track : tracks)
+    {
+        track->writer.reset();
+        releasePreallocated (track->getFile());
+    }
+    takeOpen = false;
+}
+
+void DiskRecorder::run()
+{
+    while (! threadShouldExit())
+    {
+        const int current = state.load();
+        if (current != Idle && ! takeOpen)
+            openTake();
+        if (takeOpen)
+            drain();
+        if (current == Stopping)
+        {
+            if (takeOpen)
+                closeTake();
+            state.store (Idle);
+        }
+
+        wait (writerIntervalMs);
+    }
+
+    if (takeOpen)
+        closeTake();
+    state.store (Idle);
+}
+
+}
@@ -0,0 +1,200 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+class DiskRecorder;
+class NodeObject;
+
+/** One armed track of a DiskRecorder, written to its own file */
+class RecorderTrack : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<RecorderTrack>;
+
+    ~RecorderTrack();
+
+    const String& getName() const noexcept  { return name; }
+    int getNumChannels() const noexcept     { return numChannels; }
+
+    /** The file of the current or last take */
+    File getFile() const;
+
+    /** Audio thread. Copies this track's channels of a block into its FIFO
+        while the recorder is capturing */
+    void push (const AudioSampleBuffer& source, int numSamples) noexcept;
+
+private:
+    friend class DiskRecorder;
+    RecorderTrack (DiskRecorder&, int sourceType, int firstChannel, int numChannels,
+                   NodeObject* node, const String& name);
+
+    DiskRecorder& recorder;
+    const int sourceType, firstChannel, numChannels;
+    ReferenceCountedObjectPtr<NodeObject> node;
+    const String name;
+
+    AbstractFifo fifo { 1 };
+    AudioSampleBuffer buffer;
+    bool pushed = false;
+
+    // writer thread only
+    File file;
+    std::unique_ptr<AudioFormatWriter> writer;
+    HeapBlock<const float*> channels;
+    int64 framesWritten = 0, bytesWritten = 0, bytesAllocated = 0;
+    CriticalSection fileLock;
+
+    void allocate (int capacity);
+    void pushSilence (int numSamples) noexcept;
+    bool write (const float* const* data, int numSamples);
+    JUCE_DECLARE_NON_COPYABLE (RecorderTrack)
+};
+
+/** Records engine audio to disk while the transport is recording.
+
+    Graph inputs, graph outputs and node outputs are armed as tracks, each
+    written to its own WAV file. On the audio thread a track only copies
+    into a lock-free FIFO. A writer thread drains the FIFOs through large
+    file buffers, preallocates disk space ahead of the writes where the
+    platform supports it and flushes to disk every couple of seconds.
+
+    Capture runs while the transport is playing with record on. Each time
+    it starts is a new take, written to new files in the recordings
+    directory. Tracks can only be armed or disarmed between takes.
+ */
+class DiskRecorder : private Thread
+{
+public:
+    enum SourceType
+    {
+        GraphInputs = 0,
+        GraphOutputs,
+        NodeOutputs
+    };
+
+    struct Stats
+    {
+        int numTracks           = 0;
+        int numChannels         = 0;
+        bool recording          = false;
+        /** Frames written to each track in this take */
+        int64 framesWritten     = 0;
+        /** Bytes written to disk per second, over the last second */
+        double throughputMBps   = 0.0;
+        /** Lowest fraction of free FIFO space seen on any track */
+        double bufferHeadroom   = 1.0;
+        /** Blocks dropped because a FIFO was full */
+        int64 numOverruns       = 0;
+    };
+
+    DiskRecorder();
+    ~DiskRecorder();
+
+    /** Returns the default recordings directory in the user data path */
+    static File getDefaultDirectory();
+
+    /** Sets the directory takes are written to */
+    void setDirectory (const File& directory);
+    File getDirectory() const;
+
+    /** Sets how much audio each FIFO holds. Applies to tracks armed after
+        and to every track the next time the recorder is prepared */
+    void setBufferSeconds (double seconds);
+
+    /** Arms graph input or output channels as a track. Returns false
+        while a take is being recorded */
+    bool armChannels (SourceType type, int firstChannel, int numChannels, const String& name);
+
+    /** Arms a node's audio outputs as a track. Returns false while a
+        take is being recorded */
+    bool armNode (NodeObject* node, const String& name);
+
+    /** Disarms every track. Returns false while a take is being recorded */
+    bool disarmAll();
+
+    int getNumTracks() const;
+    RecorderTrack::Ptr getTrack (int index) const;
+
+    /** Allocates the FIFOs and starts the writer. Call when audio starts */
+    void prepare (double sampleRate, int maxBlockSize);
+
+    /** Finishes a take in progress and stops the writer */
+    void release();
+
+    //==========================================================================
+    /** Audio thread. Starts a block, capturing it if shouldRecord is true */
+    void beginBlock (bool shouldRecord, int numSamples) noexcept;
+
+    /** Audio thread. Pushes graph input or output channels */
+    void pushChannels (SourceType type, const AudioSampleBuffer& buffer, int numSamples) noexcept;
+
+    /** Audio thread. Ends a block. Tracks nothing was pushed to get silence
+        so every file of a take stays the same length */
+    void endBlock() noexcept;
+
+    //==========================================================================
+    /** Returns true while a take is being captured or written */
+    bool isRecording() const noexcept       { return state.load() != Idle; }
+
+    /** Returns true if the audio thread is capturing the current block */
+    bool isCapturing() const noexcept       { return capturing.load (std::memory_order_relaxed); }
+
+    /** Waits until the last take has been written and closed */
+    bool waitUntilIdle (int timeoutMs);
+
+    Stats getStats() const;
+    void resetStats();
+
+private:
+    friend class RecorderTrack;
+    enum State { Idle = 0, Recording, Stopping };
+
+    CriticalSection lock;
+    ReferenceCountedArray<RecorderTrack> tracks, retired;
+    File directory;
+    double sampleRate = 0.0;
+    double bufferSeconds = 4.0;
+    int blockSize = 0, blockSamples = 0;
+    CriticalSection directoryLock;
+
+    std::atomic<int> state { Idle };
+    std::atomic<bool> capturing { false };
+    bool takeOpen = false;
+
+    std::atomic<int64> framesWritten { 0 }, numOverruns { 0 };
+    std::atomic<float> minHeadroom { 1.f };
+    std::atomic<double> throughput { 0.0 };
+    int64 bytesSinceUpdate = 0;
+    uint32 lastUpdate = 0, lastFlush = 0;
+
+    bool canChangeTracks() const;
+    void noteHeadroom (float headroom) noexcept;
+    void openTake();
+    void closeTake();
+    void drain();
+    void run() override;
+    JUCE_DECLARE_NON_COPYABLE (DiskRecorder)
+};
+
+}
@@ -19,6 +19,7 @@
 
 #include "engine/nodes/AudioProcessorNode.h"
 #include "engine/AudioEngine.h"
+#include "engine/DiskRecorder.h"
 #include "engine/GraphProcessor.h"
 #include "engine/MidiPipe.h"
 #include "engine/MidiTranspose.h"
@@ -42,6 +43,19 @@ public:
                           const OwnedArray <MidiBuffer>& sharedMidiBuffers,
                           const int numSamples) = 0;
 
+    /** Called with the time perform() took when the graph is profiling */
+    virtual void addRenderTime (int64) noexcept { }
+
+    /** Used instead of perform() while the graph is profiling */
+    virtual void performProfiled (AudioSampleBuffer& sharedBufferChans,
+                                  const OwnedArray <MidiBuffer>& sharedMidiBuffers,
+                                  const int numSamples)
+    {
+        const auto start = Time::getHighResolutionTicks();
+        perform (sharedBufferChans, sharedMidiBuffers, numSamples);
+        addRenderTime (Time::getHighResolutionTicks() - start);
+    }
+
     JUCE_LEAK_DETECTOR (Task);
 };
 
@@ -197,6 +211,70 @@ private:
 };
 
 
+/** Applies a node's key range, MIDI channels, program changes and transpose
+    to the MIDI it is about to render */
+class NodeMidiFilter
+{
+public:
+    NodeMidiFilter()    { tempMidi.ensureSize (128); }
+
+    void process (NodeObject& node, MidiPipe& midiPipe, const int numSamples)
+    {
+        jassert (tempMidi.getNumEvents() == 0);
+        ScopedLock spl (node.getPropertyLock());
+        transpose.setNoteOffset (node.getTransposeOffset());
+        const auto keyRange (node.getKeyRange());
+        const auto midiChans (node.getMidiChannels());
+        const auto useMidiProgram (node.areMidiProgramsEnabled());
+
+        if (keyRange.getLength() > 0 || !midiChans.isOmni() || useMidiProgram)
+        {
+            for (int i = 0; i < midiPipe.getNumBuffers(); ++i)
+            {
+                auto& midi = *midiPipe.getWriteBuffer (i);
+                MidiBuffer::Iterator iter (midi);
+                int frame = 0; MidiMessage msg;
+                while (iter.getNextEvent (msg, frame))
+                {
+                    if (msg.isNoteOnOrOff())
+                    {
+                        // out of range 
+                        if (keyRange.getLength() > 0 && (msg.getNoteNumber() < keyRange.getStart() || msg.getNoteNumber() > keyRange.getEnd()))
+                            continue;
+                    }
+
+                    if (msg.getChannel() > 0 && midiChans.isOff (msg.getChannel()))
+                        continue;
+
+                    if (useMidiProgram && msg.isProgramChange())
+                    {
+                        node.setMidiProgram (msg.getProgramChangeNumber());
+                        node.reloadMidiProgram();
+                        continue;
+                    }
+
+                    transpose.process (msg);
+                    tempMidi.addEvent (msg, frame);
+                }
+
+                midi.swapWith (tempMidi);
+                tempMidi.clear();
+            }
+        }
+        else
+        {
+            for (int i = 0; i < midiPipe.getNumBuffers(); ++i)
+                transpose.process (*midiPipe.getWriteBuffer (i), numSamples);
+        }
+
+        tempMidi.clear();
+    }
+
+private:
+    MidiTranspose transpose;
+    MidiBuffer tempMidi;
+};
+
 class ProcessBufferOp : public Task
 {
 public:
@@ -281,58 +359,7 @@ public:
             node->setInputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
 
        #ifndef EL_FREE
-        // Begin MIDI filters
-        {
-            jassert (tempMidi.getNumEvents() == 0);
-            ScopedLock spl (node->getPropertyLock());
-            transpose.setNoteOffset (node->getTransposeOffset());
-            const auto keyRange (node->getKeyRange());
-            const auto midiChans (node->getMidiChannels());
-            const auto useMidiProgram (node->areMidiProgramsEnabled());
- 
-            if (keyRange.getLength() > 0 || !midiChans.isOmni() || useMidiProgram)
-            {
-                for (int i = 0; i < midiPipe.getNumBuffers(); ++i)
-                {
-                    auto& midi = *midiPipe.getWriteBuffer (i);
-                    MidiBuffer::Iterator iter (midi);
-                    int frame = 0; MidiMessage msg;
-                    while (iter.getNextEvent (msg, frame))
-                    {
-                        if (msg.isNoteOnOrOff())
-                        {
-                            // out of range 
-                            if (keyRange.getLength() > 0 && (msg.getNoteNumber() < keyRange.getStart() || msg.getNoteNumber() > keyRange.getEnd()))
-                                continue;
-                        }
-
-                        if (msg.getChannel() > 0 && midiChans.isOff (msg.getChannel()))
-                            continue;
-
-                        if (useMidiProgram && msg.isProgramChange())
-                        {
-                            node->setMidiProgram (msg.getProgramChangeNumber());
-                            node->reloadMidiProgram();
-                            continue;
-                        }
-
-                        transpose.process (msg);
-                        tempMidi.addEvent (msg, frame);
-                    }
-
-                    midi.swapWith (tempMidi);
-                    tempMidi.clear();
-                }
-            }
-            else
-            {
-                for (int i = 0; i < midiPipe.getNumBuffers(); ++i)
-                    transpose.process (*midiPipe.getWriteBuffer (i), numSamples);
-            }
-        }
-
-        tempMidi.clear();
-        // End MIDI filters
+        midiFilter.process (*node, midiPipe, numSamples);
        #endif
         
         auto pluginProcessBlock = [=, &sharedMidiBuffers] (AudioSampleBuffer& buffer, MidiPipe& midiPipe, bool isSuspended)
@@ -453,6 +480,14 @@ public:
 
         for (int i = 0; i < numAudioOuts; ++i)
             node->setOutputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
+
+        if (auto* track = node->recordTrack.load (std::memory_order_acquire))
+            track->push (buffer, numSamples);
+    }
+
+    void addRenderTime (int64 ticks) noexcept override
+    {
+        node->addRenderTime (ticks);
     }
 
     const NodeObjectPtr node;
@@ -465,7 +500,7 @@ private:
     int totalChans, numAudioIns, numAudioOuts;
     int midiBufferToUse;
     bool lastMute = false;
-    MidiTranspose transpose;
+    NodeMidiFilter midiFilter;
     MidiBuffer tempMidi;
 
     std::unique_ptr<float*> osChans;
@@ -474,6 +509,107 @@ private:
 };
 
 
+/** Renders consecutive nodes which only have MIDI ports in a single task.
+
+    The planner appends a node here when nothing needs to happen to its input
+    buffers between it and the previous MIDI-only node, so running them back
+    to back is the same as running separate ops. Everything on the audio side
+    (gain and mute ramps, meters, oversampling) is skipped.
+ */
+class ProcessMidiChainOp : public Task
+{
+public:
+    ProcessMidiChainOp() = default;
+
+    static bool canRender (NodeObject& node)
+    {
+        return node.getNumPorts (PortType::Audio, true) == 0
+            && node.getNumPorts (PortType::Audio, false) == 0
+            && node.getNumPorts (PortType::Midi, true) + node.getNumPorts (PortType::Midi, false) > 0
+            && ! node.isGraph()
+            && ! node.isAudioIONode()
+            && ! node.isMidiIONode()
+            && node.getOversamplingFactor() <= 1;
+    }
+
+    void add (const NodeObjectPtr& node, const Array<int>& midiChannelsToUse)
+    {
+        auto* step = steps.add (new Step());
+        step->node = node;
+        step->processor = node->getAudioPluginInstance();
+        step->midiChannels = midiChannelsToUse;
+        if (step->midiChannels.isEmpty())
+            step->midiChannels.add (0);
+    }
+
+    int size() const noexcept { return steps.size(); }
+
+    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    {
+        AudioSampleBuffer noAudio (noChannels, 0, numSamples);
+
+        for (auto* step : steps)
+            if (step->node->isEnabled())
+                render (*step, noAudio, sharedMidiBuffers, numSamples);
+    }
+
+    /** Each step is timed on its own and credited to its node */
+    void performProfiled (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples) override
+    {
+        AudioSampleBuffer noAudio (noChannels, 0, numSamples);
+
+        for (auto* step : steps)
+        {
+            if (! step->node->isEnabled())
+                continue;
+
+            const auto start = Time::getHighResolutionTicks();
+            render (*step, noAudio, sharedMidiBuffers, numSamples);
+            step->node->addRenderTime (Time::getHighResolutionTicks() - start);
+        }
+    }
+
+private:
+    struct Step
+    {
+        NodeObjectPtr node;
+        AudioProcessor* processor = nullptr;
+        Array<int> midiChannels;
+        NodeMidiFilter midiFilter;
+    };
+
+    void render (Step& step, AudioSampleBuffer& noAudio, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    {
+        auto& node = *step.node;
+        MidiPipe midiPipe (sharedMidiBuffers, step.midiChannels);
+
+       #ifndef EL_FREE
+        step.midiFilter.process (node, midiPipe, numSamples);
+       #endif
+
+        if (node.wantsMidiPipe())
+        {
+            if (! node.isSuspended())
+                node.render (noAudio, midiPipe);
+            else
+                node.renderBypassed (noAudio, midiPipe);
+        }
+        else if (step.processor != nullptr)
+        {
+            if (! node.isSuspended())
+                step.processor->processBlock (noAudio, *midiPipe.getWriteBuffer (0));
+            else
+                step.processor->processBlockBypassed (noAudio, *midiPipe.getWriteBuffer (0));
+        }
+    }
+
+    OwnedArray<Step> steps;
+    float* noChannels[1] = { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE (ProcessMidiChainOp)
+};
+
+
 /** Used to calculate the correct sequence of rendering ops needed, based on
     the best re-use of shared buffers at each stage. */
 class ProcessorGraphBuilder
@@ -518,6 +654,7 @@ private:
     Array <uint32> nodeDelayIDs;
     Array <int> nodeDelays;
     int totalLatency;
+    ProcessMidiChainOp* midiChain = nullptr;
 
     int getNodeDelay (const uint32 nodeID) const          { return nodeDelays [nodeDelayIDs.indexOf (nodeID)]; }
 
@@ -808,6 +945,15 @@ private:
         if (node->isAudioIONode() && node->getNumPorts (PortType::Audio, false) == 0)
             totalLatency = maxLatency;
 
+        if (ProcessMidiChainOp::canRender (*node))
+        {
+            // extend the current chain if no ops were needed for this node's inputs
+            if (midiChain == nullptr || renderingOps.getLast() != midiChain)
+                renderingOps.add (midiChain = new ProcessMidiChainOp());
+            midiChain->add (node, channelsToUse [PortType::Midi]);
+            return;
+        }
+
         int totalChans = jmax (node->getNumPorts (PortType::Audio, true),
                                node->getNumPorts (PortType::Audio, false));
         renderingOps.add (new ProcessBufferOp (node, channelsToUse [PortType::Audio],
@@ -1490,10 +1636,21 @@ void GraphProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMe
     
     currentMidiOutputBuffer.clear();
 
-    for (int i = 0; i < renderingOps.size(); ++i)
+    if (profiling.get() != 0)
     {
-        GraphRender::Task* const op = static_cast<GraphRender::Task*> (renderingOps.getUnchecked (i));
-        op->perform (renderingBuffers, midiBuffers, numSamples);
+        for (int i = 0; i < renderingOps.size(); ++i)
+        {
+            GraphRender::Task* const op = static_cast<GraphRender::Task*> (renderingOps.getUnchecked (i));
+            op->performProfiled (renderingBuffers, midiBuffers, numSamples);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < renderingOps.size(); ++i)
+        {
+            GraphRender::Task* const op = static_cast<GraphRender::Task*> (renderingOps.getUnchecked (i));
+            op->perform (renderingBuffers, midiBuffers, numSamples);
+        }
     }
 
     for (int i = 0; i < buffer.getNumChannels(); ++i)
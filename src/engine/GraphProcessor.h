@@ -110,6 +110,12 @@ public:
     */
     bool removeNode (uint32 nodeId);
 
+    /** When enabled, the time each node takes to render is added to it.
+        See NodeObject::getRenderTicks()
+     */
+    void setProfilingEnabled (bool shouldProfile) noexcept  { profiling = shouldProfile; }
+    bool isProfilingEnabled() const noexcept                { return profiling.get() != 0; }
+
     /** Builds an array of ordered nodes */
     void getOrderedNodes (ReferenceCountedArray<NodeObject>& res);
     
@@ -356,6 +362,7 @@ private:
     kv::MidiChannels midiChannels;
     VelocityCurve velocityCurve;
     MidiBuffer filteredMidi;
+    Atomic<int> profiling { 0 };
     
     void handleAsyncUpdate() override;
     void clearRenderingSequence();
@@ -76,4 +76,159 @@ void MidiClock::removeListener (Listener* listener)
         listeners.removeFirstMatchingValue (listener);
 }
 
+//==============================================================================
+void MidiClockMaster::reset()
+{
+    tempo           = targetTempo;
+    phase           = 0.0;
+    wasPlaying      = false;
+    expectedFrame   = 0;
+    relocate (0.0, noEvent);
+}
+
+void MidiClockMaster::setSampleRate (const double newSampleRate) noexcept
+{
+    if (sampleRate == newSampleRate || newSampleRate <= 0.0)
+        return;
+    sampleRate = newSampleRate;
+    reset();
+}
+
+void MidiClockMaster::sync (bool playing, int64 positionFrames)
+{
+    // the transport doesn't have a tempo map, so its beat position is
+    // derived from the current tempo the same way here.
+    const double clockAtPosition = (double) positionFrames * clocksPerSample (targetTempo);
+
+    if (playing != wasPlaying)
+    {
+        if (playing)
+            relocate (clockAtPosition, positionFrames <= 0 ? startEvent : continueEvent);
+        else
+            relocate (phase, stopEvent);
+    }
+    else if (positionFrames != expectedFrame)
+    {
+        relocate (clockAtPosition, playing ? relocateEvent : locateEvent);
+    }
+
+    wasPlaying      = playing;
+    expectedFrame   = positionFrames;
+}
+
+void MidiClockMaster::relocate (double newPhase, TransportEvent newEvent)
+{
+    event = newEvent;
+    ++eventSerial;
+
+    if (newEvent == stopEvent)
+        return;
+
+    // song position is in sixteenth notes (6 clocks), start at the next one
+    songPosition = newEvent == startEvent ? 0
+        : jlimit (0, 16383, (int) std::ceil (newPhase / 6.0 - 1.0e-9));
+    eventClock  = static_cast<int64> (songPosition) * 6;
+    phase       = newEvent == startEvent ? 0.0 : newPhase;
+}
+
+void MidiClockMaster::render (MidiBuffer& midi, int numSamples, Output& output) const noexcept
+{
+    if (numSamples <= 0)
+        return;
+
+    if (output.lastEventSerial != eventSerial)
+    {
+        output.lastEventSerial = eventSerial;
+
+        switch (event)
+        {
+            case startEvent:
+                midi.addEvent (MidiMessage::midiStart(), 0);
+                break;
+            case continueEvent:
+                midi.addEvent (MidiMessage::songPositionPointer (songPosition), 0);
+                midi.addEvent (MidiMessage::midiContinue(), 0);
+                break;
+            case relocateEvent:
+                midi.addEvent (MidiMessage::midiStop(), 0);
+                midi.addEvent (MidiMessage::songPositionPointer (songPosition), 0);
+                midi.addEvent (MidiMessage::midiContinue(), 0);
+                break;
+            case locateEvent:
+                midi.addEvent (MidiMessage::songPositionPointer (songPosition), 0);
+                break;
+            case stopEvent:
+                midi.addEvent (MidiMessage::midiStop(), 0);
+                break;
+            case noEvent:
+                break;
+        }
+
+        if (event != stopEvent)
+            output.nextClock = eventClock;
+    }
+
+    const double latency = static_cast<double> (jmax (0, output.latencySamples));
+
+    // don't burst out clocks for an output that fell behind, just pick up
+    // from the phase it should currently be at
+    const auto firstDue = static_cast<int64> (std::ceil (getPhaseAt (latency, numSamples) - 1.0e-9));
+    if (output.nextClock < firstDue - 1)
+        output.nextClock = firstDue;
+
+    const auto clockMessage = MidiMessage::midiClock();
+    for (;;)
+    {
+        const double frame = getFrameForClock ((double) output.nextClock, numSamples) - latency;
+        const int offset = frame <= 0.0 ? 0 : static_cast<int> (std::ceil (frame - 1.0e-9));
+        if (offset >= numSamples)
+            break;
+        midi.addEvent (clockMessage, offset);
+        ++output.nextClock;
+    }
+}
+
+void MidiClockMaster::advance (int numSamples) noexcept
+{
+    if (numSamples <= 0)
+        return;
+
+    phase = getPhaseAt ((double) numSamples, numSamples);
+    tempo = targetTempo;
+    if (wasPlaying)
+        expectedFrame += numSamples;
+}
+
+double MidiClockMaster::getPhaseAt (double frame, int numSamples) const noexcept
+{
+    const double length = (double) jmax (1, numSamples);
+    const double c0 = clocksPerSample (tempo);
+    const double c1 = clocksPerSample (targetTempo);
+
+    // tempo ramps linearly from c0 to c1 across the block and holds after it
+    if (frame <= length)
+        return phase + c0 * frame + 0.5 * (c1 - c0) * frame * frame / length;
+    return phase + 0.5 * (c0 + c1) * length + c1 * (frame - length);
+}
+
+double MidiClockMaster::getFrameForClock (double clock, int numSamples) const noexcept
+{
+    const double delta = clock - phase;
+    if (delta <= 0.0)
+        return 0.0;
+
+    const double length = (double) jmax (1, numSamples);
+    const double c0 = clocksPerSample (tempo);
+    const double c1 = clocksPerSample (targetTempo);
+    const double inBlock = 0.5 * (c0 + c1) * length;
+
+    if (delta > inBlock)
+        return length + (delta - inBlock) / c1;
+
+    // solve c0 * t + a * t^2 = delta for t in the ramp
+    const double a = 0.5 * (c1 - c0) / length;
+    const double root = std::sqrt (jmax (0.0, c0 * c0 + 4.0 * a * delta));
+    return (2.0 * delta) / (c0 + root);
+}
+
 }
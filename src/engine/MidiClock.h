@@ -59,68 +59,115 @@ private:
     Array<Listener*> listeners;
 };
 
+/** Generates MIDI clock, start/stop and song position messages.
+
+    The clock phase is kept in fractional clock units and advanced per block
+    by integrating the tempo, so rounding never accumulates and tempo changes
+    ramp linearly across the block instead of resetting the phase.  The phase
+    is re-locked to the transport's beat position when playback starts or the
+    transport is relocated.
+ */
 class MidiClockMaster
 {
 public:
-    MidiClockMaster()
+    /** Per-destination state.  Each destination keeps its own so it can be
+        compensated for latency independently of the others.
+     */
+    struct Output
     {
-        clockMessage = MidiMessage::midiClock();
-        updateCoefficients();
-    }
+        Output() = default;
+        explicit Output (int latency) : latencySamples (latency) { }
+
+        /** Latency of the destination in samples. Messages are rendered this
+            many samples early so they arrive on the beat.
+         */
+        int latencySamples = 0;
+
+    private:
+        friend class MidiClockMaster;
+        int64 nextClock = 0;
+        uint32 lastEventSerial = 0;
+    };
 
+    MidiClockMaster() { reset(); }
     ~MidiClockMaster() noexcept { }
 
-    inline void reset()
-    {
-        pos = 0;
-        updateCoefficients();
-    }
+    /** Resets the clock phase to zero. */
+    void reset();
 
+    /** Sets the tempo the clock should reach by the end of the next block. */
     inline void setTempo (const double newTempo) noexcept
     {
-        if (tempo == newTempo)
-            return;
-        tempo = newTempo;
-        updateCoefficients();
+        targetTempo = jmax (1.0, newTempo);
     }
 
-    inline void setSampleRate (const double newSampleRate) noexcept
-    {
-        if (sampleRate == newSampleRate)
-            return;
-        sampleRate = newSampleRate;
-        updateCoefficients();
-    }
+    /** Changes the sample rate. This resets the clock phase. */
+    void setSampleRate (const double newSampleRate) noexcept;
 
+    /** Synchronizes with the transport state at the start of a block.
+
+        When the play state changes or the position isn't where the clock
+        expects it to be, the phase is relocated to the transport's position
+        and start, continue, stop and song position messages are queued for
+        every output.
+     */
+    void sync (bool playing, int64 positionFrames);
+
+    /** Renders clock messages for one output into a buffer. This doesn't
+        advance the clock, so it can be called once per output each block.
+     */
+    void render (MidiBuffer& midi, int numSamples, Output& output) const noexcept;
+
+    /** Advances the clock phase by a block. Call after all outputs rendered. */
+    void advance (int numSamples) noexcept;
+
+    /** Renders to a single uncompensated output and advances the clock */
     inline void render (MidiBuffer& midi, int numSamples) noexcept
     {
-        if (samplesPerClock <= 0)
-            return;
-
-        int frame = static_cast<int> (pos % samplesPerClock);
-        if (frame > 0) frame = samplesPerClock - frame;
-        while (frame < numSamples)
-        {
-            midi.addEvent (clockMessage, frame);
-            frame += samplesPerClock;
-        }
-
-        pos += numSamples;
+        render (midi, numSamples, defaultOutput);
+        advance (numSamples);
     }
 
+    /** Returns the current phase in MIDI clocks (24 per quarter note) */
+    inline double getPhase() const noexcept { return phase; }
+
+    /** Returns the tempo at the end of the last rendered block */
+    inline double getTempo() const noexcept { return tempo; }
+
 private:
-    MidiMessage clockMessage;
-    int64 pos = 0;
-    double tempo = 120.0;
+    enum TransportEvent
+    {
+        noEvent = 0,
+        startEvent,
+        continueEvent,
+        stopEvent,
+        locateEvent,
+        relocateEvent
+    };
+
     double sampleRate = 44100.0;
-    int samplesPerClock = 0;
-    double clocksPerMinute = 1.0;
+    double tempo = 120.0;
+    double targetTempo = 120.0;
+    double phase = 0.0;
+
+    bool wasPlaying = false;
+    int64 expectedFrame = 0;
+
+    TransportEvent event = noEvent;
+    uint32 eventSerial = 0;
+    int songPosition = 0;
+    int64 eventClock = 0;
 
-    void updateCoefficients()
+    Output defaultOutput;
+
+    inline double clocksPerSample (double bpm) const noexcept
     {
-        clocksPerMinute = 24.f * tempo;
-        samplesPerClock = roundToIntAccurate ((60.0 * sampleRate) / clocksPerMinute);
+        return (24.0 * bpm) / (60.0 * sampleRate);
     }
+
+    void relocate (double newPhase, TransportEvent newEvent);
+    double getPhaseAt (double frame, int numSamples) const noexcept;
+    double getFrameForClock (double clock, int numSamples) const noexcept;
 };
 
 }
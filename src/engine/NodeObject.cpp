@@ -526,6 +526,7 @@ void NodeObject::MidiProgramLoader::handleAsyncUpdate()
         }
     }
 
+    node.markStateDirty();
     node.midiProgramChanged(); // always notify the program # changed even if not loaded.
                                // do this because there may not be data for the program but
                                // the property is still relavent.
@@ -32,6 +32,7 @@ class ProcessBufferOp;
 }
 
 class GraphProcessor;
+class RecorderTrack;
 
 class NodeObject : public ReferenceCountedObject
 {
@@ -206,6 +207,22 @@ public:
     void setOutputRMS (int chan, float val);
     float getOutputRMS (int chan) const { return (chan < outRMS.size()) ? outRMS.getUnchecked(chan)->get() : 0.0f; }
 
+    /** Adds time spent rendering, measured while the parent graph is profiling */
+    inline void addRenderTime (int64 ticks) noexcept
+    {
+        renderTicks += ticks;
+        ++numRenders;
+    }
+
+    /** Returns high resolution ticks spent rendering since the last reset */
+    int64 getRenderTicks() const noexcept   { return renderTicks.get(); }
+
+    /** Returns the number of blocks timed since the last reset */
+    int64 getNumRenders() const noexcept    { return numRenders.get(); }
+
+    /** Clears the render time */
+    void resetRenderTime() noexcept         { renderTicks = 0; numRenders = 0; }
+
     //=========================================================================
     /** Connect this node's output audio to another node's input audio */
     void connectAudioTo (const NodeObject* other);
@@ -336,6 +353,16 @@ public:
     virtual void getState (MemoryBlock&) = 0;
     virtual void setState (const void*, int sizeInBytes) = 0;
 
+    /** Returns true if the state may have changed since it was last saved.
+        Nodes that can't tell when their state changes always return true */
+    virtual bool isStateDirty() const       { return true; }
+
+    /** Flags the state as changed so the next save captures it */
+    void markStateDirty() noexcept          { stateDirty.set (1); }
+
+    /** Called once the state has been captured */
+    virtual void markStateSaved() noexcept  { stateDirty.set (0); }
+
     //=========================================================================
     void setOversamplingFactor (int osFactor);
     int getOversamplingFactor();
@@ -390,6 +417,10 @@ protected:
     /** Set latency samples */
     void setLatencySamples (int latency);
 
+    //==========================================================================
+    /** Returns true if markStateDirty() was called since the last save */
+    bool wasStateChanged() const noexcept   { return stateDirty.get() != 0; }
+
     //==========================================================================
     virtual Parameter::Ptr getParameter (const PortDescription& port) { return nullptr; }
 
@@ -405,6 +436,7 @@ private:
     friend class GraphManager;
     friend class EngineController;
     friend class Node;
+    friend class DiskRecorder;
     
     GraphProcessor* parent = nullptr;
     bool isPrepared = false;
@@ -413,6 +445,7 @@ private:
     Atomic<int> bypassed { 0 };
     Atomic<int> mute { 0 };
     Atomic<int> muteInput { 0 };
+    Atomic<int> stateDirty { 1 };
 
     double sampleRate = 0.0;
     int latencySamples = 0;
@@ -422,6 +455,8 @@ private:
 
     Atomic<float> gain, lastGain, inputGain, lastInputGain;
     OwnedArray<AtomicValue<float> > inRMS, outRMS;
+    Atomic<int64> renderTicks { 0 }, numRenders { 0 };
+    std::atomic<RecorderTrack*> recordTrack { nullptr };
     
     Atomic<int> keyRangeLow { 0 };
     Atomic<int> keyRangeHigh { 127 };
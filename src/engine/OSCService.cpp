@@ -0,0 +1,459 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/OSCService.h"
+#include "Utils.h"
+
+namespace Element {
+
+static constexpr int maxPendingOscEvents = 512;
+
+//==============================================================================
+OSCService::EventQueue::EventQueue (int capacity)
+    : fifo (capacity)
+{
+    events.allocate ((size_t) capacity, true);
+}
+
+bool OSCService::EventQueue::push (const MidiEvent& event) noexcept
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (1, start1, size1, start2, size2);
+    if (size1 + size2 < 1)
+        return false;
+    events[size1 > 0 ? start1 : start2] = event;
+    fifo.finishedWrite (1);
+    return true;
+}
+
+bool OSCService::EventQueue::pop (MidiEvent& event) noexcept
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (1, start1, size1, start2, size2);
+    if (size1 + size2 < 1)
+        return false;
+    event = events[size1 > 0 ? start1 : start2];
+    fifo.finishedRead (1);
+    return true;
+}
+
+//==============================================================================
+class OSCService::SendThread : public Thread
+{
+public:
+    SendThread (OSCService& s)
+        : Thread ("OSC Sender"), service (s) { }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            sem.wait();
+            if (threadShouldExit())
+                break;
+
+            ScopedLock sl (service.lock);
+            for (auto* outbox : service.outboxes)
+                outbox->flush();
+        }
+    }
+
+    void stop()
+    {
+        signalThreadShouldExit();
+        sem.post();
+        stopThread (100);
+    }
+
+    Semaphore sem;
+
+private:
+    OSCService& service;
+};
+
+//==============================================================================
+OSCService::OSCService()
+{
+    getWallClockMillis();
+    sendThread.reset (new SendThread (*this));
+    sendThread->startThread();
+}
+
+OSCService::~OSCService()
+{
+    sendThread->stop();
+    sendThread.reset();
+    releaseUnused();
+    jassert (ports.isEmpty() && destinations.isEmpty() && outboxes.isEmpty());
+}
+
+void OSCService::notifySender() noexcept
+{
+    sendThread->sem.post();
+}
+
+OSCService::PortPtr OSCService::getPort (int portNumber)
+{
+    releaseUnused();
+
+    ScopedLock sl (lock);
+    for (auto* port : ports)
+        if (port->getPortNumber() == portNumber)
+            return port;
+
+    PortPtr port = new Port (portNumber);
+    if (! port->receiver.connect (portNumber))
+        return nullptr;
+    ports.add (port);
+    return port;
+}
+
+OSCService::Port::~Port()
+{
+    receiver.disconnect();
+}
+
+OSCService::DestinationPtr OSCService::getDestination (const String& hostName, int portNumber)
+{
+    releaseUnused();
+
+    ScopedLock sl (lock);
+    for (auto* dest : destinations)
+        if (dest->getPortNumber() == portNumber && dest->getHostName() == hostName)
+            return dest;
+
+    DestinationPtr dest = new Destination (hostName, portNumber);
+    if (! dest->sender.connect (hostName, portNumber))
+        return nullptr;
+    destinations.add (dest);
+    return dest;
+}
+
+OSCService::Destination::~Destination()
+{
+    sender.disconnect();
+}
+
+void OSCService::releaseUnused()
+{
+    ReferenceCountedArray<Port> unusedPorts;
+    ReferenceCountedArray<Destination> unusedDestinations;
+
+    {
+        // a count of one is the registry's own reference. Nobody can take
+        // another without this lock, so the socket is never handed out
+        // while it's being destroyed
+        ScopedLock sl (lock);
+        for (int i = ports.size(); --i >= 0;)
+            if (ports.getObjectPointerUnchecked (i)->getReferenceCount() == 1)
+                unusedPorts.add (ports.removeAndReturn (i));
+        for (int i = destinations.size(); --i >= 0;)
+            if (destinations.getObjectPointerUnchecked (i)->getReferenceCount() == 1)
+                unusedDestinations.add (destinations.removeAndReturn (i));
+    }
+
+    // the sockets close here, outside the lock
+}
+
+double OSCService::getWallClockMillis() noexcept
+{
+    static const double offset = (double) Time::currentTimeMillis() - Time::getMillisecondCounterHiRes();
+    return Time::getMillisecondCounterHiRes() + offset;
+}
+
+static constexpr double secondsFrom1900To1970 = 2208988800.0;
+static constexpr double timeTagFractionScale  = 4294967296.0;
+
+double OSCService::toMillis (const OSCTimeTag& timeTag) noexcept
+{
+    const auto raw = timeTag.getRawTimeTag();
+    const double seconds  = (double) (raw >> 32) - secondsFrom1900To1970;
+    const double fraction = (double) (raw & 0xffffffffull) / timeTagFractionScale;
+    return (seconds + fraction) * 1000.0;
+}
+
+OSCTimeTag OSCService::toTimeTag (double milliseconds) noexcept
+{
+    const double seconds  = milliseconds / 1000.0 + secondsFrom1900To1970;
+    const auto whole      = static_cast<uint64> (seconds);
+    const auto fraction   = static_cast<uint64> ((seconds - (double) whole) * timeTagFractionScale);
+    return OSCTimeTag ((whole << 32) | (fraction & 0xffffffffull));
+}
+
+//==============================================================================
+OSCService::Inbox::Inbox (OSCService& s)
+    : service (s)
+{
+    pending.allocate ((size_t) maxPendingOscEvents, true);
+}
+
+OSCService::Inbox::~Inbox()
+{
+    disconnect();
+}
+
+bool OSCService::Inbox::connect (int portNumber)
+{
+    if (port != nullptr && port->getPortNumber() == portNumber)
+        return true;
+
+    disconnect();
+    port = service.getPort (portNumber);
+    if (port == nullptr)
+        return false;
+
+    port->getReceiver().addListener (this);
+    for (auto* listener : messageLoopListeners)
+        port->getReceiver().addListener (listener);
+    return true;
+}
+
+void OSCService::Inbox::disconnect()
+{
+    if (port == nullptr)
+        return;
+
+    for (auto* listener : messageLoopListeners)
+        port->getReceiver().removeListener (listener);
+    port->getReceiver().removeListener (this);
+    port = nullptr;
+    service.releaseUnused();
+}
+
+void OSCService::Inbox::addMessageLoopListener (OSCReceiver::Listener<OSCReceiver::MessageLoopCallback>* listener)
+{
+    if (listener == nullptr || messageLoopListeners.contains (listener))
+        return;
+    messageLoopListeners.add (listener);
+    if (port != nullptr)
+        port->getReceiver().addListener (listener);
+}
+
+void OSCService::Inbox::removeMessageLoopListener (OSCReceiver::Listener<OSCReceiver::MessageLoopCallback>* listener)
+{
+    if (! messageLoopListeners.contains (listener))
+        return;
+    messageLoopListeners.removeFirstMatchingValue (listener);
+    if (port != nullptr)
+        port->getReceiver().removeListener (listener);
+}
+
+void OSCService::Inbox::oscMessageReceived (const OSCMessage& message)
+{
+    enqueue (message, 0.0);
+}
+
+void OSCService::Inbox::oscBundleReceived (const OSCBundle& bundle)
+{
+    enqueue (bundle, 0.0);
+}
+
+void OSCService::Inbox::enqueue (const OSCBundle& bundle, double time)
+{
+    const auto timeTag = bundle.getTimeTag();
+    if (! timeTag.isImmediately())
+        time = toMillis (timeTag);
+
+    for (const auto& element : bundle)
+    {
+        if (element.isMessage())
+            enqueue (element.getMessage(), time);
+        else if (element.isBundle())
+            enqueue (element.getBundle(), time);
+    }
+}
+
+void OSCService::Inbox::enqueue (const OSCMessage& message, double time)
+{
+    if (paused.get())
+        return;
+
+    const auto midi = Util::processOscToMidiMessage (message);
+    const int size = midi.getRawDataSize();
+    if (size <= 0 || size > 3 || midi.isSysEx())
+        return;
+
+    MidiEvent event;
+    event.time = time;
+    event.size = (uint8) size;
+    memcpy (event.data, midi.getRawData(), (size_t) size);
+    queue.push (event);
+}
+
+void OSCService::Inbox::render (MidiBuffer& midi, int numSamples, double sampleRate) noexcept
+{
+    MidiEvent event;
+    while (numPending < maxPendingOscEvents && queue.pop (event))
+        pending[numPending++] = event;
+
+    if (numPending <= 0 || numSamples <= 0)
+        return;
+
+    const double blockStart = getWallClockMillis();
+    const double samplesPerMilli = sampleRate / 1000.0;
+
+    // deliver what's due and compact the rest, keeping arrival order
+    int numKept = 0;
+    for (int i = 0; i < numPending; ++i)
+    {
+        const auto& ev = pending[i];
+        const double offset = ev.time <= 0.0 ? 0.0 : (ev.time - blockStart) * samplesPerMilli;
+        if (offset < (double) numSamples)
+        {
+            midi.addEvent (ev.data, (int) ev.size, jlimit (0, numSamples - 1, (int) offset));
+        }
+        else
+        {
+            if (numKept != i)
+                pending[numKept] = ev;
+            ++numKept;
+        }
+    }
+
+    numPending = numKept;
+}
+
+//==============================================================================
+OSCService::Outbox::Outbox (OSCService& s)
+    : service (s)
+{
+    ScopedLock sl (service.lock);
+    service.outboxes.add (this);
+}
+
+OSCService::Outbox::~Outbox()
+{
+    {
+        ScopedLock sl (service.lock);
+        service.outboxes.removeFirstMatchingValue (this);
+        destination = nullptr;
+    }
+
+    service.releaseUnused();
+}
+
+bool OSCService::Outbox::connect (const String& hostName, int portNumber)
+{
+    auto newDestination = service.getDestination (hostName, portNumber);
+    {
+        ScopedLock sl (service.lock);
+        destination = newDestination;
+    }
+
+    service.releaseUnused();
+    return newDestination != nullptr;
+}
+
+void OSCService::Outbox::disconnect()
+{
+    {
+        ScopedLock sl (service.lock);
+        destination = nullptr;
+    }
+
+    service.releaseUnused();
+}
+
+void OSCService::Outbox::send (const MidiBuffer& midi, int numSamples, double sampleRate) noexcept
+{
+    if (midi.isEmpty() || sampleRate <= 0.0)
+        return;
+
+    const double blockTime = getWallClockMillis() + latencyMs.get();
+    const double millisPerSample = 1000.0 / sampleRate;
+    bool queued = false;
+
+    for (const auto msg : midi)
+    {
+        if (msg.numBytes > 3 || msg.samplePosition >= numSamples)
+            continue;
+
+        MidiEvent event;
+        event.time = blockTime + millisPerSample * msg.samplePosition;
+        event.size = (uint8) msg.numBytes;
+        memcpy (event.data, msg.data, (size_t) msg.numBytes);
+        queued |= queue.push (event);
+    }
+
+    if (queued)
+    {
+        queue.push (MidiEvent());
+        service.notifySender();
+    }
+}
+
+void OSCService::Outbox::flush()
+{
+    MidiEvent event;
+    while (queue.pop (event))
+    {
+        if (event.size == 0)
+            sendBlock();
+        else
+            block.add (event);
+    }
+}
+
+void OSCService::Outbox::sendBlock()
+{
+    if (destination == nullptr || block.isEmpty())
+    {
+        block.clearQuick();
+        return;
+    }
+
+    // one bundle per block, with a nested bundle for each distinct time
+    OSCBundle bundle;
+    std::unique_ptr<OSCBundle> group;
+    double groupTime = -1.0;
+    Array<MidiMessage> sent;
+
+    for (const auto& event : block)
+    {
+        if (group == nullptr || event.time != groupTime)
+        {
+            if (group != nullptr)
+                bundle.addElement (*group);
+            groupTime = event.time;
+            group.reset (new OSCBundle (toTimeTag (groupTime)));
+        }
+
+        const MidiMessage midi (event.data, (int) event.size);
+        group->addElement (Util::processMidiToOscMessage (midi));
+        sent.add (midi);
+    }
+
+    if (group != nullptr)
+        bundle.addElement (*group);
+    block.clearQuick();
+
+    const bool wasSent = bundle.size() == 1
+        ? destination->send (bundle[0].getBundle())
+        : destination->send (bundle);
+
+    if (! wasSent || ! onMessageSent)
+        return;
+
+    int index = 0;
+    for (const auto& element : bundle)
+        for (const auto& inner : element.getBundle())
+            onMessageSent (inner.getMessage(), sent.getReference (index++));
+}
+
+}
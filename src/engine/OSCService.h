@@ -0,0 +1,217 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** OSC I/O shared by the OSC nodes and the OSCController.
+
+    There is one receiving socket per UDP port and one sending socket per
+    destination, no matter how many nodes use them. The service keeps a
+    reference to each socket, they are closed by releaseUnused() once
+    nothing else holds them. Use it through a SharedResourcePointer<OSCService>.
+ */
+class OSCService
+{
+public:
+    /** A MIDI event bridged to or from OSC */
+    struct MidiEvent
+    {
+        /** Wall clock time in milliseconds, zero means immediately */
+        double time = 0.0;
+        uint8 data[3] = { 0, 0, 0 };
+        /** Zero marks the end of an audio block in outgoing queues */
+        uint8 size = 0;
+    };
+
+    /** Fixed size, lock-free, single producer/single consumer event queue */
+    class EventQueue
+    {
+    public:
+        explicit EventQueue (int capacity = 1024);
+        bool push (const MidiEvent& event) noexcept;
+        bool pop (MidiEvent& event) noexcept;
+        int getNumReady() const noexcept { return fifo.getNumReady(); }
+
+    private:
+        AbstractFifo fifo;
+        HeapBlock<MidiEvent> events;
+    };
+
+    //==========================================================================
+    /** A shared receiving socket */
+    class Port : public ReferenceCountedObject
+    {
+    public:
+        ~Port();
+        int getPortNumber() const noexcept { return portNumber; }
+        OSCReceiver& getReceiver() noexcept { return receiver; }
+
+    private:
+        friend class OSCService;
+        explicit Port (int p) : portNumber (p) { }
+        const int portNumber;
+        OSCReceiver receiver { "elosc" };
+    };
+
+    using PortPtr = ReferenceCountedObjectPtr<Port>;
+
+    /** A shared sending socket */
+    class Destination : public ReferenceCountedObject
+    {
+    public:
+        ~Destination();
+        const String& getHostName() const noexcept { return hostName; }
+        int getPortNumber() const noexcept { return portNumber; }
+        bool send (const OSCBundle& bundle) { return sender.send (bundle); }
+
+    private:
+        friend class OSCService;
+        Destination (const String& h, int p)
+            : hostName (h), portNumber (p) { }
+        const String hostName;
+        const int portNumber;
+        OSCSender sender;
+    };
+
+    using DestinationPtr = ReferenceCountedObjectPtr<Destination>;
+
+    //==========================================================================
+    /** Receives OSC on a port and schedules the MIDI it maps to.
+
+        Bundle time tags are honored: events are delivered at the sample in
+        the audio block their time tag falls in.
+     */
+    class Inbox : private OSCReceiver::Listener<OSCReceiver::RealtimeCallback>
+    {
+    public:
+        explicit Inbox (OSCService& service);
+        ~Inbox();
+
+        bool connect (int portNumber);
+        void disconnect();
+        bool isConnected() const noexcept { return port != nullptr; }
+
+        void setPaused (bool shouldPause) noexcept  { paused.set (shouldPause); }
+        bool isPaused() const noexcept              { return paused.get(); }
+
+        /** Adds a listener to the connected port, it is carried over when
+            the inbox is connected to another port.
+         */
+        void addMessageLoopListener (OSCReceiver::Listener<OSCReceiver::MessageLoopCallback>*);
+        void removeMessageLoopListener (OSCReceiver::Listener<OSCReceiver::MessageLoopCallback>*);
+
+        /** Adds the events due in the next block. Call from the audio thread */
+        void render (MidiBuffer& midi, int numSamples, double sampleRate) noexcept;
+
+    private:
+        OSCService& service;
+        PortPtr port;
+        EventQueue queue;
+        HeapBlock<MidiEvent> pending;
+        int numPending = 0;
+        Atomic<bool> paused { false };
+        Array<OSCReceiver::Listener<OSCReceiver::MessageLoopCallback>*> messageLoopListeners;
+
+        void oscMessageReceived (const OSCMessage&) override;
+        void oscBundleReceived (const OSCBundle&) override;
+        void enqueue (const OSCMessage&, double time);
+        void enqueue (const OSCBundle&, double time);
+    };
+
+    //==========================================================================
+    /** Sends MIDI as OSC. Each audio block is sent as a single bundle with
+        every event time tagged at its sample position.
+     */
+    class Outbox
+    {
+    public:
+        explicit Outbox (OSCService& service);
+        ~Outbox();
+
+        bool connect (const String& hostName, int portNumber);
+        void disconnect();
+        bool isConnected() const noexcept { return destination != nullptr; }
+
+        /** Time added to outgoing time tags so receivers can schedule ahead */
+        void setLatency (double milliseconds) noexcept  { latencyMs.set (jmax (0.0, milliseconds)); }
+        double getLatency() const noexcept              { return latencyMs.get(); }
+
+        /** Queues a block of MIDI to send. Call from the audio thread */
+        void send (const MidiBuffer& midi, int numSamples, double sampleRate) noexcept;
+
+        /** Called on the sending thread after each message is sent */
+        std::function<void(const OSCMessage&, const MidiMessage&)> onMessageSent;
+
+    private:
+        friend class OSCService;
+        OSCService& service;
+        DestinationPtr destination;
+        EventQueue queue;
+        Array<MidiEvent> block;
+        Atomic<double> latencyMs { 0.0 };
+
+        void flush();
+        void sendBlock();
+    };
+
+    //==========================================================================
+    OSCService();
+    ~OSCService();
+
+    /** Returns the receiving socket for a port, opening it if needed.
+        Returns nullptr if the port could not be bound.
+     */
+    PortPtr getPort (int portNumber);
+
+    /** Returns the sending socket for a destination, opening it if needed.
+        Returns nullptr if the socket could not be created.
+     */
+    DestinationPtr getDestination (const String& hostName, int portNumber);
+
+    /** Closes the sockets only the service still holds. Called when a user
+        lets go of one, so the next getPort() can bind the port again.
+     */
+    void releaseUnused();
+
+    /** Milliseconds since the epoch with sub-millisecond resolution */
+    static double getWallClockMillis() noexcept;
+
+    /** Converts an OSC time tag to wall clock milliseconds */
+    static double toMillis (const OSCTimeTag& timeTag) noexcept;
+
+    /** Converts wall clock milliseconds to an OSC time tag */
+    static OSCTimeTag toTimeTag (double milliseconds) noexcept;
+
+private:
+    class SendThread;
+    std::unique_ptr<SendThread> sendThread;
+    CriticalSection lock;
+    ReferenceCountedArray<Port> ports;
+    ReferenceCountedArray<Destination> destinations;
+    Array<Outbox*> outboxes;
+
+    void notifySender() noexcept;
+    JUCE_DECLARE_NON_COPYABLE (OSCService)
+};
+
+}
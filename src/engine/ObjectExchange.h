@@ -0,0 +1,107 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** Hands objects from the message thread to the audio thread without
+    locking.
+
+    The writer publishes a complete object with a single pointer exchange.
+    The audio thread takes ownership with acquire() and gives objects it no
+    longer needs back with retire(), they are deleted on the message thread
+    by collectGarbage(), which publish() also calls.
+ */
+template<class ObjectType>
+class ObjectExchange
+{
+public:
+    ObjectExchange() : retiredFifo (numRetiredSlots) { }
+
+    ~ObjectExchange()
+    {
+        delete pending.exchange (nullptr);
+        collectGarbage();
+    }
+
+    /** Publishes an object. Call from the message thread */
+    void publish (std::unique_ptr<ObjectType> object)
+    {
+        collectGarbage();
+        // an object the audio thread never picked up can be deleted here
+        delete pending.exchange (object.release());
+    }
+
+    /** Returns the newest published object, or nullptr if nothing changed.
+        Call from the audio thread, the caller owns the result.
+     */
+    ObjectType* acquire() noexcept { return pending.exchange (nullptr); }
+
+    /** Returns true if something was published the audio thread hasn't
+        acquired yet
+     */
+    bool hasPending() const noexcept { return pending.load() != nullptr; }
+
+    /** Returns an object to be deleted off the audio thread */
+    void retire (ObjectType* object) noexcept
+    {
+        if (object == nullptr)
+            return;
+
+        int start1, size1, start2, size2;
+        retiredFifo.prepareToWrite (1, start1, size1, start2, size2);
+        if (size1 + size2 < 1)
+        {
+            // the message thread isn't keeping up, leak it rather than
+            // deleting on the audio thread
+            jassertfalse;
+            return;
+        }
+
+        retired[size1 > 0 ? start1 : start2] = object;
+        retiredFifo.finishedWrite (1);
+    }
+
+    /** Returns the number of retired objects waiting to be deleted */
+    int getNumRetired() const noexcept { return retiredFifo.getNumReady(); }
+
+    /** Deletes retired objects. Call from the message thread */
+    void collectGarbage()
+    {
+        int start1, size1, start2, size2;
+        retiredFifo.prepareToRead (retiredFifo.getNumReady(), start1, size1, start2, size2);
+        for (int i = 0; i < size1; ++i)
+            delete retired[start1 + i];
+        for (int i = 0; i < size2; ++i)
+            delete retired[start2 + i];
+        retiredFifo.finishedRead (size1 + size2);
+    }
+
+private:
+    enum { numRetiredSlots = 16 };
+    std::atomic<ObjectType*> pending { nullptr };
+    AbstractFifo retiredFifo;
+    ObjectType* retired [numRetiredSlots];
+    JUCE_DECLARE_NON_COPYABLE (ObjectExchange)
+};
+
+}
@@ -0,0 +1,92 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "engine/ObjectExchange.h"
+#include "engine/ToggleGrid.h"
+
+namespace Element {
+
+/** A patch grid prepared for rendering. Each destination keeps a sorted,
+    sparse list of the sources patched to it, so the audio thread never scans
+    the whole grid.
+
+    These allocate: build them on the message thread and hand them to the
+    audio thread with a RoutingMatrix::Exchange.
+ */
+class RoutingMatrix
+{
+public:
+    explicit RoutingMatrix (const MatrixState& matrix)
+        : toggles (matrix)
+    {
+        const int ins  = toggles.getNumInputs();
+        const int outs = toggles.getNumOutputs();
+        offsets.allocate ((size_t) outs + 1, true);
+        sources.allocate ((size_t) jmax (1, ins * outs), true);
+
+        int numConnections = 0;
+        for (int dst = 0; dst < outs; ++dst)
+        {
+            offsets[dst] = numConnections;
+            for (int src = 0; src < ins; ++src)
+                if (toggles.get (src, dst))
+                    sources[numConnections++] = src;
+        }
+
+        offsets[outs] = numConnections;
+    }
+
+    inline int getNumSources() const noexcept       { return toggles.getNumInputs(); }
+    inline int getNumDestinations() const noexcept  { return toggles.getNumOutputs(); }
+
+    inline bool sameSizeAs (const RoutingMatrix& other) const noexcept
+    {
+        return toggles.sameSizeAs (other.toggles);
+    }
+
+    inline bool isConnected (int src, int dst) const noexcept { return toggles.get (src, dst); }
+
+    /** Returns the number of sources patched to a destination */
+    inline int getNumSourcesFor (int dst) const noexcept
+    {
+        jassert (isPositiveAndBelow (dst, getNumDestinations()));
+        return offsets[dst + 1] - offsets[dst];
+    }
+
+    /** Returns the sources patched to a destination in ascending order */
+    inline const int* getSourcesFor (int dst) const noexcept
+    {
+        jassert (isPositiveAndBelow (dst, getNumDestinations()));
+        return sources + offsets[dst];
+    }
+
+    /** Hands matrices to the audio thread, build them on the message thread */
+    using Exchange = ObjectExchange<RoutingMatrix>;
+
+private:
+    ToggleGrid toggles;
+    HeapBlock<int> offsets;
+    HeapBlock<int> sources;
+    JUCE_DECLARE_NON_COPYABLE (RoutingMatrix)
+};
+
+}
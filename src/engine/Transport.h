@@ -90,6 +90,9 @@ namespace Element
         void postProcess (int nframes);
 
         inline MonitorPtr getMonitor() const { return monitor; }
+
+        /** Returns true if the current block should be recorded */
+        inline bool isPlayingAndRecording() const { return playing && recording; }
         
     private:
         AtomicValue<bool> playState, recordState;
@@ -0,0 +1,298 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** Assigns MIDI notes to a fixed number of voices.
+
+    Free voices are used first. When none are left the oldest voice that was
+    released is stolen, then the oldest held one. A voice stays busy after
+    its note ends until the owner calls finish(), so release tails play out.
+
+    Pitch bend, channel pressure and CC 74 are tracked per channel. In MPE
+    mode channel 1 is the master channel of a lower zone: its bend is added
+    to every voice and its sustain pedal holds every voice. Otherwise a
+    voice only follows the channel it was started on.
+
+    Doesn't allocate, handleMessage() can be called on the audio thread.
+ */
+class VoiceAllocator
+{
+public:
+    enum { maxVoices = 64, masterChannel = 1 };
+
+    struct Voice
+    {
+        int note        = -1;
+        int channel     = 1;
+        float velocity  = 0.f;
+        /** Rendering, until finish() is called */
+        bool active     = false;
+        /** The key is down */
+        bool held       = false;
+        /** The key is up but a sustain pedal holds the note */
+        bool sustained  = false;
+        /** Polyphonic aftertouch, 0 to 1 */
+        float pressure  = 0.f;
+        uint32 age      = 0;
+    };
+
+    /** Receives voice changes from handleMessage() */
+    struct Listener
+    {
+        virtual ~Listener() { }
+        /** A voice should start a note. stolen is true if it was playing */
+        virtual void voiceStarted (int voice, bool stolen) = 0;
+        /** A voice's note ended, it keeps rendering until finished */
+        virtual void voiceStopped (int voice) = 0;
+    };
+
+    VoiceAllocator() { reset(); }
+
+    void setNumVoices (int newNumVoices) noexcept
+    {
+        numVoices = jlimit (1, (int) maxVoices, newNumVoices);
+        reset();
+    }
+
+    int getNumVoices() const noexcept { return numVoices; }
+
+    void setMPEEnabled (bool shouldBeEnabled) noexcept { mpe = shouldBeEnabled; }
+    bool isMPEEnabled() const noexcept { return mpe; }
+
+    /** Silences every voice and clears the channel state */
+    void reset() noexcept
+    {
+        for (auto& voice : voices)
+            voice = {};
+        for (auto& state : channels)
+            state = {};
+        counter = 0;
+    }
+
+    const Voice& getVoice (int index) const noexcept
+    {
+        jassert (isPositiveAndBelow (index, numVoices));
+        return voices[index];
+    }
+
+    /** Frees a voice once its release has finished */
+    void finish (int index) noexcept
+    {
+        if (isPositiveAndBelow (index, numVoices))
+            voices[index].active = voices[index].held = voices[index].sustained = false;
+    }
+
+    /** Returns a voice's pitch bend from -1 to 1 */
+    float getBend (int index) const noexcept
+    {
+        const auto& voice = getVoice (index);
+        float bend = channels[voice.channel - 1].bend;
+        if (mpe && voice.channel != masterChannel)
+            bend += channels[masterChannel - 1].bend;
+        return bend;
+    }
+
+    /** Returns a voice's pressure from 0 to 1, channel or polyphonic */
+    float getPressure (int index) const noexcept
+    {
+        const auto& voice = getVoice (index);
+        return jmax (voice.pressure, channels[voice.channel - 1].pressure);
+    }
+
+    /** Returns a voice's CC 74 value from 0 to 1 */
+    float getTimbre (int index) const noexcept
+    {
+        return channels[getVoice (index).channel - 1].timbre;
+    }
+
+    /** Updates the voices for a raw MIDI message */
+    void handleMessage (const uint8* data, int size, Listener& listener) noexcept
+    {
+        if (size < 2 || (data[0] & 0xf0) == 0xf0)
+            return;
+
+        const int status  = data[0] & 0xf0;
+        const int channel = (data[0] & 0x0f) + 1;
+        const int data1   = data[1] & 0x7f;
+        const int data2   = size > 2 ? (data[2] & 0x7f) : 0;
+        auto& state = channels[channel - 1];
+
+        switch (status)
+        {
+            case 0x90:
+                if (data2 > 0)
+                    noteOn (channel, data1, (float) data2 / 127.f, listener);
+                else
+                    noteOff (channel, data1, listener);
+                break;
+
+            case 0x80:
+                noteOff (channel, data1, listener);
+                break;
+
+            case 0xa0:
+                for (int i = 0; i < numVoices; ++i)
+                    if (voices[i].active && voices[i].channel == channel && voices[i].note == data1)
+                        voices[i].pressure = (float) data2 / 127.f;
+                break;
+
+            case 0xd0:
+                state.pressure = (float) data1 / 127.f;
+                break;
+
+            case 0xe0:
+                state.bend = jlimit (-1.f, 1.f, (float) ((data2 << 7 | data1) - 8192) / 8191.f);
+                break;
+
+            case 0xb0:
+                if (data1 == 64)
+                    setSustain (channel, data2 >= 64, listener);
+                else if (data1 == 74)
+                    state.timbre = (float) data2 / 127.f;
+                else if (data1 == 120 || data1 == 123)
+                    allNotesOff (channel, listener);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+private:
+    struct ChannelState
+    {
+        float bend      = 0.f;
+        float pressure  = 0.f;
+        float timbre    = 0.5f;
+        bool sustain    = false;
+    };
+
+    Voice voices [maxVoices];
+    ChannelState channels [16];
+    int numVoices = 8;
+    bool mpe = false;
+    uint32 counter = 0;
+
+    bool isSustained (int channel) const noexcept
+    {
+        return channels[channel - 1].sustain
+            || (mpe && channels[masterChannel - 1].sustain);
+    }
+
+    /** Returns true if a channel message applies to a voice */
+    bool follows (const Voice& voice, int channel) const noexcept
+    {
+        return voice.channel == channel || (mpe && channel == masterChannel);
+    }
+
+    int findVoiceToStart (int channel, int note) const noexcept
+    {
+        // a repeated note restarts its own voice
+        for (int i = 0; i < numVoices; ++i)
+            if (voices[i].active && voices[i].channel == channel && voices[i].note == note)
+                return i;
+
+        int oldestReleased = -1, oldestHeld = -1;
+        for (int i = 0; i < numVoices; ++i)
+        {
+            const auto& voice = voices[i];
+            if (! voice.active)
+                return i;
+
+            int& oldest = voice.held || voice.sustained ? oldestHeld : oldestReleased;
+            if (oldest < 0 || voice.age < voices[oldest].age)
+                oldest = i;
+        }
+
+        return oldestReleased >= 0 ? oldestReleased : oldestHeld;
+    }
+
+    void noteOn (int channel, int note, float velocity, Listener& listener) noexcept
+    {
+        const int index = findVoiceToStart (channel, note);
+        auto& voice = voices[index];
+        const bool stolen = voice.active;
+
+        voice.note      = note;
+        voice.channel   = channel;
+        voice.velocity  = velocity;
+        voice.active    = voice.held = true;
+        voice.sustained = false;
+        voice.pressure  = 0.f;
+        voice.age       = ++counter;
+        listener.voiceStarted (index, stolen);
+    }
+
+    void noteOff (int channel, int note, Listener& listener) noexcept
+    {
+        for (int i = 0; i < numVoices; ++i)
+        {
+            auto& voice = voices[i];
+            if (! voice.held || voice.channel != channel || voice.note != note)
+                continue;
+
+            voice.held = false;
+            if (isSustained (channel))
+            {
+                voice.sustained = true;
+            }
+            else
+            {
+                listener.voiceStopped (i);
+            }
+        }
+    }
+
+    void setSustain (int channel, bool sustain, Listener& listener) noexcept
+    {
+        channels[channel - 1].sustain = sustain;
+        if (sustain)
+            return;
+
+        for (int i = 0; i < numVoices; ++i)
+        {
+            auto& voice = voices[i];
+            if (voice.sustained && follows (voice, channel) && ! isSustained (voice.channel))
+            {
+                voice.sustained = false;
+                listener.voiceStopped (i);
+            }
+        }
+    }
+
+    void allNotesOff (int channel, Listener& listener) noexcept
+    {
+        for (int i = 0; i < numVoices; ++i)
+        {
+            auto& voice = voices[i];
+            if ((voice.held || voice.sustained) && follows (voice, channel))
+            {
+                voice.held = voice.sustained = false;
+                listener.voiceStopped (i);
+            }
+        }
+    }
+};
+
+}
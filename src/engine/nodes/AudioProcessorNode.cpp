@@ -21,6 +21,7 @@
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/GraphProcessor.h"
 #include "engine/nodes/MidiDeviceProcessor.h"
+#include "session/PluginSandbox.h"
 #include "ScopedFlag.h"
 
 namespace Element {
@@ -123,6 +124,8 @@ void AudioProcessorNode::prepareToRender (double sampleRate, int maxBufferSize)
 
     proc->setRateAndBufferSizeDetails (sampleRate, maxBufferSize);
     proc->prepareToPlay (sampleRate, maxBufferSize);
+    // plugins may change latency when prepared, e.g. sandboxed ones
+    setLatencySamples (proc->getLatencySamples());
 }
 
 void AudioProcessorNode::releaseResources() 
@@ -162,6 +165,9 @@ AudioProcessorNode::AudioProcessorNode (uint32 nodeId, AudioProcessor* processor
     {
         jassertfalse; // need a way to identify normal audio processors
     }
+
+    tracksChanges = ! PluginSandbox::isSandboxed (*proc);
+    proc->addListener (this);
 }
 
 AudioProcessorNode::~AudioProcessorNode()
@@ -170,6 +176,10 @@ AudioProcessorNode::~AudioProcessorNode()
     NodeObject::clearParameters();
     enablement.cancelPendingUpdate();
     pluginState.reset();
+    if (proc != nullptr)
+        proc->removeListener (this);
+    if (recycler != nullptr && proc != nullptr)
+        recycler (std::move (proc));
     proc = nullptr;
 }
 
@@ -185,6 +195,31 @@ void AudioProcessorNode::setState (const void* data, int size)
         proc->setStateInformation (data, size);
 }
 
+bool AudioProcessorNode::isStateDirty() const
+{
+    return ! tracksChanges || wasStateChanged()
+        || (proc != nullptr && proc->getActiveEditor() != nullptr);
+}
+
+void AudioProcessorNode::markStateSaved() noexcept
+{
+    NodeObject::markStateSaved();
+    if (proc != nullptr && proc->getActiveEditor() != nullptr)
+        markStateDirty();
+}
+
+void AudioProcessorNode::audioProcessorParameterChanged (AudioProcessor*, int, float)
+{
+    markStateDirty();
+}
+
+void AudioProcessorNode::audioProcessorChanged (AudioProcessor*, const ChangeDetails& details)
+{
+    // a latency change alone doesn't touch the state
+    if (! details.latencyChanged || details.parameterInfoChanged || details.programChanged)
+        markStateDirty();
+}
+
 void AudioProcessorNode::createPorts()
 {
     kv::PortList newPorts;
@@ -26,7 +26,8 @@ namespace Element {
 class GraphProcessor;
 class MidiPipe;
 
-class AudioProcessorNode : public NodeObject
+class AudioProcessorNode : public NodeObject,
+                           private AudioProcessorListener
 {
 public:
     AudioProcessorNode (uint32 nodeId, AudioProcessor* processor);
@@ -37,10 +38,24 @@ public:
     
     void getState (MemoryBlock&) override;
     void setState (const void*, int) override;
+
+    /** Plugins report parameter and program changes, but not every change
+        to their state. So a plugin with its editor open, or one running in
+        a sandbox, is always treated as changed */
+    bool isStateDirty() const override;
+
+    /** Keeps the node dirty while its editor is open, the editor can still
+        change the state after it was captured */
+    void markStateSaved() noexcept override;
     
     void prepareToRender (double sampleRate, int maxBufferSize) override;
     void releaseResources() override;
 
+    /** Receives the processor when this node is deleted, instead of it
+        being deleted too. Used to return plugins to the instance pool */
+    using Recycler = std::function<void (std::unique_ptr<AudioProcessor>)>;
+    void setRecycler (Recycler newRecycler) { recycler = std::move (newRecycler); }
+
 protected:
     void createPorts() override;
     Parameter::Ptr getParameter (const PortDescription& port) override;
@@ -50,6 +65,11 @@ private:
     Atomic<int> enabled { 1 };
     MemoryBlock pluginState;
     ParameterArray params;
+    Recycler recycler;
+    bool tracksChanges = false;
+
+    void audioProcessorParameterChanged (AudioProcessor*, int, float) override;
+    void audioProcessorChanged (AudioProcessor*, const ChangeDetails&) override;
 
     struct EnablementUpdater : public AsyncUpdater
     {
@@ -18,6 +18,7 @@
 */
 
 #include "engine/nodes/BaseProcessor.h"
+#include "engine/DSPKernels.h"
 #include "engine/nodes/AudioRouterNode.h"
 #include "Common.h"
 
@@ -29,18 +30,11 @@ AudioRouterNode::AudioRouterNode (int ins, int outs)
     : NodeObject (0),
       numSources (ins),
       numDestinations (outs),
-      state (ins, outs),
-      toggles (ins, outs),
-      nextToggles (ins, outs)
+      state (ins, outs)
 {
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, "Element", nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_AUDIO_ROUTER, nullptr);
-    
-    fadeIn.setFadesIn (true);
-    fadeIn.setLength (fadeLengthSeconds);
-    fadeOut.setFadesIn (false);
-    fadeOut.setLength (fadeLengthSeconds);
 
     clearPatches();
 
@@ -92,16 +86,16 @@ void AudioRouterNode::setCurrentProgram (int index)
     }
 }
 
-void AudioRouterNode::applyMatrix (const MatrixState& matrix)
+void AudioRouterNode::prepareToRender (double newSampleRate, int maxBufferSize)
 {
-    jassert (matrix.sameSizeAs (state));
-    ToggleGrid newPatches (matrix);
-    {
-        ScopedLock sl (getLock());
-        nextToggles.swapWith (newPatches);
-        togglesChanged = true; // initiate the crossfade
-    }
+    renderSampleRate = newSampleRate;
+    tempAudio.setSize (jmax (numSources, numDestinations), maxBufferSize, false, false, true);
+}
 
+void AudioRouterNode::applyMatrix (const MatrixState& matrix)
+{
+    // the audio thread crossfades when the new matrix has the same size
+    routing.publish (std::unique_ptr<RoutingMatrix> (new RoutingMatrix (matrix)));
     sendChangeMessage();
 }
 
@@ -131,21 +125,16 @@ void AudioRouterNode::setSize (int newIns, int newOuts)
     }
 
     state.resize (newIns, newOuts, true);
-    ToggleGrid newPatches (state);
-    ToggleGrid newNextPatches (state);
-    
+
     {
         ScopedLock sl (getLock());
-        nextToggles.swapWith (newNextPatches);
-        toggles.swapWith (newPatches);
         numSources = newIns;
         numDestinations = newOuts;
-        sizeChanged = true; // initiate the size change
     }
 
     rebuildPorts = true;
+    applyMatrix (state);
     triggerPortReset();
-    sendChangeMessage();
 }
 
 void AudioRouterNode::setMatrixState (const MatrixState& matrix)
@@ -159,6 +148,84 @@ MatrixState AudioRouterNode::getMatrixState() const
     return state;
 }
 
+void AudioRouterNode::updateRouting() noexcept
+{
+    auto* const published = routing.acquire();
+    if (published == nullptr)
+        return;
+
+    if (current == nullptr || ! current->sameSizeAs (*published))
+    {
+        // size changes are not crossfaded
+        routing.retire (next.release());
+        routing.retire (current.release());
+        current.reset (published);
+        TRACE_AUDIO_ROUTER("size changed");
+        return;
+    }
+
+    if (next != nullptr)
+    {
+        // a fade is running, jump it to its target and fade from there
+        routing.retire (current.release());
+        current.reset (next.release());
+    }
+
+    next.reset (published);
+    fadePosition = 0;
+    fadeLength = jmax (1, roundToInt (fadeLengthSeconds.get() * renderSampleRate));
+    TRACE_AUDIO_ROUTER("fade start");
+}
+
+void AudioRouterNode::renderCrossfade (const AudioSampleBuffer& input, int numFrames) noexcept
+{
+    const float startGain = (float) fadePosition / (float) fadeLength;
+    const float endGain   = (float) (fadePosition + numFrames) / (float) fadeLength;
+
+    for (int dst = 0; dst < current->getNumDestinations(); ++dst)
+    {
+        auto* const out = tempAudio.getWritePointer (dst);
+        const int* const from = current->getSourcesFor (dst);
+        const int* const to   = next->getSourcesFor (dst);
+        const int numFrom = current->getNumSourcesFor (dst);
+        const int numTo   = next->getNumSourcesFor (dst);
+
+        // both lists are sorted, so a merge visits each connection once
+        int i = 0, j = 0;
+        while (i < numFrom || j < numTo)
+        {
+            if (j >= numTo || (i < numFrom && from[i] < to[j]))
+            {
+                DSP::addWithRamp (out, input.getReadPointer (from[i]), numFrames,
+                                  1.0f - startGain, 1.0f - endGain);
+                ++i;
+            }
+            else if (i >= numFrom || to[j] < from[i])
+            {
+                DSP::addWithRamp (out, input.getReadPointer (to[j]), numFrames,
+                                  startGain, endGain);
+                ++j;
+            }
+            else
+            {
+                FloatVectorOperations::add (out, input.getReadPointer (from[i]), numFrames);
+                ++i; ++j;
+            }
+        }
+    }
+}
+
+void AudioRouterNode::renderPatches (const AudioSampleBuffer& input, int startFrame, int numFrames) noexcept
+{
+    for (int dst = 0; dst < current->getNumDestinations(); ++dst)
+    {
+        auto* const out = tempAudio.getWritePointer (dst, startFrame);
+        const int* const sources = current->getSourcesFor (dst);
+        for (int i = current->getNumSourcesFor (dst); --i >= 0;)
+            FloatVectorOperations::add (out, input.getReadPointer (sources[i], startFrame), numFrames);
+    }
+}
+
 void AudioRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
     jassert (midi.getNumBuffers() == 1);
@@ -178,142 +245,36 @@ void AudioRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
     const int numFrames = audio.getNumSamples();
     const int numChannels = audio.getNumChannels();
 
-    tempAudio.setSize (numChannels, numFrames, false, false, true);
-    tempAudio.clear (0, numFrames);
-
-    if (sizeChanged)
-    {
-        fadeIn.reset();
-        fadeOut.reset();
-        sizeChanged = false;
-        TRACE_AUDIO_ROUTER("size changed");
-    }
-
-    if (togglesChanged)
-    {
-        fadeIn.reset();
-        fadeIn.startFading();
-        fadeOut.reset();
-        fadeOut.startFading();
-        togglesChanged = false;
-        TRACE_AUDIO_ROUTER("fade start");
-    }
+    updateRouting();
 
-    if (numSources > numChannels || numDestinations > numChannels)
+    if (current == nullptr || current->getNumSources() > numChannels 
+        || current->getNumDestinations() > numChannels)
     {
         audio.clear();
         midi.clear();
         return;
     }
 
-    if (fadeIn.isActive() || fadeOut.isActive())
-    {
-        auto framesToProcess = numFrames;
-        int frame = 0;
-        ScopedLock sl (lock);
-        
-        float fadeInGain  = 0.0f;
-        float fadeOutGain = 1.0f;
-
-        while (--framesToProcess >= 0)
-        {
-            fadeInGain  = fadeIn.isActive()  ? fadeIn.getNextEnvelopeValue()  : 1.0f;
-            fadeOutGain = fadeOut.isActive() ? fadeOut.getNextEnvelopeValue() : 0.0f;
-
-            if (!fadeIn.isActive() && !fadeOut.isActive())
-            {
-                TRACE_AUDIO_ROUTER("last frame fade in gain  : " << fadeInGain);
-                TRACE_AUDIO_ROUTER("last frame fade out gain : " << fadeOutGain);
-            }
-
-            for (int i = 0; i < numSources; ++i)
-            {
-                for (int j = 0; j < numDestinations; ++j)
-                {
-                    if (toggles.get (i, j) && nextToggles.get (i, j))
-                    {
-                        // no patch change and on means 1 to 1 mix
-                        tempAudio.getWritePointer(j)[frame] += 
-                            audio.getReadPointer(i)[frame];
-                    }
-                    else if (! toggles.get (i, j) && ! nextToggles.get (i, j))
-                    {
-                        // no patch change and off means no fade and zero'd
-                        tempAudio.getWritePointer(j)[frame] += 0.0f;
-                    }
-                    else if (!toggles.get (i, j) && nextToggles.get (i, j))
-                    {
-                        tempAudio.getWritePointer(j)[frame] += 
-                            (audio.getReadPointer(i)[frame] * fadeInGain);
-                    }
-                    else if (toggles.get (i, j) && !nextToggles.get (i, j))
-                    {
-                        tempAudio.getWritePointer(j)[frame] += 
-                            (audio.getReadPointer(i)[frame] * fadeOutGain);
-                    }
-                }
-            }
-
-            ++frame;
+    tempAudio.setSize (numChannels, numFrames, false, false, true);
+    tempAudio.clear (0, numFrames);
 
-            if (!fadeIn.isActive() && !fadeOut.isActive())
-                break;
-        }
+    int frame = 0;
+    if (next != nullptr)
+    {
+        frame = jmin (numFrames, fadeLength - fadePosition);
+        renderCrossfade (audio, frame);
+        fadePosition += frame;
 
-        if (!fadeOut.isActive() && !fadeIn.isActive())
+        if (fadePosition >= fadeLength)
         {
-            TRACE_AUDIO_ROUTER("fade stopped @ frame: " << (frame));
-            TRACE_AUDIO_ROUTER("fade in level  : " << fadeInGain);
-            TRACE_AUDIO_ROUTER("fade out level : " << fadeOutGain);
-
-            if (framesToProcess > 0)
-            {
-                TRACE_AUDIO_ROUTER("rendering " << framesToProcess << " remainging frames");
-                for (int i = 0; i < numSources; ++i)
-                {
-                    for (int j = 0; j < numDestinations; ++j)
-                    {
-                        if (toggles.get(i, j) && nextToggles.get (i, j))
-                        {
-                            // no patch change and on means 1 to 1 mix
-                            tempAudio.addFrom (j, frame, audio.getReadPointer (i, frame), 
-                                               framesToProcess);
-                        }
-                        else if (! toggles.get (i, j) && ! nextToggles.get (i, j))
-                        {
-                            // patch not changed and of, so clear the out channel.
-                            // nothing to do
-                        }
-                        else if (!toggles.get (i, j) && nextToggles.get (i, j))
-                        {
-                            tempAudio.addFromWithRamp (j, frame, audio.getReadPointer (i, frame), 
-                                                          framesToProcess, fadeInGain, 1.0f);
-                        }
-                        else if (toggles.get (i, j) && !nextToggles.get (i, j))
-                        {
-                            tempAudio.addFromWithRamp (j, frame, audio.getReadPointer (i, frame),
-                                                          framesToProcess, fadeOutGain, 0.0f);
-                        }
-                        else
-                        {
-                            // this would be an unhandled fading scenario
-                            jassertfalse;
-                        }
-                    }
-                }
-            }
-
-            toggles.swapWith (nextToggles);
+            TRACE_AUDIO_ROUTER("fade stopped @ frame: " << frame);
+            routing.retire (current.release());
+            current.reset (next.release());
         }
     }
-    else
-    {
-        ScopedLock sl (lock);
-        for (int i = 0; i < numSources; ++i)
-            for (int j = 0; j < numDestinations; ++j)
-                if (toggles.get (i, j))
-                    tempAudio.addFrom (j, 0, audio, i, 0, numFrames);
-    }
+
+    if (frame < numFrames)
+        renderPatches (audio, frame, numFrames - frame);
 
     for (int c = 0; c < numChannels; ++c)
         audio.copyFrom (c, 0, tempAudio.getReadPointer(c), numFrames);
@@ -339,19 +300,14 @@ void AudioRouterNode::setState (const void* data, int sizeInBytes)
         {
             state = matrix;
 
-            ToggleGrid newPatches (state);
-            ToggleGrid newNextPatches (state);
             {
                 ScopedLock sl (getLock());
                 numSources = matrix.getNumRows();
                 numDestinations = matrix.getNumColumns();
-                nextToggles.swapWith (newNextPatches);
-                toggles.swapWith (newPatches);
-                sizeChanged = true;
             }
 
             rebuildPorts = true;
-            sendChangeMessage();
+            applyMatrix (state);
             triggerPortReset();
         }
     }
@@ -360,28 +316,23 @@ void AudioRouterNode::setState (const void* data, int sizeInBytes)
 void AudioRouterNode::setWithoutLocking (int src, int dst, bool set)
 {
     jassert (src >= 0 && src < numSources && dst >= 0 && dst < numDestinations);
-    toggles.set (src, dst, set);
     state.set (src, dst, set);
+    applyMatrix (state);
 }
 
 void AudioRouterNode::set (int src, int dst, bool patched)
 {
-    jassert (src >= 0 && src < numSources && dst >= 0 && numDestinations < 4);
-    toggles.set (src, dst, patched);
+    jassert (src >= 0 && src < numSources && dst >= 0 && dst < numDestinations);
     state.set (src, dst, patched);
+    applyMatrix (state);
 }
 
 void AudioRouterNode::clearPatches()
 {
-    {
-        ScopedLock sl (getLock());
-        toggles.clear();
-        nextToggles.clear();
-    }
-
     for (int r = 0; r < state.getNumRows(); ++r)
         for (int c = 0; c < state.getNumColumns(); ++c)
             state.set (r, c, false);
+    applyMatrix (state);
 }
 
 }
@@ -20,8 +20,7 @@
 #pragma once
 
 #include "engine/NodeObject.h"
-#include "engine/LinearFade.h"
-#include "engine/ToggleGrid.h"
+#include "engine/RoutingMatrix.h"
 #include "engine/nodes/BaseProcessor.h"
 
 namespace Element {
@@ -33,7 +32,7 @@ public:
     explicit AudioRouterNode (int ins = 4, int outs = 4);
     ~AudioRouterNode();
 
-    void prepareToRender (double sampleRate, int maxBufferSize) override { ignoreUnused (sampleRate, maxBufferSize); }
+    void prepareToRender (double sampleRate, int maxBufferSize) override;
     void releaseResources() override { }
 
     inline bool wantsMidiPipe() const override { return true; }
@@ -60,11 +59,7 @@ public:
 
     void setFadeLength (double seconds)
     {
-        seconds = jlimit (0.001, 5.0, seconds);
-        ScopedLock sl (lock);
-        fadeLengthSeconds = seconds;
-        fadeIn.setLength (static_cast<float> (fadeLengthSeconds));
-        fadeOut.setLength (static_cast<float> (fadeLengthSeconds));
+        fadeLengthSeconds.set (jlimit (0.001, 5.0, seconds));
     }
 
     void getPluginDescription (PluginDescription& desc) const override
@@ -137,15 +132,19 @@ private:
     // used by the UI, but not the rendering
     MatrixState state;
 
-    double fadeLengthSeconds { 0.001 }; // 1 ms
-    LinearFade fadeIn;
-    LinearFade fadeOut;
-    ToggleGrid toggles;
-    ToggleGrid nextToggles;
-    bool togglesChanged { false },
-         sizeChanged { false };
+    Atomic<double> fadeLengthSeconds { 0.001 }; // 1 ms
+    double renderSampleRate { 44100.0 };
+
+    // owned by the audio thread, next is non-null while crossfading
+    RoutingMatrix::Exchange routing;
+    std::unique_ptr<RoutingMatrix> current, next;
+    int fadePosition { 0 },
+        fadeLength { 1 };
 
     void applyMatrix (const MatrixState&);
+    void updateRouting() noexcept;
+    void renderCrossfade (const AudioSampleBuffer& input, int numFrames) noexcept;
+    void renderPatches (const AudioSampleBuffer& input, int startFrame, int numFrames) noexcept;
 };
 
 }
@@ -26,7 +26,10 @@
 #include "engine/nodes/LuaNode.h"
 #include "engine/MidiPipe.h"
 #include "engine/Parameter.h"
+#include "scripting/LuaAllocator.h"
 #include "scripting/LuaBindings.h"
+#include "scripting/LuaBytecodeCache.h"
+#include "scripting/LuaWatchdog.h"
 
 #define EL_LUA_DBG(x)
 // #define EL_LUA_DBG(x) DBG(x)
@@ -170,12 +173,24 @@ private:
 struct LuaNode::Context
 {
     explicit Context ()
+        : state (sol::default_at_panic, LuaAllocator::alloc, &allocator)
     {
         L = state.lua_state();
+        LuaAllocator::setupCollector (L);
+        watchdog.attach (L);
     }
 
     ~Context()
     {
+        try
+        {
+            release();
+        }
+        catch (const std::exception& e)
+        {
+            DBG("[EL] " << e.what());
+        }
+
         for (auto* ip : inParams)
             dynamic_cast<LuaParameter*>(ip)->unlink();
         for (auto* op : outParams)
@@ -204,51 +219,42 @@ struct LuaNode::Context
         try
         {
             Lua::initializeState (state);
-            auto res = state.script (initScript.toRawUTF8());
-            if (res.valid())
-            {
-                res = state.script (script.toRawUTF8());
-            }
-            else
+            run (initScript, "=init");
+            run (script, "=script");
+
+            bool ok = false;
+            if (lua_getglobal (state, "node_render") == LUA_TFUNCTION)
             {
-                sol::error e = res;
-                errorMsg = e.what();
+                renderRef = luaL_ref (state, LUA_REGISTRYINDEX);
+                ok = renderRef != LUA_REFNIL && renderRef != LUA_NOREF;
             }
+            
+            if (! ok)
+                errorMsg = "render function not found";
 
-            if (res.valid())
+            if (ok)
             {
-                bool ok = false;
-                if (lua_getglobal (state, "node_render") == LUA_TFUNCTION)
-                {
-                    renderRef = luaL_ref (state, LUA_REGISTRYINDEX);
-                    ok = renderRef != LUA_REFNIL && renderRef != LUA_NOREF;
-                }
-                
-                if (! ok)
-                    errorMsg = "render function not found";
+                audioBuffer = kv::lua::new_userdata<AudioBuffer<float>> (state, LKV_MT_AUDIO_BUFFER_32);
+                audioBufRef = luaL_ref (state, LUA_REGISTRYINDEX);
+                ok = audioBufRef != LUA_REFNIL && audioBufRef != LUA_NOREF;
+            }
 
-                if (ok)
-                {
-                    audioBuffer = kv::lua::new_userdata<AudioBuffer<float>> (state, LKV_MT_AUDIO_BUFFER_32);
-                    audioBufRef = luaL_ref (state, LUA_REGISTRYINDEX);
-                    ok = audioBufRef != LUA_REFNIL && audioBufRef != LUA_NOREF;
-                }
+            if (! ok)
+                errorMsg = "could not allocate audio buffer";
 
-                if (! ok)
-                    errorMsg = "could not allocate audio buffer";
+            if (ok)
+            {
+                midiPipe = LuaMidiPipe::create (L, 4);
+                midiPipeRef = luaL_ref (state, LUA_REGISTRYINDEX);
+                ok = midiPipeRef != LUA_REFNIL && midiPipeRef != LUA_NOREF;
+            }
 
-                if (ok)
-                {
-                    midiPipe = LuaMidiPipe::create (L, 4);
-                    midiPipeRef = luaL_ref (state, LUA_REGISTRYINDEX);
-                    ok = midiPipeRef != LUA_REFNIL && midiPipeRef != LUA_NOREF;
-                }
+            if (! ok)
+                errorMsg = "could not create MIDI pipe";
 
-                if (! ok)
-                    errorMsg = "could not create MIDI pipe";
+            loaded = ok;
 
-                loaded = ok;
-            }
+            state.collect_garbage();
         }
         catch (const std::exception& e)
         {
@@ -274,6 +280,27 @@ struct LuaNode::Context
                 ? errorMsg : String("unknown error in script"));
     }
 
+    /** Runs a chunk through the shared bytecode cache, throws on errors */
+    void run (const String& code, const char* chunkName)
+    {
+        if (bytecode->load (L, code, chunkName) != LUA_OK)
+        {
+            const char* message = lua_tostring (L, -1);
+            const std::string error = message != nullptr ? message : "could not load chunk";
+            lua_pop (L, 1);
+            throw std::runtime_error (error);
+        }
+
+        sol::protected_function chunk (L, -1);
+        lua_pop (L, 1);
+        auto result = chunk();
+        if (! result.valid())
+        {
+            sol::error e = result;
+            throw e;
+        }
+    }
+
     static Result validate (const String& script)
     {
         if (script.isEmpty())
@@ -309,7 +336,7 @@ struct LuaNode::Context
             ctx->state["__ln_validate_nmidi"]   = nmidi;
             ctx->state["__ln_validate_nchans"]  = nchans;
             ctx->state["__ln_validate_nframes"] = block;
-            ctx->state.script (R"(
+            ctx->run (R"(
                 function __ln_validate_render()
                     local AudioBuffer = require ('kv.AudioBuffer')
                     local MidiPipe    = require ('el.MidiPipe')
@@ -336,7 +363,7 @@ struct LuaNode::Context
                 __ln_validate_render()
                 __ln_validate_render = nil
                 collectgarbage()
-            )");
+            )", "=validate");
 
             ctx->release();
             ctx.reset();
@@ -355,6 +382,9 @@ struct LuaNode::Context
         if (! ready())
             return;
 
+        sampleRate = rate;
+        blockSize = block;
+        prepared = true;
         if (sol::function f = state ["node_prepare"])
             f (rate, block);
         
@@ -379,9 +409,10 @@ struct LuaNode::Context
 
     void release()
     {
-        if (! ready())
+        if (! ready() || ! prepared)
             return;
 
+        prepared = false;
         if (sol::function f = state ["node_release"])
             f();
         
@@ -398,25 +429,40 @@ struct LuaNode::Context
         state.collect_garbage();
     }
 
-    void render (AudioSampleBuffer& audio, MidiPipe& midi) noexcept
+    /** Returns false if the output should be discarded */
+    bool render (AudioSampleBuffer& audio, MidiPipe& midi) noexcept
     {
         if (! loaded)
-            return;
+            return true;
 
+        const int top = lua_gettop (L);
         if (lua_rawgeti (L, LUA_REGISTRYINDEX, renderRef) == LUA_TFUNCTION)
         {
             if (lua_rawgeti (L, LUA_REGISTRYINDEX, audioBufRef) == LUA_TUSERDATA)
             {
                 if (lua_rawgeti (L, LUA_REGISTRYINDEX, midiPipeRef) == LUA_TUSERDATA)
                 {
+                    if (! watchdog.beginBlock (audio.getNumSamples(), sampleRate))
+                    {
+                        lua_settop (L, top);
+                        return false;
+                    }
+
                     // (*audioBuffer)->setSize (audio.getNumChannels(), audio.getNumSamples(), true, false, true);
                     (*audioBuffer)->setDataToReferTo (audio.getArrayOfWritePointers(),
                             audio.getNumChannels(), audio.getNumSamples());
                     (*midiPipe)->swapWith (midi);
 
-                    lua_call (L, 2, 0);
-                    
+                    allocator.beginBlock();
+                    if (lua_pcall (L, 2, 0, 0) != LUA_OK)
+                        LuaWatchdog::reportError (L);
+                    const bool overran = watchdog.endBlock();
+                    // give the collector up to a tenth of the block
+                    allocator.collectGarbage (L, 100.0 * audio.getNumSamples() / sampleRate);
+                    allocator.endBlock();
+
                     (*midiPipe)->swapWith (midi);
+                    return ! overran;
                 }
             }
         }
@@ -424,7 +470,23 @@ struct LuaNode::Context
         {
             DBG("didn't get render fucntion in callback");
         }
+
+        lua_settop (L, top);
+        return true;
+    }
+
+    bool isPreparedFor (double rate, int block) const noexcept
+    {
+        return prepared && rate == sampleRate && block == blockSize;
+    }
+
+    int getNumAudioChannels() const
+    {
+        return jmax (ports.size (PortType::Audio, true), ports.size (PortType::Audio, false));
     }
+
+    LuaAllocator::Stats getMemoryStats() const noexcept { return allocator.getStats(); }
+    LuaWatchdog& getWatchdog() noexcept { return watchdog; }
     
     const OwnedArray<PortDescription>& getPortArray() const noexcept
     {
@@ -543,8 +605,14 @@ struct LuaNode::Context
     }
 
 private:
+    LuaAllocator allocator;
+    LuaWatchdog watchdog;
     sol::state state;
     lua_State* L { nullptr };
+    SharedResourcePointer<LuaBytecodeCache> bytecode;
+    double sampleRate { 44100.0 };
+    int blockSize { 512 };
+    bool prepared { false };
     sol::function renderf;
     std::function<void(AudioSampleBuffer&, MidiPipe&)> renderstdf;
     String name;
@@ -713,63 +781,103 @@ void LuaParameter::controlValueChanged (int index, float value)
 void LuaParameter::controlTouched (int, bool) {}
 
 LuaNode::LuaNode() noexcept
-    : NodeObject (0)
+    : NodeObject (0),
+      contexts (std::make_unique<Context>())
 {
-    context = std::make_unique<Context>();
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, EL_INTERNAL_FORMAT_NAME, nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_LUA, nullptr);
     loadScript (stereoAmpScript);
 }
 
-LuaNode::~LuaNode()
-{
-    context.reset();
-}
+LuaNode::~LuaNode() { }
 
 void LuaNode::createPorts()
 {
-    if (context == nullptr)
-        return;
     ports.clearQuick();
-    context->getPorts (ports);
+    contexts.getLatest()->getPorts (ports);
 }
 
 Parameter::Ptr LuaNode::getParameter (const PortDescription& port)
 {
-    return context->getParameter (port);
+    return contexts.getLatest()->getParameter (port);
 }
 
-Result LuaNode::loadScript (const String& newScript)
+std::function<Result (std::unique_ptr<LuaNode::Context>&)>
+LuaNode::makeBuilder (const String& code) const
 {
-    auto result = Context::validate (newScript);
-    if (result.failed())
+    const double rate   = sampleRate;
+    const int block     = blockSize;
+    const bool prepare  = prepared;
+    const double budget = cpuBudget;
+
+    return [=] (std::unique_ptr<Context>& context)
+    {
+        // the dry run is only needed the first time a script is seen
+        SharedResourcePointer<LuaBytecodeCache> bytecode;
+        if (! bytecode->isValidated (code, "LuaNode"))
+        {
+            auto result = Context::validate (code);
+            if (result.failed())
+                return result;
+            bytecode->setValidated (code, "LuaNode");
+        }
+
+        context = std::make_unique<Context>();
+        auto result = context->load (code);
+        if (result.failed())
+            return result;
+
+        context->getWatchdog().setBudget (budget);
+        if (prepare)
+            context->prepare (rate, block);
         return result;
-    
-    auto newContext = std::make_unique<Context>();
-    result = newContext->load (newScript);
+    };
+}
 
-    if (result.wasOk())
+void LuaNode::installContext (std::unique_ptr<Context> context, const String& code,
+                              bool keepParameterValues)
+{
+    // the node may have been prepared or released while this was built
+    if (prepared && ! context->isPreparedFor (sampleRate, blockSize))
     {
-        script = draftScript = newScript;
-        if (prepared)
-            newContext->prepare (sampleRate, blockSize);
-        triggerPortReset();
-        ScopedLock sl (lock);
-        if (context != nullptr)
-            newContext->copyParameterValues (*context);
-        context.swap (newContext);
+        context->release();
+        context->prepare (sampleRate, blockSize);
     }
-
-    if (newContext != nullptr)
+    else if (! prepared)
     {
-        newContext->release();
-        newContext.reset();
+        context->release();
     }
 
+    if (keepParameterValues)
+        context->copyParameterValues (*contexts.getLatest());
+
+    script = draftScript = code;
+    contexts.install (std::move (context));
+    triggerPortReset();
+}
+
+Result LuaNode::loadScript (const String& newScript)
+{
+    std::unique_ptr<Context> context;
+    auto result = makeBuilder (newScript) (context);
+    if (result.wasOk())
+        installContext (std::move (context), newScript, true);
     return result;
 }
 
+void LuaNode::loadScriptAsync (const String& newScript, std::function<void (Result)> onLoaded)
+{
+    contexts.buildAsync (makeBuilder (newScript),
+        [this, newScript, onLoaded] (Result result, std::unique_ptr<Context> context)
+        {
+            if (result.wasOk())
+                installContext (std::move (context), newScript, true);
+            if (onLoaded)
+                onLoaded (result);
+        });
+}
+
 void LuaNode::getPluginDescription (PluginDescription& desc) const
 {
     desc.name               = "Lua";
@@ -791,7 +899,13 @@ void LuaNode::prepareToRender (double rate, int block)
         return;
     sampleRate = rate;
     blockSize = block;
-    context->prepare (sampleRate, blockSize);
+    auto* const context = contexts.getLatest();
+    contexts.prepare (sampleRate, blockSize, context->getNumAudioChannels());
+    if (! context->isPreparedFor (sampleRate, blockSize))
+    {
+        context->release();
+        context->prepare (sampleRate, blockSize);
+    }
     prepared = true;
 }
 
@@ -800,13 +914,14 @@ void LuaNode::releaseResources()
     if (! prepared)
         return;
     prepared = false;
-    context->release();
+    contexts.release();
+    contexts.getLatest()->release();
 }
 
 void LuaNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
-    ScopedLock sl (lock);
-    context->render (audio, midi);
+    if (! contexts.render (audio, midi))
+        renderBypassed (audio, midi);
 }
 
 void LuaNode::setState (const void* data, int size)
@@ -814,11 +929,15 @@ void LuaNode::setState (const void* data, int size)
     const auto state = ValueTree::readFromGZIPData (data, size);
     if (state.isValid())
     {
-        // May want to do this procedure async with a Message::post()
-        auto result = loadScript (state["script"].toString());
+        setCpuBudget (state.getProperty ("cpuBudget", cpuBudget));
+        const auto code = state["script"].toString();
+        std::unique_ptr<Context> context;
+        auto result = makeBuilder (code) (context);
 
         if (result.wasOk())
         {
+            // restored before it's installed so the audio thread never sees
+            // a half restored script
             if (state.hasProperty ("params"))
             {
                 const var& params = state.getProperty ("params");
@@ -834,16 +953,21 @@ void LuaNode::setState (const void* data, int size)
                     if (auto* block = data.getBinaryData())
                         context->setState (block->getData(), block->getSize());
             }
+
+            installContext (std::move (context), code, false);
         }
+
         sendChangeMessage();
     }
 }
 
 void LuaNode::getState (MemoryBlock& block)
 {
+    auto* const context = contexts.getLatest();
     ValueTree state ("LuaNodeState");
     state.setProperty ("script", script, nullptr)
-         .setProperty ("draft",  draftScript, nullptr);
+         .setProperty ("draft",  draftScript, nullptr)
+         .setProperty ("cpuBudget", cpuBudget, nullptr);
 
     MemoryBlock scriptBlock;
     context->getParameterData (scriptBlock);
@@ -864,8 +988,28 @@ void LuaNode::getState (MemoryBlock& block)
 
 void LuaNode::setParameter (int index, float value)
 {
-    ScopedLock sl (lock);
-    context->setParameter (index, value);
+    contexts.getLatest()->setParameter (index, value);
+}
+
+LuaAllocator::Stats LuaNode::getMemoryStats()
+{
+    return contexts.getLatest()->getMemoryStats();
+}
+
+LuaWatchdog::Stats LuaNode::getCpuStats()
+{
+    return contexts.getLatest()->getWatchdog().getStats();
+}
+
+void LuaNode::setCpuBudget (double proportionOfBlock)
+{
+    cpuBudget = jlimit (0.01, 1.0, proportionOfBlock);
+    contexts.getLatest()->getWatchdog().setBudget (cpuBudget);
+}
+
+void LuaNode::resumeScript()
+{
+    contexts.getLatest()->getWatchdog().resume();
 }
 
 }
@@ -21,6 +21,9 @@
 
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/NodeObject.h"
+#include "scripting/LuaAllocator.h"
+#include "scripting/LuaWatchdog.h"
+#include "scripting/ScriptHotSwap.h"
 
 namespace Element {
 
@@ -42,8 +45,15 @@ public:
     void setState (const void* data, int size) override;
     void getState (MemoryBlock& block) override;
     
+    /** Compiles a script and swaps it in, blocking until it is ready */
     Result loadScript (const String&);
 
+    /** Compiles a script on a background thread and crossfades to it when
+        it is ready. onLoaded is called on the message thread with the result,
+        unless another script was loaded in the meantime.
+     */
+    void loadScriptAsync (const String&, std::function<void (Result)> onLoaded = nullptr);
+
     const String& getScript() const { return script; }
     const String& getDraftScript() const { return draftScript; }
     void setDraftScript (const String& draft) { draftScript = draft; }
@@ -56,6 +66,19 @@ public:
     */
     void setParameter (int index, float value);
 
+    /** Returns the memory counters of the running script */
+    LuaAllocator::Stats getMemoryStats();
+
+    /** Returns the CPU counters of the running script */
+    LuaWatchdog::Stats getCpuStats();
+
+    /** Sets how much of each block the script may use before it is stopped */
+    void setCpuBudget (double proportionOfBlock);
+    double getCpuBudget() const noexcept { return cpuBudget; }
+
+    /** Lets a script suspended for overrunning its budget run again */
+    void resumeScript();
+
 protected:
     inline bool wantsMidiPipe() const override { return true; }
     void createPorts() override;
@@ -66,9 +89,12 @@ private:
     int blockSize = 512;
     double sampleRate = 44100.0;
     bool prepared = false;
-    CriticalSection lock;
-    std::unique_ptr<Context> context;
+    double cpuBudget = 0.5;
+    ScriptHotSwap<Context> contexts;
     ParameterArray inParams, outParams;
+
+    std::function<Result (std::unique_ptr<Context>&)> makeBuilder (const String& code) const;
+    void installContext (std::unique_ptr<Context>, const String& code, bool keepParameterValues);
 };
 
 }
@@ -22,26 +22,31 @@
 
 namespace Element {
 
+static constexpr int midiMonitorRingSize = 4096;
+
 MidiMonitorNode::MidiMonitorNode()
-    : MidiFilterNode (0)
+    : MidiFilterNode (0),
+      fifo (midiMonitorRingSize)
 {
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, "Element", nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_MIDI_MONITOR, nullptr);
-    midiTemp.ensureSize (3 * 32);
+    ring.allocate ((size_t) midiMonitorRingSize, true);
+    log.ensureStorageAllocated (maxLoggedMessages);
 }
 
 MidiMonitorNode::~MidiMonitorNode()
 {
     stopTimer();
+    stopCapture();
     clearMessages();
 }
 
 void MidiMonitorNode::prepareToRender (double sampleRate, int maxBufferSize)
 {
-    inputMessages.reset (sampleRate);
+    ignoreUnused (maxBufferSize);
     currentSampleRate = sampleRate;
-    numSamples = 0;
+    framesRendered = 0;
     startTimerHz (refreshRateHz);
 };
 
@@ -52,84 +57,189 @@ void MidiMonitorNode::releaseResources()
 
 void MidiMonitorNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
-    auto timestamp = Time::getMillisecondCounterHiRes();
     const auto nframes = audio.getNumSamples();
-
     if (nframes == 0)
         return;
 
     auto* const midiIn = midi.getWriteBuffer (0);
-    MidiBuffer::Iterator iter (*midiIn);
-    MidiMessage msg;
-    int frame;
+    for (const auto msg : *midiIn)
+    {
+        if (! passesFilter (msg.data, msg.numBytes))
+            continue;
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+        if (size1 + size2 < 1)
+        {
+            ++numDropped;
+            continue;
+        }
+
+        auto& event = ring[size1 > 0 ? start1 : start2];
+        event.frame     = framesRendered + msg.samplePosition;
+        event.fullSize  = msg.numBytes;
+        event.size      = (uint8) jmin (3, msg.numBytes);
+        memcpy (event.data, msg.data, (size_t) event.size);
+        fifo.finishedWrite (1);
+    }
+
+    framesRendered += nframes;
+}
+
+bool MidiMonitorNode::passesFilter (const uint8* data, int size) const noexcept
+{
+    if (size <= 0)
+        return false;
+
+    const auto status = data[0];
+    int type = otherMessages;
 
-    ScopedLock sl (lock);
-    while (iter.getNextEvent (msg, frame))
+    if (status < 0xf0)
     {
-        msg.setTimeStamp (timestamp + (1000.0 * (static_cast<double> (frame) / currentSampleRate)));
-        inputMessages.addMessageToQueue (msg);
+        if (((1 << (status & 0x0f)) & channelFilter.get()) == 0)
+            return false;
+
+        switch (status & 0xf0)
+        {
+            case 0x80:
+            case 0x90: type = noteMessages; break;
+            case 0xa0: type = pressureMessages; break;
+            case 0xb0: type = controllerMessages; break;
+            case 0xc0: type = programMessages; break;
+            case 0xd0: type = pressureMessages; break;
+            case 0xe0: type = pitchMessages; break;
+            default: break;
+        }
+
+        if ((status & 0xf0) <= 0xa0 && size > 1)
+            if (data[1] < lowestNote.get() || data[1] > highestNote.get())
+                return false;
+    }
+    else
+    {
+        switch (status)
+        {
+            case 0xf0:
+            case 0xf7: type = sysexMessages; break;
+            case 0xf8: type = clockMessages; break;
+            case 0xf2:
+            case 0xfa:
+            case 0xfb:
+            case 0xfc: type = transportMessages; break;
+            default: break;
+        }
     }
 
-    numSamples += nframes;
+    return (type & typeFilter.get()) != 0;
 }
 
-void MidiMonitorNode::getMessages (MidiBuffer& destBuffer)
+void MidiMonitorNode::setNoteRange (int lowest, int highest)
 {
-    ScopedLock sl (lock);
-    if (numSamples <= 0)
-        return;
-    inputMessages.removeNextBlockOfMessages (destBuffer, numSamples);
-    numSamples = 0;
+    lowest  = jlimit (0, 127, lowest);
+    highest = jlimit (0, 127, highest);
+    lowestNote.set (jmin (lowest, highest));
+    highestNote.set (jmax (lowest, highest));
+}
+
+String MidiMonitorNode::formatEvent (const Event& event) const
+{
+    String text;
+    text << String ((double) event.frame / currentSampleRate, 6).paddedLeft (' ', 12) << "  ";
+
+    const auto status = event.data[0];
+    if (status == 0xf0 || status == 0xf7)
+        text << "SysEx (" << event.fullSize << " bytes)";
+    else if (status == 0xfa)
+        text << "Start";
+    else if (status == 0xfb)
+        text << "Continue";
+    else if (status == 0xfc)
+        text << "Stop";
+    else
+        text << MidiMessage (event.data, (int) event.size).getDescription();
+
+    return text;
+}
+
+String MidiMonitorNode::getLogText (int index) const
+{
+    return isPositiveAndBelow (index, log.size()) ? formatEvent (log.getReference (index))
+                                                  : String();
 }
 
 void MidiMonitorNode::clearMessages()
 {
-    midiLog.clearQuick();
-    {
-        ScopedLock sl (lock);
-        inputMessages.reset (currentSampleRate);
-        numSamples = 0;
-    }
+    fifo.finishedRead (fifo.getNumReady());
+    log.clearQuick();
+    numDropped.set (0);
     messagesLogged();
 }
 
+bool MidiMonitorNode::startCapture (const File& file)
+{
+    stopCapture();
+    std::unique_ptr<FileOutputStream> stream (file.createOutputStream());
+    if (stream == nullptr || stream->failedToOpen())
+        return false;
+    captureFile = file;
+    captureStream.reset (stream.release());
+    return true;
+}
+
+void MidiMonitorNode::stopCapture()
+{
+    if (captureStream != nullptr)
+        captureStream->flush();
+    captureStream.reset();
+}
+
 void MidiMonitorNode::timerCallback()
 {
-    midiTemp.clear();
-    getMessages (midiTemp);
-    if (midiTemp.getNumEvents() <= 0)
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (fifo.getNumReady(), start1, size1, start2, size2);
+    const int numRead = size1 + size2;
+    if (numRead <= 0)
         return;
 
-    MidiBuffer::Iterator iter (midiTemp);
-    MidiMessage msg; int frame = 0;
+    for (int i = 0; i < size1; ++i)
+        log.add (ring[start1 + i]);
+    for (int i = 0; i < size2; ++i)
+        log.add (ring[start2 + i]);
+    fifo.finishedRead (numRead);
 
-    int numLogged = 0;
-    String text;
-    while (iter.getNextEvent (msg, frame))
+    if (captureStream != nullptr)
     {
-        if (msg.isMidiClock())
-        {
-            text.clear();
-            continue;
-        }
-
-        if (msg.isMidiStart())
-            text << "Start";
-        else if (msg.isMidiStop())
-            text << "Stop";
-        else if (msg.isMidiContinue())
-            text << "Continue";
-        
-        midiLog.add (text.isNotEmpty() ? text : msg.getDescription());
-        text.clear();
-        ++numLogged;
+        for (int i = log.size() - numRead; i < log.size(); ++i)
+            *captureStream << formatEvent (log.getReference (i)) << newLine;
+        captureStream->flush();
     }
 
-    if (midiLog.size() > maxLoggedMessages)
-        midiLog.removeRange (0, midiLog.size() - maxLoggedMessages);
+    if (log.size() > maxLoggedMessages)
+        log.removeRange (0, log.size() - maxLoggedMessages);
 
-    if (numLogged > 0)
-        messagesLogged();
+    messagesLogged();
+}
+
+void MidiMonitorNode::getState (MemoryBlock& block)
+{
+    ValueTree state ("MidiMonitor");
+    state.setProperty ("types", getTypeFilter(), nullptr)
+         .setProperty ("channels", getChannelFilter(), nullptr)
+         .setProperty ("lowestNote", lowestNote.get(), nullptr)
+         .setProperty ("highestNote", highestNote.get(), nullptr);
+    MemoryOutputStream stream (block, false);
+    state.writeToStream (stream);
+}
+
+void MidiMonitorNode::setState (const void* data, int size)
+{
+    const auto state = ValueTree::readFromData (data, (size_t) size);
+    if (! state.isValid())
+        return;
+    setTypeFilter ((int) state.getProperty ("types", (int) defaultMessages));
+    setChannelFilter ((int) state.getProperty ("channels", 0xffff));
+    setNoteRange ((int) state.getProperty ("lowestNote", 0),
+                  (int) state.getProperty ("highestNote", 127));
 }
 
 };
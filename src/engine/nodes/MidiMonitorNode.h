@@ -31,6 +31,23 @@ class MidiMonitorNode   : public MidiFilterNode,
                           private Timer
 {
 public:
+    /** Message categories used by the filter */
+    enum MessageType
+    {
+        noteMessages        = 1 << 0,
+        controllerMessages  = 1 << 1,
+        programMessages     = 1 << 2,
+        pitchMessages       = 1 << 3,
+        pressureMessages    = 1 << 4,
+        sysexMessages       = 1 << 5,
+        clockMessages       = 1 << 6,
+        transportMessages   = 1 << 7,
+        otherMessages       = 1 << 8,
+
+        allMessages         = 0x1ff,
+        defaultMessages     = allMessages & ~clockMessages
+    };
+
     MidiMonitorNode();
     virtual ~MidiMonitorNode();
 
@@ -56,27 +73,83 @@ public:
 
     void render (AudioSampleBuffer& audio, MidiPipe& midi) override;
 
-    void setState (const void* data, int size) override {};
-    void getState (MemoryBlock& block) override {};
+    void setState (const void* data, int size) override;
+    void getState (MemoryBlock& block) override;
 
+    /** Clears the log and discards anything pending in the capture ring */
     void clearMessages();
-    
-    const StringArray& getLog() const { return midiLog; }
+
+    /** Returns the number of logged messages */
+    int getNumLogged() const { return log.size(); }
+
+    /** Formats a logged message. Rows are only formatted when asked for,
+        so the editor should call this for visible rows only.
+     */
+    String getLogText (int index) const;
+
+    /** Returns the number of messages dropped because the ring was full */
+    int getNumDropped() const { return numDropped.get(); }
+
+    //==========================================================================
+    /** Sets which message types are logged, see MessageType */
+    void setTypeFilter (int types)          { typeFilter.set (types & allMessages); }
+    int getTypeFilter() const               { return typeFilter.get(); }
+
+    /** Sets which channels are logged, bit 0 is channel 1 */
+    void setChannelFilter (int channels)    { channelFilter.set (channels & 0xffff); }
+    int getChannelFilter() const            { return channelFilter.get(); }
+
+    /** Sets the range of notes logged by note and poly pressure messages */
+    void setNoteRange (int lowest, int highest);
+    Range<int> getNoteRange() const         { return { lowestNote.get(), highestNote.get() }; }
+
+    //==========================================================================
+    /** Writes every logged message to a file until stopCapture is called.
+        Messages are appended, so long running captures can be resumed.
+     */
+    bool startCapture (const File& file);
+
+    /** Stops capturing to file */
+    void stopCapture();
+
+    /** Returns true if currently capturing */
+    bool isCapturing() const { return captureStream != nullptr; }
+
+    /** Returns the file being captured to */
+    const File& getCaptureFile() const { return captureFile; }
 
 private:
     friend class MidiMonitorNodeEditor;
-     Signal<void()> messagesLogged;
+    Signal<void()> messagesLogged;
+
+    struct Event
+    {
+        int64 frame = 0;
+        uint8 data[3] = { 0, 0, 0 };
+        uint8 size = 0;
+        int32 fullSize = 0;
+    };
+
     double currentSampleRate = 44100.0;
-    int numSamples = 0;
-    MidiMessageCollector inputMessages;
+    int64 framesRendered = 0;
     bool createdPorts = false;
-    CriticalSection lock;
-    
-    MidiBuffer  midiTemp;
-    StringArray midiLog;
-    int maxLoggedMessages { 100 };
+
+    AbstractFifo fifo;
+    HeapBlock<Event> ring;
+    Atomic<int> numDropped { 0 };
+
+    Atomic<int> typeFilter { defaultMessages };
+    Atomic<int> channelFilter { 0xffff };
+    Atomic<int> lowestNote { 0 };
+    Atomic<int> highestNote { 127 };
+
+    Array<Event> log;
+    int maxLoggedMessages { 1000 };
     float refreshRateHz { 60.0 };
 
+    File captureFile;
+    std::unique_ptr<FileOutputStream> captureStream;
+
     inline void createPorts() override
     {
         if (createdPorts)
@@ -88,7 +161,8 @@ private:
         createdPorts = true;
     }
 
-    void getMessages (MidiBuffer &destBuffer);
+    bool passesFilter (const uint8* data, int size) const noexcept;
+    String formatEvent (const Event& event) const;
     void timerCallback() override;
 };
 
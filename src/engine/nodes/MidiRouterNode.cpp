@@ -30,9 +30,7 @@ MidiRouterNode::MidiRouterNode (int ins, int outs)
     : NodeObject (0),
       numSources (ins),
       numDestinations (outs),
-      state (ins, outs),
-      toggles (ins, outs),
-      nextToggles (ins, outs)
+      state (ins, outs)
 {
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, "Element", nullptr);
@@ -86,14 +84,12 @@ void MidiRouterNode::setMatrixState (const MatrixState& matrix)
 {
     jassert (state.sameSizeAs (matrix));
     state = matrix;
-    ToggleGrid newPatches (state);
-
-    {
-        ScopedLock sl (getLock());
-        toggles.swapWith (newPatches);
-        togglesChanged = true; // initiate the crossfade
-    }
+    applyMatrix (state);
+}
 
+void MidiRouterNode::applyMatrix (const MatrixState& matrix)
+{
+    routing.publish (std::unique_ptr<RoutingMatrix> (new RoutingMatrix (matrix)));
     sendChangeMessage();
 }
 
@@ -110,16 +106,22 @@ void MidiRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
     const auto nbuffers = midi.getNumBuffers();
     audio.clear();
 
-    ScopedLock sl (getLock());
-    for (int src = 0; src < numSources; ++src)
+    if (auto* const published = routing.acquire())
+    {
+        routing.retire (current.release());
+        current.reset (published);
+    }
+
+    if (current != nullptr)
     {
-        if (src >= nbuffers)
-            break;
-        
-        const auto& rb = *midi.getReadBuffer (src);
-        for (int dst = 0; dst < numDestinations; ++dst)
-            if (toggles.get (src, dst))
-                midiOuts.getUnchecked(dst)->addEvents (rb, 0, nsamples, 0);
+        for (int dst = 0; dst < current->getNumDestinations(); ++dst)
+        {
+            auto* const ob = midiOuts.getUnchecked (dst);
+            const int* const sources = current->getSourcesFor (dst);
+            for (int i = 0; i < current->getNumSourcesFor (dst); ++i)
+                if (sources[i] < nbuffers)
+                    ob->addEvents (*midi.getReadBuffer (sources[i]), 0, nsamples, 0);
+        }
     }
 
     for (int i = midiOuts.size(); --i >= 0;)
@@ -152,28 +154,23 @@ void MidiRouterNode::setState (const void* data, int sizeInBytes)
 void MidiRouterNode::setWithoutLocking (int src, int dst, bool set)
 {
     jassert (src >= 0 && src < numSources && dst >= 0 && dst < numDestinations);
-    toggles.set (src, dst, set);
     state.set (src, dst, set);
+    applyMatrix (state);
 }
 
 void MidiRouterNode::set (int src, int dst, bool patched)
 {
-    jassert (src >= 0 && src < numSources && dst >= 0 && numDestinations < 4);
-    toggles.set (src, dst, patched);
+    jassert (src >= 0 && src < numSources && dst >= 0 && dst < numDestinations);
     state.set (src, dst, patched);
+    applyMatrix (state);
 }
 
 void MidiRouterNode::clearPatches()
 {
-    {
-        ScopedLock sl (getLock());
-        toggles.clear();
-        nextToggles.clear();
-    }
-
     for (int r = 0; r < state.getNumRows(); ++r)
         for (int c = 0; c < state.getNumColumns(); ++c)
             state.set (r, c, false);
+    applyMatrix (state);
 }
 
 void MidiRouterNode::initMidiOuts (OwnedArray<MidiBuffer>& outs)
@@ -21,8 +21,7 @@
 
 #include "engine/nodes/NodeTypes.h"
 #include "engine/NodeObject.h"
-#include "engine/LinearFade.h"
-#include "engine/ToggleGrid.h"
+#include "engine/RoutingMatrix.h"
 
 namespace Element {
 
@@ -112,9 +111,10 @@ private:
     // used by the UI, but not the rendering
     MatrixState state;
 
-    ToggleGrid toggles;
-    ToggleGrid nextToggles;
-    bool togglesChanged { false };
+    // current is owned by the audio thread
+    RoutingMatrix::Exchange routing;
+    std::unique_ptr<RoutingMatrix> current;
+    void applyMatrix (const MatrixState&);
 
     OwnedArray<MidiBuffer> midiOuts;
     void initMidiOuts (OwnedArray<MidiBuffer>& outs);
@@ -24,18 +24,17 @@
 namespace Element {
 
 OSCReceiverNode::OSCReceiverNode()
-    : MidiFilterNode (0)
+    : MidiFilterNode (0),
+      inbox (*service)
 {
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, "Element", nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_OSC_RECEIVER, nullptr);
-    oscReceiver.addListener (this);
 }
 
 OSCReceiverNode::~OSCReceiverNode()
 {
-    oscReceiver.removeListener (this);
-    oscReceiver.disconnect();
+    inbox.disconnect();
 }
 
 void OSCReceiverNode::setState (const void* data, int size)
@@ -58,6 +57,7 @@ void OSCReceiverNode::setState (const void* data, int size)
     currentPortNumber = newPortNumber;
     connected = newConnected;
     paused = newPaused;
+    inbox.setPaused (paused);
 
     sendChangeMessage();
 }
@@ -94,11 +94,8 @@ inline void OSCReceiverNode::createPorts()
 
 void OSCReceiverNode::prepareToRender (double sampleRate, int maxBufferSize)
 {
-    if (! outputMidiMessagesInitDone) {
-        outputMidiMessages.reset (sampleRate);
-        currentSampleRate = sampleRate;
-        outputMidiMessagesInitDone = true;
-    }
+    ignoreUnused (maxBufferSize);
+    currentSampleRate = sampleRate;
 }
 
 void OSCReceiverNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
@@ -108,28 +105,9 @@ void OSCReceiverNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
         return;
 
     midi.clear();
-    outputMidiMessages.removeNextBlockOfMessages (*midi.getWriteBuffer (0), nframes);
+    inbox.render (*midi.getWriteBuffer (0), nframes, currentSampleRate);
 }
 
-/** OSCReceiver real-time callbacks */
-
-void OSCReceiverNode::oscMessageReceived (const OSCMessage& message)
-{
-    if (paused)
-        return;
-
-    auto timestamp = Time::getMillisecondCounterHiRes();
-
-    MidiMessage midiMsg = Util::processOscToMidiMessage (message);
-    midiMsg.setTimeStamp (timestamp);
-
-    outputMidiMessages.addMessageToQueue (midiMsg);
-};
-
-void OSCReceiverNode::oscBundleReceived(const OSCBundle& bundle)
-{
-};
-
 /** For node editor */
 
 bool OSCReceiverNode::connect (int portNumber)
@@ -138,7 +116,7 @@ bool OSCReceiverNode::connect (int portNumber)
         return connected;
 
     currentPortNumber = portNumber;
-    connected = oscReceiver.connect (portNumber);
+    connected = inbox.connect (portNumber);
 
     return connected;
 }
@@ -148,7 +126,8 @@ bool OSCReceiverNode::disconnect ()
     if (!connected)
         return true;
     connected = false;
-    return oscReceiver.disconnect();
+    inbox.disconnect();
+    return true;
 }
 
 bool OSCReceiverNode::isConnected ()
@@ -159,11 +138,13 @@ bool OSCReceiverNode::isConnected ()
 void OSCReceiverNode::pause ()
 {
     paused = true;
+    inbox.setPaused (true);
 }
 
 void OSCReceiverNode::resume ()
 {
     paused = false;
+    inbox.setPaused (false);
 }
 
 bool OSCReceiverNode::isPaused ()
@@ -207,12 +188,12 @@ void OSCReceiverNode::setHostName (String hostName)
 
 void OSCReceiverNode::addMessageLoopListener (OSCReceiver::Listener<OSCReceiver::MessageLoopCallback>* callback)
 {
-    oscReceiver.addListener (callback);
+    inbox.addMessageLoopListener (callback);
 }
 
 void OSCReceiverNode::removeMessageLoopListener (OSCReceiver::Listener<OSCReceiver::MessageLoopCallback>* callback)
 {
-    oscReceiver.removeListener (callback);
+    inbox.removeMessageLoopListener (callback);
 }
 
 }
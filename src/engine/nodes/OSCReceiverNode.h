@@ -23,12 +23,12 @@
 #include "engine/MidiPipe.h"
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/MidiFilterNode.h"
+#include "engine/OSCService.h"
 
 namespace Element {
 
 class OSCReceiverNode : public MidiFilterNode,
-                        public ChangeBroadcaster,
-                        public OSCReceiver::Listener<OSCReceiver::RealtimeCallback>
+                        public ChangeBroadcaster
 {
 public:
     OSCReceiverNode();
@@ -79,19 +79,15 @@ private:
 
     /** MIDI */
     bool createdPorts = false;
-    double currentSampleRate;
-    bool outputMidiMessagesInitDone = false;
-    MidiMessageCollector outputMidiMessages;
+    double currentSampleRate = 44100.0;
 
     /** OSC */
-    OSCReceiver oscReceiver;
+    SharedResourcePointer<OSCService> service;
+    OSCService::Inbox inbox;
     bool connected = false;
     bool paused = false;
     int currentPortNumber = 9001;
     String currentHostName = "";
-
-    void oscMessageReceived(const OSCMessage& message) override;
-    void oscBundleReceived(const OSCBundle& bundle) override;
 };
 
 
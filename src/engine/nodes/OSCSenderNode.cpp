@@ -25,19 +25,18 @@ namespace Element {
 
 OSCSenderNode::OSCSenderNode()
     : MidiFilterNode (0),
-      Thread ("osc sender midi processing thread")
+      outbox (*service)
 {
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, "Element", nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_OSC_SENDER, nullptr);
-
-    startThread();
+    outbox.onMessageSent = std::bind (&OSCSenderNode::messageSent, this,
+                                      std::placeholders::_1, std::placeholders::_2);
 }
 
 OSCSenderNode::~OSCSenderNode()
 {
-    stop();
-    oscSender.disconnect();
+    outbox.disconnect();
 }
 
 void OSCSenderNode::setState (const void* data, int size)
@@ -80,54 +79,15 @@ void OSCSenderNode::getState (MemoryBlock& block)
     }
 }
 
-void OSCSenderNode::run ()
+void OSCSenderNode::messageSent (const OSCMessage& oscMsg, const MidiMessage& msg)
 {
-    while (! threadShouldExit())
-    {
-        sem.wait();
-
-        if (threadShouldExit())
-            break;
-
-        /** MIDI queue -> OSC messages */
-
-        MidiBuffer messages;
-
-        midiMessageQueue.removeNextBlockOfMessages (messages, numSamples.get());
-        numSamples = 0;
-
-        MidiBuffer::Iterator iter1 (messages);
-        MidiMessage msg;
-        int frame;
-
-        ScopedLock sl (lock);
-
-        while (iter1.getNextEvent (msg, frame))
-        {
-            OSCMessage oscMsg = Util::processMidiToOscMessage (msg);
-            oscSender.send ( oscMsg );
-
-            if (! msg.isMidiClock())
-            {
-                oscMessagesToLog.push_back ( oscMsg );
-            }
-        }
-
-        while (oscMessagesToLog.size() > (size_t) maxOscMessages)
-            oscMessagesToLog.erase ( oscMessagesToLog.begin() );
-    }
-
-    DBG("[EL] OSCSenderNode: OSC -> MIDI processing thread exited");
-}
+    if (msg.isMidiClock())
+        return;
 
-void OSCSenderNode::stop ()
-{
-    if (isThreadRunning())
-    {
-        signalThreadShouldExit();
-        sem.post();
-        stopThread (100);
-    }
+    ScopedLock sl (lock);
+    oscMessagesToLog.push_back (oscMsg);
+    while (oscMessagesToLog.size() > (size_t) maxOscMessages)
+        oscMessagesToLog.erase (oscMessagesToLog.begin());
 }
 
 /** MIDI */
@@ -143,37 +103,20 @@ inline void OSCSenderNode::createPorts()
     createdPorts = true;
 }
 
-void OSCSenderNode::prepareToRender (double sampleRate, int maxBufferSize) {
-    if (! midiMessageQueueInitDone) {
-        midiMessageQueue.reset (sampleRate);
-        currentSampleRate = sampleRate;
-        midiMessageQueueInitDone = true;
-    }
-};
+void OSCSenderNode::prepareToRender (double sampleRate, int maxBufferSize)
+{
+    ignoreUnused (maxBufferSize);
+    currentSampleRate = sampleRate;
+}
 
 void OSCSenderNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
     const auto nframes = audio.getNumSamples();
     auto* const midiIn = midi.getWriteBuffer (0);
 
-    if (nframes == 0 || !connected || paused) {
-        midiIn->clear();
-        return;
-    }
-
-    MidiBuffer::Iterator iter1 (*midiIn);
-    MidiMessage msg;
-    int frame;
-    auto timestamp = Time::getMillisecondCounterHiRes();
-
-    while (iter1.getNextEvent (msg, frame))
-    {
-        msg.setTimeStamp ( timestamp + (1000.0 * (static_cast<double> (frame) / currentSampleRate)) );
-        midiMessageQueue.addMessageToQueue ( msg );
-    }
+    if (nframes > 0 && connected && ! paused)
+        outbox.send (*midiIn, nframes, currentSampleRate);
 
-    numSamples += nframes;
-    sem.post();
     midiIn->clear();
 }
 
@@ -186,7 +129,7 @@ bool OSCSenderNode::connect (String hostName, int portNumber)
 
     currentHostName = hostName;
     currentPortNumber = portNumber;
-    connected = oscSender.connect (hostName, portNumber);
+    connected = outbox.connect (hostName, portNumber);
 
     return connected;
 }
@@ -196,7 +139,8 @@ bool OSCSenderNode::disconnect ()
    if (!connected)
         return true;
     connected = false;
-    return oscSender.disconnect();
+    outbox.disconnect();
+    return true;
 }
 
 bool OSCSenderNode::isConnected ()
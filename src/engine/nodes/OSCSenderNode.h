@@ -23,12 +23,12 @@
 #include "engine/MidiPipe.h"
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/MidiFilterNode.h"
+#include "engine/OSCService.h"
 
 namespace Element {
 
 class OSCSenderNode   : public MidiFilterNode,
-                        public ChangeBroadcaster,
-                        public Thread
+                        public ChangeBroadcaster
 {
 public:
 
@@ -53,11 +53,6 @@ public:
     void getState (MemoryBlock& block) override;
     void setState (const void* data, int size) override;
 
-    /** OSC -> MIDI processing thread */
-
-    void run() override;
-    void stop();
-
     /** MIDI */
 
     void prepareToRender (double sampleRate, int maxBufferSize) override;
@@ -85,14 +80,14 @@ public:
 
 private:
 
-    Semaphore sem;
     CriticalSection lock;
 
     /** MIDI */
     bool createdPorts = false;
 
     /** OSC */
-    OSCSender oscSender;
+    SharedResourcePointer<OSCService> service;
+    OSCService::Outbox outbox;
 
     bool connected = false;
     bool paused = false;
@@ -106,12 +101,9 @@ private:
     /** GUI */
     std::vector<OSCMessage> oscMessagesToLog;
 
-    /** To be processed and sent as OSC messages */
-    MidiMessageCollector midiMessageQueue;
+    double currentSampleRate = 44100.0;
 
-    Atomic<int> numSamples = 0;
-    double currentSampleRate = 0;
-    bool midiMessageQueueInitDone = false;
+    void messageSent (const OSCMessage&, const MidiMessage&);
 };
 
 }
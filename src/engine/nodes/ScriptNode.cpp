@@ -46,72 +46,186 @@ require ('el.MidiPipe')
 
 namespace Element {
 
+//=============================================================================
+/** A script and the Lua state it runs in */
+struct ScriptNode::Context
+{
+    Context()
+        : lua (sol::default_at_panic, LuaAllocator::alloc, &allocator)
+    {
+        LuaAllocator::setupCollector (lua);
+        watchdog.attach (lua);
+        Lua::initializeState (lua);
+        script.reset (new DSPScript (lua.create_table()));
+    }
+
+    ~Context()
+    {
+        try
+        {
+            release();
+            script->cleanup();
+        }
+        catch (const std::exception& e)
+        {
+            DBG("[EL] " << e.what());
+        }
+
+        script.reset();
+    }
+
+    Result load (const String& code)
+    {
+        Script loader (lua);
+        loader.load (code);
+        if (loader.hasError())
+            return Result::fail (loader.getErrorMessage());
+
+        auto dsp = loader();
+        if (! dsp.valid() || dsp.get_type() != sol::type::table)
+            return Result::fail ("Could not instantiate script");
+
+        script.reset (new DSPScript (dsp));
+        lua.collect_garbage();
+        return Result::ok();
+    }
+
+    void prepare (double rate, int block)
+    {
+        sampleRate = rate;
+        blockSize = block;
+        script->prepare (sampleRate, blockSize);
+        prepared = true;
+    }
+
+    void release()
+    {
+        if (! prepared)
+            return;
+        prepared = false;
+        script->release();
+    }
+
+    bool isPreparedFor (double rate, int block) const noexcept
+    {
+        return prepared && rate == sampleRate && block == blockSize;
+    }
+
+    int getNumAudioChannels() const
+    {
+        const auto& ports = script->getPorts();
+        return jmax (ports.size (PortType::Audio, true), ports.size (PortType::Audio, false));
+    }
+
+    /** Returns false if the output should be discarded */
+    bool render (AudioSampleBuffer& audio, MidiPipe& midi) noexcept
+    {
+        if (! watchdog.beginBlock (audio.getNumSamples(), sampleRate))
+            return false;
+
+        allocator.beginBlock();
+        script->process (audio, midi);
+        const bool overran = watchdog.endBlock();
+        allocator.collectGarbage (lua, 100.0 * audio.getNumSamples() / sampleRate);
+        allocator.endBlock();
+        return ! overran;
+    }
+
+    LuaAllocator allocator;
+    LuaWatchdog watchdog;
+    sol::state lua;
+    std::unique_ptr<DSPScript> script;
+    double sampleRate = 44100.0;
+    int blockSize = 512;
+    bool prepared = false;
+};
+
 //=============================================================================
 ScriptNode::ScriptNode() noexcept
-    : NodeObject (0)
+    : NodeObject (0),
+      contexts (std::make_unique<Context>())
 {
-    Lua::initializeState (lua);
-    script.reset (new DSPScript (lua.create_table()));
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, EL_INTERNAL_FORMAT_NAME, nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_SCRIPT, nullptr);
 }
 
-ScriptNode::~ScriptNode()
-{
-    script.reset();
-}
+ScriptNode::~ScriptNode() { }
 
 void ScriptNode::createPorts()
 {
-    if (script == nullptr)
-        return;
     ports.clearQuick();
-    script->getPorts (ports);
+    contexts.getLatest()->script->getPorts (ports);
 }
 
 Parameter::Ptr ScriptNode::getParameter (const PortDescription& port)
 {
     jassert (port.type == PortType::Control);
-    return script ? script->getParameterObject (port.channel, port.input) : nullptr;
+    return contexts.getLatest()->script->getParameterObject (port.channel, port.input);
 }
 
-Result ScriptNode::loadScript (const String& newCode)
+std::function<Result (std::unique_ptr<ScriptNode::Context>&)>
+ScriptNode::makeBuilder (const String& code) const
 {
-    auto result = DSPScript::validate (newCode);
-    if (result.failed())
-        return result;
+    const double rate   = sampleRate;
+    const int block     = blockSize;
+    const bool prepare  = prepared;
+    const double budget = cpuBudget;
 
-    Script loader (lua);
-    loader.load (newCode);
-    if (loader.hasError())
-        return Result::fail (loader.getErrorMessage());
-
-    auto dsp = loader();
-    if (! dsp.valid() || dsp.get_type() != sol::type::table)
-        return Result::fail ("Could not instantiate script");
+    return [=] (std::unique_ptr<Context>& context)
+    {
+        auto result = DSPScript::validate (code);
+        if (result.failed())
+            return result;
+
+        context = std::make_unique<Context>();
+        context->watchdog.setBudget (budget);
+        result = context->load (code);
+        if (result.wasOk() && prepare)
+            context->prepare (rate, block);
+        return result;
+    };
+}
 
-    auto newScript = std::make_unique<DSPScript> (dsp);
-    
-    if (true)
+void ScriptNode::installContext (std::unique_ptr<Context> context, bool keepParameterValues)
+{
+    // the node may have been prepared or released while this was built
+    if (prepared && ! context->isPreparedFor (sampleRate, blockSize))
     {
-        if (prepared)
-            newScript->prepare (sampleRate, blockSize);
-        triggerPortReset();
-        ScopedLock sl (lock);
-        if (script != nullptr)
-            newScript->copyParameterValues (*script);
-        script.swap (newScript);
+        context->release();
+        context->prepare (sampleRate, blockSize);
     }
-
-    if (newScript != nullptr)
+    else if (! prepared)
     {
-        newScript->release();
-        newScript->cleanup();
-        newScript.reset();
+        context->release();
     }
 
-    return Result::ok();
+    if (keepParameterValues)
+        context->script->copyParameterValues (*contexts.getLatest()->script);
+
+    contexts.install (std::move (context));
+    triggerPortReset();
+}
+
+Result ScriptNode::loadScript (const String& newCode)
+{
+    std::unique_ptr<Context> context;
+    auto result = makeBuilder (newCode) (context);
+    if (result.wasOk())
+        installContext (std::move (context), true);
+    return result;
+}
+
+void ScriptNode::loadScriptAsync (const String& newCode, std::function<void (Result)> onLoaded)
+{
+    contexts.buildAsync (makeBuilder (newCode),
+        [this, onLoaded] (Result result, std::unique_ptr<Context> context)
+        {
+            if (result.wasOk())
+                installContext (std::move (context), true);
+            if (onLoaded)
+                onLoaded (result);
+        });
 }
 
 void ScriptNode::getPluginDescription (PluginDescription& desc) const
@@ -135,7 +249,13 @@ void ScriptNode::prepareToRender (double rate, int block)
         return;
     sampleRate = rate;
     blockSize = block;
-    script->prepare (sampleRate, blockSize);
+    auto* const context = contexts.getLatest();
+    contexts.prepare (sampleRate, blockSize, context->getNumAudioChannels());
+    if (! context->isPreparedFor (sampleRate, blockSize))
+    {
+        context->release();
+        context->prepare (sampleRate, blockSize);
+    }
     prepared = true;
 }
 
@@ -144,13 +264,14 @@ void ScriptNode::releaseResources()
     if (! prepared)
         return;
     prepared = false;
-    script->release();
+    contexts.release();
+    contexts.getLatest()->release();
 }
 
 void ScriptNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
-    ScopedLock sl (lock);
-    script->process (audio, midi);
+    if (! contexts.render (audio, midi))
+        renderBypassed (audio, midi);
 }
 
 void ScriptNode::setState (const void* data, int size)
@@ -158,20 +279,26 @@ void ScriptNode::setState (const void* data, int size)
     const auto state = ValueTree::readFromGZIPData (data, size);
     if (state.isValid())
     {
+        setCpuBudget (state.getProperty ("cpuBudget", getCpuBudget()));
         dspCode.replaceAllContent (state["dspCode"].toString());
         edCode.replaceAllContent  (state["editorCode"].toString());
 
-        auto result = loadScript (dspCode.getAllContent());
+        std::unique_ptr<Context> context;
+        auto result = makeBuilder (dspCode.getAllContent()) (context);
 
         if (result.wasOk())
         {
+            // restored before it's installed so the audio thread never sees
+            // a half restored script
             if (state.hasProperty ("data"))
             {
                 const var& data = state.getProperty ("data");
                 if (data.isBinaryData())
                     if (auto* block = data.getBinaryData())
-                        script->restore (block->getData(), block->getSize());
+                        context->script->restore (block->getData(), block->getSize());
             }
+
+            installContext (std::move (context), false);
         }
 
         sendChangeMessage();
@@ -182,10 +309,11 @@ void ScriptNode::getState (MemoryBlock& out)
 {
     ValueTree state ("ScriptNode");
     state.setProperty ("dspCode", dspCode.getAllContent(), nullptr)
-         .setProperty ("editorCode", edCode.getAllContent(), nullptr);
+         .setProperty ("editorCode", edCode.getAllContent(), nullptr)
+         .setProperty ("cpuBudget", getCpuBudget(), nullptr);
 
     MemoryBlock block;
-    script->save (block);
+    contexts.getLatest()->script->save (block);
     if (block.getSize() > 0)
         state.setProperty ("data", block, nullptr);
     block.reset();
@@ -199,7 +327,28 @@ void ScriptNode::getState (MemoryBlock& out)
 
 void ScriptNode::setParameter (int index, float value)
 {
-    ScopedLock sl (lock);
+    ignoreUnused (index, value);
+}
+
+LuaAllocator::Stats ScriptNode::getMemoryStats() const
+{
+    return contexts.getLatest()->allocator.getStats();
+}
+
+LuaWatchdog::Stats ScriptNode::getCpuStats() const
+{
+    return contexts.getLatest()->watchdog.getStats();
+}
+
+void ScriptNode::setCpuBudget (double proportionOfBlock)
+{
+    cpuBudget = jlimit (0.01, 1.0, proportionOfBlock);
+    contexts.getLatest()->watchdog.setBudget (cpuBudget);
+}
+
+void ScriptNode::resumeScript()
+{
+    contexts.getLatest()->watchdog.resume();
 }
 
 }
@@ -21,12 +21,13 @@
 
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/NodeObject.h"
+#include "scripting/LuaAllocator.h"
+#include "scripting/LuaWatchdog.h"
+#include "scripting/ScriptHotSwap.h"
 #include "sol/sol.hpp"
 
 namespace Element {
 
-class DSPScript;
-
 class ScriptNode : public NodeObject,
                    public ChangeBroadcaster
 {
@@ -45,8 +46,15 @@ public:
     void setState (const void* data, int size) override;
     void getState (MemoryBlock& block) override;
 
+    /** Compiles a script and swaps it in, blocking until it is ready */
     Result loadScript (const String&);
 
+    /** Compiles a script on a background thread and crossfades to it when
+        it is ready. onLoaded is called on the message thread with the result,
+        unless another script was loaded in the meantime.
+     */
+    void loadScriptAsync (const String&, std::function<void (Result)> onLoaded = nullptr);
+
     CodeDocument& getCodeDocument (bool forEditor = false) { return forEditor ? edCode : dspCode; }
 
     /** Set a parameter value by index
@@ -56,21 +64,36 @@ public:
     */
     void setParameter (int index, float value);
 
+    /** Returns the memory counters of the script's Lua state */
+    LuaAllocator::Stats getMemoryStats() const;
+
+    /** Returns the CPU counters of the script */
+    LuaWatchdog::Stats getCpuStats() const;
+
+    /** Sets how much of each block the script may use before it is stopped */
+    void setCpuBudget (double proportionOfBlock);
+    double getCpuBudget() const noexcept { return cpuBudget; }
+
+    /** Lets a script suspended for overrunning its budget run again */
+    void resumeScript();
+
 protected:
     inline bool wantsMidiPipe() const override { return true; }
     void createPorts() override;
     Parameter::Ptr getParameter (const PortDescription& port) override;
 
 private:
-    CriticalSection lock;
-    sol::state lua;
     CodeDocument dspCode, edCode;
-    std::unique_ptr<DSPScript> script;
+    ScriptHotSwap<Context> contexts;
     ParameterArray inParams, outParams;
 
     int blockSize = 512;
     double sampleRate = 44100.0;
     bool prepared = false;
+    double cpuBudget = 0.5;
+
+    std::function<Result (std::unique_ptr<Context>&)> makeBuilder (const String& code) const;
+    void installContext (std::unique_ptr<Context>, bool keepParameterValues);
 };
 
 }
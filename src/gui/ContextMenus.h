@@ -332,8 +332,7 @@ public:
                 const auto data = Node::parse (item->file);
                 if (n.isValid() && data.isValid() && data.hasProperty (Tags::state))
                 {
-                    const String state = data.getProperty(Tags::state).toString();
-                    n.getValueTree().setProperty (Tags::state, state, 0);
+                    n.getValueTree().setProperty (Tags::state, data.getProperty (Tags::state), 0);
                     if (data.hasProperty (Tags::programState))
                         n.getValueTree().setProperty (Tags::programState, data.getProperty (Tags::programState), 0);
                     n.restorePluginState();
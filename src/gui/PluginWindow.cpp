@@ -93,6 +93,8 @@ public:
             if (auto* proc = object->getAudioProcessor())
                 if (auto* const e = dynamic_cast<AudioProcessorEditor*> (editor.get()))
                     proc->editorBeingDeleted (e);
+            // the editor may have changed the state without telling us
+            object->markStateDirty();
         }
         
         editor      = nullptr;
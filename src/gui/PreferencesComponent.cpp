@@ -467,6 +467,23 @@ namespace Element {
                 }
             };
 
+            addAndMakeVisible (autosaveIntervalLabel);
+            autosaveIntervalLabel.setText ("Autosave interval (minutes)", dontSendNotification);
+            autosaveIntervalLabel.setFont (Font (12.0, Font::bold));
+            addAndMakeVisible (autosaveInterval);
+            autosaveInterval.textFromValueFunction = [](double value) -> String {
+                return value > 0.0 ? String (roundToInt (value)) : String ("Off");
+            };
+            autosaveInterval.setRange (0.0, 120.0, 1.0);
+            autosaveInterval.setValue ((double) settings.getAutosaveInterval());
+            autosaveInterval.setSliderStyle (Slider::IncDecButtons);
+            autosaveInterval.setTextBoxStyle (Slider::TextBoxLeft, false, 82, 22);
+            autosaveInterval.onValueChange = [this]()
+            {
+                settings.setAutosaveInterval (roundToInt (autosaveInterval.getValue()));
+                settings.saveIfNeeded();
+            };
+
            #ifdef EL_PRO
             addAndMakeVisible (defaultSessionFileLabel);
             defaultSessionFileLabel.setText ("Default new Session", dontSendNotification);
@@ -546,6 +563,7 @@ namespace Element {
             layoutSetting (r, askToSaveSessionLabel, askToSaveSession);
             layoutSetting (r, systrayLabel, systray);
             layoutSetting (r, desktopScaleLabel, desktopScale, getWidth() / 4);
+            layoutSetting (r, autosaveIntervalLabel, autosaveInterval, getWidth() / 4);
            #ifdef EL_PRO
             layoutSetting (r, defaultSessionFileLabel, defaultSessionFile, 190 - settingHeight);
             defaultSessionClearButton.setBounds (defaultSessionFile.getRight(),
@@ -650,6 +668,9 @@ namespace Element {
         Label desktopScaleLabel;
         Slider desktopScale;
 
+        Label autosaveIntervalLabel;
+        Slider autosaveInterval;
+
         Settings& settings;
         AudioEnginePtr engine;
         GuiController& gui;
@@ -165,14 +165,12 @@ void SessionImportWizard::loadSession (const File& file)
 {
     SessionPtr newSession;
     bool loaded = false;
-    if (auto e = XmlDocument::parse (file))
+    const auto newData = Session::readFromFile (file);
+
+    if (newData.isValid() && newData.hasType ("session"))
     {
-        ValueTree newData (ValueTree::fromXml (*e));
-        if (newData.isValid() && newData.hasType ("session"))
-        {
-            newSession = new Session();
-            loaded = newSession->loadData (newData);
-        }
+        newSession = new Session();
+        loaded = newSession->loadData (newData);
     }
 
     if (newSession != nullptr && loaded)
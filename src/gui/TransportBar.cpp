@@ -17,6 +17,7 @@
     Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include "engine/DiskRecorder.h"
 #include "session/Session.h"
 #include "gui/GuiCommon.h"
 #include "gui/TransportBar.h"
@@ -127,6 +128,14 @@ void TransportBar::timerCallback()
     if (record->getToggleState() != monitor->recording.get())
         record->setToggleState (monitor->recording.get(), dontSendNotification);
 
+    const auto stats = engine->getDiskRecorder().getStats();
+    if (stats.recording)
+        record->setTooltip (String (stats.numChannels) + " channels, " + String (stats.throughputMBps, 1)
+            + " MB/s, " + String (roundToInt (stats.bufferHeadroom * 100.0)) + "% buffer headroom"
+            + (stats.numOverruns > 0 ? ", " + String (stats.numOverruns) + " overruns" : String()));
+    else if (record->getTooltip().isNotEmpty())
+        record->setTooltip (String());
+
     stabilize();
 }
 
@@ -155,12 +155,14 @@ LuaNodeEditor::LuaNodeEditor (const Node& node)
         if (auto* const lua = getNodeObjectOfType<LuaNode>())
         {
             const auto script = document.getAllContent();
-            auto result = lua->loadScript (script);
-            if (! result.wasOk())
+            lua->loadScriptAsync (script, [](Result result)
             {
-                AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon,
-                    "Script Error", result.getErrorMessage());
-            }
+                if (! result.wasOk())
+                {
+                    AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon,
+                        "Script Error", result.getErrorMessage());
+                }
+            });
         }
     };
 
@@ -177,6 +179,11 @@ LuaNodeEditor::LuaNodeEditor (const Node& node)
     addAndMakeVisible (props);
     props.setVisible (editorButton.getToggleState());
 
+    addAndMakeVisible (status);
+    status.getCpuStats    = [this]() { return lua->getCpuStats(); };
+    status.getMemoryStats = [this]() { return lua->getMemoryStats(); };
+    status.onResume       = [this]() { lua->resumeScript(); };
+
     updateProperties();
     lua->addChangeListener (this);
     portsChangedConnection = lua->portsChanged.connect (
@@ -235,6 +242,9 @@ void LuaNodeEditor::resized()
     editorButton.setBounds (r2.removeFromRight (editorButton.getWidth()));
 
     r1.removeFromTop (2);
+    status.setBounds (r1.removeFromBottom (22));
+    r1.removeFromBottom (2);
+
     if (props.isVisible())
     {
         props.setBounds (r1.removeFromRight (220));
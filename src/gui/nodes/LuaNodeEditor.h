@@ -22,6 +22,7 @@
 
 #include "engine/nodes/LuaNode.h"
 #include "gui/nodes/NodeEditorComponent.h"
+#include "gui/widgets/ScriptStatusBar.h"
 #include "gui/LuaTokeniser.h"
 
 namespace Element {
@@ -45,6 +46,7 @@ private:
     TextButton compileButton;
     TextButton editorButton;
     PropertyPanel props;
+    ScriptStatusBar status;
     SignalConnection portsChangedConnection;
     LuaNode::Ptr lua;
 
@@ -21,6 +21,7 @@
 #include "engine/nodes/MidiMonitorNode.h"
 #include "gui/nodes/MidiMonitorNodeEditor.h"
 #include "gui/ViewHelpers.h"
+#include "Utils.h"
 
 namespace Element {
 
@@ -48,23 +49,21 @@ public:
         node = nullptr;
     }
 
-    int getNumRows() override { return node->getLog().size(); }
+    int getNumRows() override { return node->getNumLogged(); }
 
     void paintListBoxItem (int row, Graphics& g, int width, int height, bool rowIsSelected) override
     {
-        const auto& logList = node->getLog();
         ignoreUnused (rowIsSelected);
         g.setFont (Font (Font::getDefaultMonospacedFontName(), 
                    g.getCurrentFont().getHeight(), Font::plain));
-        if (isPositiveAndBelow (row, logList.size()))
-            ViewHelpers::drawBasicTextRow (logList[row], g, width, height, false);
+        if (isPositiveAndBelow (row, node->getNumLogged()))
+            ViewHelpers::drawBasicTextRow (node->getLogText (row), g, width, height, false);
     }
 
     void handleAsyncUpdate() override
     {
-        const auto& logList = node->getLog();
         updateContent();
-        scrollToEnsureRowIsOnscreen (logList.size() - 1);
+        scrollToEnsureRowIsOnscreen (node->getNumLogged() - 1);
         repaint();
     }
 
@@ -87,6 +86,17 @@ MidiMonitorNodeEditor::MidiMonitorNodeEditor (const Node& node)
             n->clearMessages();
     };
 
+    addAndMakeVisible (filterButton);
+    filterButton.setButtonText ("Filter");
+    filterButton.onClick = [this]() { showFilterMenu(); };
+
+    addAndMakeVisible (captureButton);
+    captureButton.setButtonText ("Capture");
+    captureButton.setClickingTogglesState (false);
+    captureButton.onClick = [this]() { toggleCapture(); };
+    if (auto* n = getNodeObjectOfType<MidiMonitorNode>())
+        captureButton.setToggleState (n->isCapturing(), dontSendNotification);
+
     setSize (320, 160);
 }
 
@@ -100,8 +110,116 @@ void MidiMonitorNodeEditor::resized ()
     auto r1 = getLocalBounds().reduced (4);
     clearButton.changeWidthToFitText (24);
     clearButton.setBounds (r1.getX(), r1.getY(), clearButton.getWidth(), clearButton.getHeight());
+    filterButton.changeWidthToFitText (24);
+    filterButton.setBounds (clearButton.getRight() + 4, r1.getY(), filterButton.getWidth(), filterButton.getHeight());
+    captureButton.changeWidthToFitText (24);
+    captureButton.setBounds (filterButton.getRight() + 4, r1.getY(), captureButton.getWidth(), captureButton.getHeight());
     r1.removeFromTop (24 + 2);
     logger->setBounds (r1);
 }
 
+void MidiMonitorNodeEditor::showFilterMenu()
+{
+    auto* node = getNodeObjectOfType<MidiMonitorNode>();
+    if (node == nullptr)
+        return;
+
+    const int types = node->getTypeFilter();
+    const int channels = node->getChannelFilter();
+    const auto notes = node->getNoteRange();
+
+    PopupMenu menu;
+    const auto addType = [&menu, types] (int type, const String& name) {
+        menu.addItem (type, name, true, (types & type) != 0);
+    };
+
+    addType (MidiMonitorNode::noteMessages,       "Notes");
+    addType (MidiMonitorNode::controllerMessages, "Controllers");
+    addType (MidiMonitorNode::programMessages,    "Program Changes");
+    addType (MidiMonitorNode::pitchMessages,      "Pitch Bend");
+    addType (MidiMonitorNode::pressureMessages,   "Aftertouch");
+    addType (MidiMonitorNode::sysexMessages,      "SysEx");
+    addType (MidiMonitorNode::clockMessages,      "Clock");
+    addType (MidiMonitorNode::transportMessages,  "Transport");
+    addType (MidiMonitorNode::otherMessages,      "Other");
+
+    PopupMenu channelMenu;
+    channelMenu.addItem (1000, "All Channels", true, channels == 0xffff);
+    channelMenu.addSeparator();
+    for (int ch = 0; ch < 16; ++ch)
+        channelMenu.addItem (1001 + ch, String ("Channel ") + String (ch + 1), true, (channels & (1 << ch)) != 0);
+    menu.addSeparator();
+    menu.addSubMenu ("Channels", channelMenu);
+
+    // note range, items are grouped by octave
+    const auto noteMenu = [] (int firstId, int selected) {
+        PopupMenu octaves;
+        for (int octave = 0; octave < 11; ++octave)
+        {
+            PopupMenu octaveMenu;
+            for (int note = octave * 12; note < jmin (128, octave * 12 + 12); ++note)
+                octaveMenu.addItem (firstId + note, Util::noteValueToString (note), true, note == selected);
+            octaves.addSubMenu (Util::noteValueToString (octave * 12), octaveMenu,
+                                true, Image(), selected / 12 == octave);
+        }
+        return octaves;
+    };
+
+    PopupMenu rangeMenu;
+    rangeMenu.addItem (2000, "All Notes", true, notes.getStart() == 0 && notes.getEnd() == 127);
+    rangeMenu.addSeparator();
+    rangeMenu.addSubMenu ("Lowest: " + Util::noteValueToString (notes.getStart()),
+                          noteMenu (2100, notes.getStart()));
+    rangeMenu.addSubMenu ("Highest: " + Util::noteValueToString (notes.getEnd()),
+                          noteMenu (2300, notes.getEnd()));
+    menu.addSubMenu ("Note Range", rangeMenu);
+
+    Component::SafePointer<MidiMonitorNodeEditor> safeThis (this);
+    menu.showMenuAsync (PopupMenu::Options().withTargetComponent (&filterButton),
+        [safeThis] (int result)
+        {
+            if (safeThis == nullptr || result <= 0)
+                return;
+            auto* node = safeThis->getNodeObjectOfType<MidiMonitorNode>();
+            if (node == nullptr)
+                return;
+
+            const auto range = node->getNoteRange();
+            if (result >= 2300)
+                node->setNoteRange (jmin (range.getStart(), result - 2300), result - 2300);
+            else if (result >= 2100)
+                node->setNoteRange (result - 2100, jmax (range.getEnd(), result - 2100));
+            else if (result == 2000)
+                node->setNoteRange (0, 127);
+            else if (result == 1000)
+                node->setChannelFilter (node->getChannelFilter() == 0xffff ? 0 : 0xffff);
+            else if (result > 1000)
+                node->setChannelFilter (node->getChannelFilter() ^ (1 << (result - 1001)));
+            else
+                node->setTypeFilter (node->getTypeFilter() ^ result);
+        });
+}
+
+void MidiMonitorNodeEditor::toggleCapture()
+{
+    auto* node = getNodeObjectOfType<MidiMonitorNode>();
+    if (node == nullptr)
+        return;
+
+    if (node->isCapturing())
+    {
+        node->stopCapture();
+    }
+    else
+    {
+        chooser.reset (new FileChooser ("Capture MIDI to file",
+            File::getSpecialLocation (File::userDocumentsDirectory).getChildFile ("MIDI Capture.txt"),
+            "*.txt", false, false, this));
+        if (chooser->browseForFileToSave (true))
+            node->startCapture (chooser->getResult());
+    }
+
+    captureButton.setToggleState (node->isCapturing(), dontSendNotification);
+}
+
 };
@@ -35,6 +35,12 @@ public:
 private:
     class Logger; std::unique_ptr<Logger> logger;
     TextButton clearButton;
+    TextButton filterButton;
+    TextButton captureButton;
+    std::unique_ptr<FileChooser> chooser;
+
+    void showFilterMenu();
+    void toggleCapture();
 };
 
 }
@@ -346,6 +346,11 @@ ScriptNodeEditor::ScriptNodeEditor (ScriptingEngine& scripts, const Node& node)
     lua = getNodeObjectOfType<ScriptNode>();
     jassert (lua);
 
+    addAndMakeVisible (status);
+    status.getCpuStats    = [this]() { return lua->getCpuStats(); };
+    status.getMemoryStats = [this]() { return lua->getMemoryStats(); };
+    status.onResume       = [this]() { lua->resumeScript(); };
+
     chooser.reset (new FileChooser ("Script", ScriptManager::getUserScriptsDir(),
                                     "*.lua", false, false, this));
 
@@ -354,12 +359,14 @@ ScriptNodeEditor::ScriptNodeEditor (ScriptingEngine& scripts, const Node& node)
     compileButton.onClick = [this]()
     {
         const auto script = lua->getCodeDocument(false).getAllContent();
-        auto result = lua->loadScript (script);
-        if (! result.wasOk())
+        lua->loadScriptAsync (script, [](Result result)
         {
-            AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon,
-                "Script Error", result.getErrorMessage());
-        }
+            if (! result.wasOk())
+            {
+                AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon,
+                    "Script Error", result.getErrorMessage());
+            }
+        });
     };
 
     addAndMakeVisible (paramsButton);
@@ -644,6 +651,8 @@ void ScriptNodeEditor::resized()
     paramsButton.setBounds (r2.removeFromRight (paramsButton.getWidth()));
 
     r1.removeFromTop (2);
+    status.setBounds (r1.removeFromBottom (toolbarSize));
+    r1.removeFromBottom (2);
 
     if (props.isVisible())
     {
@@ -23,6 +23,7 @@
 #include "engine/nodes/ScriptNode.h"
 #include "gui/nodes/NodeEditorComponent.h"
 #include "gui/widgets/LuaConsole.h"
+#include "gui/widgets/ScriptStatusBar.h"
 #include "gui/LuaTokeniser.h"
 
 namespace Element {
@@ -62,6 +63,7 @@ private:
     ScriptNode::Ptr lua;
 
     LuaConsole console;
+    ScriptStatusBar status;
     
     FileBrowserComponent fileBrowser;
     std::unique_ptr<FileChooser> chooser;
@@ -365,6 +365,9 @@ void NodeEditorContentView::clearEditor()
     {
         if (proc)
             proc->editorBeingDeleted (aped);
+        // the editor may have changed the state without telling us
+        if (object)
+            object->markStateDirty();
     }
 
     removeChildComponent (editor.get());
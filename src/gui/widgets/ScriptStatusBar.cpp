@@ -0,0 +1,112 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "gui/widgets/ScriptStatusBar.h"
+#include "gui/LookAndFeel.h"
+
+namespace Element {
+
+ScriptStatusBar::ScriptStatusBar()
+{
+    addChildComponent (resumeButton);
+    resumeButton.setButtonText ("Resume");
+    resumeButton.setTooltip ("Let the suspended script run again");
+    resumeButton.onClick = [this]()
+    {
+        if (onResume)
+            onResume();
+        timerCallback();
+    };
+
+    startTimerHz (4);
+}
+
+ScriptStatusBar::~ScriptStatusBar()
+{
+    stopTimer();
+}
+
+void ScriptStatusBar::paint (Graphics& g)
+{
+    g.fillAll (LookAndFeel::widgetBackgroundColor);
+    auto r = getLocalBounds().reduced (4, 0);
+    if (resumeButton.isVisible())
+        r.removeFromRight (resumeButton.getWidth() + 4);
+
+    g.setColour (suspended ? Colors::toggleOrange : LookAndFeel::textColor);
+    g.setFont (12.f);
+    g.drawText (text, r, Justification::centredLeft, true);
+}
+
+void ScriptStatusBar::resized()
+{
+    resumeButton.changeWidthToFitText (getHeight() - 4);
+    resumeButton.setTopRightPosition (getWidth() - 2, 2);
+}
+
+void ScriptStatusBar::timerCallback()
+{
+    String newText;
+
+    if (getCpuStats)
+    {
+        const auto cpu = getCpuStats();
+        suspended = cpu.suspended;
+
+        if (suspended)
+        {
+            newText << "Suspended for exceeding its CPU budget at " << cpu.location;
+        }
+        else
+        {
+            newText << "CPU " << String (cpu.lastMillis, 2) << " of "
+                    << String (cpu.budgetMillis, 2) << " ms (peak "
+                    << String (cpu.peakMillis, 2) << ")";
+            if (cpu.overruns > 0)
+                newText << "  overruns " << String (cpu.overruns);
+            if (cpu.errors > 0)
+                newText << "  errors " << String (cpu.errors) << ": " << cpu.lastError;
+        }
+    }
+
+    if (getMemoryStats && ! suspended)
+    {
+        const auto mem = getMemoryStats();
+        newText << "  |  Lua " << String (roundToInt ((double) mem.bytesInUse / 1024.0))
+                << " of " << String (roundToInt ((double) mem.budget / 1024.0)) << " KB, "
+                << String (mem.blockAllocations) << " allocs/block (peak "
+                << String (mem.peakBlockAllocations) << ")";
+        if (mem.failedAllocations > 0)
+            newText << "  out of memory " << String (mem.failedAllocations);
+    }
+
+    if (resumeButton.isVisible() != suspended)
+    {
+        resumeButton.setVisible (suspended);
+        resized();
+    }
+
+    if (newText != text)
+    {
+        text = newText;
+        repaint();
+    }
+}
+
+}
@@ -0,0 +1,54 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "scripting/LuaAllocator.h"
+#include "scripting/LuaWatchdog.h"
+
+namespace Element {
+
+/** Shows the CPU and memory use of a script node, and lets the user resume
+    a script the watchdog suspended.
+ */
+class ScriptStatusBar : public Component,
+                        private Timer
+{
+public:
+    ScriptStatusBar();
+    ~ScriptStatusBar();
+
+    std::function<LuaWatchdog::Stats()> getCpuStats;
+    std::function<LuaAllocator::Stats()> getMemoryStats;
+    std::function<void()> onResume;
+
+    void paint (Graphics&) override;
+    void resized() override;
+
+private:
+    TextButton resumeButton;
+    String text;
+    bool suspended = false;
+
+    friend class Timer;
+    void timerCallback() override;
+};
+
+}
@@ -30,6 +30,7 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "PluginState.h"
 
 // #define PLUGIN_DBG(msg) DBG(msg)
 #define PLUGIN_DBG(msg)
@@ -327,6 +328,8 @@ void PluginProcessor::getStateInformation (MemoryBlock& destData)
 {
     if (auto session = world->getSession())
     {
+        // the host keeps this chunk as the project's state, so every plugin
+        // is asked for its state, not only those that reported a change
         session->saveGraphState();
         session->getValueTree()
             .setProperty ("pluginEditorBounds", editorBounds.toString(), nullptr)
@@ -345,11 +348,70 @@ void PluginProcessor::getStateInformation (MemoryBlock& destData)
             ppData.appendChild (data, nullptr);
         }
 
-        if (auto xml = std::unique_ptr<XmlElement> (session->createXml()))
-            copyXmlToBinary (*xml, destData);
+        ValueTree saveData = session->getValueTree().createCopy();
+        Node::sanitizeProperties (saveData, true);
+        if (PluginState::write (saveData, destData))
+        {
+            lastStateHash  = PluginState::getHash (destData.getData(), destData.getSize());
+            lastLayoutHash = PluginState::getLayoutHash (session->getValueTree(), true);
+        }
     }
 }
 
+bool PluginProcessor::isUnchangedSinceLastSave() const
+{
+    auto session = world->getSession();
+    if (lastLayoutHash != PluginState::getLayoutHash (session->getValueTree(), true))
+        return false;
+
+    bool changed = false;
+    session->forEach ([&changed] (const ValueTree& tree) {
+        if (changed || ! tree.hasType (Tags::node))
+            return;
+        if (NodeObjectPtr obj = Node (tree, false).getGraphNode())
+            changed = obj->isStateDirty();
+    });
+    return ! changed;
+}
+
+bool PluginProcessor::reloadChangedNodes (const ValueTree& newData)
+{
+    auto session = world->getSession();
+    session->saveGraphState();
+    if (PluginState::getLayoutHash (session->getValueTree(), false) != PluginState::getLayoutHash (newData, false))
+        return false;
+
+    const int numReloaded = PluginState::reloadChangedNodes (session->getValueTree(), newData);
+    ignoreUnused (numReloaded);
+    PLUGIN_DBG("[EL] reloaded " << numReloaded << " changed nodes");
+
+    auto sessionData = session->getValueTree();
+    for (const auto* property : { "pluginEditorBounds", "editorKeyboardFocus", "forceZeroLatency" })
+    {
+        if (newData.hasProperty (property))
+            sessionData.setProperty (property, newData.getProperty (property), nullptr);
+        else
+            sessionData.removeProperty (property, nullptr);
+    }
+    sessionData.removeChild (sessionData.getChildWithName ("perfParams"), nullptr);
+    const auto ppData = newData.getChildWithName ("perfParams");
+    if (ppData.isValid())
+        sessionData.appendChild (ppData.createCopy(), nullptr);
+    return true;
+}
+
+void PluginProcessor::restoreHostProperties()
+{
+    auto session = world->getSession();
+    typedef Rectangle<int> RI;
+    editorBounds = RI::fromString (session->getProperty (
+        "pluginEditorBounds", RI().toString()).toString());
+    editorWantsKeyboard = (bool) session->getProperty ("editorKeyboardFocus", false);
+    setForceZeroLatency ((bool)session->getProperty ("forceZeroLatency", isForcingZeroLatency()));
+    for (auto* const param : perfparams)
+        param->clearNode();
+}
+
 void PluginProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
     PLUGIN_DBG("[EL] restore state: prepared: " << (int) prepared);
@@ -359,42 +421,53 @@ void PluginProcessor::setStateInformation (const void* data, int sizeInBytes)
         return;
     
     mapsctl->learn (false);
+
+    // hosts often recall the state they just saved, nothing to do
+    const auto hash = PluginState::getHash (data, (size_t) sizeInBytes);
+    if (hash.isNotEmpty() && hash == lastStateHash && isUnchangedSinceLastSave())
+    {
+        PLUGIN_DBG("[EL] plugin state unchanged");
+        return;
+    }
+
+    ValueTree newData = PluginState::read (data, (size_t) sizeInBytes);
+    if (! newData.isValid())
+        return;
+
+    String error;
+    if (! newData.hasType (Tags::session))
+        error = "Invalid session state information provided.";
+
+    // same graphs and connections, only reload the nodes that differ
+    if (error.isEmpty() && reloadChangedNodes (newData))
+    {
+        restoreHostProperties();
+        bindPerformanceParameters();
+        return;
+    }
+
+    if (error.isEmpty() && !session->loadData (newData))
+        error = "Could not load session data.";
     
-    if (auto xml = getXmlFromBinary (data, sizeInBytes))
+    if (error.isNotEmpty())
     {
-        String error;
-        ValueTree newData = ValueTree::fromXml (*xml);
-        if (!newData.isValid() || !newData.hasType (Tags::session))
-            error = "Invalid session state information provided.";
-        if (error.isEmpty() && !session->loadData (newData))
-            error = "Could not load session data.";
-        
-        if (error.isNotEmpty())
-        {
-            PLUGIN_DBG("[EL] plugin failed restoring state: " << error);
-        }
-        else
-        {
-            typedef Rectangle<int> RI;
-            editorBounds = RI::fromString (session->getProperty (
-                "pluginEditorBounds", RI().toString()).toString());
-            editorWantsKeyboard = (bool) session->getProperty ("editorKeyboardFocus", false);
-            setForceZeroLatency ((bool)session->getProperty ("forceZeroLatency", isForcingZeroLatency()));
-            session->forEach (setPluginMissingNodeProperties);
-            for (auto* const param : perfparams)
-                param->clearNode();
-        }
-        
-        triggerAsyncUpdate();
-        
-        if (prepared)
-        {
-            PLUGIN_DBG("[EL] plugin restored state while already prepared");
-        }
-        else
-        {
-            PLUGIN_DBG("[EL] plugin tried to restore state when not prepared");
-        }
+        PLUGIN_DBG("[EL] plugin failed restoring state: " << error);
+    }
+    else
+    {
+        restoreHostProperties();
+        session->forEach (setPluginMissingNodeProperties);
+    }
+    
+    triggerAsyncUpdate();
+    
+    if (prepared)
+    {
+        PLUGIN_DBG("[EL] plugin restored state while already prepared");
+    }
+    else
+    {
+        PLUGIN_DBG("[EL] plugin tried to restore state when not prepared");
     }
 }
 
@@ -420,7 +493,11 @@ void PluginProcessor::handleAsyncUpdate()
 {
     PLUGIN_DBG("[EL] handle async update");
     reloadEngine();
-    
+    bindPerformanceParameters();
+}
+
+void PluginProcessor::bindPerformanceParameters()
+{
     auto session = world->getSession();
     const auto ppData = session->getValueTree().getChildWithName ("perfParams");
     
@@ -437,6 +437,9 @@ private:
     
     bool forceZeroLatency = false;
 
+    // hashes of the last state handed to the host, see setStateInformation
+    String lastStateHash, lastLayoutHash;
+
     class AsyncPrepare : public AsyncUpdater
     {
         AudioProcessor& processor;
@@ -465,6 +468,10 @@ private:
     friend class AsyncUpdater;
     void handleAsyncUpdate() override;
     void reloadEngine();
+    void bindPerformanceParameters();
+    void restoreHostProperties();
+    bool isUnchangedSinceLastSave() const;
+    bool reloadChangedNodes (const ValueTree& newData);
     
     var hasCheckedLicense { 0 };    
     int calculateLatencySamples() const;
@@ -0,0 +1,257 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "plugins/PluginState.h"
+#include "session/BinaryModel.h"
+#include "session/Node.h"
+
+namespace Element {
+
+namespace PluginStateFormat
+{
+    static const char magic[]    = { 'E', 'L', 'P', 'S' };
+    static constexpr int version = 1;
+    static constexpr size_t hashSize   = 16;
+    static constexpr size_t headerSize = sizeof (magic) + sizeof (int32) + hashSize;
+}
+
+/** Properties the plugin processor stores in the session for itself */
+static bool isHostProperty (const Identifier& property)
+{
+    return property == Identifier ("pluginEditorBounds") ||
+           property == Identifier ("editorKeyboardFocus") ||
+           property == Identifier ("forceZeroLatency");
+}
+
+static bool isRuntimeProperty (const ValueTree& tree, const Identifier& property)
+{
+    if (property == Tags::object || property == Tags::updater)
+        return true;
+    return tree.hasType (Tags::node) && (property == Tags::offline ||
+        property == Tags::placeholder || property == Tags::missing);
+}
+
+static bool isStateProperty (const Identifier& property)
+{
+    return property == Tags::state || property == Tags::programState;
+}
+
+/** The node settings Node::restorePluginState applies */
+static const Array<Identifier>& getNodeSettings()
+{
+    static const Array<Identifier> settings ({
+        Tags::program, Tags::bypass, Tags::gain, "inputGain",
+        Tags::keyStart, Tags::keyEnd, Tags::midiChannels, Tags::midiProgram,
+        Tags::midiProgramsEnabled, Tags::globalMidiPrograms, Tags::midiProgramsState,
+        Tags::mute, "muteInput", Tags::transpose, Tags::oversamplingFactor,
+        Tags::delayCompensation
+    });
+    return settings;
+}
+
+/** Nodes that can be reloaded on their own. A graph restores everything in it */
+static bool isReloadableNode (const ValueTree& tree)
+{
+    return tree.hasType (Tags::node) && ! Node::isProbablyGraphNode (tree);
+}
+
+static void writeLayoutValue (OutputStream& output, const var& value)
+{
+    if (auto* block = value.getBinaryData())
+        output.writeString (MD5 (*block).toHexString());
+    else
+        output.writeString (value.toString());
+}
+
+static void writeLayout (OutputStream& output, const ValueTree& tree,
+                         const bool isRoot, const bool includeNodeSettings)
+{
+    output.writeString (tree.getType().toString());
+
+    const bool reloadable = isReloadableNode (tree);
+    StringArray names;
+    for (int i = 0; i < tree.getNumProperties(); ++i)
+    {
+        const auto property = tree.getPropertyName (i);
+        if (isRuntimeProperty (tree, property) || (isRoot && isHostProperty (property)))
+            continue;
+        if (reloadable && (isStateProperty (property) ||
+            (! includeNodeSettings && getNodeSettings().contains (property))))
+            continue;
+        names.add (property.toString());
+    }
+
+    // properties can be in any order, depending on how the model was built
+    names.sort (false);
+    output.writeCompressedInt (names.size());
+    for (const auto& name : names)
+    {
+        output.writeString (name);
+        writeLayoutValue (output, tree.getProperty (name));
+    }
+
+    int numChildren = 0;
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+        if (! (isRoot && tree.getChild(i).hasType ("perfParams")))
+            ++numChildren;
+    output.writeCompressedInt (numChildren);
+
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+    {
+        const auto child = tree.getChild (i);
+        if (! (isRoot && child.hasType ("perfParams")))
+            writeLayout (output, child, false, includeNodeSettings);
+    }
+}
+
+static void collectReloadableNodes (const ValueTree& tree, HashMap<String, ValueTree>& nodes)
+{
+    if (isReloadableNode (tree))
+        nodes.set (tree.getProperty (Tags::uuid).toString(), tree);
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+        collectReloadableNodes (tree.getChild (i), nodes);
+}
+
+static bool statesMatch (const var& a, const var& b)
+{
+    MemoryBlock first, second;
+    Node::getStateData (a, first);
+    Node::getStateData (b, second);
+    return first == second;
+}
+
+/** Copies one node's states and settings if they differ. Returns true if it did */
+static bool copyNodeSettings (ValueTree node, const ValueTree& newNode)
+{
+    bool changed = false;
+
+    for (const auto& property : { Tags::state, Tags::programState })
+    {
+        if (node.hasProperty (property) == newNode.hasProperty (property)
+            && statesMatch (node.getProperty (property), newNode.getProperty (property)))
+            continue;
+        changed = true;
+        if (newNode.hasProperty (property))
+            node.setProperty (property, newNode.getProperty (property), nullptr);
+        else
+            node.removeProperty (property, nullptr);
+    }
+
+    for (const auto& property : getNodeSettings())
+    {
+        if (node.hasProperty (property) == newNode.hasProperty (property)
+            && node.getProperty (property) == newNode.getProperty (property))
+            continue;
+        changed = true;
+        if (newNode.hasProperty (property))
+            node.setProperty (property, newNode.getProperty (property), nullptr);
+        else
+            node.removeProperty (property, nullptr);
+    }
+
+    return changed;
+}
+
+//=============================================================================
+bool PluginState::write (const ValueTree& session, MemoryBlock& data)
+{
+    MemoryOutputStream model;
+    if (! BinaryModel::write (session, model))
+        return false;
+
+    const MD5 hash (model.getData(), model.getDataSize());
+    data.reset();
+    MemoryOutputStream output (data, false);
+    output.write (PluginStateFormat::magic, sizeof (PluginStateFormat::magic));
+    output.writeInt (PluginStateFormat::version);
+    output.write (hash.getChecksumDataArray(), PluginStateFormat::hashSize);
+    output.write (model.getData(), model.getDataSize());
+    output.flush();
+    return true;
+}
+
+bool PluginState::isPluginState (const void* data, size_t size)
+{
+    using namespace PluginStateFormat;
+    if (data == nullptr || size < headerSize)
+        return false;
+    const auto* bytes = static_cast<const char*> (data);
+    return memcmp (bytes, magic, sizeof (magic)) == 0
+        && ByteOrder::littleEndianInt (bytes + sizeof (magic)) == (uint32) version;
+}
+
+String PluginState::getHash (const void* data, size_t size)
+{
+    using namespace PluginStateFormat;
+    if (! isPluginState (data, size))
+        return {};
+    return String::toHexString (static_cast<const char*> (data) + headerSize - hashSize,
+                                (int) hashSize, 0);
+}
+
+ValueTree PluginState::read (const void* data, size_t size)
+{
+    using namespace PluginStateFormat;
+
+    if (isPluginState (data, size))
+    {
+        const auto* model = static_cast<const char*> (data) + headerSize;
+        const auto modelSize = size - headerSize;
+        if (MD5 (model, modelSize).toHexString() != getHash (data, size))
+            return {};
+        return BinaryModel::read (model, modelSize, true);
+    }
+
+    if (auto xml = AudioProcessor::getXmlFromBinary (data, (int) size))
+        return ValueTree::fromXml (*xml);
+
+    return {};
+}
+
+String PluginState::getLayoutHash (const ValueTree& session, bool includeNodeSettings)
+{
+    MemoryOutputStream layout;
+    writeLayout (layout, session, true, includeNodeSettings);
+    return MD5 (layout.getData(), layout.getDataSize()).toHexString();
+}
+
+int PluginState::reloadChangedNodes (const ValueTree& session, const ValueTree& newSession)
+{
+    HashMap<String, ValueTree> nodes;
+    collectReloadableNodes (session, nodes);
+    HashMap<String, ValueTree> newNodes;
+    collectReloadableNodes (newSession, newNodes);
+
+    int numReloaded = 0;
+    for (HashMap<String, ValueTree>::Iterator iter (newNodes); iter.next();)
+    {
+        if (! nodes.contains (iter.getKey()))
+            continue;
+        auto node = nodes [iter.getKey()];
+        if (copyNodeSettings (node, iter.getValue()))
+        {
+            Node (node, false).restorePluginState();
+            ++numReloaded;
+        }
+    }
+
+    return numReloaded;
+}
+
+}
@@ -0,0 +1,63 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** The state chunk Element plugins give their host.
+
+    A chunk is the session encoded as a binary model behind a short header
+    holding the MD5 of the model, so a host recalling a state can be
+    recognized without decoding it. States from older versions, XML in
+    JUCE's binary wrapper, are still read.
+ */
+struct PluginState
+{
+    /** Encodes a session */
+    static bool write (const ValueTree& session, MemoryBlock& data);
+
+    /** Returns true if data is a chunk written by write() */
+    static bool isPluginState (const void* data, size_t size);
+
+    /** Returns the content hash of a chunk, or an empty string if it isn't one */
+    static String getHash (const void* data, size_t size);
+
+    /** Decodes a chunk or an older XML state. Node states are left
+        compressed until the nodes are restored */
+    static ValueTree read (const void* data, size_t size);
+
+    /** Returns a digest of everything in a session that a node reload
+        can't change: the graphs, nodes, connections and controllers, but
+        not plugin states, and not the properties the plugin keeps for
+        itself. If includeNodeSettings is false the settings restored by
+        Node::restorePluginState are left out as well.
+     */
+    static String getLayoutHash (const ValueTree& session, bool includeNodeSettings);
+
+    /** Copies node states and settings from a session with the same layout
+        onto the running one and restores the nodes that differ. Returns
+        the number of nodes reloaded.
+     */
+    static int reloadChangedNodes (const ValueTree& session, const ValueTree& newSession);
+};
+
+}
@@ -19,7 +19,10 @@
 
 #include "kv/lua/factories.hpp"
 #include "engine/MidiPipe.h"
+#include "engine/VoiceAllocator.h"
 #include "scripting/DSPScript.h"
+#include "scripting/LuaDSP.h"
+#include "scripting/LuaWatchdog.h"
 
 using namespace kv;
 namespace Element {
@@ -85,6 +88,236 @@ private:
     DSPScript* ctx { nullptr };
 };
 
+//==============================================================================
+/** Runs the voices of a polyphonic script.
+
+    MIDI from the first input splits the block into sub-blocks at each event.
+    Every active voice renders a sub-block into a scratch buffer, which is
+    added to the output.
+ */
+class DSPScript::Voices : private VoiceAllocator::Listener
+{
+public:
+    explicit Voices (DSPScript& s)
+        : script (s), L (s.L) { }
+
+    ~Voices()
+    {
+        buffer = nullptr;
+        luaL_unref (L, LUA_REGISTRYINDEX, bufferRef);
+    }
+
+    /** Creates the voices by calling the script's voice function */
+    bool load (sol::function factory, int numVoices, bool mpe)
+    {
+        allocator.setNumVoices (numVoices);
+        allocator.setMPEEnabled (mpe);
+
+        for (int i = 0; i < allocator.getNumVoices(); ++i)
+        {
+            auto result = factory (i + 1);
+            if (! result.valid() || result.get_type() != sol::type::table)
+                return false;
+
+            auto& voice = voices[i];
+            voice.self = result;
+            voice.render = voice.self ["render"];
+            if (! voice.render.valid())
+                return false;
+
+            // the keys are created here so setting them while rendering doesn't allocate
+            voice.self ["index"]    = i + 1;
+            voice.self ["note"]     = -1;
+            voice.self ["velocity"] = 0.0;
+            voice.self ["channel"]  = 1;
+            voice.self ["stolen"]   = false;
+            voice.self ["bend"]     = 0.0;
+            voice.self ["pressure"] = 0.0;
+            voice.self ["timbre"]   = 0.5;
+        }
+
+        buffer = kv::lua::new_userdata<AudioBuffer<float>> (L, LKV_MT_AUDIO_BUFFER_32);
+        bufferRef = luaL_ref (L, LUA_REGISTRYINDEX);
+        return bufferRef != LUA_REFNIL && bufferRef != LUA_NOREF;
+    }
+
+    int getNumVoices() const noexcept { return allocator.getNumVoices(); }
+
+    void prepare (double rate, int block, int numChannels)
+    {
+        scratch.setSize (jmax (1, numChannels), jmax (1, block), false, false, true);
+        allocator.reset();
+
+        for (int i = 0; i < allocator.getNumVoices(); ++i)
+            if (sol::function f = voices[i].self ["prepare"])
+                f (voices[i].self, rate, block);
+    }
+
+    void release()
+    {
+        allocator.reset();
+    }
+
+    void process (AudioSampleBuffer& audio, MidiPipe& midi) noexcept
+    {
+        const int numSamples = audio.getNumSamples();
+        audio.clear();
+
+        int position = 0;
+        if (midi.getNumBuffers() > 0)
+        {
+            MidiBuffer::Iterator iter (*midi.getReadBuffer (0));
+            const uint8* data = nullptr;
+            int size = 0, frame = 0;
+
+            while (iter.getNextEvent (data, size, frame))
+            {
+                frame = jlimit (0, numSamples, frame);
+                if (frame > position)
+                {
+                    render (audio, position, frame - position);
+                    position = frame;
+                }
+
+                allocator.handleMessage (data, size, *this);
+            }
+        }
+
+        if (position < numSamples)
+            render (audio, position, numSamples - position);
+    }
+
+private:
+    struct Voice
+    {
+        sol::table self;
+        sol::function render;
+    };
+
+    DSPScript& script;
+    lua_State* L = nullptr;
+    VoiceAllocator allocator;
+    Voice voices [VoiceAllocator::maxVoices];
+    AudioBuffer<float>** buffer = nullptr;
+    int bufferRef = LUA_REFNIL;
+    AudioSampleBuffer scratch;
+
+    void render (AudioSampleBuffer& audio, int start, int length) noexcept
+    {
+        const int numChannels = jmin (audio.getNumChannels(), scratch.getNumChannels());
+
+        // blocks bigger than prepared for are rendered in pieces
+        for (int done = 0; done < length;)
+        {
+            const int numSamples = jmin (length - done, scratch.getNumSamples());
+            for (int i = 0; i < allocator.getNumVoices(); ++i)
+            {
+                // the watchdog is disarmed once it aborts a voice
+                if (LuaWatchdog::hasOverrun (L))
+                    return;
+                if (! allocator.getVoice (i).active)
+                    continue;
+
+                for (int ch = 0; ch < numChannels; ++ch)
+                    FloatVectorOperations::clear (scratch.getWritePointer (ch), numSamples);
+                (*buffer)->setDataToReferTo (scratch.getArrayOfWritePointers(), numChannels, numSamples);
+
+                const bool sounding = renderVoice (i);
+                for (int ch = 0; ch < numChannels; ++ch)
+                    FloatVectorOperations::add (audio.getWritePointer (ch, start + done),
+                                                scratch.getReadPointer (ch), numSamples);
+
+                const auto& voice = allocator.getVoice (i);
+                if (! sounding && ! voice.held && ! voice.sustained)
+                    allocator.finish (i);
+            }
+
+            done += numSamples;
+        }
+    }
+
+    /** Calls voice:render (buffer, params), returns what it returned */
+    bool renderVoice (int index) noexcept
+    {
+        const auto& voice = voices[index];
+        lua_rawgeti (L, LUA_REGISTRYINDEX, voice.render.registry_index());
+        lua_rawgeti (L, LUA_REGISTRYINDEX, voice.self.registry_index());
+        lua_pushnumber (L, static_cast<lua_Number> (allocator.getBend (index)));
+        lua_setfield (L, -2, "bend");
+        lua_pushnumber (L, static_cast<lua_Number> (allocator.getPressure (index)));
+        lua_setfield (L, -2, "pressure");
+        lua_pushnumber (L, static_cast<lua_Number> (allocator.getTimbre (index)));
+        lua_setfield (L, -2, "timbre");
+        lua_rawgeti (L, LUA_REGISTRYINDEX, bufferRef);
+        lua_rawgeti (L, LUA_REGISTRYINDEX, script.params.registry_index());
+
+        // errors must not unwind through the audio thread
+        if (lua_pcall (L, 3, 1, 0) != LUA_OK)
+        {
+            LuaWatchdog::reportError (L);
+            return false;
+        }
+
+        const bool sounding = lua_toboolean (L, -1) != 0;
+        lua_pop (L, 1);
+        return sounding;
+    }
+
+    /** Calls voice:start (note, velocity) or voice:stop() if the voice has it */
+    void callVoice (int index, const char* method, bool starting) noexcept
+    {
+        if (LuaWatchdog::hasOverrun (L))
+            return;
+
+        const auto& state = allocator.getVoice (index);
+        lua_rawgeti (L, LUA_REGISTRYINDEX, voices[index].self.registry_index());
+        const int self = lua_gettop (L);
+
+        if (starting)
+        {
+            lua_pushinteger (L, state.note);
+            lua_setfield (L, self, "note");
+            lua_pushnumber (L, static_cast<lua_Number> (state.velocity));
+            lua_setfield (L, self, "velocity");
+            lua_pushinteger (L, state.channel);
+            lua_setfield (L, self, "channel");
+        }
+
+        if (lua_getfield (L, self, method) != LUA_TFUNCTION)
+        {
+            lua_settop (L, self - 1);
+            return;
+        }
+
+        lua_pushvalue (L, self);
+        int numArgs = 1;
+        if (starting)
+        {
+            lua_pushinteger (L, state.note);
+            lua_pushnumber (L, static_cast<lua_Number> (state.velocity));
+            numArgs += 2;
+        }
+
+        if (lua_pcall (L, numArgs, 0, 0) != LUA_OK)
+            LuaWatchdog::reportError (L);
+        lua_settop (L, self - 1);
+    }
+
+    void voiceStarted (int index, bool stolen) override
+    {
+        lua_rawgeti (L, LUA_REGISTRYINDEX, voices[index].self.registry_index());
+        lua_pushboolean (L, stolen);
+        lua_setfield (L, -2, "stolen");
+        lua_pop (L, 1);
+        callVoice (index, "start", true);
+    }
+
+    void voiceStopped (int index) override
+    {
+        callVoice (index, "stop", false);
+    }
+};
+
 //==============================================================================
 DSPScript::DSPScript (sol::table tbl)
     : DSP (tbl)
@@ -142,11 +375,14 @@ DSPScript::DSPScript (sol::table tbl)
         }
     }
 
+    sol::function voiceFactory;
     if (ok)
     {
         processFunc = DSP ["process"];
         processRef = processFunc.registry_index();
-        ok = processRef != LUA_REFNIL && processRef != LUA_NOREF;
+        voiceFactory = DSP ["voice"];
+        ok = (processRef != LUA_REFNIL && processRef != LUA_NOREF)
+            || voiceFactory.valid();
     }
 
     if (ok)
@@ -164,12 +400,31 @@ DSPScript::DSPScript (sol::table tbl)
         ok = midiRef != LUA_REFNIL && midiRef != LUA_NOREF;
     }
 
+    if (ok)
+    {
+        rampsView = Lua::pushParameterRamps (L, &ramps);
+        rampsRef = luaL_ref (L, LUA_REGISTRYINDEX);
+        ok = rampsRef != LUA_REFNIL && rampsRef != LUA_NOREF;
+    }
+
     if (ok)
     {
         addAudioMidiPorts();
         addParameterPorts();
     }
 
+    if (ok && voiceFactory.valid())
+    {
+        try {
+            voices.reset (new Voices (*this));
+            ok = voices->load (voiceFactory, DSP["polyphony"].get_or (8),
+                               DSP["mpe"].get_or (false));
+        } catch (const std::exception& e) {
+            DBG("[EL] " << e.what());
+            ok = false;
+        }
+    }
+
     if (ok)
     {
         sol::state_view view (L);
@@ -192,6 +447,29 @@ DSPScript::~DSPScript()
     deref();
 }
 
+void DSPScript::prepare (double rate, int block)
+{
+    ramps.prepare (rate);
+    resetRamps();
+    if (voices != nullptr)
+        voices->prepare (rate, block, ports.size (PortType::Audio, false));
+    if (sol::function f = DSP ["prepare"])
+        f (rate, block);
+}
+
+void DSPScript::release()
+{
+    if (voices != nullptr)
+        voices->release();
+    if (sol::function f = DSP ["release"])
+        f();
+}
+
+int DSPScript::getNumVoices() const
+{
+    return voices != nullptr ? voices->getNumVoices() : 0;
+}
+
 Result DSPScript::validate (const String& script)
 {
     if (script.isEmpty())
@@ -284,21 +562,34 @@ void DSPScript::process (AudioSampleBuffer& a, MidiPipe& m)
     if (! loaded)
         return;
 
+    ramps.advance (paramData, a.getNumSamples());
+    if (voices != nullptr)
+    {
+        voices->process (a, m);
+        if (processRef == LUA_REFNIL || processRef == LUA_NOREF || LuaWatchdog::hasOverrun (L))
+            return;
+    }
+
+    const int top = lua_gettop (L);
     if (lua_rawgeti (L, LUA_REGISTRYINDEX, processRef) == LUA_TFUNCTION)
     {
         if (lua_rawgeti (L, LUA_REGISTRYINDEX, audioRef) == LUA_TUSERDATA)
         {
             if (lua_rawgeti (L, LUA_REGISTRYINDEX, midiRef) == LUA_TUSERDATA)
             {
-                if (lua_rawgeti (L, LUA_REGISTRYINDEX, params.registry_index()) == LUA_TUSERDATA)
+                if (lua_rawgeti (L, LUA_REGISTRYINDEX, params.registry_index()) == LUA_TUSERDATA
+                    && lua_rawgeti (L, LUA_REGISTRYINDEX, rampsRef) == LUA_TUSERDATA)
                 {
                     (*audio)->setDataToReferTo (a.getArrayOfWritePointers(),
                             a.getNumChannels(), a.getNumSamples());
                     (*midi)->swapWith (m);
 
-                    lua_call (L, 3, 0);
-                    
+                    // errors must not unwind through the audio thread
+                    if (lua_pcall (L, 4, 0, 0) != LUA_OK)
+                        LuaWatchdog::reportError (L);
+
                     (*midi)->swapWith (m);
+                    return;
                 }
             }
         }
@@ -307,6 +598,8 @@ void DSPScript::process (AudioSampleBuffer& a, MidiPipe& m)
     {
         DBG("didn't get render function in callback");
     }
+
+    lua_settop (L, top);
 }
 
 void DSPScript::save (MemoryBlock& out)
@@ -379,6 +672,7 @@ void DSPScript::restore (const void* d, size_t s)
             const auto port = param->getPort();
             param->update (paramData [port.channel]);
         }
+        resetRamps();
     }
 
     const var& data = state.getProperty ("data");
@@ -424,6 +718,13 @@ void DSPScript::copyParameterValues (const DSPScript& o)
 {
     for (int i = jmin (numParams, o.numParams); --i >= 0;)
         paramData[i] = o.paramData[i];
+    resetRamps();
+}
+
+void DSPScript::resetRamps()
+{
+    for (int i = 0; i < numParams; ++i)
+        ramps.reset (i, paramData[i]);
 }
 
 void DSPScript::getParameterData (MemoryBlock& block)
@@ -450,12 +751,19 @@ String DSPScript::getUI() const
 void DSPScript::deref()
 {
     loaded = false;
+    voices.reset();
     audio = nullptr;
     luaL_unref (L, LUA_REGISTRYINDEX, audioRef);
     audioRef = LUA_REFNIL;
     midi = nullptr;
     luaL_unref (L, LUA_REGISTRYINDEX, midiRef);
     midiRef = LUA_REFNIL;
+    // scripts can hold on to the ramps
+    if (rampsView != nullptr)
+        *rampsView = nullptr;
+    rampsView = nullptr;
+    luaL_unref (L, LUA_REGISTRYINDEX, rampsRef);
+    rampsRef = LUA_REFNIL;
 }
 
 void DSPScript::addAudioMidiPorts()
@@ -535,6 +843,7 @@ void DSPScript::addParameterPorts()
     try {
         int index = ports.size();
         int inChan = 0, outChan = 0;
+        double smoothingTimes [maxParams] = { 0.0 };
         sol::table params = f();
         for (size_t i = 0; i < params.size(); ++i)
         {
@@ -559,6 +868,7 @@ void DSPScript::addParameterPorts()
             float dfault = param["default"].get_or (1.0);
             ignoreUnused (min, max, dfault);
             const int channel = isInput ? inChan++ : outChan++;
+            const double smoothing = param["smoothing"].get_or (0.0);
 
             // EL_LUA_DBG("index = " << index);
             // EL_LUA_DBG("channel = " << channel);
@@ -569,9 +879,10 @@ void DSPScript::addParameterPorts()
             // EL_LUA_DBG("max = " << max);
             // EL_LUA_DBG("default = " << dfault);
 
-            if (isInput)
+            if (isInput && channel < maxParams)
             {
                 paramData[channel] = dfault;
+                smoothingTimes[channel] = smoothing;
             }
 
             ports.addControl (index++, channel, sym, name,
@@ -579,6 +890,12 @@ void DSPScript::addParameterPorts()
         }
 
         numParams = ports.size (PortType::Control, true);
+        ramps.setNumParameters (numParams);
+        for (int i = 0; i < ramps.getNumParameters(); ++i)
+        {
+            ramps.setSmoothingTime (i, smoothingTimes[i]);
+            ramps.reset (i, paramData[i]);
+        }
 
         unlinkParams();
         for (const auto* port : ports.getPorts())
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "sol/sol.hpp"
+#include "engine/DSPKernels.h"
 #include "engine/Parameter.h"
 #include "scripting/ScriptInstance.h"
 #include "JuceHeader.h"
@@ -46,19 +47,17 @@ public:
     bool isValid() const { return loaded; }
 
     //==========================================================================
-    void prepare (double rate, int block)
-    {
-        if (sol::function f = DSP ["prepare"])
-            f (rate, block);
-    }
-    
-    void release()
-    {
-        if (sol::function f = DSP ["release"])
-            f();
-    }
+    void prepare (double rate, int block);
+    void release();
+
+    /** Returns the number of voices, or zero if the script isn't polyphonic */
+    int getNumVoices() const;
 
     //==========================================================================
+    /** Calls the script's process function with the audio, MIDI, parameter
+        values and the parameter ramps for this block. Polyphonic scripts
+        render their voices first, process is then optional.
+     */
     void process (AudioSampleBuffer& a, MidiPipe& m);
 
     //==========================================================================
@@ -85,15 +84,19 @@ private:
     int processRef              = LUA_REFNIL;
     int audioRef                = LUA_REFNIL;
     int midiRef                 = LUA_REFNIL;
+    int rampsRef                = LUA_REFNIL;
     lua_State* L                = nullptr;
     bool loaded                 = false;
     int numParams               = 0;
     enum { maxParams = 128 };
     float paramData [maxParams];
     sol::userdata params;
+    DSP::ParameterRamps ramps;
+    DSP::ParameterRamps** rampsView = nullptr;
     kv::PortList ports;
 
     class Parameter; friend class Parameter;
+    class Voices; std::unique_ptr<Voices> voices;
     ReferenceCountedArray<Parameter> inParams, outParams;
 
     void deref();
@@ -103,6 +106,7 @@ private:
     void addParameterPorts();
     void unlinkParams();
     void setParameter (int, float);
+    void resetRamps();
 };
 
 }
@@ -0,0 +1,248 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "sol/sol.hpp"
+#include "scripting/LuaAllocator.h"
+
+namespace Element {
+
+// every class is a multiple of 16 so blocks carved from the arena stay aligned
+static const size_t sizeClasses[] = {
+    16, 32, 48, 64, 96, 128, 192, 256,
+    384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+
+LuaAllocator::LuaAllocator (size_t budgetInBytes)
+    : budget (budgetInBytes)
+{
+    static_assert (numElementsInArray (sizeClasses) == numSizeClasses, "size class mismatch");
+    static_assert (maxPooledSize == 4096, "size class mismatch");
+
+    // not cleared, pages are only touched once the pool reaches them
+    arenaSize = budget - (budget % 16);
+    arena.malloc (arenaSize);
+    for (auto& list : freeLists)
+        list = nullptr;
+}
+
+LuaAllocator::~LuaAllocator()
+{
+    // the state must be closed first
+    jassert (bytesInUse == 0);
+}
+
+int LuaAllocator::getSizeClass (size_t size) noexcept
+{
+    if (size > (size_t) maxPooledSize)
+        return -1;
+    int sizeClass = 0;
+    while (sizeClasses[sizeClass] < size)
+        ++sizeClass;
+    return sizeClass;
+}
+
+size_t LuaAllocator::getAccountedSize (size_t size) noexcept
+{
+    const int sizeClass = getSizeClass (size);
+    return sizeClass >= 0 ? sizeClasses[sizeClass] : size;
+}
+
+bool LuaAllocator::isInArena (const void* ptr) const noexcept
+{
+    auto* const p = static_cast<const char*> (ptr);
+    return p >= arena.get() && p < arena.get() + arenaSize;
+}
+
+void* LuaAllocator::alloc (void* userData, void* ptr, size_t oldSize, size_t newSize) noexcept
+{
+    auto& self = *static_cast<LuaAllocator*> (userData);
+
+    if (newSize == 0)
+    {
+        if (ptr != nullptr)
+            self.deallocate (ptr, oldSize);
+        return nullptr;
+    }
+
+    // when ptr is null, oldSize holds the object type and not a size
+    return ptr == nullptr ? self.allocate (newSize)
+                          : self.reallocate (ptr, oldSize, newSize);
+}
+
+void* LuaAllocator::allocate (size_t size, bool ignoreBudget) noexcept
+{
+    const int sizeClass = getSizeClass (size);
+    const size_t accounted = getAccountedSize (size);
+
+    if (! ignoreBudget && bytesInUse + accounted > budget)
+    {
+        ++failedAllocations;
+        return nullptr;
+    }
+
+    void* block = nullptr;
+    if (sizeClass >= 0)
+    {
+        if (auto* const head = freeLists[sizeClass])
+        {
+            freeLists[sizeClass] = head->next;
+            block = head;
+        }
+        else if (arenaUsed + accounted <= arenaSize)
+        {
+            block = arena.get() + arenaUsed;
+            arenaUsed += accounted;
+        }
+    }
+
+    if (block == nullptr)
+    {
+        // too big for the pool, or the arena is spent on other size classes
+        block = std::malloc (accounted);
+        if (block != nullptr)
+            ++systemAllocations;
+    }
+
+    if (block == nullptr)
+    {
+        if (! ignoreBudget)
+            ++failedAllocations;
+        return nullptr;
+    }
+
+    ++blockAllocations;
+    bytesInUse += accounted;
+    peakBytesInUse = jmax (peakBytesInUse, bytesInUse);
+    return block;
+}
+
+void LuaAllocator::deallocate (void* ptr, size_t size) noexcept
+{
+    const size_t accounted = getAccountedSize (size);
+    jassert (bytesInUse >= accounted);
+    bytesInUse -= jmin (bytesInUse, accounted);
+
+    if (isInArena (ptr))
+    {
+        const int sizeClass = getSizeClass (size);
+        jassert (sizeClass >= 0);
+        auto* const block = static_cast<FreeBlock*> (ptr);
+        block->next = freeLists[sizeClass];
+        freeLists[sizeClass] = block;
+    }
+    else
+    {
+        std::free (ptr);
+    }
+}
+
+void* LuaAllocator::reallocate (void* ptr, size_t oldSize, size_t newSize) noexcept
+{
+    const int oldClass = getSizeClass (oldSize);
+    const int newClass = getSizeClass (newSize);
+
+    if (oldClass >= 0 && oldClass == newClass)
+        return ptr;
+
+    const bool shrinking = newSize <= oldSize;
+
+    if (oldClass < 0 && newClass < 0 && ! isInArena (ptr))
+    {
+        if (! shrinking && bytesInUse + (newSize - oldSize) > budget)
+        {
+            ++failedAllocations;
+            return nullptr;
+        }
+
+        if (auto* const block = std::realloc (ptr, newSize))
+        {
+            ++blockAllocations;
+            ++systemAllocations;
+            bytesInUse = bytesInUse - oldSize + newSize;
+            peakBytesInUse = jmax (peakBytesInUse, bytesInUse);
+            return block;
+        }
+
+        if (! shrinking)
+            return nullptr;
+    }
+    else if (auto* const block = allocate (newSize, shrinking))
+    {
+        memcpy (block, ptr, jmin (oldSize, newSize));
+        deallocate (ptr, oldSize);
+        return block;
+    }
+    else if (! shrinking)
+    {
+        return nullptr;
+    }
+
+    // Lua expects shrinking to succeed: keep the bigger block, it is freed
+    // by address later, and account for it at the smaller size
+    bytesInUse -= jmin (bytesInUse, getAccountedSize (oldSize) - getAccountedSize (newSize));
+    return ptr;
+}
+
+LuaAllocator::Stats LuaAllocator::getStats() const noexcept
+{
+    Stats stats;
+    stats.budget                = budget;
+    stats.bytesInUse            = (size_t) publishedBytesInUse.get();
+    stats.peakBytesInUse        = (size_t) publishedPeakBytes.get();
+    stats.blockAllocations      = lastBlockAllocations.get();
+    stats.peakBlockAllocations  = peakBlockAllocations.get();
+    stats.systemAllocations     = publishedSystem.get();
+    stats.failedAllocations     = publishedFailed.get();
+    return stats;
+}
+
+void LuaAllocator::endBlock() noexcept
+{
+    lastBlockAllocations.set (blockAllocations);
+    if (blockAllocations > peakBlockAllocations.get())
+        peakBlockAllocations.set (blockAllocations);
+    publishedBytesInUse.set ((int64) bytesInUse);
+    publishedPeakBytes.set ((int64) peakBytesInUse);
+    publishedSystem.set (systemAllocations);
+    publishedFailed.set (failedAllocations);
+}
+
+bool LuaAllocator::collectGarbage (lua_State* L, double maxMilliseconds) noexcept
+{
+    if (blockAllocations == 0)
+        return true;
+
+    const double start = Time::getMillisecondCounterHiRes();
+    do
+    {
+        const bool finishedCycle = lua_gc (L, LUA_GCSTEP, 0) != 0;
+        if (finishedCycle || bytesInUse < budget / 2)
+            return true;
+    } while (Time::getMillisecondCounterHiRes() - start < maxMilliseconds);
+
+    return false;
+}
+
+void LuaAllocator::setupCollector (lua_State* L) noexcept
+{
+    lua_gc (L, LUA_GCGEN, 0, 0);
+    lua_gc (L, LUA_GCSTOP);
+}
+
+}
@@ -0,0 +1,124 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+struct lua_State;
+
+namespace Element {
+
+/** Memory for a Lua state that runs on the audio thread.
+
+    Blocks up to maxPooledSize come from segregated free lists carved out of
+    one preallocated arena, so allocating and freeing don't reach the system
+    allocator. Larger blocks, or small ones once the arena is spent, fall back
+    to malloc and are counted separately.
+    Everything counts against a fixed budget: when it is used up Lua gets a
+    memory error after its emergency collection, the state never grows past
+    it.
+
+    Pass alloc() and the allocator to the sol::state (or lua_newstate) and
+    keep the allocator alive longer than the state.
+ */
+class LuaAllocator
+{
+public:
+    enum
+    {
+        defaultBudget   = 8 * 1024 * 1024,
+        maxPooledSize   = 4096
+    };
+
+    struct Stats
+    {
+        size_t bytesInUse       = 0;
+        size_t peakBytesInUse   = 0;
+        size_t budget           = 0;
+        /** Allocations made during the last rendered block */
+        int blockAllocations    = 0;
+        /** The most allocations made during a single block */
+        int peakBlockAllocations = 0;
+        /** Allocations the pool couldn't serve */
+        int64 systemAllocations = 0;
+        /** Allocations refused because the budget was used up */
+        int64 failedAllocations = 0;
+    };
+
+    explicit LuaAllocator (size_t budgetInBytes = defaultBudget);
+    ~LuaAllocator();
+
+    /** The lua_Alloc function, userdata is the LuaAllocator */
+    static void* alloc (void* userData, void* ptr, size_t oldSize, size_t newSize) noexcept;
+
+    /** Returns a snapshot of the counters. Safe to call from any thread */
+    Stats getStats() const noexcept;
+
+    /** Marks the start of a rendered block */
+    void beginBlock() noexcept { blockAllocations = 0; }
+
+    /** Marks the end of a rendered block and publishes its counters */
+    void endBlock() noexcept;
+
+    /** Runs the collector after a block. Nothing is done if the block didn't
+        allocate, otherwise a generational step runs and further steps follow
+        while more than half the budget is in use and there is time left.
+        Returns false if it ran out of time.
+     */
+    bool collectGarbage (lua_State* L, double maxMilliseconds) noexcept;
+
+    /** Prepares a state for realtime use: the collector is switched to
+        generational mode and stopped, so it only runs from collectGarbage(),
+        a full collection, or when an allocation fails.
+     */
+    static void setupCollector (lua_State* L) noexcept;
+
+private:
+    enum { numSizeClasses = 16 };
+    struct FreeBlock { FreeBlock* next; };
+
+    HeapBlock<char> arena;
+    size_t arenaSize = 0, arenaUsed = 0;
+    FreeBlock* freeLists [numSizeClasses];
+
+    const size_t budget;
+    size_t bytesInUse = 0, peakBytesInUse = 0;
+    int blockAllocations = 0;
+    int64 systemAllocations = 0, failedAllocations = 0;
+
+    Atomic<int> lastBlockAllocations { 0 },
+                peakBlockAllocations { 0 };
+    Atomic<int64> publishedBytesInUse { 0 },
+                  publishedPeakBytes { 0 },
+                  publishedSystem { 0 },
+                  publishedFailed { 0 };
+
+    void* allocate (size_t size, bool ignoreBudget = false) noexcept;
+    void deallocate (void* ptr, size_t size) noexcept;
+    void* reallocate (void* ptr, size_t oldSize, size_t newSize) noexcept;
+    bool isInArena (const void* ptr) const noexcept;
+
+    static int getSizeClass (size_t size) noexcept;
+    static size_t getAccountedSize (size_t size) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE (LuaAllocator)
+};
+
+}
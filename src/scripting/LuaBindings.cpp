@@ -24,8 +24,11 @@
 #include "engine/AudioEngine.h"
 #include "engine/MidiPipe.h"
 #include "gui/SystemTray.h"
+#include "scripting/LuaBindings.h"
+#include "scripting/LuaBytecodeCache.h"
 #include "scripting/ScriptManager.h"
 #include "session/CommandManager.h"
+#include "session/GraphBuilder.h"
 #include "session/MediaManager.h"
 #include "session/Node.h"
 #include "session/PluginManager.h"
@@ -81,6 +84,7 @@ extern int luaopen_kv_Range (lua_State*);
 extern int luaopen_kv_Rectangle (lua_State*);
 extern int luaopen_kv_Slider (lua_State*);
 extern int luaopen_el_MidiPipe (lua_State*);
+extern int luaopen_el_dsp (lua_State*);
 
 using namespace sol;
 
@@ -276,6 +280,39 @@ static String getLuaCPath()
 }
 
 //==============================================================================
+/** Finds Lua modules on package.path like the stock searcher, but loads them
+    through the bytecode cache so each state doesn't parse them again. */
+static int searchCachedModules (lua_State* L)
+{
+    const char* name = luaL_checkstring (L, 1);
+    lua_getglobal (L, LUA_LOADLIBNAME);
+    lua_getfield (L, -1, "searchpath");
+    lua_pushvalue (L, 1);
+    lua_getfield (L, -3, "path");
+    lua_call (L, 2, 2);
+    if (lua_isnil (L, -2))
+        return 1; // the "no file" message
+
+    {
+        const String filename = String::fromUTF8 (lua_tostring (L, -2));
+        auto source = File (filename).loadFileAsString();
+        if (source.startsWithChar ('#'))
+            source = "--" + source; // skip a shebang like luaL_loadfile, keeping line numbers
+
+        SharedResourcePointer<LuaBytecodeCache> cache;
+        const auto chunkName = "@" + filename;
+        if (cache->load (L, source, chunkName.toRawUTF8()) == LUA_OK)
+        {
+            lua_pushvalue (L, 3);
+            return 2;
+        }
+    }
+
+    // raised out here, lua_error doesn't unwind the scope above
+    return luaL_error (L, "error loading module '%s' from file '%s':\n\t%s",
+                       name, lua_tostring (L, 3), lua_tostring (L, -1));
+}
+
 static int searchInternalModules (lua_State* L)
 {
     const auto mod = sol::stack::get<std::string> (L);
@@ -296,6 +333,10 @@ static int searchInternalModules (lua_State* L)
     {
         sol::stack::push (L, luaopen_el_Node);
     }
+    else if (mod == "el.dsp")
+    {
+        sol::stack::push (L, luaopen_el_dsp);
+    }
     else if (mod == "el.Session")
     {
         sol::stack::push (L, luaopen_el_Session);
@@ -396,6 +437,116 @@ static int searchInternalModules (lua_State* L)
 	return 1;
 }
 
+//==============================================================================
+// only the address is used, as a registry key scripts can't make
+static const char engineControllerKey = 0;
+
+void setEngineController (lua_State* L, EngineController* engine)
+{
+    if (engine != nullptr)
+        lua_pushlightuserdata (L, engine);
+    else
+        lua_pushnil (L);
+    lua_rawsetp (L, LUA_REGISTRYINDEX, &engineControllerKey);
+}
+
+EngineController* getEngineController (lua_State* L)
+{
+    EngineController* engine = nullptr;
+    if (lua_rawgetp (L, LUA_REGISTRYINDEX, &engineControllerKey) == LUA_TLIGHTUSERDATA)
+        engine = static_cast<EngineController*> (lua_touserdata (L, -1));
+    lua_pop (L, 1);
+    return engine;
+}
+
+//==============================================================================
+static String getKeyName (const sol::object& key)
+{
+    if (key.get_type() == sol::type::string)
+        return String::fromUTF8 (key.as<const char*>());
+    if (key.get_type() == sol::type::number)
+        return String (static_cast<int64> (key.as<lua_Integer>()));
+    return "?";
+}
+
+String fillGraphBuilder (const sol::table& spec, GraphBuilder& builder,
+                         std::vector<sol::object>& keys)
+{
+    sol::state_view view (spec.lua_state());
+    auto indexes = view.create_table();
+
+    sol::optional<sol::table> nodes = spec ["nodes"];
+    if (! nodes)
+        return "missing nodes table";
+
+    for (const auto& kv : *nodes)
+    {
+        const auto& value = kv.second;
+        int index = -1;
+
+        if (value.is<Node>())
+        {
+            index = builder.addExistingNode (value.as<Node>());
+        }
+        else if (value.get_type() == sol::type::table)
+        {
+            sol::table node = value;
+            sol::optional<std::string> identifier = node ["identifier"];
+            if (! identifier)
+                return "node has no identifier: " + getKeyName (kv.first);
+
+            const auto format = node.get_or<std::string> ("format", "Element");
+            const auto name   = node.get_or<std::string> ("name", std::string());
+            index = builder.addNode (String::fromUTF8 (format.c_str()),
+                                     String::fromUTF8 (identifier->c_str()),
+                                     String::fromUTF8 (name.c_str()));
+        }
+        else
+        {
+            return "invalid node: " + getKeyName (kv.first);
+        }
+
+        indexes [kv.first] = index;
+        keys.push_back (kv.first);
+    }
+
+    sol::optional<sol::table> connections = spec ["connections"];
+    if (! connections)
+        return String();
+
+    for (const auto& kv : *connections)
+    {
+        if (kv.second.get_type() != sol::type::table)
+            return "invalid connection";
+
+        sol::table c = kv.second;
+        sol::object sourceKey = c[1], destKey = c[3];
+        sol::optional<int> source = indexes [sourceKey];
+        sol::optional<int> dest   = indexes [destKey];
+        if (! source || ! dest)
+            return "connection to an unknown node: " + getKeyName (source ? destKey : sourceKey);
+
+        const int sourcePort = c.get_or (2, -1);
+        const int destPort   = c.get_or (4, -1);
+        if (sourcePort < 0 || destPort < 0)
+            return "connection without ports";
+
+        if (sol::optional<std::string> slug = c ["type"])
+        {
+            const PortType type (String::fromUTF8 (slug->c_str()));
+            if (type == PortType::Unknown)
+                return "unknown port type: " + String::fromUTF8 (slug->c_str());
+            builder.connectChannels (type, *source, sourcePort, *dest, destPort);
+        }
+        else
+        {
+            builder.connect (*source, sourcePort, *dest, destPort);
+        }
+    }
+
+    return String();
+}
+
 //==============================================================================
 void setGlobals (sol::state_view& view, Globals& g)
 {
@@ -416,8 +567,10 @@ void initializeState (sol::state_view& view)
     auto newSearchers = view.create_table();
     newSearchers.add (package ["searchers"][1]);
     newSearchers.add (searchInternalModules);
+    newSearchers.add (searchCachedModules);
     sol::table packageSearchers = package["searchers"];
-    for (int i = 2; i <= packageSearchers.size(); ++i)
+    // the stock Lua file searcher is replaced by the cached one
+    for (int i = 3; i <= packageSearchers.size(); ++i)
         newSearchers.add (package["searchers"][i]);
     package["searchers"] = newSearchers;
 
@@ -19,10 +19,15 @@
 
 #pragma once
 
+#include "JuceHeader.h"
 #include "sol/forward.hpp"
 
+struct lua_State;
+
 namespace Element {
 
+class EngineController;
+class GraphBuilder;
 class Globals;
 
 namespace Lua {
@@ -30,6 +35,21 @@ extern void initializeState (sol::state_view&);
 extern void initializeState (sol::state_view&, Globals&);
 extern void setGlobals (sol::state_view&, Globals&);
 extern void clearGlobals (sol::state_view&);
+
+/** Reads a table of nodes and connections into a builder, see Node:build.
+    The key of each node is added to keys in builder index order. Returns an
+    error message or an empty string.
+ */
+extern String fillGraphBuilder (const sol::table& spec, GraphBuilder& builder,
+                                std::vector<sol::object>& keys);
+
+/** Sets the engine controller Node:build uses in a state, or nullptr to
+    remove it. It's kept in the registry, out of reach of scripts.
+ */
+extern void setEngineController (lua_State* L, EngineController* engine);
+
+/** Returns the engine controller set for a state, or nullptr */
+extern EngineController* getEngineController (lua_State* L);
 }
 
 }
@@ -0,0 +1,136 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "sol/sol.hpp"
+#include "scripting/LuaBytecodeCache.h"
+
+namespace Element {
+
+static int writeBytecode (lua_State*, const void* data, size_t size, void* userData)
+{
+    static_cast<MemoryBlock*> (userData)->append (data, size);
+    return 0;
+}
+
+int LuaBytecodeCache::load (lua_State* L, const String& source, const char* chunkName)
+{
+    const auto hash = source.hashCode64();
+    {
+        ScopedLock sl (lock);
+        if (auto* entry = find (hash, source, chunkName))
+        {
+            entry->lastUsed = ++counter;
+            ++hits;
+            // undumping runs no Lua code, holding the lock keeps the entry alive
+            return luaL_loadbufferx (L, (const char*) entry->bytecode.getData(),
+                                     entry->bytecode.getSize(), chunkName, "b");
+        }
+
+        ++misses;
+    }
+
+    const char* const text = source.toRawUTF8();
+    const int status = luaL_loadbufferx (L, text, source.getNumBytesAsUTF8(), chunkName, "t");
+    if (status != LUA_OK)
+        return status;
+
+    auto entry = std::make_unique<Entry>();
+    // debug info is kept so errors still report line numbers
+    if (lua_dump (L, writeBytecode, &entry->bytecode, 0) != 0 || entry->bytecode.getSize() <= 0)
+        return status;
+
+    entry->hash         = hash;
+    entry->source       = source;
+    entry->chunkName    = chunkName;
+
+    ScopedLock sl (lock);
+    if (find (hash, source, chunkName) == nullptr)
+    {
+        entry->lastUsed = ++counter;
+        entries.add (entry.release());
+        trim();
+    }
+
+    return status;
+}
+
+bool LuaBytecodeCache::isValidated (const String& source, const String& kind) const
+{
+    ScopedLock sl (lock);
+    return validated.contains (kind + "\n" + source);
+}
+
+void LuaBytecodeCache::setValidated (const String& source, const String& kind)
+{
+    ScopedLock sl (lock);
+    validated.addIfNotAlreadyThere (kind + "\n" + source);
+    while (validated.size() > maxEntries)
+        validated.remove (0);
+}
+
+void LuaBytecodeCache::setMaxEntries (int newMax)
+{
+    ScopedLock sl (lock);
+    maxEntries = jmax (1, newMax);
+    trim();
+    while (validated.size() > maxEntries)
+        validated.remove (0);
+}
+
+void LuaBytecodeCache::clear()
+{
+    ScopedLock sl (lock);
+    entries.clear();
+    validated.clear();
+}
+
+LuaBytecodeCache::Stats LuaBytecodeCache::getStats() const
+{
+    ScopedLock sl (lock);
+    Stats stats;
+    stats.numEntries = entries.size();
+    for (const auto* entry : entries)
+        stats.numBytes += entry->bytecode.getSize();
+    stats.hits = hits;
+    stats.misses = misses;
+    return stats;
+}
+
+LuaBytecodeCache::Entry* LuaBytecodeCache::find (int64 hash, const String& source,
+                                                 const char* chunkName) const
+{
+    for (auto* entry : entries)
+        if (entry->hash == hash && entry->chunkName == chunkName && entry->source == source)
+            return entry;
+    return nullptr;
+}
+
+void LuaBytecodeCache::trim()
+{
+    while (entries.size() > maxEntries)
+    {
+        int oldest = 0;
+        for (int i = 1; i < entries.size(); ++i)
+            if (entries.getUnchecked (i)->lastUsed < entries.getUnchecked (oldest)->lastUsed)
+                oldest = i;
+        entries.remove (oldest);
+    }
+}
+
+}
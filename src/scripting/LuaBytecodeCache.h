@@ -0,0 +1,100 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+struct lua_State;
+
+namespace Element {
+
+/** Precompiled Lua chunks shared by every script in the process.
+
+    The first time a source is loaded it is parsed as usual and its bytecode
+    dumped into the cache. Later loads of the same source and chunk name,
+    into any state, skip the parser and load the bytecode. Only bytecode the
+    cache produced itself is ever loaded as binary.
+
+    States set up with Lua::initializeState also load the Lua modules that
+    require finds on package.path through it.
+
+    Use it through a SharedResourcePointer. Safe to call from any thread.
+ */
+class LuaBytecodeCache
+{
+public:
+    enum { defaultMaxEntries = 128 };
+
+    struct Stats
+    {
+        int numEntries  = 0;
+        size_t numBytes = 0;
+        int64 hits      = 0;
+        int64 misses    = 0;
+    };
+
+    LuaBytecodeCache() = default;
+    ~LuaBytecodeCache() = default;
+
+    /** Loads a chunk like luaL_loadbufferx and returns its status. On success
+        the function is left on the stack, otherwise the error message is.
+     */
+    int load (lua_State* L, const String& source, const char* chunkName);
+
+    /** Returns true if a script was marked as validated */
+    bool isValidated (const String& source, const String& kind) const;
+
+    /** Remembers that a script passed a validation run. Which kind of
+        validation is up to the caller.
+     */
+    void setValidated (const String& source, const String& kind);
+
+    /** Limits the number of cached chunks, the least recently used go first */
+    void setMaxEntries (int newMax);
+
+    /** Drops every cached chunk */
+    void clear();
+
+    /** Returns the cache counters */
+    Stats getStats() const;
+
+private:
+    struct Entry
+    {
+        int64 hash = 0;
+        String source, chunkName;
+        MemoryBlock bytecode;
+        uint32 lastUsed = 0;
+    };
+
+    CriticalSection lock;
+    OwnedArray<Entry> entries;
+    StringArray validated;
+    int maxEntries = defaultMaxEntries;
+    uint32 counter = 0;
+    int64 hits = 0, misses = 0;
+
+    Entry* find (int64 hash, const String& source, const char* chunkName) const;
+    void trim();
+
+    JUCE_DECLARE_NON_COPYABLE (LuaBytecodeCache)
+};
+
+}
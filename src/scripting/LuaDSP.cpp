@@ -0,0 +1,921 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/// Native DSP for scripts.
+// Filters, gains, delays, followers, oscillators and waveshapers that run
+// over a whole kv.AudioBuffer in one call, so per-sample loops stay in
+// native code. Channel arguments are 1-based, omit them to process every
+// channel (up to 16). Create objects when the script loads or in prepare,
+// not in process. DSP scripts also receive an el.dsp.Ramps with smoothed
+// parameter changes for each block.
+// @module el.dsp
+// @usage
+// local dsp = require ('el.dsp')
+// local lp  = dsp.Biquad()
+// local function prepare (rate, block)
+//     lp:prepare (rate)
+//     lp:set ('lowpass', 1000, 0.707)
+// end
+// local function process (a, m, params)
+//     lp:process (a)
+// end
+// @pragma nostrip
+
+#include "lua.hpp"
+#include "lua-kv.h"
+#include "engine/DSPKernels.h"
+#include "scripting/LuaDSP.h"
+
+using namespace Element;
+
+namespace {
+
+//==============================================================================
+struct LuaBiquad
+{
+    static constexpr const char* name = "el.dsp.Biquad";
+    DSP::Biquad filter;
+    DSP::BiquadCoefficients::Type type = DSP::BiquadCoefficients::lowPass;
+    double sampleRate = 44100.0, frequency = 1000.0, q = 0.7071, gain = 0.0;
+
+    void update() noexcept
+    {
+        filter.setCoefficients (DSP::BiquadCoefficients::make (type, sampleRate, frequency, q, gain));
+    }
+};
+
+struct LuaSVF
+{
+    static constexpr const char* name = "el.dsp.SVF";
+    DSP::StateVariableFilter filter;
+    double sampleRate = 44100.0, frequency = 1000.0, q = 0.7071;
+
+    void update() noexcept { filter.setParameters (sampleRate, frequency, q); }
+};
+
+struct LuaGain
+{
+    static constexpr const char* name = "el.dsp.Gain";
+    DSP::SmoothedGain gain;
+};
+
+struct LuaDelay
+{
+    static constexpr const char* name = "el.dsp.Delay";
+    LuaDelay (int maxDelay, int numChannels) : delay (maxDelay, numChannels) { }
+    DSP::DelayLine delay;
+};
+
+struct LuaFollower
+{
+    static constexpr const char* name = "el.dsp.Follower";
+    DSP::EnvelopeFollower follower;
+    double sampleRate = 44100.0, attack = 0.01, release = 0.1;
+
+    void update() noexcept { follower.prepare (sampleRate, attack, release); }
+};
+
+struct LuaRamps
+{
+    static constexpr const char* name = "el.dsp.Ramps";
+    DSP::ParameterRamps* ramps = nullptr;
+};
+
+struct LuaOscillator
+{
+    static constexpr const char* name = "el.dsp.Oscillator";
+    DSP::Oscillator osc;
+    double sampleRate = 44100.0, frequency = 440.0;
+
+    void update() noexcept { osc.setFrequency (sampleRate, frequency); }
+};
+
+//==============================================================================
+template<class T>
+static T* dsp_check (lua_State* L, int index = 1)
+{
+    return static_cast<T*> (luaL_checkudata (L, index, T::name));
+}
+
+template<class T, typename ...Args>
+static T* dsp_push (lua_State* L, Args&&... args)
+{
+    auto* obj = new (lua_newuserdatauv (L, sizeof (T), 0)) T (std::forward<Args> (args)...);
+    luaL_setmetatable (L, T::name);
+    return obj;
+}
+
+template<class T>
+static int dsp_gc (lua_State* L)
+{
+    dsp_check<T> (L)->~T();
+    return 0;
+}
+
+static AudioBuffer<float>& dsp_checkbuffer (lua_State* L, int index)
+{
+    auto** buffer = static_cast<AudioBuffer<float>**> (luaL_checkudata (L, index, LKV_MT_AUDIO_BUFFER_32));
+    luaL_argcheck (L, *buffer != nullptr, index, "invalid audio buffer");
+    return **buffer;
+}
+
+/** Returns the channels an optional 1-based channel argument refers to */
+static Range<int> dsp_checkchannels (lua_State* L, int index, const AudioBuffer<float>& buffer)
+{
+    const int numChannels = jmin (buffer.getNumChannels(), (int) DSP::maxChannels);
+    if (lua_isnoneornil (L, index))
+        return { 0, numChannels };
+    const auto channel = static_cast<int> (luaL_checkinteger (L, index) - 1);
+    luaL_argcheck (L, isPositiveAndBelow (channel, numChannels), index, "channel out of range");
+    return { channel, channel + 1 };
+}
+
+static double dsp_checkrate (lua_State* L, int index)
+{
+    const auto rate = luaL_checknumber (L, index);
+    luaL_argcheck (L, rate > 0.0, index, "sample rate must be positive");
+    return rate;
+}
+
+//==============================================================================
+static int biquad_new (lua_State* L)
+{
+    dsp_push<LuaBiquad> (L)->update();
+    return 1;
+}
+
+static int biquad_prepare (lua_State* L)
+{
+    auto* self = dsp_check<LuaBiquad> (L);
+    self->sampleRate = dsp_checkrate (L, 2);
+    self->update();
+    self->filter.reset();
+    return 0;
+}
+
+static int biquad_set (lua_State* L)
+{
+    static const char* const types[] = { "lowpass", "highpass", "bandpass", "notch",
+                                         "allpass", "peak", "lowshelf", "highshelf", nullptr };
+    auto* self = dsp_check<LuaBiquad> (L);
+    self->type      = (DSP::BiquadCoefficients::Type) luaL_checkoption (L, 2, nullptr, types);
+    self->frequency = luaL_checknumber (L, 3);
+    self->q         = luaL_optnumber (L, 4, 0.7071);
+    self->gain      = luaL_optnumber (L, 5, 0.0);
+    self->update();
+    return 0;
+}
+
+static int biquad_process (lua_State* L)
+{
+    auto* self = dsp_check<LuaBiquad> (L);
+    auto& buffer = dsp_checkbuffer (L, 2);
+    const auto channels = dsp_checkchannels (L, 3, buffer);
+    for (int ch = channels.getStart(); ch < channels.getEnd(); ++ch)
+        self->filter.process (buffer.getWritePointer (ch), buffer.getNumSamples(), ch);
+    return 0;
+}
+
+static int biquad_reset (lua_State* L)
+{
+    dsp_check<LuaBiquad> (L)->filter.reset();
+    return 0;
+}
+
+/// Create a biquad filter.
+// Starts as a 1kHz low pass at 44.1kHz.
+// @treturn el.dsp.Biquad A new filter
+// @within Constructors
+// @function Biquad
+
+static const luaL_Reg biquad_methods[] = {
+    { "__gc",       dsp_gc<LuaBiquad> },
+
+    /// Set the sample rate and clear the filter state.
+    // @number rate Sample rate
+    // @within Biquad
+    // @function Biquad:prepare
+    { "prepare",    biquad_prepare },
+
+    /// Design the filter.
+    // @string type One of lowpass, highpass, bandpass, notch, allpass,
+    // peak, lowshelf or highshelf
+    // @number frequency Cutoff or center frequency in Hz
+    // @number[opt=0.707] q Resonance
+    // @number[opt=0] gain Gain in dB, for peak and shelf filters
+    // @within Biquad
+    // @function Biquad:set
+    { "set",        biquad_set },
+
+    /// Filter a buffer in place.
+    // @tparam kv.AudioBuffer buffer Audio to filter
+    // @int[opt] channel Channel to filter, all if omitted
+    // @within Biquad
+    // @function Biquad:process
+    { "process",    biquad_process },
+
+    /// Clear the filter state.
+    // @within Biquad
+    // @function Biquad:reset
+    { "reset",      biquad_reset },
+
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static int svf_new (lua_State* L)
+{
+    dsp_push<LuaSVF> (L)->update();
+    return 1;
+}
+
+static int svf_prepare (lua_State* L)
+{
+    auto* self = dsp_check<LuaSVF> (L);
+    self->sampleRate = dsp_checkrate (L, 2);
+    self->update();
+    self->filter.reset();
+    return 0;
+}
+
+static int svf_set (lua_State* L)
+{
+    static const char* const modes[] = { "lowpass", "highpass", "bandpass", "notch", nullptr };
+    auto* self = dsp_check<LuaSVF> (L);
+    self->filter.setMode ((DSP::StateVariableFilter::Mode) luaL_checkoption (L, 2, nullptr, modes));
+    self->frequency = luaL_checknumber (L, 3);
+    self->q         = luaL_optnumber (L, 4, 0.7071);
+    self->update();
+    return 0;
+}
+
+static int svf_frequency (lua_State* L)
+{
+    auto* self = dsp_check<LuaSVF> (L);
+    self->frequency = luaL_checknumber (L, 2);
+    self->update();
+    return 0;
+}
+
+static int svf_process (lua_State* L)
+{
+    auto* self = dsp_check<LuaSVF> (L);
+    auto& buffer = dsp_checkbuffer (L, 2);
+    const auto channels = dsp_checkchannels (L, 3, buffer);
+    for (int ch = channels.getStart(); ch < channels.getEnd(); ++ch)
+        self->filter.process (buffer.getWritePointer (ch), buffer.getNumSamples(), ch);
+    return 0;
+}
+
+static int svf_reset (lua_State* L)
+{
+    dsp_check<LuaSVF> (L)->filter.reset();
+    return 0;
+}
+
+/// Create a state variable filter.
+// Safe to sweep every block.
+// @treturn el.dsp.SVF A new filter
+// @within Constructors
+// @function SVF
+
+static const luaL_Reg svf_methods[] = {
+    { "__gc",       dsp_gc<LuaSVF> },
+
+    /// Set the sample rate and clear the filter state.
+    // @number rate Sample rate
+    // @within SVF
+    // @function SVF:prepare
+    { "prepare",    svf_prepare },
+
+    /// Set the filter mode, cutoff and resonance.
+    // @string mode One of lowpass, highpass, bandpass or notch
+    // @number frequency Cutoff frequency in Hz
+    // @number[opt=0.707] q Resonance
+    // @within SVF
+    // @function SVF:set
+    { "set",        svf_set },
+
+    /// Change only the cutoff.
+    // @number frequency Cutoff frequency in Hz
+    // @within SVF
+    // @function SVF:frequency
+    { "frequency",  svf_frequency },
+
+    /// Filter a buffer in place.
+    // @tparam kv.AudioBuffer buffer Audio to filter
+    // @int[opt] channel Channel to filter, all if omitted
+    // @within SVF
+    // @function SVF:process
+    { "process",    svf_process },
+
+    /// Clear the filter state.
+    // @within SVF
+    // @function SVF:reset
+    { "reset",      svf_reset },
+
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static int gain_new (lua_State* L)
+{
+    auto* self = dsp_push<LuaGain> (L);
+    self->gain.prepare (44100.0);
+    self->gain.setCurrentAndTarget ((float) luaL_optnumber (L, 1, 1.0));
+    return 1;
+}
+
+static int gain_prepare (lua_State* L)
+{
+    auto* self = dsp_check<LuaGain> (L);
+    self->gain.prepare (dsp_checkrate (L, 2), jmax (0.0, luaL_optnumber (L, 3, 0.02)));
+    return 0;
+}
+
+static int gain_set (lua_State* L)
+{
+    dsp_check<LuaGain> (L)->gain.setTarget ((float) luaL_checknumber (L, 2));
+    return 0;
+}
+
+static int gain_setdb (lua_State* L)
+{
+    dsp_check<LuaGain> (L)->gain.setTarget (
+        Decibels::decibelsToGain ((float) luaL_checknumber (L, 2)));
+    return 0;
+}
+
+static int gain_get (lua_State* L)
+{
+    lua_pushnumber (L, static_cast<lua_Number> (dsp_check<LuaGain> (L)->gain.getCurrent()));
+    return 1;
+}
+
+static int gain_process (lua_State* L)
+{
+    auto* self = dsp_check<LuaGain> (L);
+    auto& buffer = dsp_checkbuffer (L, 2);
+    self->gain.process (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples());
+    return 0;
+}
+
+/// Create a smoothed gain.
+// @number[opt=1] gain Initial gain
+// @treturn el.dsp.Gain A new gain
+// @within Constructors
+// @function Gain
+
+static const luaL_Reg gain_methods[] = {
+    { "__gc",       dsp_gc<LuaGain> },
+
+    /// Set the sample rate and ramp time.
+    // Jumps to the target gain.
+    // @number rate Sample rate
+    // @number[opt=0.02] seconds Time it takes to reach a new gain
+    // @within Gain
+    // @function Gain:prepare
+    { "prepare",    gain_prepare },
+
+    /// Ramp to a new linear gain.
+    // @number gain Target gain
+    // @within Gain
+    // @function Gain:set
+    { "set",        gain_set },
+
+    /// Ramp to a new gain in decibels.
+    // @number db Target gain in dB
+    // @within Gain
+    // @function Gain:setdb
+    { "setdb",      gain_setdb },
+
+    /// Returns the current linear gain.
+    // @treturn number The gain
+    // @within Gain
+    // @function Gain:get
+    { "get",        gain_get },
+
+    /// Apply the gain to every channel of a buffer.
+    // @tparam kv.AudioBuffer buffer Audio to process
+    // @within Gain
+    // @function Gain:process
+    { "process",    gain_process },
+
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static int delay_new (lua_State* L)
+{
+    const auto maxDelay = luaL_checkinteger (L, 1);
+    luaL_argcheck (L, maxDelay > 0 && maxDelay <= 10 * 192000, 1, "delay length out of range");
+    const auto numChannels = luaL_optinteger (L, 2, 2);
+    luaL_argcheck (L, numChannels > 0 && numChannels <= DSP::maxChannels, 2, "channel count out of range");
+    dsp_push<LuaDelay> (L, static_cast<int> (maxDelay), static_cast<int> (numChannels));
+    return 1;
+}
+
+static int delay_set (lua_State* L)
+{
+    auto& delay = dsp_check<LuaDelay> (L)->delay;
+    delay.setDelay ((float) luaL_checknumber (L, 2));
+    delay.setFeedback ((float) luaL_optnumber (L, 3, delay.getFeedback()));
+    delay.setMix ((float) luaL_optnumber (L, 4, delay.getMix()));
+    return 0;
+}
+
+static int delay_process (lua_State* L)
+{
+    auto& delay = dsp_check<LuaDelay> (L)->delay;
+    auto& buffer = dsp_checkbuffer (L, 2);
+    const auto channels = dsp_checkchannels (L, 3, buffer);
+    for (int ch = channels.getStart(); ch < channels.getEnd(); ++ch)
+        delay.process (buffer.getWritePointer (ch), buffer.getNumSamples(), ch);
+    return 0;
+}
+
+static int delay_reset (lua_State* L)
+{
+    dsp_check<LuaDelay> (L)->delay.reset();
+    return 0;
+}
+
+/// Create a delay line.
+// Allocates its memory, don't call from process.
+// @int length Longest delay in samples
+// @int[opt=2] channels Number of channels
+// @treturn el.dsp.Delay A new delay
+// @within Constructors
+// @function Delay
+
+static const luaL_Reg delay_methods[] = {
+    { "__gc",       dsp_gc<LuaDelay> },
+
+    /// Set the delay time, feedback and mix.
+    // @number samples Delay in samples, may be fractional
+    // @number[opt] feedback Feedback from -1 to 1, unchanged if omitted
+    // @number[opt] mix Wet amount from 0 to 1, unchanged if omitted
+    // @within Delay
+    // @function Delay:set
+    { "set",        delay_set },
+
+    /// Delay a buffer in place.
+    // @tparam kv.AudioBuffer buffer Audio to process
+    // @int[opt] channel Channel to process, all if omitted
+    // @within Delay
+    // @function Delay:process
+    { "process",    delay_process },
+
+    /// Clear the delay memory.
+    // @within Delay
+    // @function Delay:reset
+    { "reset",      delay_reset },
+
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static int follower_new (lua_State* L)
+{
+    dsp_push<LuaFollower> (L)->update();
+    return 1;
+}
+
+static int follower_prepare (lua_State* L)
+{
+    auto* self = dsp_check<LuaFollower> (L);
+    self->sampleRate = dsp_checkrate (L, 2);
+    self->attack     = luaL_optnumber (L, 3, self->attack);
+    self->release    = luaL_optnumber (L, 4, self->release);
+    self->update();
+    self->follower.reset();
+    return 0;
+}
+
+static int follower_process (lua_State* L)
+{
+    auto* self = dsp_check<LuaFollower> (L);
+    auto& buffer = dsp_checkbuffer (L, 2);
+    const auto channels = dsp_checkchannels (L, 3, buffer);
+    float envelope = 0.f;
+    for (int ch = channels.getStart(); ch < channels.getEnd(); ++ch)
+        envelope = jmax (envelope, self->follower.process (
+            buffer.getReadPointer (ch), nullptr, buffer.getNumSamples(), ch));
+    lua_pushnumber (L, static_cast<lua_Number> (envelope));
+    return 1;
+}
+
+static int follower_envelope (lua_State* L)
+{
+    auto* self = dsp_check<LuaFollower> (L);
+    const auto channel = static_cast<int> (luaL_optinteger (L, 2, 1) - 1);
+    lua_pushnumber (L, static_cast<lua_Number> (self->follower.getEnvelope (channel)));
+    return 1;
+}
+
+/// Create an envelope follower.
+// @treturn el.dsp.Follower A new follower
+// @within Constructors
+// @function Follower
+
+static const luaL_Reg follower_methods[] = {
+    { "__gc",       dsp_gc<LuaFollower> },
+
+    /// Set the sample rate and timing, clears the envelope.
+    // @number rate Sample rate
+    // @number[opt=0.01] attack Attack in seconds
+    // @number[opt=0.1] release Release in seconds
+    // @within Follower
+    // @function Follower:prepare
+    { "prepare",    follower_prepare },
+
+    /// Follow a block of audio. The buffer isn't changed.
+    // @tparam kv.AudioBuffer buffer Audio to follow
+    // @int[opt] channel Channel to follow, all if omitted
+    // @treturn number The highest envelope of the followed channels
+    // @within Follower
+    // @function Follower:process
+    { "process",    follower_process },
+
+    /// Returns the envelope of a channel.
+    // @int[opt=1] channel The channel
+    // @treturn number The envelope
+    // @within Follower
+    // @function Follower:envelope
+    { "envelope",   follower_envelope },
+
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static const char* const waveforms[] = { "sine", "saw", "square", "triangle", nullptr };
+
+static int oscillator_new (lua_State* L)
+{
+    auto* self = dsp_push<LuaOscillator> (L);
+    self->osc.setWaveform ((DSP::Oscillator::Waveform) luaL_checkoption (L, 1, "sine", waveforms));
+    self->update();
+    return 1;
+}
+
+static int oscillator_prepare (lua_State* L)
+{
+    auto* self = dsp_check<LuaOscillator> (L);
+    self->sampleRate = dsp_checkrate (L, 2);
+    self->update();
+    self->osc.reset();
+    return 0;
+}
+
+static int oscillator_frequency (lua_State* L)
+{
+    auto* self = dsp_check<LuaOscillator> (L);
+    self->frequency = luaL_checknumber (L, 2);
+    self->update();
+    return 0;
+}
+
+static int oscillator_waveform (lua_State* L)
+{
+    dsp_check<LuaOscillator> (L)->osc.setWaveform (
+        (DSP::Oscillator::Waveform) luaL_checkoption (L, 2, nullptr, waveforms));
+    return 0;
+}
+
+static int oscillator_render (lua_State* L)
+{
+    auto* self = dsp_check<LuaOscillator> (L);
+    auto& buffer = dsp_checkbuffer (L, 2);
+    const auto channels = dsp_checkchannels (L, 3, buffer);
+    const auto gain = (float) luaL_optnumber (L, 4, 1.0);
+    if (channels.isEmpty())
+        return 0;
+
+    const int first = channels.getStart();
+    self->osc.render (buffer.getWritePointer (first), buffer.getNumSamples(), gain);
+    for (int ch = first + 1; ch < channels.getEnd(); ++ch)
+        buffer.copyFrom (ch, 0, buffer, first, 0, buffer.getNumSamples());
+    return 0;
+}
+
+static int oscillator_reset (lua_State* L)
+{
+    dsp_check<LuaOscillator> (L)->osc.reset (luaL_optnumber (L, 2, 0.0));
+    return 0;
+}
+
+/// Create an oscillator.
+// @string[opt='sine'] waveform One of sine, saw, square or triangle
+// @treturn el.dsp.Oscillator A new oscillator
+// @within Constructors
+// @function Oscillator
+
+static const luaL_Reg oscillator_methods[] = {
+    { "__gc",       dsp_gc<LuaOscillator> },
+
+    /// Set the sample rate and restart the phase.
+    // @number rate Sample rate
+    // @within Oscillator
+    // @function Oscillator:prepare
+    { "prepare",    oscillator_prepare },
+
+    /// Set the frequency.
+    // @number frequency Frequency in Hz
+    // @within Oscillator
+    // @function Oscillator:frequency
+    { "frequency",  oscillator_frequency },
+
+    /// Change the waveform.
+    // @string waveform One of sine, saw, square or triangle
+    // @within Oscillator
+    // @function Oscillator:waveform
+    { "waveform",   oscillator_waveform },
+
+    /// Write the next block to a buffer, replacing what's there.
+    // @tparam kv.AudioBuffer buffer Destination
+    // @int[opt] channel Channel to write, all if omitted
+    // @number[opt=1] gain Output level
+    // @within Oscillator
+    // @function Oscillator:render
+    { "render",     oscillator_render },
+
+    /// Restart the phase.
+    // @number[opt=0] phase Phase from 0 to 1
+    // @within Oscillator
+    // @function Oscillator:reset
+    { "reset",      oscillator_reset },
+
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static DSP::ParameterRamps& ramps_check (lua_State* L)
+{
+    auto* self = dsp_check<LuaRamps> (L);
+    luaL_argcheck (L, self->ramps != nullptr, 1, "ramps are no longer valid");
+    return *self->ramps;
+}
+
+static int ramps_checkindex (lua_State* L, int index, const DSP::ParameterRamps& ramps)
+{
+    const auto param = static_cast<int> (luaL_checkinteger (L, index) - 1);
+    luaL_argcheck (L, isPositiveAndBelow (param, ramps.getNumParameters()), index, "parameter out of range");
+    return param;
+}
+
+static int ramps_get (lua_State* L)
+{
+    const auto& ramps = ramps_check (L);
+    const auto& ramp = ramps.getRamp (ramps_checkindex (L, 2, ramps));
+    lua_pushnumber (L, static_cast<lua_Number> (ramp.start));
+    lua_pushnumber (L, static_cast<lua_Number> (ramp.end));
+    lua_pushinteger (L, static_cast<lua_Integer> (ramp.length));
+    return 3;
+}
+
+static int ramps_changed (lua_State* L)
+{
+    const auto& ramps = ramps_check (L);
+    lua_pushboolean (L, ramps.getRamp (ramps_checkindex (L, 2, ramps)).length > 0);
+    return 1;
+}
+
+static int ramps_value (lua_State* L)
+{
+    const auto& ramps = ramps_check (L);
+    const int param = ramps_checkindex (L, 2, ramps);
+    const auto frame = static_cast<int> (jmax ((lua_Integer) 0, luaL_checkinteger (L, 3)));
+    lua_pushnumber (L, static_cast<lua_Number> (ramps.getValue (param, frame)));
+    return 1;
+}
+
+template<bool decibels>
+static int ramps_gain (lua_State* L)
+{
+    const auto& ramps = ramps_check (L);
+    const int param = ramps_checkindex (L, 2, ramps);
+    auto& buffer = dsp_checkbuffer (L, 3);
+    const auto channels = dsp_checkchannels (L, 4, buffer);
+    for (int ch = channels.getStart(); ch < channels.getEnd(); ++ch)
+        ramps.applyGain (param, buffer.getWritePointer (ch), buffer.getNumSamples(), decibels);
+    return 0;
+}
+
+static int ramps_smoothing (lua_State* L)
+{
+    auto& ramps = ramps_check (L);
+    const int param = ramps_checkindex (L, 2, ramps);
+    ramps.setSmoothingTime (param, luaL_checknumber (L, 3));
+    return 0;
+}
+
+static int ramps_len (lua_State* L)
+{
+    lua_pushinteger (L, static_cast<lua_Integer> (ramps_check (L).getNumParameters()));
+    return 1;
+}
+
+// Ramps are passed to a DSP script's process function after the params
+// array, there is no constructor. Each input parameter gets a ramp per
+// block: the value it started at, the value it reached and the number of
+// frames it took. Parameters are 1-based like the params array, frames are
+// offsets into the block.
+
+static const luaL_Reg ramps_methods[] = {
+    /// Returns a parameter's ramp for this block.
+    // @int param Parameter index
+    // @treturn number Value at the start of the block
+    // @treturn number Value it reached
+    // @treturn int Frames it took, 0 if it didn't move
+    // @within Ramps
+    // @function Ramps:get
+    { "get",        ramps_get },
+
+    /// Returns true if a parameter moved in this block.
+    // @int param Parameter index
+    // @treturn bool True if it changed
+    // @within Ramps
+    // @function Ramps:changed
+    { "changed",    ramps_changed },
+
+    /// Returns a parameter's value at a frame of this block.
+    // @int param Parameter index
+    // @int frame Offset from the start of the block
+    // @treturn number The value
+    // @within Ramps
+    // @function Ramps:value
+    { "value",      ramps_value },
+
+    /// Multiply a buffer by a parameter used as a linear gain.
+    // @int param Parameter index
+    // @tparam kv.AudioBuffer buffer Audio to process
+    // @int[opt] channel Channel to process, all if omitted
+    // @within Ramps
+    // @function Ramps:gain
+    { "gain",       ramps_gain<false> },
+
+    /// Multiply a buffer by a parameter in decibels.
+    // The parameter is converted to a gain at both ends of the ramp.
+    // @int param Parameter index
+    // @tparam kv.AudioBuffer buffer Audio to process
+    // @int[opt] channel Channel to process, all if omitted
+    // @within Ramps
+    // @function Ramps:gaindb
+    { "gaindb",     ramps_gain<true> },
+
+    /// Set how long a parameter takes to reach a new value.
+    // Zero, the default, spreads a change over the block it arrives in. The
+    // parameters table can set this with a smoothing field instead.
+    // @int param Parameter index
+    // @number seconds Smoothing time
+    // @within Ramps
+    // @function Ramps:smoothing
+    { "smoothing",  ramps_smoothing },
+
+    { "__len",      ramps_len },
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+/// Add one buffer to another.
+// Channels and samples beyond either buffer's size are left alone.
+// @tparam kv.AudioBuffer dst Destination
+// @tparam kv.AudioBuffer src Source
+// @number[opt=1] gain Gain applied to the source
+// @number[opt] endgain Ramp the gain to this over the block
+// @within Functions
+// @function mix
+static int dsp_mix (lua_State* L)
+{
+    auto& dst = dsp_checkbuffer (L, 1);
+    auto& src = dsp_checkbuffer (L, 2);
+    const auto startGain = (float) luaL_optnumber (L, 3, 1.0);
+    const auto endGain   = (float) luaL_optnumber (L, 4, startGain);
+    const int numChannels = jmin (dst.getNumChannels(), src.getNumChannels());
+    const int numSamples  = jmin (dst.getNumSamples(), src.getNumSamples());
+    for (int ch = 0; ch < numChannels; ++ch)
+        DSP::addWithRamp (dst.getWritePointer (ch), src.getReadPointer (ch),
+                          numSamples, startGain, endGain);
+    return 0;
+}
+
+/// Equal power pan of the first two channels.
+// @tparam kv.AudioBuffer buffer A stereo buffer
+// @number pan From -1 (left) to 1 (right)
+// @number[opt] endpan Ramp the pan to this over the block
+// @within Functions
+// @function pan
+static int dsp_pan (lua_State* L)
+{
+    auto& buffer = dsp_checkbuffer (L, 1);
+    const auto startPan = (float) luaL_checknumber (L, 2);
+    const auto endPan   = (float) luaL_optnumber (L, 3, startPan);
+    if (buffer.getNumChannels() < 2)
+        return 0;
+
+    float l1, r1, l2, r2;
+    DSP::getPanGains (startPan, l1, r1);
+    DSP::getPanGains (endPan, l2, r2);
+    DSP::applyRamp (buffer.getWritePointer (0), buffer.getNumSamples(), l1, l2);
+    DSP::applyRamp (buffer.getWritePointer (1), buffer.getNumSamples(), r1, r2);
+    return 0;
+}
+
+template<void (*shape)(float*, int, float)>
+static int dsp_shape (lua_State* L)
+{
+    auto& buffer = dsp_checkbuffer (L, 1);
+    const auto drive = (float) luaL_optnumber (L, 2, 1.0);
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        shape (buffer.getWritePointer (ch), buffer.getNumSamples(), drive);
+    return 0;
+}
+
+static const luaL_Reg dsp_functions[] = {
+    { "Biquad",     biquad_new },
+    { "SVF",        svf_new },
+    { "Gain",       gain_new },
+    { "Delay",      delay_new },
+    { "Follower",   follower_new },
+    { "Oscillator", oscillator_new },
+    { "mix",        dsp_mix },
+    { "pan",        dsp_pan },
+
+    /// Hard clip a buffer to -1..1.
+    // @tparam kv.AudioBuffer buffer Audio to shape
+    // @number[opt=1] drive Gain applied first
+    // @within Functions
+    // @function clip
+    { "clip",       dsp_shape<DSP::hardClip> },
+
+    /// Cubic soft clip.
+    // @tparam kv.AudioBuffer buffer Audio to shape
+    // @number[opt=1] drive Gain applied first
+    // @within Functions
+    // @function softclip
+    { "softclip",   dsp_shape<DSP::softClip> },
+
+    /// Hyperbolic tangent saturation.
+    // @tparam kv.AudioBuffer buffer Audio to shape
+    // @number[opt=1] drive Gain applied first
+    // @within Functions
+    // @function tanh
+    { "tanh",       dsp_shape<DSP::tanhShape> },
+
+    { nullptr, nullptr }
+};
+
+template<class T>
+static void dsp_register (lua_State* L, const luaL_Reg* methods)
+{
+    if (luaL_newmetatable (L, T::name)) {
+        lua_pushvalue (L, -1);               /* duplicate the metatable */
+        lua_setfield (L, -2, "__index");     /* mt.__index = mt */
+        luaL_setfuncs (L, methods, 0);
+    }
+    lua_pop (L, 1);
+}
+
+}
+
+int luaopen_el_dsp (lua_State* L)
+{
+    dsp_register<LuaBiquad>     (L, biquad_methods);
+    dsp_register<LuaSVF>        (L, svf_methods);
+    dsp_register<LuaGain>       (L, gain_methods);
+    dsp_register<LuaDelay>      (L, delay_methods);
+    dsp_register<LuaFollower>   (L, follower_methods);
+    dsp_register<LuaOscillator> (L, oscillator_methods);
+    dsp_register<LuaRamps>      (L, ramps_methods);
+    luaL_newlib (L, dsp_functions);
+    return 1;
+}
+
+namespace Element {
+namespace Lua {
+
+DSP::ParameterRamps** pushParameterRamps (lua_State* L, DSP::ParameterRamps* ramps)
+{
+    dsp_register<LuaRamps> (L, ramps_methods);
+    auto* self = dsp_push<LuaRamps> (L);
+    self->ramps = ramps;
+    return &self->ramps;
+}
+
+}}
@@ -0,0 +1,34 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+struct lua_State;
+
+namespace Element {
+namespace DSP { class ParameterRamps; }
+namespace Lua {
+
+/** Pushes an el.dsp.Ramps userdata that views ramps owned by the caller.
+    Returns the pointer the userdata holds, set it to nullptr before the
+    ramps are deleted.
+ */
+DSP::ParameterRamps** pushParameterRamps (lua_State* L, DSP::ParameterRamps* ramps);
+
+}}
@@ -0,0 +1,182 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "sol/sol.hpp"
+#include "scripting/LuaWatchdog.h"
+
+namespace Element {
+
+// the watchdog's address is kept in the registry under this key's address
+static const char watchdogKey = 0;
+
+/** Returns the watchdog attached to a state, or nullptr if there isn't one */
+static LuaWatchdog* getWatchdog (lua_State* L) noexcept
+{
+    LuaWatchdog* watchdog = nullptr;
+    if (lua_rawgetp (L, LUA_REGISTRYINDEX, &watchdogKey) == LUA_TLIGHTUSERDATA)
+        watchdog = static_cast<LuaWatchdog*> (lua_touserdata (L, -1));
+    lua_pop (L, 1);
+    return watchdog;
+}
+
+LuaWatchdog::LuaWatchdog()
+{
+    zeromem (overrunLocation, sizeof (overrunLocation));
+    zeromem (suspendedLocation, sizeof (suspendedLocation));
+    zeromem (pendingError, sizeof (pendingError));
+}
+
+LuaWatchdog::~LuaWatchdog() { }
+
+void LuaWatchdog::attach (lua_State* L) noexcept
+{
+    // coroutines share the registry and copy the hook from the main thread
+    lua_pushlightuserdata (L, this);
+    lua_rawsetp (L, LUA_REGISTRYINDEX, &watchdogKey);
+    lua_sethook (L, hook, LUA_MASKCOUNT, instructionsPerCheck);
+}
+
+void LuaWatchdog::hook (lua_State* L, lua_Debug* ar)
+{
+    auto* const self = getWatchdog (L);
+    if (self == nullptr || ! self->armed || Time::getHighResolutionTicks() < self->deadlineTicks)
+        return;
+
+    self->armed = false;
+    self->overran = true;
+
+    if (lua_getinfo (L, "Sl", ar) != 0)
+        snprintf (self->overrunLocation, sizeof (self->overrunLocation),
+                  "%s:%d", ar->short_src, ar->currentline);
+    else
+        strncpy (self->overrunLocation, "unknown", sizeof (self->overrunLocation) - 1);
+
+    lua_pushliteral (L, "script exceeded its CPU budget");
+    lua_error (L);
+}
+
+void LuaWatchdog::resume() noexcept
+{
+    overruns.set (0);
+    errors.set (0);
+    peakMillis.set (0.0);
+    lastError.clear();
+    resumeRequested.set (1);
+    suspended.set (false);
+}
+
+bool LuaWatchdog::beginBlock (int numSamples, double sampleRate) noexcept
+{
+    if (resumeRequested.compareAndSetBool (0, 1))
+        strikes = cleanBlocks = 0;
+
+    overran = false;
+    if (suspended.get())
+        return false;
+    if (sampleRate <= 0.0)
+        return true;
+
+    const double budgetSeconds = budget.get() * (double) numSamples / sampleRate;
+    budgetMillis.set (budgetSeconds * 1000.0);
+
+    startTicks = Time::getHighResolutionTicks();
+    deadlineTicks = startTicks + Time::secondsToHighResolutionTicks (budgetSeconds);
+    armed = true;
+    return true;
+}
+
+bool LuaWatchdog::endBlock() noexcept
+{
+    if (! armed && ! overran)
+        return false;
+
+    armed = false;
+    const double elapsed = 1000.0 * Time::highResolutionTicksToSeconds (
+        Time::getHighResolutionTicks() - startTicks);
+    lastMillis.set (elapsed);
+    if (elapsed > peakMillis.get())
+        peakMillis.set (elapsed);
+
+    if (! overran)
+    {
+        if (++cleanBlocks >= cleanBlocksToForgive)
+            strikes = cleanBlocks = 0;
+        return false;
+    }
+
+    overruns.set (overruns.get() + 1);
+    cleanBlocks = 0;
+
+    if (++strikes >= defaultMaxOverruns)
+    {
+        // the location must be in place before the flag is seen
+        memcpy (suspendedLocation, overrunLocation, sizeof (suspendedLocation));
+        suspended.set (true);
+    }
+
+    return true;
+}
+
+void LuaWatchdog::reportError (lua_State* L) noexcept
+{
+    auto* const self = getWatchdog (L);
+    if (self != nullptr && ! self->overran)
+    {
+        self->errors.set (self->errors.get() + 1);
+        if (self->errorPending.get() == 0)
+        {
+            const char* message = lua_tostring (L, -1);
+            strncpy (self->pendingError, message != nullptr ? message : "error object is not a string",
+                     sizeof (self->pendingError) - 1);
+            self->errorPending.set (1);
+        }
+    }
+
+    lua_pop (L, 1);
+}
+
+bool LuaWatchdog::hasOverrun (lua_State* L) noexcept
+{
+    auto* const self = getWatchdog (L);
+    return self != nullptr && self->overran;
+}
+
+LuaWatchdog::Stats LuaWatchdog::getStats() const
+{
+    Stats stats;
+    stats.budgetMillis  = budgetMillis.get();
+    stats.lastMillis    = lastMillis.get();
+    stats.peakMillis    = peakMillis.get();
+    stats.overruns      = overruns.get();
+    stats.suspended     = suspended.get();
+    if (stats.suspended)
+        stats.location = String (CharPointer_UTF8 (suspendedLocation));
+
+    if (errorPending.get() != 0)
+    {
+        lastError = String (CharPointer_UTF8 (pendingError));
+        errorPending.set (0);
+    }
+
+    stats.errors        = errors.get();
+    stats.lastError     = lastError;
+    return stats;
+}
+
+}
@@ -0,0 +1,134 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+struct lua_State;
+struct lua_Debug;
+
+namespace Element {
+
+/** Keeps Lua code called from the audio thread within a CPU budget.
+
+    A count hook checks the clock every few hundred VM instructions while a
+    block is being rendered. When the budget is used up the running call is
+    aborted with a Lua error, which the caller's lua_pcall catches, and the
+    block is reported as overrun so the node can output its bypassed signal.
+    After repeated overruns the watchdog suspends the script until resume()
+    is called, keeping the source line it was stopped at. Errors the script
+    raises are counted and the latest message is kept for the UI.
+
+    One watchdog per lua_State. It keeps its address in the state's registry,
+    so it must outlive the state.
+ */
+class LuaWatchdog
+{
+public:
+    enum
+    {
+        /** VM instructions between clock checks */
+        instructionsPerCheck    = 500,
+        /** Overruns, without a long enough clean run between them, that suspend the script */
+        defaultMaxOverruns      = 3,
+        /** Clean blocks in a row that forgive earlier overruns */
+        cleanBlocksToForgive    = 100
+    };
+
+    struct Stats
+    {
+        double budgetMillis     = 0.0;
+        double lastMillis       = 0.0;
+        double peakMillis       = 0.0;
+        int64 overruns          = 0;
+        bool suspended          = false;
+        /** Where the script was stopped when it got suspended, as "source:line" */
+        String location;
+        /** Errors raised by the script, other than overruns */
+        int64 errors            = 0;
+        String lastError;
+    };
+
+    LuaWatchdog();
+    ~LuaWatchdog();
+
+    /** Installs the count hook on a state */
+    void attach (lua_State* L) noexcept;
+
+    /** Sets the budget as a proportion of the block's duration */
+    void setBudget (double proportionOfBlock) noexcept { budget.set (jlimit (0.01, 1.0, proportionOfBlock)); }
+    double getBudget() const noexcept                 { return budget.get(); }
+
+    bool isSuspended() const noexcept                 { return suspended.get(); }
+
+    /** Lets a suspended script run again and clears the counters */
+    void resume() noexcept;
+
+    /** Call on the audio thread before running script code for a block.
+        Returns false if the script is suspended and shouldn't be called.
+     */
+    bool beginBlock (int numSamples, double sampleRate) noexcept;
+
+    /** Call on the audio thread after the script returned. Returns true if
+        the block overran and its output should be discarded.
+     */
+    bool endBlock() noexcept;
+
+    /** Call on the audio thread when a lua_pcall failed. Records the error
+        message on top of the stack and pops it. States without a watchdog
+        just have the message popped.
+     */
+    static void reportError (lua_State* L) noexcept;
+
+    /** Call on the audio thread. Returns true if the state's watchdog aborted
+        a call in the current block. The hook is disarmed by then, so no more
+        script code should run until the next beginBlock().
+     */
+    static bool hasOverrun (lua_State* L) noexcept;
+
+    /** Returns a snapshot of the counters. Call from the message thread */
+    Stats getStats() const;
+
+private:
+    Atomic<double> budget { 0.5 };
+    Atomic<bool> suspended { false };
+    Atomic<int> resumeRequested { 0 };
+
+    // audio thread only
+    bool armed = false, overran = false;
+    int64 startTicks = 0, deadlineTicks = 0;
+    int strikes = 0, cleanBlocks = 0;
+    char overrunLocation [256];
+
+    // published
+    Atomic<double> budgetMillis { 0.0 }, lastMillis { 0.0 }, peakMillis { 0.0 };
+    Atomic<int64> overruns { 0 }, errors { 0 };
+    char suspendedLocation [256];
+
+    // one message at a time is handed to the message thread
+    mutable Atomic<int> errorPending { 0 };
+    char pendingError [256];
+    mutable String lastError;
+
+    static void hook (lua_State* L, lua_Debug* ar);
+    JUCE_DECLARE_NON_COPYABLE (LuaWatchdog)
+};
+
+}
@@ -82,7 +82,8 @@ bool Script::load (const String& buffer)
     error = "";
 
     try {
-        loaded = view.load_buffer (buffer.toRawUTF8(), (size_t) buffer.length(), chunk);
+        const auto status = static_cast<sol::load_status> (bytecode->load (L, buffer, chunk.c_str()));
+        loaded = sol::load_result (L, lua_absindex (L, -1), 1, 1, status);
         switch (loaded.status())
         {
             case sol::load_status::file:
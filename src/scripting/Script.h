@@ -17,6 +17,7 @@
     Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include "scripting/LuaBytecodeCache.h"
 #include "scripting/ScriptDescription.h"
 #include "sol/sol.hpp"
 
@@ -90,6 +91,7 @@ private:
     bool hasloaded  = false;
     sol::load_result loaded;
     String error;
+    SharedResourcePointer<LuaBytecodeCache> bytecode;
 
     template<typename ...Args>
     sol::reference execute (const sol::environment& e, Args&& ...args)
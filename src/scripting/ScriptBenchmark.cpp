@@ -0,0 +1,161 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "sol/sol.hpp"
+#include "controllers/GraphManager.h"
+#include "scripting/LuaBindings.h"
+#include "scripting/ScriptBenchmark.h"
+#include "session/GraphBuilder.h"
+#include "Globals.h"
+
+namespace Element {
+
+ScriptBenchmark::ScriptBenchmark (Globals& g)
+    : world (g) { }
+
+ScriptBenchmark::~ScriptBenchmark() { }
+
+Result ScriptBenchmark::run (const File& script, const Options& options)
+{
+    if (! script.existsAsFile())
+        return Result::fail ("script not found: " + script.getFullPathName());
+    return run (script.loadFileAsString(), options);
+}
+
+Result ScriptBenchmark::run (const String& code, const Options& options)
+{
+    timings.clearQuick();
+    errors.clearQuick();
+    totalMs = 0.0;
+    lastOptions = options;
+
+    if (options.numBlocks <= 0 || options.blockSize <= 0 || options.sampleRate <= 0.0)
+        return Result::fail ("invalid benchmark options");
+
+    sol::state lua;
+    Lua::initializeState (lua, world);
+
+    GraphBuilder builder;
+    std::vector<sol::object> keys;
+    {
+        auto result = lua.safe_script (code.toStdString(), sol::script_pass_on_error);
+        if (! result.valid())
+        {
+            sol::error e = result;
+            return Result::fail (e.what());
+        }
+
+        if (result.get_type() != sol::type::table)
+            return Result::fail ("the script must return a table of nodes and connections");
+
+        const auto error = Lua::fillGraphBuilder (result.get<sol::table>(), builder, keys);
+        if (error.isNotEmpty())
+            return Result::fail (error);
+    }
+
+    GraphProcessor graph;
+    graph.setPlayConfigDetails (options.numChannels, options.numChannels,
+                                options.sampleRate, options.blockSize);
+    graph.prepareToPlay (options.sampleRate, options.blockSize);
+
+    {
+        GraphManager manager (graph, world.getPluginManager());
+        manager.setNodeModel (Node::createGraph ("Benchmark"));
+        builder.build (manager);
+        errors = builder.getErrors();
+        graph.handleUpdateNowIfNeeded();
+
+        for (int i = 0; i < graph.getNumNodes(); ++i)
+            graph.getNode(i)->resetRenderTime();
+
+        AudioSampleBuffer audio (jmax (1, options.numChannels), options.blockSize);
+        MidiBuffer midi;
+        graph.setProfilingEnabled (true);
+
+        const auto start = Time::getHighResolutionTicks();
+        for (int block = 0; block < options.numBlocks; ++block)
+        {
+            audio.clear();
+            midi.clear();
+            graph.processBlock (audio, midi);
+        }
+
+        totalMs = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1000.0;
+        graph.setProfilingEnabled (false);
+
+        for (int i = 0; i < graph.getNumNodes(); ++i)
+        {
+            NodeObjectPtr node = graph.getNode (i);
+            NodeTiming timing;
+            timing.nodeId       = node->nodeId;
+            timing.name         = manager.getNodeModelForId (node->nodeId).getName();
+            timing.numBlocks    = node->getNumRenders();
+            timing.totalMs      = Time::highResolutionTicksToSeconds (node->getRenderTicks()) * 1000.0;
+            timing.averageUs    = timing.numBlocks > 0 ? timing.totalMs * 1000.0 / (double) timing.numBlocks : 0.0;
+            timings.add (timing);
+        }
+
+        manager.clear();
+    }
+
+    graph.releaseResources();
+    graph.clear();
+
+    struct SlowestFirst
+    {
+        static int compareElements (const NodeTiming& a, const NodeTiming& b)
+        {
+            return a.totalMs > b.totalMs ? -1 : (a.totalMs < b.totalMs ? 1 : 0);
+        }
+    } sorter;
+    timings.sort (sorter, true);
+
+    return Result::ok();
+}
+
+String ScriptBenchmark::createReport() const
+{
+    const double blockMs  = 1000.0 * (double) lastOptions.blockSize / lastOptions.sampleRate;
+    const double averageMs = lastOptions.numBlocks > 0 ? totalMs / (double) lastOptions.numBlocks : 0.0;
+
+    String report;
+    report << "Benchmark: " << lastOptions.numBlocks << " blocks of " << lastOptions.blockSize
+           << " samples at " << String (lastOptions.sampleRate, 0) << " Hz" << newLine
+           << "Graph: " << String (totalMs, 3) << " ms total, "
+           << String (averageMs * 1000.0, 2) << " us per block, "
+           << String (blockMs > 0.0 ? 100.0 * averageMs / blockMs : 0.0, 2) << "% of real time" << newLine
+           << newLine
+           << "    id  avg us      total ms    % graph  name" << newLine;
+
+    for (const auto& timing : timings)
+    {
+        report << String ((int) timing.nodeId).paddedLeft (' ', 6) << "  "
+               << String (timing.averageUs, 2).paddedRight (' ', 10) << "  "
+               << String (timing.totalMs, 3).paddedRight (' ', 10) << "  "
+               << String (totalMs > 0.0 ? 100.0 * timing.totalMs / totalMs : 0.0, 1).paddedRight (' ', 7) << "  "
+               << timing.name << newLine;
+    }
+
+    for (const auto& error : errors)
+        report << "error: " << error << newLine;
+
+    return report;
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+class Globals;
+
+/** Renders a graph built by a Lua script offline and times every node.
+
+    The script returns a table of nodes and connections in the form
+    Node:build takes. The graph is built in one batch, rendered for a
+    number of blocks without an audio device, and each node's render time
+    is collected. Used by the --benchmark command line option.
+ */
+class ScriptBenchmark
+{
+public:
+    struct Options
+    {
+        int numBlocks       = 1000;
+        int blockSize       = 512;
+        double sampleRate   = 44100.0;
+        int numChannels     = 2;
+    };
+
+    struct NodeTiming
+    {
+        uint32 nodeId       = 0;
+        String name;
+        int64 numBlocks     = 0;
+        /** Total time spent rendering in milliseconds */
+        double totalMs      = 0.0;
+        /** Average time per block in microseconds */
+        double averageUs    = 0.0;
+    };
+
+    explicit ScriptBenchmark (Globals& world);
+    ~ScriptBenchmark();
+
+    /** Runs a script file */
+    Result run (const File& script, const Options& options);
+
+    /** Runs Lua code */
+    Result run (const String& code, const Options& options);
+
+    /** Returns per node timings of the last run, slowest first */
+    const Array<NodeTiming>& getNodeTimings() const noexcept { return timings; }
+
+    /** Returns the time the whole graph took in the last run */
+    double getTotalMilliseconds() const noexcept { return totalMs; }
+
+    /** Returns the nodes and connections the last run couldn't create */
+    const StringArray& getErrors() const noexcept { return errors; }
+
+    /** Returns a plain text table of the last run */
+    String createReport() const;
+
+private:
+    Globals& world;
+    Options lastOptions;
+    Array<NodeTiming> timings;
+    StringArray errors;
+    double totalMs = 0.0;
+};
+
+}
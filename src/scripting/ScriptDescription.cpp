@@ -23,20 +23,20 @@
 
 namespace Element {
 
-static ScriptDescription parseScriptComments (const String& buffer)
+/** Reads the tags from a script's leading comments, one line at a time */
+class CommentParser
 {
-    static const StringArray tags = { "@author", "@script", "@description", "@kind" };
+public:
+    CommentParser() { desc.type = ""; }
 
-    ScriptDescription desc;
-    desc.type = "";
-    const auto lines = StringArray::fromLines (buffer);
-    int index = 0;
-    bool inBlock = false;
-    bool finished = false;
-    for (index = 0; index < lines.size(); ++index)
+    /** Adds a line, returns false once the comments are over */
+    bool addLine (const String& text)
     {
-        const auto line = lines[index].trim();
-        
+        static const StringArray tags = { "@author", "@script", "@description", "@kind" };
+
+        const auto line = text.trim();
+        bool finished = false;
+
         if (! inBlock)
             inBlock = line.startsWith ("--[[");
         
@@ -49,8 +49,6 @@ static ScriptDescription parseScriptComments (const String& buffer)
                     const auto value = line.fromFirstOccurrenceOf (tag, false, false).trimStart()
                                            .upToFirstOccurrenceOf ("--]]", false, false).trimEnd();
                     
-                    // DBG (tag.replace("@","") << " = " << value);
-                    
                     if (tag == "@kind" && desc.type.isEmpty())
                     {
                         desc.type = value.fromLastOccurrenceOf(".", false, false);
@@ -76,19 +74,37 @@ static ScriptDescription parseScriptComments (const String& buffer)
                 finished = ! inBlock;
             }
         }
-        else if (! inBlock && ! line.startsWith ("--"))
+        else
         {
             finished = true;
         }
 
-        if (finished) {
-            // DBG("finihed at line index: " << index);
-            // DBG("LINE: " << lines[index]);
-            break;
-        }
+        return ! finished;
     }
 
-    return desc;
+    ScriptDescription desc;
+
+private:
+    bool inBlock = false;
+};
+
+static ScriptDescription parseScriptComments (const String& buffer)
+{
+    CommentParser parser;
+    for (const auto& line : StringArray::fromLines (buffer))
+        if (! parser.addLine (line))
+            break;
+    return parser.desc;
+}
+
+/** Only reads as far as the end of the leading comments */
+static ScriptDescription parseScriptComments (File file)
+{
+    CommentParser parser;
+    FileInputStream stream (file);
+    if (stream.openedOk())
+        while (! stream.isExhausted() && parser.addLine (stream.readNextLine())) {}
+    return parser.desc;
 }
 
 ScriptDescription ScriptDescription::read (lua_State* L, const String& buffer)
@@ -140,7 +156,7 @@ ScriptDescription ScriptDescription::parse (File file) {
 
     if (file.existsAsFile())
     {
-        desc = parseScriptComments (file.loadFileAsString());
+        desc = parseScriptComments (file);
         desc.source = URL(file).toString (false);
     }
 
@@ -0,0 +1,327 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "engine/DSPKernels.h"
+#include "engine/MidiPipe.h"
+#include "engine/ObjectExchange.h"
+
+namespace Element {
+
+/** The thread scripts are compiled on, shared by every script node */
+class ScriptBuildPool : public ThreadPool
+{
+public:
+    ScriptBuildPool() : ThreadPool (1) { }
+};
+
+/** Replaces the Lua state a script node renders with, without locking or
+    glitching.
+
+    New contexts are built on a background thread by buildAsync(), or on
+    the calling thread, and installed from the message thread. The audio
+    thread picks them up at the start of a block and crossfades from the
+    old context's output to the new one's. Old contexts are deleted on the
+    message thread.
+
+    ContextType needs a `bool render (AudioSampleBuffer&, MidiPipe&) noexcept`
+    which returns false when its output should be discarded.
+ */
+template<class ContextType>
+class ScriptHotSwap : private AsyncUpdater,
+                      private Timer
+{
+public:
+    using ContextPtr = std::unique_ptr<ContextType>;
+
+    /** Builds a context, called on the build thread */
+    using BuildFunction = std::function<Result (ContextPtr&)>;
+
+    /** Receives a finished build on the message thread */
+    using LoadedFunction = std::function<void (Result, ContextPtr)>;
+
+    explicit ScriptHotSwap (ContextPtr initial)
+    {
+        latest = active = initial.release();
+        for (int i = 0; i < maxMidiBuffers; ++i)
+            scratchMidi.add (new MidiBuffer());
+    }
+
+    ~ScriptHotSwap()
+    {
+        stopTimer();
+        // a running job refers to this and can't be freed, so wait for it
+        // however long it takes
+        for (auto* job : jobs)
+            pool->removeJob (job, true, -1);
+        cancelPendingUpdate();
+        jobs.clear();
+
+        if (auto* next = exchange.acquire())
+            delete next;
+        delete outgoing;
+        delete active;
+    }
+
+    //==========================================================================
+    /** Returns the newest installed context. Message thread only */
+    ContextType* getLatest() const noexcept { return latest; }
+
+    /** Installs a context, the audio thread switches to it at its next
+        block. If not prepared it's switched to immediately.
+     */
+    void install (ContextPtr context)
+    {
+        ++generation;
+        latest = context.get();
+        exchange.publish (std::move (context));
+        if (prepared)
+            startTimer (250);
+        else
+            adoptLatest();
+    }
+
+    /** Builds a context on the build thread. When it finishes loaded is
+        called on the message thread, unless another build or install was
+        started in the meantime.
+     */
+    void buildAsync (BuildFunction build, LoadedFunction loaded)
+    {
+        auto* job = new BuildJob (*this, ++generation, std::move (build), std::move (loaded));
+        jobs.add (job);
+        pool->addJob (job, false);
+    }
+
+    /** Returns true while a build started by buildAsync() is running */
+    bool isBuilding() const
+    {
+        for (auto* job : jobs)
+            if (! job->hasFinished())
+                return true;
+        return false;
+    }
+
+    /** Call when the node is prepared, while it isn't rendering. Switches
+        to the latest context immediately and sizes the crossfade buffers.
+     */
+    void prepare (double sampleRate, int blockSize, int numChannels)
+    {
+        adoptLatest();
+        scratch.setSize (jmax (1, numChannels), blockSize, false, false, true);
+        for (auto* buffer : scratchMidi)
+            buffer->ensureSize (2048);
+        fadeLength = jmax (1, roundToInt (sampleRate * 0.01));
+        prepared = true;
+    }
+
+    /** Call when the node is released, while it isn't rendering */
+    void release()
+    {
+        adoptLatest();
+        prepared = false;
+        stopTimer();
+    }
+
+    //==========================================================================
+    /** Renders the current context, crossfading if it was just replaced.
+        Returns false if the output should be discarded.
+     */
+    bool render (AudioSampleBuffer& audio, MidiPipe& midi) noexcept
+    {
+        if (auto* next = exchange.acquire())
+        {
+            if (active != nullptr && prepared)
+            {
+                // a fade still running is cut short
+                exchange.retire (outgoing);
+                outgoing = active;
+                fadePosition = 0;
+                fading.store (true);
+            }
+            else
+            {
+                exchange.retire (active);
+            }
+
+            active = next;
+        }
+
+        if (active == nullptr)
+            return false;
+
+        const int numSamples = audio.getNumSamples();
+        if (outgoing != nullptr && numSamples > scratch.getNumSamples())
+            finishFade();
+
+        if (outgoing == nullptr)
+            return active->render (audio, midi);
+
+        // the old context renders a copy of the input and receives the same
+        // MIDI, its MIDI output is dropped
+        const int numChannels = jmin (audio.getNumChannels(), scratch.getNumChannels());
+        for (int ch = 0; ch < numChannels; ++ch)
+            scratch.copyFrom (ch, 0, audio, ch, 0, numSamples);
+        AudioSampleBuffer outgoingAudio (scratch.getArrayOfWritePointers(), numChannels, numSamples);
+
+        MidiBuffer* midiBuffers [maxMidiBuffers];
+        const int numMidi = jmin (midi.getNumBuffers(), (int) maxMidiBuffers);
+        for (int i = 0; i < numMidi; ++i)
+        {
+            midiBuffers[i] = scratchMidi.getUnchecked (i);
+            midiBuffers[i]->clear();
+            midiBuffers[i]->addEvents (*midi.getReadBuffer (i), 0, numSamples, 0);
+        }
+        MidiPipe outgoingMidi (midiBuffers, numMidi);
+
+        const bool outgoingOk = outgoing->render (outgoingAudio, outgoingMidi);
+        const bool ok = active->render (audio, midi);
+
+        const int numFaded = jmin (numSamples, fadeLength - fadePosition);
+        const float start = (float) fadePosition / (float) fadeLength;
+        const float end   = (float) (fadePosition + numFaded) / (float) fadeLength;
+        for (int ch = 0; ch < audio.getNumChannels(); ++ch)
+        {
+            DSP::applyRamp (audio.getWritePointer (ch), numFaded, start, end);
+            if (outgoingOk && ch < numChannels)
+                DSP::addWithRamp (audio.getWritePointer (ch), scratch.getReadPointer (ch),
+                                  numFaded, 1.f - start, 1.f - end);
+        }
+
+        fadePosition += numFaded;
+        if (fadePosition >= fadeLength)
+            finishFade();
+
+        return ok;
+    }
+
+private:
+    enum { maxMidiBuffers = 4 };
+
+    class BuildJob : public ThreadPoolJob
+    {
+    public:
+        BuildJob (ScriptHotSwap& o, int g, BuildFunction b, LoadedFunction l)
+            : ThreadPoolJob ("Script Build"), owner (o), generation (g),
+              build (std::move (b)), loaded (std::move (l)) { }
+
+        JobStatus runJob() override
+        {
+            try
+            {
+                result = build (context);
+            }
+            catch (const std::exception& e)
+            {
+                result = Result::fail (e.what());
+            }
+
+            if (result.failed())
+                context.reset();
+            done.set (1);
+            owner.triggerAsyncUpdate();
+            return jobHasFinished;
+        }
+
+        bool hasFinished() const noexcept { return done.get() != 0; }
+
+    private:
+        friend class ScriptHotSwap;
+        ScriptHotSwap& owner;
+        const int generation;
+        BuildFunction build;
+        LoadedFunction loaded;
+        Result result { Result::ok() };
+        ContextPtr context;
+        Atomic<int> done { 0 };
+    };
+
+    SharedResourcePointer<ScriptBuildPool> pool;
+    OwnedArray<BuildJob> jobs;
+    int generation = 0;
+
+    ObjectExchange<ContextType> exchange;
+    ContextType* latest = nullptr;
+    ContextType* active = nullptr;
+    ContextType* outgoing = nullptr;
+    bool prepared = false;
+    std::atomic<bool> fading { false };
+
+    AudioSampleBuffer scratch;
+    OwnedArray<MidiBuffer> scratchMidi;
+    int fadeLength = 1, fadePosition = 0;
+
+    void finishFade() noexcept
+    {
+        exchange.retire (outgoing);
+        outgoing = nullptr;
+        fading.store (false);
+    }
+
+    void adoptLatest()
+    {
+        if (auto* next = exchange.acquire())
+        {
+            delete active;
+            active = next;
+        }
+
+        delete outgoing;
+        outgoing = nullptr;
+        fading.store (false);
+        exchange.collectGarbage();
+    }
+
+    void handleAsyncUpdate() override
+    {
+        // only the newest request is installed, older ones were superseded
+        std::unique_ptr<BuildJob> newest;
+        for (int i = jobs.size(); --i >= 0;)
+        {
+            if (! jobs.getUnchecked (i)->hasFinished())
+                continue;
+            // the pool may still be detaching it, try again later if so
+            if (! pool->waitForJobToFinish (jobs.getUnchecked (i), 1000))
+            {
+                triggerAsyncUpdate();
+                continue;
+            }
+
+            std::unique_ptr<BuildJob> job (jobs.removeAndReturn (i));
+            if (job->generation == generation)
+                newest = std::move (job);
+        }
+
+        if (newest != nullptr && newest->loaded)
+            newest->loaded (newest->result, std::move (newest->context));
+    }
+
+    void timerCallback() override
+    {
+        exchange.collectGarbage();
+        // fading is checked first, a fade ends by retiring before clearing it
+        if (! fading.load() && exchange.getNumRetired() <= 0 && ! exchange.hasPending())
+            stopTimer();
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (ScriptHotSwap)
+};
+
+}
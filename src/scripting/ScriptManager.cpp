@@ -26,23 +26,114 @@
 
 namespace Element {
 
-static void scanForScripts (File dir, Array<ScriptDescription>& results, bool recursive = true)
+struct ScriptIndexEntry
 {
-    for (DirectoryEntry entry : RangedDirectoryIterator (dir, recursive, "*.lua"))
+    int64 modified = 0;
+    int64 size = 0;
+    ScriptDescription desc;
+};
+
+/** Script metadata keyed by full path. Invalid scripts are kept too, so
+    they aren't read again until they change.
+ */
+using ScriptIndex = std::map<String, ScriptIndexEntry>;
+
+/** Indexes the scripts in a directory. Files whose modification time and
+    size match the previous index aren't read. Returns false if the thread
+    was asked to exit before it finished.
+ */
+static bool scanForScripts (const File& dir, const ScriptIndex& previous, ScriptIndex& results,
+                            int& numParsed, Thread* thread = nullptr)
+{
+    numParsed = 0;
+    if (! dir.isDirectory())
+        return true;
+
+    for (const auto& entry : RangedDirectoryIterator (dir, true, "*.lua"))
     {
-        ScriptDescription desc;
+        if (thread != nullptr && thread->threadShouldExit())
+            return false;
+
+        const auto file = entry.getFile();
+        const auto path = file.getFullPathName();
+        const auto modified = entry.getModificationTime().toMilliseconds();
+        const auto size = entry.getFileSize();
+
+        const auto iter = previous.find (path);
+        if (iter != previous.end() && iter->second.modified == modified && iter->second.size == size)
+        {
+            results[path] = iter->second;
+            continue;
+        }
+
+        ScriptIndexEntry item;
+        item.modified = modified;
+        item.size = size;
         try {
-            desc = ScriptDescription::parse (entry.getFile());
+            item.desc = ScriptDescription::parse (file);
         } catch (const std::exception& e) {
             DBG (e.what());
-            desc = {};
+            item.desc = {};
         }
 
-        if (desc.isValid())
-        {
-            results.add (desc);
-        }
+        results[path] = item;
+        ++numParsed;
     }
+
+    return true;
+}
+
+static bool sameFiles (const ScriptIndex& a, const ScriptIndex& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (auto i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j)
+        if (i->first != j->first || i->second.modified != j->second.modified || i->second.size != j->second.size)
+            return false;
+    return true;
+}
+
+static ScriptIndex readIndex (const File& file)
+{
+    ScriptIndex index;
+    auto xml = XmlDocument::parse (file);
+    if (xml == nullptr || ! xml->hasTagName ("scripts"))
+        return index;
+
+    forEachXmlChildElementWithTagName (*xml, e, "script")
+    {
+        ScriptIndexEntry item;
+        item.modified           = e->getStringAttribute ("modified").getLargeIntValue();
+        item.size               = e->getStringAttribute ("size").getLargeIntValue();
+        item.desc.name          = e->getStringAttribute ("name");
+        item.desc.type          = e->getStringAttribute ("type");
+        item.desc.author        = e->getStringAttribute ("author");
+        item.desc.description   = e->getStringAttribute ("description");
+        item.desc.source        = e->getStringAttribute ("source");
+        index[e->getStringAttribute ("path")] = item;
+    }
+
+    return index;
+}
+
+static bool writeIndex (const ScriptIndex& index, const File& file)
+{
+    XmlElement xml ("scripts");
+    xml.setAttribute ("version", 1);
+    for (const auto& iter : index)
+    {
+        auto* e = xml.createNewChildElement ("script");
+        e->setAttribute ("path",        iter.first);
+        e->setAttribute ("modified",    String (iter.second.modified));
+        e->setAttribute ("size",        String (iter.second.size));
+        e->setAttribute ("name",        iter.second.desc.name);
+        e->setAttribute ("type",        iter.second.desc.type);
+        e->setAttribute ("author",      iter.second.desc.author);
+        e->setAttribute ("description", iter.second.desc.description);
+        e->setAttribute ("source",      iter.second.desc.source);
+    }
+
+    return xml.writeTo (file);
 }
 
 static File getDefaultScriptsDir()
@@ -55,22 +146,166 @@ static File getDefaultScriptsDir()
 }
 
 //==============================================================================
-class ScriptManager::Registry
+class ScriptManager::Registry : public Thread,
+                                private AsyncUpdater
 {
 public:
     Registry (ScriptManager& sm)
-        : owner (sm) {}
+        : Thread ("Script Scanner"), owner (sm) {}
 
-    void scanDefaults()
+    ~Registry()
     {
-        Array<ScriptDescription> results;
-        scanForScripts (getDefaultScriptsDir(), results);
-        Array<ScriptDescription> newDSP;
-        Array<ScriptDescription> newDSPUI;
-        
-        for (int i = 0; i < results.size(); ++i)
+        stopThread (5000);
+        cancelPendingUpdate();
+    }
+
+    void setIndexFile (const File& file)
+    {
+        indexFile = file;
+        auto loaded = indexFile.existsAsFile() ? readIndex (indexFile) : ScriptIndex();
+        ScopedLock sl (lock);
+        index = std::move (loaded);
+    }
+
+    void scan (const File& dir)
+    {
+        {
+            ScopedLock sl (lock);
+            directory = dir;
+        }
+
+        ScriptIndex results;
+        int parsed = 0;
+        scanForScripts (dir, getIndex(), results, parsed);
+        apply (results, parsed);
+    }
+
+    void scanAsync (const File& dir)
+    {
+        {
+            ScopedLock sl (lock);
+            directory = dir;
+            scanRequested = true;
+        }
+
+        if (! isThreadRunning())
+            startThread (3);
+        notify();
+    }
+
+    void setWatching (bool shouldWatch, int intervalMs)
+    {
+        {
+            ScopedLock sl (lock);
+            watchInterval = shouldWatch ? jmax (100, intervalMs) : 0;
+        }
+
+        if (shouldWatch && ! isThreadRunning())
+            startThread (3);
+        notify();
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            bool requested, shouldScan;
+            File dir;
+            int interval;
+            {
+                ScopedLock sl (lock);
+                requested = scanRequested;
+                scanRequested = false;
+                dir = directory;
+                interval = watchInterval;
+                shouldScan = scanning = requested || (interval > 0 && dir != File());
+            }
+
+            if (shouldScan)
+            {
+                ScriptIndex results;
+                int parsed = 0;
+                if (scanForScripts (dir, getIndex(), results, parsed, this)
+                    && (requested || parsed > 0 || ! sameFiles (results, getIndex())))
+                {
+                    ScopedLock sl (lock);
+                    pending = std::move (results);
+                    pendingParsed = parsed;
+                    hasPending = true;
+                    triggerAsyncUpdate();
+                }
+
+                ScopedLock sl (lock);
+                scanning = false;
+            }
+
+            wait (interval > 0 ? interval : -1);
+        }
+    }
+
+    ScriptIndex getIndex() const
+    {
+        ScopedLock sl (lock);
+        return index;
+    }
+
+private:
+    friend class ScriptManager;
+    ScriptManager& owner;
+    Array<ScriptDescription> scripts;
+    Array<ScriptDescription> dsp, dspui;
+    bool listed = false;
+    File indexFile;
+
+    CriticalSection lock;
+    ScriptIndex index, pending;
+    File directory;
+    bool scanRequested = false, hasPending = false;
+    int watchInterval = 0;
+    int numParsed = 0, pendingParsed = 0;
+    bool scanning = false;
+
+    bool isScanning() const
+    {
+        ScopedLock sl (lock);
+        return scanRequested || scanning;
+    }
+
+    void handleAsyncUpdate() override
+    {
+        ScriptIndex results;
+        int parsed = 0;
+        {
+            ScopedLock sl (lock);
+            if (! hasPending)
+                return;
+            results = std::move (pending);
+            pending.clear();
+            parsed = pendingParsed;
+            hasPending = false;
+        }
+
+        apply (results, parsed);
+    }
+
+    void apply (const ScriptIndex& results, int parsed)
+    {
+        bool changed;
         {
-            const auto d = results [i];
+            ScopedLock sl (lock);
+            changed = parsed > 0 || ! sameFiles (results, index);
+            index = results;
+            numParsed = parsed;
+        }
+
+        Array<ScriptDescription> newScripts, newDSP, newDSPUI;
+        for (const auto& iter : results)
+        {
+            const auto& d = iter.second.desc;
+            if (! d.isValid())
+                continue;
+
+            newScripts.add (d);
             if (d.type.toLowerCase() == "dsp")
             {
                 newDSP.add (d);
@@ -81,16 +316,16 @@ public:
             }
         }
         
-        scripts.swapWith (results);
+        scripts.swapWith (newScripts);
         dsp.swapWith (newDSP);
         dspui.swapWith (newDSPUI);
-    }
 
-private:
-    friend class ScriptManager;
-    ScriptManager& owner;
-    Array<ScriptDescription> scripts;
-    Array<ScriptDescription> dsp, dspui;
+        if (changed && indexFile != File())
+            writeIndex (results, indexFile);
+        if (changed || ! listed)
+            owner.sendChangeMessage();
+        listed = true;
+    }
 };
 
 //==============================================================================
@@ -99,11 +334,55 @@ ScriptManager::ScriptManager()
     registry.reset (new Registry (*this));
 }
 
-ScriptManager::~ScriptManager() {}
+ScriptManager::~ScriptManager()
+{
+    registry.reset();
+}
+
+void ScriptManager::setIndexFile (const File& file)
+{
+    registry->setIndexFile (file);
+}
+
+File ScriptManager::getIndexFile() const
+{
+    return registry->indexFile;
+}
 
 void ScriptManager::scanDefaultLocation()
 {
-    registry->scanDefaults();
+    registry->scan (getDefaultScriptsDir());
+}
+
+void ScriptManager::scanDefaultLocationAsync()
+{
+    registry->scanAsync (getDefaultScriptsDir());
+}
+
+void ScriptManager::scanDirectory (const File& directory)
+{
+    registry->scan (directory);
+}
+
+void ScriptManager::scanDirectoryAsync (const File& directory)
+{
+    registry->scanAsync (directory);
+}
+
+bool ScriptManager::isScanning() const
+{
+    return registry->isScanning();
+}
+
+void ScriptManager::setWatchingEnabled (bool shouldWatch, int intervalMs)
+{
+    registry->setWatching (shouldWatch, intervalMs);
+}
+
+int ScriptManager::getNumFilesParsed() const
+{
+    ScopedLock sl (registry->lock);
+    return registry->numParsed;
 }
 
 int ScriptManager::getNumScripts() const
@@ -25,14 +25,55 @@ namespace Element {
 
 using ScriptArray = Array<ScriptDescription>;
 
-class ScriptManager final
+/** Keeps track of the scripts installed on disk.
+
+    Script metadata is indexed by path, modification time and size, so a
+    rescan only reads the headers of files that were added or changed. The
+    index can be saved to a file and is reloaded from it on the next run.
+    Scans can run on a background thread, listeners get a change message on
+    the message thread when the list of scripts changed.
+ */
+class ScriptManager final : public ChangeBroadcaster
 {
 public:
     ScriptManager();
     ~ScriptManager();
 
+    /** Sets the file the index is kept in, and loads it. Pass an empty file
+        to keep the index in memory only.
+     */
+    void setIndexFile (const File& file);
+
+    /** Returns the file the index is kept in */
+    File getIndexFile() const;
+
+    /** Scans the default location on the calling thread */
     void scanDefaultLocation();
-    
+
+    /** Scans the default location on a background thread */
+    void scanDefaultLocationAsync();
+
+    /** Scans a directory on the calling thread, replacing the current list */
+    void scanDirectory (const File& directory);
+
+    /** Scans a directory on a background thread, replacing the current list
+        when it finishes
+     */
+    void scanDirectoryAsync (const File& directory);
+
+    /** Returns true while a background scan is running */
+    bool isScanning() const;
+
+    /** When enabled the last scanned directory is rescanned periodically in
+        the background, changed files are picked up without a restart.
+     */
+    void setWatchingEnabled (bool shouldWatch, int intervalMs = 2000);
+
+    /** Returns the number of files whose headers were read during the last
+        scan. Unchanged files come from the index and aren't counted.
+     */
+    int getNumFilesParsed() const;
+
     int getNumScripts() const;
     ScriptDescription getScript (int) const;
 
@@ -21,6 +21,7 @@
 #include "scripting/ScriptingEngine.h"
 #include "scripting/ScriptManager.h"
 #include "scripting/LuaBindings.h"
+#include "DataPath.h"
 #include "Globals.h"
 
 #ifndef EL_LUA_SPATH
@@ -84,6 +85,11 @@ void ScriptingEngine::initialize (Globals& g)
     world = &g;
     Lua::setGlobals (lua, g);
     lua.set_exception_handler (LuaHelpers::exceptionHandler);
+
+    // unchanged scripts come from the index, the rest are read in the background
+    auto& manager = impl->manager;
+    manager.setIndexFile (DataPath::applicationDataDir().getChildFile ("ScriptIndex.xml"));
+    manager.scanDefaultLocationAsync();
 }
 
 ScriptManager& ScriptingEngine::getScriptManager()
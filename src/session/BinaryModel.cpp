@@ -0,0 +1,721 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/BinaryModel.h"
+#include "session/Node.h"
+#include "session/Session.h"
+#include "session/SessionArchive.h"
+
+#define EL_BINARY_MODEL_MAGIC           "ELBM"
+#define EL_BINARY_MODEL_VERSION         1
+// binary properties at least this big are compressed
+#define EL_BINARY_MODEL_COMPRESS_SIZE   4096
+#define EL_BINARY_MODEL_COMPRESSION     1
+// deflate can't expand data more than about 1032 to 1
+#define EL_BINARY_MODEL_MAX_RATIO       1040
+// largest state decompressed, also keeps sizes readable as an int
+#define EL_BINARY_MODEL_MAX_STATE_SIZE  (1024 * 1024 * 1024)
+
+namespace Element {
+
+enum BinaryModelKind
+{
+    modelVoid = 0,
+    modelInt,
+    modelInt64,
+    modelFalse,
+    modelTrue,
+    modelDouble,
+    modelString,
+    modelBinary,
+    modelCompressed,
+    modelArray
+};
+
+//=============================================================================
+CompressedState::CompressedState (MemoryBlock data, int64 size, const String& md5)
+    : compressed (std::move (data)), rawSize (size), hash (md5) { }
+
+bool CompressedState::decompress (MemoryBlock& data) const
+{
+    if (! isPlausibleSize (rawSize, (int64) compressed.getSize()))
+        return false;
+
+    MemoryInputStream input (compressed, false);
+    GZIPDecompressorInputStream gzip (input);
+    data.setSize ((size_t) rawSize);
+    if (gzip.read (data.getData(), (int) rawSize) == (int) rawSize)
+        return true;
+    data.reset();
+    return false;
+}
+
+bool CompressedState::isPlausibleSize (int64 rawSize, int64 compressedSize) noexcept
+{
+    return rawSize > 0 && compressedSize > 0
+        && rawSize <= (int64) EL_BINARY_MODEL_MAX_STATE_SIZE
+        && rawSize <= compressedSize * EL_BINARY_MODEL_MAX_RATIO + 1024;
+}
+
+CompressedState* CompressedState::fromVar (const var& value)
+{
+    return dynamic_cast<CompressedState*> (value.getObject());
+}
+
+//=============================================================================
+/* Strings that are plain integers are stored as integers */
+static bool isPlainInteger (const String& text)
+{
+    const int length = text.length();
+    if (length == 0 || length > 11)
+        return false;
+    auto t = text.getCharPointer();
+    if (*t == '-')
+        ++t;
+    if (! t.isDigit())
+        return false;
+    for (; ! t.isEmpty(); ++t)
+        if (! t.isDigit())
+            return false;
+    return String (text.getIntValue()) == text;
+}
+
+static bool isStateProperty (const Identifier& name)
+{
+    return name == Tags::state || name == Tags::programState;
+}
+
+static void writeModelVarint (MemoryOutputStream& output, uint64 value)
+{
+    do {
+        uint8 byte = (uint8) (value & 0x7f);
+        value >>= 7;
+        if (value != 0)
+            byte |= 0x80;
+        output.writeByte ((char) byte);
+    } while (value != 0);
+}
+
+static uint64 zigzagEncode (int64 value)    { return ((uint64) value << 1) ^ (uint64) (value >> 63); }
+static int64 zigzagDecode (uint64 value)    { return (int64) (value >> 1) ^ -(int64) (value & 1); }
+
+static void patchModelSize (MemoryOutputStream& output, int64 sizePosition)
+{
+    const auto end = output.getPosition();
+    output.setPosition (sizePosition);
+    output.writeInt ((int) (end - sizePosition - 4));
+    output.setPosition (end);
+}
+
+class BinaryModelWriter
+{
+public:
+    bool write (const ValueTree& tree, OutputStream& output)
+    {
+        collect (tree);
+
+        MemoryOutputStream data;
+        data.write (EL_BINARY_MODEL_MAGIC, 4);
+        data.writeInt (EL_BINARY_MODEL_VERSION);
+        for (const auto* table : { &identifiers, &strings })
+        {
+            writeModelVarint (data, (uint64) table->size());
+            for (const auto& text : *table)
+            {
+                const auto bytes = text.getNumBytesAsUTF8();
+                writeModelVarint (data, (uint64) bytes);
+                data.write (text.toRawUTF8(), bytes);
+            }
+        }
+
+        writeTree (tree, data);
+        return output.write (data.getData(), data.getDataSize());
+    }
+
+private:
+    StringArray identifiers, strings;
+    HashMap<String, int> identifierIndex, stringIndex;
+
+    static int add (const String& text, StringArray& table, HashMap<String, int>& index)
+    {
+        if (index.contains (text))
+            return index[text];
+        index.set (text, table.size());
+        table.add (text);
+        return table.size() - 1;
+    }
+
+    void collectValue (const var& value)
+    {
+        if (auto* array = value.getArray())
+        {
+            for (const auto& item : *array)
+                collectValue (item);
+        }
+        else if (value.isString() && ! isPlainInteger (value.toString()))
+        {
+            add (value.toString(), strings, stringIndex);
+        }
+    }
+
+    void collect (const ValueTree& tree)
+    {
+        add (tree.getType().toString(), identifiers, identifierIndex);
+        for (int i = 0; i < tree.getNumProperties(); ++i)
+        {
+            const auto name = tree.getPropertyName (i);
+            add (name.toString(), identifiers, identifierIndex);
+            collectValue (tree.getProperty (name));
+        }
+
+        for (int i = 0; i < tree.getNumChildren(); ++i)
+            collect (tree.getChild (i));
+    }
+
+    static void writeCompressed (MemoryOutputStream& output, const void* data, size_t size, int64 rawSize)
+    {
+        output.writeByte ((char) modelCompressed);
+        writeModelVarint (output, (uint64) rawSize);
+        writeModelVarint (output, (uint64) size);
+        output.write (data, size);
+    }
+
+    void writeValue (const var& value, MemoryOutputStream& output)
+    {
+        if (value.isBool())
+        {
+            output.writeByte ((char) ((bool) value ? modelTrue : modelFalse));
+        }
+        else if (value.isInt())
+        {
+            output.writeByte ((char) modelInt);
+            writeModelVarint (output, zigzagEncode ((int) value));
+        }
+        else if (value.isInt64())
+        {
+            output.writeByte ((char) modelInt64);
+            writeModelVarint (output, zigzagEncode ((int64) value));
+        }
+        else if (value.isDouble())
+        {
+            output.writeByte ((char) modelDouble);
+            output.writeDouble ((double) value);
+        }
+        else if (value.isString())
+        {
+            const auto text = value.toString();
+            if (isPlainInteger (text))
+            {
+                output.writeByte ((char) modelInt);
+                writeModelVarint (output, zigzagEncode (text.getIntValue()));
+            }
+            else
+            {
+                output.writeByte ((char) modelString);
+                writeModelVarint (output, (uint64) stringIndex[text]);
+            }
+        }
+        else if (auto* block = value.getBinaryData())
+        {
+            if (block->getSize() >= EL_BINARY_MODEL_COMPRESS_SIZE)
+            {
+                MemoryOutputStream compressed;
+                {
+                    GZIPCompressorOutputStream gzip (compressed, EL_BINARY_MODEL_COMPRESSION);
+                    gzip.write (block->getData(), block->getSize());
+                }
+
+                if (compressed.getDataSize() < block->getSize())
+                {
+                    writeCompressed (output, compressed.getData(), compressed.getDataSize(),
+                                     (int64) block->getSize());
+                    return;
+                }
+            }
+
+            output.writeByte ((char) modelBinary);
+            writeModelVarint (output, (uint64) block->getSize());
+            output.write (block->getData(), block->getSize());
+        }
+        else if (auto* state = CompressedState::fromVar (value))
+        {
+            const auto& data = state->getCompressedData();
+            writeCompressed (output, data.getData(), data.getSize(), state->getSize());
+        }
+        else if (auto* array = value.getArray())
+        {
+            output.writeByte ((char) modelArray);
+            writeModelVarint (output, (uint64) array->size());
+            for (const auto& item : *array)
+                writeValue (item, output);
+        }
+        else
+        {
+            // other objects and methods can't be stored
+            jassert (value.isVoid() || value.isUndefined());
+            output.writeByte ((char) modelVoid);
+        }
+    }
+
+    /* type, properties with their size, then children each with its size */
+    void writeTree (const ValueTree& tree, MemoryOutputStream& output)
+    {
+        writeModelVarint (output, (uint64) identifierIndex[tree.getType().toString()]);
+        writeModelVarint (output, (uint64) tree.getNumProperties());
+        auto sizePosition = output.getPosition();
+        output.writeInt (0);
+        for (int i = 0; i < tree.getNumProperties(); ++i)
+        {
+            const auto name = tree.getPropertyName (i);
+            writeModelVarint (output, (uint64) identifierIndex[name.toString()]);
+            writeValue (tree.getProperty (name), output);
+        }
+        patchModelSize (output, sizePosition);
+
+        writeModelVarint (output, (uint64) tree.getNumChildren());
+        for (int i = 0; i < tree.getNumChildren(); ++i)
+        {
+            sizePosition = output.getPosition();
+            output.writeInt (0);
+            writeTree (tree.getChild (i), output);
+            patchModelSize (output, sizePosition);
+        }
+    }
+};
+
+//=============================================================================
+/* Reads from a span of the model, failing instead of reading past the end */
+struct BinaryModelCursor
+{
+    BinaryModelCursor (const uint8* d, size_t s) : pos (d), end (d + s) { }
+
+    const uint8* pos;
+    const uint8* end;
+    bool failed = false;
+
+    size_t remaining() const noexcept { return (size_t) (end - pos); }
+
+    uint64 readVarint()
+    {
+        uint64 value = 0;
+        for (int shift = 0; shift < 64 && pos < end; shift += 7)
+        {
+            const uint8 byte = *pos++;
+            value |= (uint64) (byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+        failed = true;
+        return 0;
+    }
+
+    uint32 readUint32()
+    {
+        if (remaining() < 4)
+            return fail<uint32>();
+        const auto value = ByteOrder::littleEndianInt (pos);
+        pos += 4;
+        return value;
+    }
+
+    const uint8* skip (size_t numBytes)
+    {
+        if (remaining() < numBytes)
+            return fail<const uint8*>();
+        auto* start = pos;
+        pos += numBytes;
+        return start;
+    }
+
+    template<typename Type>
+    Type fail() { failed = true; pos = end; return Type(); }
+};
+
+/* Where the parts of an encoded tree are */
+struct BinaryModelLayout
+{
+    uint64 type = 0;
+    uint64 numProperties = 0;
+    const uint8* properties = nullptr;
+    size_t propertiesSize = 0;
+    uint64 numChildren = 0;
+    const uint8* children = nullptr;
+    size_t childrenSize = 0;
+
+    bool parse (const uint8* data, size_t size)
+    {
+        BinaryModelCursor cursor (data, size);
+        type            = cursor.readVarint();
+        numProperties   = cursor.readVarint();
+        propertiesSize  = cursor.readUint32();
+        properties      = cursor.skip (propertiesSize);
+        numChildren     = cursor.readVarint();
+        children        = cursor.pos;
+        childrenSize    = cursor.remaining();
+        return ! cursor.failed;
+    }
+};
+
+static bool readModelValue (BinaryModelCursor& cursor, const StringArray& strings,
+                            bool keepCompressed, var& value)
+{
+    const auto* kind = cursor.skip (1);
+    if (kind == nullptr)
+        return false;
+
+    switch (*kind)
+    {
+        case modelVoid:     value = var(); break;
+        case modelInt:      value = (int) zigzagDecode (cursor.readVarint()); break;
+        case modelInt64:    value = (int64) zigzagDecode (cursor.readVarint()); break;
+        case modelFalse:    value = false; break;
+        case modelTrue:     value = true; break;
+
+        case modelDouble:
+        {
+            // written by OutputStream::writeDouble, a little endian int64
+            if (auto* bytes = cursor.skip (8))
+            {
+                const auto bits = ByteOrder::littleEndianInt64 (bytes);
+                double number = 0.0;
+                memcpy (&number, &bits, sizeof (number));
+                value = number;
+            }
+        } break;
+
+        case modelString:
+        {
+            const auto index = cursor.readVarint();
+            if (index >= (uint64) strings.size())
+                return false;
+            value = strings.getReference ((int) index);
+        } break;
+
+        case modelBinary:
+        {
+            const auto size = (size_t) cursor.readVarint();
+            if (auto* bytes = cursor.skip (size))
+                value = var (bytes, size);
+        } break;
+
+        case modelCompressed:
+        {
+            const auto rawSize = (int64) cursor.readVarint();
+            const auto size    = (size_t) cursor.readVarint();
+            auto* bytes = cursor.skip (size);
+            if (bytes == nullptr)
+                break;
+
+            CompressedState::Ptr state = new CompressedState (MemoryBlock (bytes, size), rawSize);
+            if (keepCompressed)
+            {
+                value = var (state.get());
+            }
+            else
+            {
+                MemoryBlock data;
+                if (! state->decompress (data))
+                    return false;
+                value = var (std::move (data));
+            }
+        } break;
+
+        case modelArray:
+        {
+            const auto size = cursor.readVarint();
+            if (size > cursor.remaining())
+                return false;
+            Array<var> array;
+            array.ensureStorageAllocated ((int) size);
+            for (uint64 i = 0; i < size; ++i)
+            {
+                var item;
+                if (! readModelValue (cursor, strings, false, item))
+                    return false;
+                array.add (item);
+            }
+            value = array;
+        } break;
+
+        default:
+            return false;
+    }
+
+    return ! cursor.failed;
+}
+
+static bool readModelTree (const uint8* data, size_t size, const Array<Identifier>& identifiers,
+                           const StringArray& strings, bool lazyStates, ValueTree& tree)
+{
+    BinaryModelLayout layout;
+    if (! layout.parse (data, size) || layout.type >= (uint64) identifiers.size())
+        return false;
+
+    tree = ValueTree (identifiers.getReference ((int) layout.type));
+    const bool isNode = lazyStates && tree.hasType (Tags::node);
+
+    BinaryModelCursor properties (layout.properties, layout.propertiesSize);
+    for (uint64 i = 0; i < layout.numProperties; ++i)
+    {
+        const auto name = properties.readVarint();
+        if (name >= (uint64) identifiers.size())
+            return false;
+        const auto& identifier = identifiers.getReference ((int) name);
+        var value;
+        if (! readModelValue (properties, strings, isNode && isStateProperty (identifier), value))
+            return false;
+        tree.setProperty (identifier, value, nullptr);
+    }
+
+    BinaryModelCursor children (layout.children, layout.childrenSize);
+    for (uint64 i = 0; i < layout.numChildren; ++i)
+    {
+        const auto childSize = children.readUint32();
+        const auto* child = children.skip (childSize);
+        ValueTree childTree;
+        if (child == nullptr || ! readModelTree (child, childSize, identifiers, strings, lazyStates, childTree))
+            return false;
+        tree.appendChild (childTree, nullptr);
+    }
+
+    return true;
+}
+
+//=============================================================================
+Identifier BinaryModel::Subtree::getType() const
+{
+    BinaryModelLayout layout;
+    if (! isValid() || ! layout.parse (data, size) || layout.type >= (uint64) model->identifiers.size())
+        return {};
+    return model->identifiers.getReference ((int) layout.type);
+}
+
+var BinaryModel::Subtree::getProperty (const Identifier& name, const var& defaultValue) const
+{
+    BinaryModelLayout layout;
+    if (! isValid() || ! layout.parse (data, size))
+        return defaultValue;
+
+    BinaryModelCursor cursor (layout.properties, layout.propertiesSize);
+    for (uint64 i = 0; i < layout.numProperties; ++i)
+    {
+        const auto index = cursor.readVarint();
+        var value;
+        if (! readModelValue (cursor, model->strings, true, value))
+            break;
+        if (index >= (uint64) model->identifiers.size() || model->identifiers.getReference ((int) index) != name)
+            continue;
+
+        if (auto* state = CompressedState::fromVar (value))
+        {
+            MemoryBlock block;
+            return state->decompress (block) ? var (block) : defaultValue;
+        }
+
+        return value;
+    }
+
+    return defaultValue;
+}
+
+int BinaryModel::Subtree::getNumChildren() const
+{
+    BinaryModelLayout layout;
+    return isValid() && layout.parse (data, size) ? (int) layout.numChildren : 0;
+}
+
+BinaryModel::Subtree BinaryModel::Subtree::getChild (int index) const
+{
+    BinaryModelLayout layout;
+    if (! isValid() || ! layout.parse (data, size) || ! isPositiveAndBelow (index, (int) layout.numChildren))
+        return {};
+
+    BinaryModelCursor cursor (layout.children, layout.childrenSize);
+    for (int i = 0; i < index; ++i)
+        cursor.skip (cursor.readUint32());
+    const auto childSize = cursor.readUint32();
+    const auto* child = cursor.skip (childSize);
+    return child != nullptr ? Subtree (model, child, childSize) : Subtree();
+}
+
+BinaryModel::Subtree BinaryModel::Subtree::getChildWithName (const Identifier& type) const
+{
+    for (int i = 0; i < getNumChildren(); ++i)
+    {
+        const auto child = getChild (i);
+        if (child.hasType (type))
+            return child;
+    }
+    return {};
+}
+
+ValueTree BinaryModel::Subtree::createValueTree (bool lazyStates) const
+{
+    ValueTree tree;
+    if (! isValid() || ! readModelTree (data, size, model->identifiers, model->strings, lazyStates, tree))
+        return {};
+    return tree;
+}
+
+//=============================================================================
+BinaryModel::BinaryModel (const void* data, size_t size)
+{
+    parse (data, size);
+}
+
+BinaryModel::BinaryModel (const File& file)
+{
+    mapped.reset (new MemoryMappedFile (file, MemoryMappedFile::readOnly, false));
+    if (mapped->getData() != nullptr)
+        parse (mapped->getData(), mapped->getSize());
+}
+
+BinaryModel::~BinaryModel() { }
+
+void BinaryModel::parse (const void* data, size_t size)
+{
+    if (! isBinaryModel (data, size))
+        return;
+
+    BinaryModelCursor cursor (static_cast<const uint8*> (data) + 4, size - 4);
+    if (cursor.readUint32() != (uint32) EL_BINARY_MODEL_VERSION)
+        return;
+
+    auto readTable = [&cursor] (std::function<void (const char*, size_t)> add) {
+        const auto count = cursor.readVarint();
+        if (count > cursor.remaining())
+            return false;
+        for (uint64 i = 0; i < count && ! cursor.failed; ++i)
+        {
+            const auto length = (size_t) cursor.readVarint();
+            if (auto* text = cursor.skip (length))
+                add (reinterpret_cast<const char*> (text), length);
+        }
+        return ! cursor.failed;
+    };
+
+    if (! readTable ([this] (const char* text, size_t length) {
+            identifiers.add (Identifier (String::fromUTF8 (text, (int) length)));
+        }))
+        return;
+
+    if (! readTable ([this] (const char* text, size_t length) {
+            strings.add (String::fromUTF8 (text, (int) length));
+        }))
+        return;
+
+    BinaryModelLayout layout;
+    if (cursor.remaining() > 0 && layout.parse (cursor.pos, cursor.remaining()))
+        root = Subtree (this, cursor.pos, cursor.remaining());
+}
+
+//=============================================================================
+bool BinaryModel::isBinaryModel (const File& file)
+{
+    FileInputStream input (file);
+    char magic[4];
+    return input.openedOk() && input.read (magic, 4) == 4
+        && isBinaryModel (magic, 4);
+}
+
+bool BinaryModel::isBinaryModel (const void* data, size_t size)
+{
+    return data != nullptr && size >= 4 && memcmp (data, EL_BINARY_MODEL_MAGIC, 4) == 0;
+}
+
+bool BinaryModel::write (const ValueTree& tree, OutputStream& output)
+{
+    if (! tree.isValid())
+        return false;
+    BinaryModelWriter writer;
+    return writer.write (tree, output);
+}
+
+bool BinaryModel::writeToFile (const ValueTree& tree, const File& file)
+{
+    TemporaryFile tempFile (file);
+    {
+        FileOutputStream output (tempFile.getFile());
+        if (output.failedToOpen() || ! write (tree, output))
+            return false;
+        output.flush();
+        if (output.getStatus().failed())
+            return false;
+    }
+
+    return tempFile.overwriteTargetFileWithTemporary();
+}
+
+ValueTree BinaryModel::read (const void* data, size_t size, bool lazyStates)
+{
+    BinaryModel model (data, size);
+    return model.getRoot().createValueTree (lazyStates);
+}
+
+ValueTree BinaryModel::readFromFile (const File& file, bool lazyStates)
+{
+    BinaryModel model (file);
+    return model.getRoot().createValueTree (lazyStates);
+}
+
+/* Older files keep states as Base64 strings, store them as binary instead */
+static void decodeStateStrings (ValueTree tree)
+{
+    if (tree.hasType (Tags::node))
+    {
+        for (const auto& property : { Tags::state, Tags::programState })
+        {
+            MemoryBlock data;
+            if (tree.getProperty (property).isString() && Node::getStateData (tree.getProperty (property), data))
+                tree.setProperty (property, var (data), nullptr);
+        }
+    }
+
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+        decodeStateStrings (tree.getChild (i));
+}
+
+Result BinaryModel::convert (const File& source, const File& target)
+{
+    auto model = Session::readFromFile (source, true);
+    if (! model.isValid())
+        return Result::fail ("Could not read " + source.getFullPathName());
+
+    if (target.hasFileExtension ("xml"))
+    {
+        Node::expandStates (model);
+        auto xml = model.createXml();
+        TemporaryFile tempFile (target);
+        return xml != nullptr && xml->writeTo (tempFile.getFile()) && tempFile.overwriteTargetFileWithTemporary()
+            ? Result::ok() : Result::fail ("Could not write " + target.getFullPathName());
+    }
+
+    decodeStateStrings (model);
+    if (model.hasType (Tags::session) && target.hasFileExtension ("els"))
+    {
+        SessionArchive archive;
+        archive.setAtomic (true);
+        return archive.write (model, target);
+    }
+
+    return writeToFile (model, target) ? Result::ok()
+        : Result::fail ("Could not write " + target.getFullPathName());
+}
+
+}
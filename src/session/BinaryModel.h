@@ -0,0 +1,162 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** Plugin state kept compressed in a model until something needs it.
+
+    Readers that load lazily put these in node state properties instead of
+    binary data. Node::getStateData() decompresses them, and a session
+    archive writes them back without decompressing when it can.
+ */
+class CompressedState : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<CompressedState>;
+
+    /** Takes gzip compressed data, the size it decompresses to, and
+        optionally the MD5 of the decompressed data */
+    CompressedState (MemoryBlock compressed, int64 rawSize, const String& hash = String());
+
+    /** Decompresses the state. Fails without allocating if the size it
+        claims to decompress to isn't plausible */
+    bool decompress (MemoryBlock& data) const;
+
+    /** Returns true if gzip data of a size could decompress to rawSize
+        bytes, and rawSize is small enough to hold in memory. Sizes come
+        from files, so check before allocating for them.
+     */
+    static bool isPlausibleSize (int64 rawSize, int64 compressedSize) noexcept;
+
+    const MemoryBlock& getCompressedData() const noexcept   { return compressed; }
+    int64 getSize() const noexcept                          { return rawSize; }
+    const String& getHash() const noexcept                  { return hash; }
+
+    /** Returns the compressed state held by a var, or nullptr */
+    static CompressedState* fromVar (const var& value);
+
+private:
+    MemoryBlock compressed;
+    int64 rawSize = 0;
+    String hash;
+};
+
+/** A versioned binary encoding for session, graph and preset models.
+
+    Type and property names go in an identifier table and string values in
+    a string table, so each distinct string is stored and decoded once.
+    Numbers are stored as numbers, including strings that are plain
+    integers, which is what port and arc properties are after an XML load.
+    Large binary properties are compressed. Every subtree is prefixed with
+    its size, so a reader can step over the parts it doesn't want.
+
+    An instance reads a model from memory or a memory mapped file and only
+    decodes the subtrees asked for. It doesn't copy the data, so it has to
+    outlive the Subtrees it returns.
+ */
+class BinaryModel
+{
+public:
+    /** A subtree of an encoded model. Nothing is decoded until asked for */
+    class Subtree
+    {
+    public:
+        Subtree() = default;
+
+        bool isValid() const noexcept   { return model != nullptr; }
+        Identifier getType() const;
+        bool hasType (const Identifier& type) const { return getType() == type; }
+
+        /** Decodes one property. Compressed data is decompressed */
+        var getProperty (const Identifier& name, const var& defaultValue = var()) const;
+
+        int getNumChildren() const;
+        Subtree getChild (int index) const;
+        Subtree getChildWithName (const Identifier& type) const;
+
+        /** Decodes this subtree and everything under it.
+
+            @param lazyStates   If true, compressed node states become
+                                CompressedState objects instead of being
+                                decompressed here
+         */
+        ValueTree createValueTree (bool lazyStates = false) const;
+
+    private:
+        friend class BinaryModel;
+        Subtree (const BinaryModel* m, const uint8* d, size_t s) : model (m), data (d), size (s) { }
+        const BinaryModel* model = nullptr;
+        const uint8* data = nullptr;
+        size_t size = 0;
+    };
+
+    /** Reads a model held in memory, which must stay valid */
+    BinaryModel (const void* data, size_t size);
+
+    /** Maps and reads a model file */
+    explicit BinaryModel (const File& file);
+
+    ~BinaryModel();
+
+    /** Returns true if the data was a model this version can read */
+    bool isValid() const noexcept { return root.isValid(); }
+
+    /** The top level tree */
+    Subtree getRoot() const noexcept { return root; }
+
+    //=========================================================================
+    /** Returns true if a file starts like a binary model */
+    static bool isBinaryModel (const File& file);
+
+    /** Returns true if a block of data starts like a binary model */
+    static bool isBinaryModel (const void* data, size_t size);
+
+    /** Encodes a tree */
+    static bool write (const ValueTree& tree, OutputStream& output);
+
+    /** Encodes a tree to a file, replacing it only once it's completely written */
+    static bool writeToFile (const ValueTree& tree, const File& file);
+
+    /** Decodes a whole model held in memory */
+    static ValueTree read (const void* data, size_t size, bool lazyStates = false);
+
+    /** Decodes a whole model file */
+    static ValueTree readFromFile (const File& file, bool lazyStates = false);
+
+    /** Converts a session, graph or preset file between formats. Targets
+        ending in .xml are written as XML, sessions as session archives and
+        anything else as a binary model.
+     */
+    static Result convert (const File& source, const File& target);
+
+private:
+    std::unique_ptr<MemoryMappedFile> mapped;
+    Array<Identifier> identifiers;
+    StringArray strings;
+    Subtree root;
+
+    void parse (const void* data, size_t size);
+    JUCE_DECLARE_NON_COPYABLE (BinaryModel)
+};
+
+}
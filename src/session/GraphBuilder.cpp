@@ -0,0 +1,137 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "controllers/GraphManager.h"
+#include "session/GraphBuilder.h"
+
+namespace Element {
+
+int GraphBuilder::addNode (const Node& model)
+{
+    Entry entry;
+    entry.model = model;
+    entries.add (entry);
+    return entries.size() - 1;
+}
+
+int GraphBuilder::addNode (const String& format, const String& identifier, const String& name)
+{
+    Node model (Tags::node);
+    model.setProperty (Tags::format, format)
+         .setProperty (Tags::identifier, identifier);
+    if (name.isNotEmpty())
+        model.setProperty (Tags::name, name);
+    return addNode (model);
+}
+
+int GraphBuilder::addExistingNode (const Node& node)
+{
+    Entry entry;
+    entry.model = node;
+    entry.existing = true;
+    entries.add (entry);
+    return entries.size() - 1;
+}
+
+void GraphBuilder::connect (int source, int sourcePort, int dest, int destPort)
+{
+    Connection c;
+    c.source = source; c.sourcePort = sourcePort;
+    c.dest = dest; c.destPort = destPort;
+    connections.add (c);
+}
+
+void GraphBuilder::connectChannels (PortType type, int source, int sourceChannel, int dest, int destChannel)
+{
+    Connection c;
+    c.type = type;
+    c.source = source; c.sourcePort = sourceChannel;
+    c.dest = dest; c.destPort = destChannel;
+    connections.add (c);
+}
+
+NodeArray GraphBuilder::build (GraphManager& graph)
+{
+    errors.clearQuick();
+    NodeArray results;
+    Array<uint32> nodeIds;
+
+    GraphManager::ScopedBatch batch (graph);
+
+    for (const auto& entry : entries)
+    {
+        uint32 nodeId = KV_INVALID_NODE;
+        if (entry.existing)
+        {
+            if (graph.contains (entry.model.getNodeId()))
+                nodeId = entry.model.getNodeId();
+            else
+                errors.add ("node is not in the graph: " + entry.model.getName());
+        }
+        else
+        {
+            nodeId = graph.addNode (entry.model);
+            if (nodeId == KV_INVALID_NODE)
+                errors.add ("could not create node: " + entry.model.getProperty (Tags::identifier).toString());
+        }
+
+        nodeIds.add (nodeId);
+        results.add (nodeId != KV_INVALID_NODE ? graph.getNodeModelForId (nodeId) : Node());
+    }
+
+    for (const auto& c : connections)
+    {
+        const uint32 source = nodeIds [c.source];
+        const uint32 dest   = nodeIds [c.dest];
+        NodeObjectPtr src = source != KV_INVALID_NODE ? graph.getNodeForId (source) : nullptr;
+        NodeObjectPtr dst = dest != KV_INVALID_NODE ? graph.getNodeForId (dest) : nullptr;
+        if (src == nullptr || dst == nullptr)
+        {
+            errors.add ("connection refers to a missing node");
+            continue;
+        }
+
+        uint32 sourcePort = (uint32) c.sourcePort;
+        uint32 destPort   = (uint32) c.destPort;
+        if (c.type != PortType::Unknown)
+        {
+            sourcePort = src->getPortForChannel (c.type, c.sourcePort, false);
+            destPort   = dst->getPortForChannel (c.type, c.destPort, true);
+        }
+
+        if (! graph.addConnection (source, (int) sourcePort, dest, (int) destPort))
+        {
+            String error = "could not connect ";
+            error << (int) source << ":" << c.sourcePort << " to "
+                  << (int) dest << ":" << c.destPort;
+            errors.add (error);
+        }
+    }
+
+    return results;
+}
+
+void GraphBuilder::clear()
+{
+    entries.clearQuick();
+    connections.clearQuick();
+    errors.clearQuick();
+}
+
+}
@@ -0,0 +1,90 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "session/Node.h"
+
+namespace Element {
+
+class GraphManager;
+
+/** Collects nodes and connections, then adds them to a graph in one batch.
+
+    Nodes are referred to by the index addNode() returned. Connections are
+    made after every node exists, so their order doesn't matter. The graph's
+    arcs model is rebuilt and its listeners notified once at the end instead
+    of after every change.
+ */
+class GraphBuilder
+{
+public:
+    GraphBuilder() = default;
+    ~GraphBuilder() = default;
+
+    /** Adds a node to create. The model needs at least a format and an
+        identifier, like the nodes in a saved graph. Returns its index.
+     */
+    int addNode (const Node& model);
+
+    /** Adds a node to create by plugin format and identifier */
+    int addNode (const String& format, const String& identifier, const String& name = String());
+
+    /** Adds a node that is already in the target graph. Returns its index */
+    int addExistingNode (const Node& node);
+
+    /** Connects two nodes by port index */
+    void connect (int source, int sourcePort, int dest, int destPort);
+
+    /** Connects two nodes by channel of a port type */
+    void connectChannels (PortType type, int source, int sourceChannel, int dest, int destChannel);
+
+    int getNumNodes() const noexcept        { return entries.size(); }
+    int getNumConnections() const noexcept  { return connections.size(); }
+
+    /** Creates the nodes and connections in a graph. Returns a model for
+        every node in the builder in index order, invalid if it failed.
+     */
+    NodeArray build (GraphManager& graph);
+
+    /** Returns what went wrong during the last build */
+    const StringArray& getErrors() const noexcept { return errors; }
+
+    /** Removes everything */
+    void clear();
+
+private:
+    struct Entry
+    {
+        Node model;
+        bool existing = false;
+    };
+
+    struct Connection
+    {
+        PortType type { PortType::Unknown };
+        int source = -1, sourcePort = -1, dest = -1, destPort = -1;
+    };
+
+    Array<Entry> entries;
+    Array<Connection> connections;
+    StringArray errors;
+};
+
+}
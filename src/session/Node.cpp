@@ -18,6 +18,7 @@
 */
 
 #include "engine/nodes/BaseProcessor.h" // for internal id macros
+#include "session/BinaryModel.h"
 #include "session/Node.h"
 #include "session/Session.h"
 #include "controllers/GraphManager.h"
@@ -270,27 +271,27 @@ ValueTree Node::resetIds (const ValueTree& data)
 
 ValueTree Node::parse (const File& file)
 {
-    ValueTree sessionData = Session::readFromFile (file);
-    if (sessionData.isValid())
+    if (BinaryModel::isBinaryModel (file))
     {
-        const auto graphs = sessionData.getChildWithName (Tags::graphs);
+        // only decode the graph that's wanted
+        BinaryModel model (file);
+        const auto root = model.getRoot();
+        if (root.hasType (Tags::session))
+        {
+            const auto graphs = root.getChildWithName (Tags::graphs);
+            return graphs.getChild (graphs.getProperty (Tags::active, 0)).createValueTree();
+        }
+    }
+
+    ValueTree data = Session::readFromFile (file);
+    if (data.hasType (Tags::session))
+    {
+        const auto graphs = data.getChildWithName (Tags::graphs);
         const auto sessionNode = graphs.getChild (graphs.getProperty (Tags::active, 0));
         return sessionNode.createCopy();
     }
 
-    ValueTree data;
     ValueTree nodeData;
-    
-    if (auto e = XmlDocument::parse (file))
-    {
-        data = ValueTree::fromXml (*e);
-    }
-    else
-    {
-        FileInputStream input (file);
-        data = ValueTree::readFromStream (input);
-    }
-    
     if (data.hasType (Tags::node))
     {
         nodeData = data;
@@ -335,6 +336,49 @@ void Node::sanitizeProperties (ValueTree node, const bool recursive)
             sanitizeProperties (node.getChild(i), recursive);
 }
 
+bool Node::getStateData (const var& value, MemoryBlock& data)
+{
+    data.reset();
+    if (auto* block = value.getBinaryData())
+    {
+        data = *block;
+    }
+    else if (auto* state = CompressedState::fromVar (value))
+    {
+        if (! state->decompress (data))
+            data.reset();
+    }
+    else
+    {
+        const auto encoded = value.toString().trim();
+        if (encoded.isNotEmpty())
+            data.fromBase64Encoding (encoded);
+    }
+
+    return data.getSize() > 0;
+}
+
+void Node::expandStates (ValueTree tree)
+{
+    if (tree.hasType (Tags::node))
+    {
+        for (const auto& property : { Tags::state, Tags::programState })
+        {
+            MemoryBlock data;
+            if (CompressedState::fromVar (tree.getProperty (property)) != nullptr)
+            {
+                if (getStateData (tree.getProperty (property), data))
+                    tree.setProperty (property, var (data), nullptr);
+                else
+                    tree.removeProperty (property, nullptr);
+            }
+        }
+    }
+
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+        expandStates (tree.getChild (i));
+}
+
 void Node::sanitizeRuntimeProperties (ValueTree node, const bool recursive)
 {
     Node::sanitizeProperties (node, recursive);
@@ -344,21 +388,7 @@ bool Node::writeToFile (const File& targetFile) const
 {
     ValueTree data = objectData.createCopy();
     sanitizeProperties (data, true);
-    
-    #if EL_SAVE_BINARY_FORMAT
-    TemporaryFile tempFile (targetFile);
-    if (auto out = std::unique_ptr<FileOutputStream> (tempFile.getFile().createOutputStream()))
-    {
-        data.writeToStream (*out);
-        out.reset();
-        return tempFile.overwriteTargetFileWithTemporary();
-    }
-    #else
-    if (auto e = data.createXml())
-        return e->writeToFile (targetFile, String());
-    #endif
-
-    return false;
+    return BinaryModel::writeToFile (data, targetFile);
 }
 
 bool Node::savePresetTo (const DataPath& path, const String& name) const
@@ -377,19 +407,7 @@ bool Node::savePresetTo (const DataPath& path, const String& name) const
     data.setProperty (Tags::name, targetFile.getFileNameWithoutExtension(), 0);
     data.setProperty (Tags::type, Tags::node.toString(), 0);
     
-    #if EL_SAVE_BINARY_FORMAT
-    TemporaryFile tempFile(targetFile);
-    if (auto out = std::unique_ptr<FileOutputStream>(tempFile.getFile().createOutputStream()))
-    {
-        data.writeToStream(*out);
-        out.reset();
-        return tempFile.overwriteTargetFileWithTemporary();
-    }
-    #else
-    if (auto e = preset.createXml())
-        return e->writeToFile (targetFile, String());
-    #endif
-    return false;
+    return BinaryModel::writeToFile (preset, targetFile);
 }
 
 Node Node::createGraph (const String& name)
@@ -769,26 +787,16 @@ void Node::restorePluginState()
             if (shouldSetProgram)
                 proc->setCurrentProgram (wantedProgram);
 
-            auto data = getProperty(Tags::state).toString().trim();
-            if (data.isNotEmpty())
+            MemoryBlock state;
+            if (getStateData (getProperty (Tags::state), state))
             {
-                MemoryBlock state;
-                state.fromBase64Encoding (data);
-                if (state.getSize() > 0)
-                {
-                    proc->setStateInformation (state.getData(), (int) state.getSize());
-                }
+                proc->setStateInformation (state.getData(), (int) state.getSize());
             }
             
-            data = getProperty(Tags::programState).toString().trim();
-            if (shouldSetProgram && data.isNotEmpty())
+            if (shouldSetProgram && getStateData (getProperty (Tags::programState), state))
             {
-                MemoryBlock state; state.fromBase64Encoding (data);
-                if (state.getSize() > 0)
-                {
-                    proc->setCurrentProgramStateInformation (state.getData(),
-                        (int) state.getSize());
-                }
+                proc->setCurrentProgramStateInformation (state.getData(),
+                    (int) state.getSize());
             }
         }
         else
@@ -799,14 +807,9 @@ void Node::restorePluginState()
             if (shouldSetProgram)
                 obj->setCurrentProgram (wantedProgram);
 
-            auto data = getProperty(Tags::state).toString().trim();
-            if (data.isNotEmpty())
-            {
-                MemoryBlock state;
-                state.fromBase64Encoding (data);
-                if (state.getSize() > 0)
-                    obj->setState (state.getData(), (int) state.getSize());
-            }
+            MemoryBlock state;
+            if (getStateData (getProperty (Tags::state), state))
+                obj->setState (state.getData(), (int) state.getSize());
         }
 
         if (hasProperty (Tags::bypass))
@@ -869,7 +872,7 @@ void Node::restorePluginState()
         getNode(i).restorePluginState();
 }
 
-void Node::savePluginState()
+void Node::savePluginState (const bool changedOnly)
 {
     if (! isValid())
         return;
@@ -878,13 +881,19 @@ void Node::savePluginState()
     if (obj && obj->isPrepared)
     {
         MemoryBlock state;
+        // capturing a plugin's state is the expensive part, reuse the
+        // last one if the plugin hasn't reported a change since
+        const bool captureState = ! changedOnly || obj->isStateDirty() || ! hasProperty (Tags::state);
+        if (captureState)
+            obj->markStateSaved();
         
         if (auto* proc = obj->getAudioProcessor())
         {
-            proc->getStateInformation (state);
+            if (captureState)
+                proc->getStateInformation (state);
             if (state.getSize() > 0)
             {
-                objectData.setProperty (Tags::state, state.toBase64Encoding(), nullptr);
+                objectData.setProperty (Tags::state, var (state), nullptr);
             }
             else
             {
@@ -894,20 +903,21 @@ void Node::savePluginState()
             }
 
             state.reset();
-            proc->getCurrentProgramStateInformation (state);
+            if (captureState)
+                proc->getCurrentProgramStateInformation (state);
             if (state.getSize() > 0)
             {
-                objectData.setProperty (Tags::programState, state.toBase64Encoding(), 0);
+                objectData.setProperty (Tags::programState, var (state), 0);
             }
 
             setProperty (Tags::bypass, proc->isSuspended());
             setProperty (Tags::program, proc->getCurrentProgram());
         }
-        else
+        else if (captureState)
         {
             obj->getState (state);
             if (state.getSize() > 0)
-                objectData.setProperty (Tags::state, state.toBase64Encoding(), nullptr);
+                objectData.setProperty (Tags::state, var (state), nullptr);
         }
 
         setProperty (Tags::midiProgram, obj->getMidiProgram());
@@ -922,7 +932,7 @@ void Node::savePluginState()
     }
 
     for (int i = 0; i < getNumNodes(); ++i)
-        getNode(i).savePluginState();
+        getNode(i).savePluginState (changedOnly);
 }
 
 void Node::setMuted (bool shouldBeMuted)
@@ -944,7 +954,10 @@ void Node::setMuteInput (bool shouldMuteInputs)
 void Node::setCurrentProgram (const int index)
 {
     if (auto* obj = getGraphNode())
+    {
         obj->setCurrentProgram (index);
+        obj->markStateDirty();
+    }
 }
 
 int Node::getCurrentProgram() const
@@ -126,6 +126,15 @@ public:
     /** Removes properties that can't be saved to a file. e.g. object properties */
     static void sanitizeProperties (ValueTree node, const bool recursive = false);
     
+    /** Reads a plugin state property. States are kept as binary but older
+        files have them as Base64 strings, and lazily loaded ones are still
+        compressed. Returns false if there's no data */
+    static bool getStateData (const var& value, MemoryBlock& data);
+
+    /** Decompresses states left compressed by lazy loading. Call this on a
+        copy before writing a model with createXml() or writeToStream() */
+    static void expandStates (ValueTree tree);
+
     /** This is just an alias right now */
     static void sanitizeRuntimeProperties (ValueTree node, const bool recursive = false);
 
@@ -231,6 +240,10 @@ public:
     /** Returns true if inputs are muted */
     bool isMutingInputs() const { return (bool) getProperty ("muteInput", false); }
 
+    /** Returns true if this node's plugin runs in a sandbox process. Takes
+        effect when the node is instantiated */
+    bool isSandboxed() const { return (bool) getProperty (Tags::sandboxed, false); }
+
     /** Change the mute status of this Node */
     void setMuted (bool);
 
@@ -436,8 +449,12 @@ public:
                      const uint32 destNode, const uint32 destPort) const;
     
     //=========================================================================
-    /** Saves the node state from NodeObject to state property */
-    void savePluginState();
+    /** Saves the node state from NodeObject to state property
+
+        @param changedOnly  If true, nodes whose objects report no change
+                            since they were last saved keep the state they have
+     */
+    void savePluginState (bool changedOnly = false);
     
     /** Reads state property and applies to NodeObject */
     void restorePluginState();
@@ -0,0 +1,365 @@
+/*
+    This file is part of Element
+    Copyright (C) 2014-2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/PluginCatalog.h"
+
+#define EL_PLUGIN_CATALOG_MAGIC         "ELPC"
+#define EL_PLUGIN_CATALOG_VERSION       1
+
+/*  Layout, all little endian:
+
+    header      magic[4] version:u32 numTypes:u32 tableSize:u32
+                recordsOffset:u64 blacklistOffset:u64 listHash:i64
+    index       numTypes x { recordOffset:u64 identifierHash:i64 uid:i32
+                             formatHash:u32 manufacturerHash:u32 recordSize:u32 }
+    table       tableSize x u32, index + 1 or 0 if empty, by identifierHash
+    records     encoded descriptions
+    blacklist   count:i32 then strings
+ */
+#define EL_PLUGIN_CATALOG_HEADER_SIZE   40
+#define EL_PLUGIN_CATALOG_ENTRY_SIZE    32
+
+namespace Element {
+
+static uint32 hashKey (const String& key)                  { return (uint32) key.hashCode(); }
+
+static void writeDescription (OutputStream& out, const PluginDescription& d)
+{
+    out.writeString (d.name);
+    out.writeString (d.descriptiveName);
+    out.writeString (d.pluginFormatName);
+    out.writeString (d.category);
+    out.writeString (d.manufacturerName);
+    out.writeString (d.version);
+    out.writeString (d.fileOrIdentifier);
+    out.writeInt64 (d.lastFileModTime.toMilliseconds());
+    out.writeInt64 (d.lastInfoUpdateTime.toMilliseconds());
+    out.writeInt (d.uid);
+    out.writeBool (d.isInstrument);
+    out.writeInt (d.numInputChannels);
+    out.writeInt (d.numOutputChannels);
+    out.writeBool (d.hasSharedContainer);
+}
+
+static PluginDescription readDescription (InputStream& in)
+{
+    PluginDescription d;
+    d.name                  = in.readString();
+    d.descriptiveName       = in.readString();
+    d.pluginFormatName      = in.readString();
+    d.category              = in.readString();
+    d.manufacturerName      = in.readString();
+    d.version               = in.readString();
+    d.fileOrIdentifier      = in.readString();
+    d.lastFileModTime       = Time (in.readInt64());
+    d.lastInfoUpdateTime    = Time (in.readInt64());
+    d.uid                   = in.readInt();
+    d.isInstrument          = in.readBool();
+    d.numInputChannels      = in.readInt();
+    d.numOutputChannels     = in.readInt();
+    d.hasSharedContainer    = in.readBool();
+    return d;
+}
+
+PluginCatalog::PluginCatalog() { }
+PluginCatalog::~PluginCatalog()
+{
+    close();
+}
+
+static uint64 hashBytes (const MemoryOutputStream& out)
+{
+    const MD5 md5 (out.getData(), out.getDataSize());
+    return ByteOrder::littleEndianInt64 (md5.getChecksumDataArray());
+}
+
+int64 PluginCatalog::createHash (const KnownPluginList& list)
+{
+    // summed so the order of the list doesn't matter. The info update time
+    // is left out since rescanning internal plugins changes it every launch
+    uint64 hash = 0;
+    for (auto type : list.getTypes())
+    {
+        type.lastInfoUpdateTime = Time();
+        MemoryOutputStream out;
+        writeDescription (out, type);
+        hash += hashBytes (out);
+    }
+
+    for (const auto& file : list.getBlacklistedFiles())
+    {
+        MemoryOutputStream out;
+        out.writeString (file);
+        hash += hashBytes (out) * 31;
+    }
+
+    return (int64) hash;
+}
+
+bool PluginCatalog::write (const KnownPluginList& list, const File& file)
+{
+    const auto types = list.getTypes();
+    const auto numTypes = types.size();
+
+    uint32 tableSize = 16;
+    while (tableSize < (uint32) numTypes * 2)
+        tableSize <<= 1;
+    std::vector<uint32> table (tableSize, 0);
+
+    MemoryOutputStream index, records;
+    for (int i = 0; i < numTypes; ++i)
+    {
+        const auto& type = types.getReference (i);
+        const auto identifierHash = type.createIdentifierString().hashCode64();
+        const auto offset = records.getPosition();
+        writeDescription (records, type);
+
+        index.writeInt64 ((int64) offset);
+        index.writeInt64 (identifierHash);
+        index.writeInt (type.uid);
+        index.writeInt ((int) hashKey (type.pluginFormatName));
+        index.writeInt ((int) hashKey (type.manufacturerName));
+        index.writeInt ((int) (records.getPosition() - offset));
+
+        auto slot = (uint32) identifierHash & (tableSize - 1);
+        while (table[slot] != 0)
+            slot = (slot + 1) & (tableSize - 1);
+        table[slot] = (uint32) i + 1;
+    }
+
+    const uint64 recordsOffset   = EL_PLUGIN_CATALOG_HEADER_SIZE + index.getDataSize() + tableSize * sizeof (uint32);
+    const uint64 blacklistOffset = recordsOffset + records.getDataSize();
+
+    file.getParentDirectory().createDirectory();
+    TemporaryFile temp (file);
+    {
+        FileOutputStream out (temp.getFile());
+        if (! out.openedOk())
+            return false;
+
+        out.write (EL_PLUGIN_CATALOG_MAGIC, 4);
+        out.writeInt (EL_PLUGIN_CATALOG_VERSION);
+        out.writeInt (numTypes);
+        out.writeInt ((int) tableSize);
+        out.writeInt64 ((int64) recordsOffset);
+        out.writeInt64 ((int64) blacklistOffset);
+        out.writeInt64 (createHash (list));
+        out << index.getMemoryBlock();
+        for (const auto slot : table)
+            out.writeInt ((int) slot);
+        out << records.getMemoryBlock();
+
+        const auto& blacklist = list.getBlacklistedFiles();
+        out.writeInt (blacklist.size());
+        for (const auto& entry : blacklist)
+            out.writeString (entry);
+
+        out.flush();
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+bool PluginCatalog::open (const File& file)
+{
+    close();
+
+    std::unique_ptr<MemoryMappedFile> newMapped (new MemoryMappedFile (file, MemoryMappedFile::readOnly));
+    const auto* bytes = static_cast<const uint8*> (newMapped->getData());
+    const auto numBytes = newMapped->getSize();
+    if (bytes == nullptr || numBytes < EL_PLUGIN_CATALOG_HEADER_SIZE
+        || memcmp (bytes, EL_PLUGIN_CATALOG_MAGIC, 4) != 0
+        || ByteOrder::littleEndianInt (bytes + 4) != EL_PLUGIN_CATALOG_VERSION)
+        return false;
+
+    const auto types        = ByteOrder::littleEndianInt (bytes + 8);
+    const auto slots        = ByteOrder::littleEndianInt (bytes + 12);
+    const auto records      = ByteOrder::littleEndianInt64 (bytes + 16);
+    const auto blacklist    = ByteOrder::littleEndianInt64 (bytes + 24);
+
+    const uint64 expectedRecords = EL_PLUGIN_CATALOG_HEADER_SIZE
+        + (uint64) types * EL_PLUGIN_CATALOG_ENTRY_SIZE + (uint64) slots * sizeof (uint32);
+    if (types > (uint32) std::numeric_limits<int>::max() || ! isPowerOfTwo (slots)
+        || slots < types || records != expectedRecords
+        || blacklist < records || blacklist + sizeof (int32) > numBytes)
+        return false;
+
+    mapped          = std::move (newMapped);
+    data            = bytes;
+    size            = numBytes;
+    numTypes        = (int) types;
+    tableSize       = slots;
+    recordsOffset   = records;
+    blacklistOffset = blacklist;
+    listHash        = (int64) ByteOrder::littleEndianInt64 (bytes + 32);
+    return true;
+}
+
+void PluginCatalog::close()
+{
+    ScopedLock sl (lock);
+    indexed = false;
+    byUid.clear();
+    byFormat.clear();
+    byManufacturer.clear();
+
+    data = nullptr;
+    size = 0;
+    numTypes = 0;
+    tableSize = 0;
+    recordsOffset = blacklistOffset = 0;
+    listHash = 0;
+    mapped.reset();
+}
+
+const uint8* PluginCatalog::getIndexEntry (int index) const noexcept
+{
+    return data + EL_PLUGIN_CATALOG_HEADER_SIZE + (size_t) index * EL_PLUGIN_CATALOG_ENTRY_SIZE;
+}
+
+PluginDescription PluginCatalog::getType (int index) const
+{
+    if (! isPositiveAndBelow (index, numTypes))
+        return {};
+
+    const auto* entry = getIndexEntry (index);
+    const auto offset = recordsOffset + ByteOrder::littleEndianInt64 (entry);
+    const auto recordSize = (size_t) ByteOrder::littleEndianInt (entry + 28);
+    if (offset + recordSize > blacklistOffset)
+        return {};
+
+    MemoryInputStream in (data + offset, recordSize, false);
+    return readDescription (in);
+}
+
+bool PluginCatalog::getTypeForIdentifierString (const String& identifier, PluginDescription& result) const
+{
+    if (! isOpen() || numTypes <= 0)
+        return false;
+
+    const auto hash = identifier.hashCode64();
+    const auto* table = data + EL_PLUGIN_CATALOG_HEADER_SIZE + (size_t) numTypes * EL_PLUGIN_CATALOG_ENTRY_SIZE;
+    auto slot = (uint32) hash & (tableSize - 1);
+
+    for (uint32 probes = 0; probes < tableSize; ++probes)
+    {
+        const auto value = ByteOrder::littleEndianInt (table + slot * sizeof (uint32));
+        if (value == 0 || value > (uint32) numTypes)
+            break;
+
+        const int index = (int) value - 1;
+        if ((int64) ByteOrder::littleEndianInt64 (getIndexEntry (index) + 8) == hash)
+        {
+            auto type = getType (index);
+            if (type.createIdentifierString() == identifier)
+            {
+                result = type;
+                return true;
+            }
+        }
+
+        slot = (slot + 1) & (tableSize - 1);
+    }
+
+    return false;
+}
+
+void PluginCatalog::buildIndexes() const
+{
+    ScopedLock sl (lock);
+    if (indexed)
+        return;
+
+    for (int i = 0; i < numTypes; ++i)
+    {
+        const auto* entry = getIndexEntry (i);
+        byUid.insert ({ (int) ByteOrder::littleEndianInt (entry + 16), i });
+        byFormat.insert ({ ByteOrder::littleEndianInt (entry + 20), i });
+        byManufacturer.insert ({ ByteOrder::littleEndianInt (entry + 24), i });
+    }
+
+    indexed = true;
+}
+
+Array<PluginDescription> PluginCatalog::getTypes (const std::multimap<uint32, int>& index, uint32 key,
+                                                  const std::function<bool (const PluginDescription&)>& matches) const
+{
+    Array<PluginDescription> results;
+    const auto range = index.equal_range (key);
+    for (auto iter = range.first; iter != range.second; ++iter)
+    {
+        auto type = getType (iter->second);
+        if (matches (type))
+            results.add (type);
+    }
+    return results;
+}
+
+Array<PluginDescription> PluginCatalog::getTypesForUid (int uid) const
+{
+    buildIndexes();
+    Array<PluginDescription> results;
+    const auto range = byUid.equal_range (uid);
+    for (auto iter = range.first; iter != range.second; ++iter)
+        results.add (getType (iter->second));
+    return results;
+}
+
+Array<PluginDescription> PluginCatalog::getTypesForFormat (const String& formatName) const
+{
+    buildIndexes();
+    return getTypes (byFormat, hashKey (formatName), [&formatName] (const PluginDescription& d) {
+        return d.pluginFormatName == formatName;
+    });
+}
+
+Array<PluginDescription> PluginCatalog::getTypesForManufacturer (const String& manufacturer) const
+{
+    buildIndexes();
+    return getTypes (byManufacturer, hashKey (manufacturer), [&manufacturer] (const PluginDescription& d) {
+        return d.manufacturerName == manufacturer;
+    });
+}
+
+StringArray PluginCatalog::getBlacklistedFiles() const
+{
+    StringArray files;
+    if (! isOpen())
+        return files;
+
+    MemoryInputStream in (data + blacklistOffset, size - (size_t) blacklistOffset, false);
+    for (int i = in.readInt(); --i >= 0 && ! in.isExhausted();)
+        files.add (in.readString());
+    return files;
+}
+
+void PluginCatalog::restore (KnownPluginList& list) const
+{
+    list.clear();
+    list.clearBlacklistedFiles();
+    // addType() inserts at the front
+    for (int i = numTypes; --i >= 0;)
+        list.addType (getType (i));
+    for (const auto& file : getBlacklistedFiles())
+        list.addToBlacklist (file);
+}
+
+}
@@ -0,0 +1,105 @@
+/*
+    This file is part of Element
+    Copyright (C) 2014-2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** A memory mapped, binary copy of the known plugins list.
+
+    The file holds a fixed size index entry per plugin, a hash table keyed
+    by identifier string, the encoded descriptions and the blacklist.
+    Opening only maps the file; descriptions are decoded when looked up and
+    the uid, format and manufacturer indexes are built from the index entries
+    the first time they're needed. Writing replaces the file atomically.
+ */
+class PluginCatalog
+{
+public:
+    PluginCatalog();
+    ~PluginCatalog();
+
+    /** Writes a known plugins list to a catalog file */
+    static bool write (const KnownPluginList& list, const File& file);
+
+    /** Returns a hash of everything the catalog stores about a list. Used to
+        tell if a list changed since it was written */
+    static int64 createHash (const KnownPluginList& list);
+
+    /** Maps a catalog file. Returns false if it is missing or invalid */
+    bool open (const File& file);
+
+    /** Unmaps the file */
+    void close();
+
+    /** Returns true if a valid catalog is mapped */
+    bool isOpen() const noexcept            { return data != nullptr; }
+
+    /** Returns the hash of the list the catalog was written from */
+    int64 getListHash() const noexcept      { return listHash; }
+
+    /** Returns the number of plugin types */
+    int getNumTypes() const noexcept        { return numTypes; }
+
+    /** Decodes one plugin type */
+    PluginDescription getType (int index) const;
+
+    /** Looks up a type by PluginDescription::createIdentifierString() */
+    bool getTypeForIdentifierString (const String& identifier, PluginDescription& result) const;
+
+    /** Returns all types with a uid */
+    Array<PluginDescription> getTypesForUid (int uid) const;
+
+    /** Returns all types of a plugin format */
+    Array<PluginDescription> getTypesForFormat (const String& formatName) const;
+
+    /** Returns all types by a manufacturer */
+    Array<PluginDescription> getTypesForManufacturer (const String& manufacturer) const;
+
+    /** Returns the blacklisted files */
+    StringArray getBlacklistedFiles() const;
+
+    /** Replaces the contents of a list with the catalog */
+    void restore (KnownPluginList& list) const;
+
+private:
+    std::unique_ptr<MemoryMappedFile> mapped;
+    const uint8* data = nullptr;
+    size_t size = 0;
+    int numTypes = 0;
+    uint32 tableSize = 0;
+    uint64 recordsOffset = 0, blacklistOffset = 0;
+    int64 listHash = 0;
+
+    CriticalSection lock;
+    mutable bool indexed = false;
+    mutable std::multimap<int, int> byUid;
+    mutable std::multimap<uint32, int> byFormat, byManufacturer;
+
+    const uint8* getIndexEntry (int index) const noexcept;
+    void buildIndexes() const;
+    Array<PluginDescription> getTypes (const std::multimap<uint32, int>& index, uint32 key,
+                                       const std::function<bool (const PluginDescription&)>& matches) const;
+
+    JUCE_DECLARE_NON_COPYABLE (PluginCatalog)
+};
+
+}
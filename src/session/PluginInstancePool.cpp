@@ -0,0 +1,332 @@
+/*
+    This file is part of Element
+    Copyright (C) 2014-2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/nodes/NodeTypes.h"
+#include "session/PluginInstancePool.h"
+
+#define EL_PLUGIN_POOL_WARM_INTERVAL    1000
+
+namespace Element {
+
+PluginInstancePool::PluginInstancePool (AudioPluginFormatManager& f)
+    : formats (f) { }
+
+PluginInstancePool::~PluginInstancePool()
+{
+    stopTimer();
+    cancelPendingUpdate();
+    clear();
+
+    // deleting these would leave their editors dangling
+    for (int i = awaitingEditor.size(); --i >= 0;)
+    {
+        if (awaitingEditor.getUnchecked(i)->getActiveEditor() != nullptr)
+        {
+            jassertfalse;
+            awaitingEditor.remove (i, false);
+        }
+    }
+}
+
+bool PluginInstancePool::canPool (const PluginDescription& desc)
+{
+    return desc.pluginFormatName.isNotEmpty()
+        && desc.pluginFormatName != EL_INTERNAL_FORMAT_NAME
+        && desc.pluginFormatName != "Internal";
+}
+
+String PluginInstancePool::keyFor (const PluginDescription& desc) const
+{
+    return desc.createIdentifierString();
+}
+
+void PluginInstancePool::setPlayConfig (double newSampleRate, int newBlockSize)
+{
+    if (newSampleRate == sampleRate && newBlockSize == blockSize)
+        return;
+    clear();
+    ScopedLock sl (lock);
+    sampleRate = newSampleRate;
+    blockSize  = newBlockSize;
+}
+
+void PluginInstancePool::setLimits (int newMaxPerPlugin, int newMaxTotal)
+{
+    ScopedLock sl (lock);
+    maxPerPlugin = jmax (0, newMaxPerPlugin);
+    maxTotal     = jmax (0, newMaxTotal);
+}
+
+void PluginInstancePool::setWarmList (const Array<PluginDescription>& types)
+{
+    warmList.clearQuick();
+    for (const auto& type : types)
+        if (canPool (type))
+            warmList.add (type);
+    startTimer (EL_PLUGIN_POOL_WARM_INTERVAL);
+}
+
+void PluginInstancePool::setNumRecentToWarm (int numPlugins)
+{
+    numRecent = jmax (0, numPlugins);
+}
+
+std::unique_ptr<AudioPluginInstance> PluginInstancePool::take (const PluginDescription& desc)
+{
+    if (! canPool (desc))
+        return nullptr;
+
+    const auto key = keyFor (desc);
+    auto& used = usage[key];
+    used.desc = desc;
+    ++used.count;
+
+    std::unique_ptr<AudioPluginInstance> instance;
+    {
+        ScopedLock sl (lock);
+        auto iter = idle.find (key);
+        if (iter != idle.end() && ! iter->second.isEmpty())
+            instance.reset (iter->second.removeAndReturn (iter->second.size() - 1));
+    }
+
+    if (numRecent > 0 || ! warmList.isEmpty())
+        startTimer (EL_PLUGIN_POOL_WARM_INTERVAL);
+    return instance;
+}
+
+void PluginInstancePool::instanceCreated (AudioPluginInstance& instance)
+{
+    const auto desc = instance.getPluginDescription();
+    if (! canPool (desc))
+        return;
+
+    const auto key = keyFor (desc);
+    if (defaults.find (key) != defaults.end())
+        return;
+
+    auto& d = defaults[key];
+    instance.getStateInformation (d.state);
+    d.layout = instance.getBusesLayout();
+}
+
+void PluginInstancePool::recycle (std::unique_ptr<AudioProcessor> processor)
+{
+    if (processor == nullptr)
+        return;
+
+    {
+        ScopedLock sl (lock);
+        returned.add (processor.release());
+    }
+
+    triggerAsyncUpdate();
+}
+
+int PluginInstancePool::getNumIdleInternal() const
+{
+    int total = 0;
+    for (const auto& item : idle)
+        total += item.second.size();
+    return total;
+}
+
+int PluginInstancePool::getNumIdle() const
+{
+    ScopedLock sl (lock);
+    return getNumIdleInternal();
+}
+
+int PluginInstancePool::getNumIdle (const PluginDescription& desc) const
+{
+    ScopedLock sl (lock);
+    const auto iter = idle.find (keyFor (desc));
+    return iter != idle.end() ? iter->second.size() : 0;
+}
+
+void PluginInstancePool::clear()
+{
+    std::map<String, OwnedArray<AudioPluginInstance>> oldIdle;
+    OwnedArray<AudioProcessor> oldReturned;
+
+    {
+        ScopedLock sl (lock);
+        std::swap (idle, oldIdle);
+        oldReturned.swapWith (returned);
+    }
+
+    defaults.clear();
+    // instances are deleted here, outside the lock
+}
+
+bool PluginInstancePool::addIdle (const String& key, std::unique_ptr<AudioPluginInstance> instance)
+{
+    ScopedLock sl (lock);
+    auto& instances = idle[key];
+    if (instances.size() >= maxPerPlugin || getNumIdleInternal() >= maxTotal)
+        return false;
+    instances.add (instance.release());
+    return true;
+}
+
+void PluginInstancePool::handleAsyncUpdate()
+{
+    resetReturnedInstances();
+}
+
+void PluginInstancePool::resetReturnedInstances()
+{
+    OwnedArray<AudioProcessor> processors;
+    {
+        ScopedLock sl (lock);
+        processors.swapWith (returned);
+    }
+
+    // another look at the ones which still had an editor open
+    while (! awaitingEditor.isEmpty())
+        processors.add (awaitingEditor.removeAndReturn (0));
+
+    while (! processors.isEmpty())
+    {
+        std::unique_ptr<AudioProcessor> processor (processors.removeAndReturn (0));
+        if (processor->getActiveEditor() != nullptr)
+        {
+            awaitingEditor.add (processor.release());
+            continue;
+        }
+
+        auto* instance = dynamic_cast<AudioPluginInstance*> (processor.get());
+        if (instance == nullptr)
+            continue;
+
+        const auto key = keyFor (instance->getPluginDescription());
+        const auto d = defaults.find (key);
+        if (d == defaults.end())
+            continue;
+
+        // back to how it was when first created
+        instance->suspendProcessing (false);
+        instance->releaseResources();
+        instance->setBusesLayout (d->second.layout);
+        instance->setStateInformation (d->second.state.getData(), (int) d->second.state.getSize());
+        instance->reset();
+
+        processor.release();
+        std::unique_ptr<AudioPluginInstance> owned (instance);
+        addIdle (key, std::move (owned));
+    }
+
+    if (! awaitingEditor.isEmpty())
+        startTimer (EL_PLUGIN_POOL_WARM_INTERVAL);
+}
+
+bool PluginInstancePool::findPluginToWarm (PluginDescription& result) const
+{
+    auto needsInstance = [this] (const PluginDescription& desc) {
+        const auto key = keyFor (desc);
+        return key != pending && ! failed.contains (key) && getNumIdle (desc) <= 0;
+    };
+
+    for (const auto& desc : warmList)
+    {
+        if (needsInstance (desc))
+        {
+            result = desc;
+            return true;
+        }
+    }
+
+    if (numRecent <= 0)
+        return false;
+
+    Array<const Usage*> used;
+    for (const auto& item : usage)
+        used.add (&item.second);
+    std::sort (used.begin(), used.end(), [] (const Usage* a, const Usage* b) {
+        return a->count > b->count;
+    });
+
+    for (int i = 0; i < jmin (numRecent, used.size()); ++i)
+    {
+        if (needsInstance (used.getUnchecked(i)->desc))
+        {
+            result = used.getUnchecked(i)->desc;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void PluginInstancePool::warmNext()
+{
+    if (pending.isNotEmpty() || maxPerPlugin <= 0)
+        return;
+
+    {
+        ScopedLock sl (lock);
+        if (getNumIdleInternal() >= maxTotal)
+            return;
+    }
+
+    PluginDescription desc;
+    if (! findPluginToWarm (desc))
+    {
+        if (awaitingEditor.isEmpty())
+            stopTimer();
+        return;
+    }
+
+    pending = keyFor (desc);
+    std::weak_ptr<PluginInstancePool> weak = shared_from_this();
+    const auto rate = sampleRate;
+    const auto size = blockSize;
+
+    formats.createPluginInstanceAsync (desc, sampleRate, blockSize,
+        [weak, rate, size] (std::unique_ptr<AudioPluginInstance> instance, const String& error)
+        {
+            auto pool = weak.lock();
+            if (pool == nullptr)
+                return;
+
+            const auto key = pool->pending;
+            pool->pending = String();
+            if (instance == nullptr)
+            {
+                DBG("[EL] couldn't warm plugin: " << error);
+                ignoreUnused (error);
+                pool->failed.add (key);
+                return;
+            }
+
+            if (rate != pool->sampleRate || size != pool->blockSize)
+                return;
+
+            pool->instanceCreated (*instance);
+            pool->addIdle (pool->keyFor (instance->getPluginDescription()), std::move (instance));
+        });
+}
+
+void PluginInstancePool::timerCallback()
+{
+    if (! awaitingEditor.isEmpty())
+        resetReturnedInstances();
+    warmNext();
+}
+
+}
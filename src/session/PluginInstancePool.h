@@ -0,0 +1,127 @@
+/*
+    This file is part of Element
+    Copyright (C) 2014-2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** Keeps idle plugin instances ready for new nodes.
+
+    Instances come from nodes which were removed, reset to the state and bus
+    layout the plugin had when it was first created, or are created ahead of
+    time for plugins in the warm list and the ones used most. Instances are
+    keyed by plugin and play config, changing the play config empties the
+    pool. Internal Element nodes are cheap to create and never pooled.
+
+    Create with std::make_shared, nodes hold weak references to return
+    their instance.
+ */
+class PluginInstancePool : public std::enable_shared_from_this<PluginInstancePool>,
+                           private AsyncUpdater,
+                           private Timer
+{
+public:
+    explicit PluginInstancePool (AudioPluginFormatManager& formats);
+    ~PluginInstancePool();
+
+    /** Returns true if instances of a plugin can be pooled */
+    static bool canPool (const PluginDescription& desc);
+
+    /** Sets the play config new instances are made for. Empties the pool if
+        it changed */
+    void setPlayConfig (double sampleRate, int blockSize);
+
+    /** Sets how many idle instances to keep of one plugin and in total */
+    void setLimits (int maxPerPlugin, int maxTotal);
+
+    /** Sets plugins which should always have an instance waiting */
+    void setWarmList (const Array<PluginDescription>& types);
+
+    /** Sets how many of the most used plugins get an instance created ahead
+        of time. Zero turns this off */
+    void setNumRecentToWarm (int numPlugins);
+
+    /** Takes an idle instance, or returns nullptr if there isn't one. Counts
+        as a use of the plugin either way */
+    std::unique_ptr<AudioPluginInstance> take (const PluginDescription& desc);
+
+    /** Lets the pool know a new instance was created outside of it. The
+        first one for each plugin provides the state instances are reset to */
+    void instanceCreated (AudioPluginInstance& instance);
+
+    /** Gives back an instance from a node being deleted. Can be called on
+        any thread, the instance is reset on the message thread later. One
+        with an editor still open is kept aside until the editor closes */
+    void recycle (std::unique_ptr<AudioProcessor> processor);
+
+    /** Resets the instances given back and makes them available. Happens
+        automatically on the message thread after recycle() */
+    void resetReturnedInstances();
+
+    /** Returns how many idle instances there are */
+    int getNumIdle() const;
+
+    /** Returns how many idle instances of a plugin there are */
+    int getNumIdle (const PluginDescription& desc) const;
+
+    /** Deletes all idle instances */
+    void clear();
+
+private:
+    struct Defaults
+    {
+        MemoryBlock state;
+        AudioProcessor::BusesLayout layout;
+    };
+
+    struct Usage
+    {
+        PluginDescription desc;
+        int count = 0;
+    };
+
+    AudioPluginFormatManager& formats;
+    CriticalSection lock;
+    OwnedArray<AudioProcessor> returned;
+    OwnedArray<AudioProcessor> awaitingEditor;
+
+    std::map<String, OwnedArray<AudioPluginInstance>> idle;
+    std::map<String, Defaults> defaults;
+    std::map<String, Usage> usage;
+    Array<PluginDescription> warmList;
+    String pending;
+    StringArray failed;
+
+    double sampleRate = 44100.0;
+    int blockSize = 512;
+    int maxPerPlugin = 2, maxTotal = 8, numRecent = 4;
+
+    String keyFor (const PluginDescription& desc) const;
+    int getNumIdleInternal() const;
+    bool addIdle (const String& key, std::unique_ptr<AudioPluginInstance> instance);
+    bool findPluginToWarm (PluginDescription& result) const;
+    void warmNext();
+
+    void handleAsyncUpdate() override;
+    void timerCallback() override;
+};
+
+}
@@ -17,8 +17,13 @@
     Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include "session/PluginCatalog.h"
+#include "session/PluginInstancePool.h"
 #include "session/PluginManager.h"
+#include "session/PluginSandbox.h"
+#include "session/PluginScanCache.h"
 #include "session/Node.h"
+#include "engine/nodes/AudioProcessorNode.h"
 #include "engine/nodes/NodeTypes.h"
 #include "engine/nodes/SubGraphProcessor.h"
 #include "engine/NodeFactory.h"
@@ -28,211 +33,477 @@
 
 #define EL_DEAD_AUDIO_PLUGINS_FILENAME          "DeadAudioPlugins.txt"
 #define EL_PLUGIN_SCANNER_SLAVE_LIST_PATH       "Temp/SlavePluginList.xml"
-#define EL_PLUGIN_SCANNER_WAITING_STATE         "waiting"
-#define EL_PLUGIN_SCANNER_READY_STATE           "ready"
 
 #define EL_PLUGIN_SCANNER_READY_ID              "ready"
-#define EL_PLUGIN_SCANNER_START_ID              "start"
-#define EL_PLUGIN_SCANNER_FINISHED_ID           "finished"
+#define EL_PLUGIN_SCANNER_LIST_ID               "list"
+#define EL_PLUGIN_SCANNER_FILES_ID              "files"
+#define EL_PLUGIN_SCANNER_CACHED_ID             "cached"
+#define EL_PLUGIN_SCANNER_FILE_ID               "file"
+#define EL_PLUGIN_SCANNER_TYPES_ID              "types"
+#define EL_PLUGIN_SCANNER_LOST_ID               "lost"
 
 #define EL_PLUGIN_SCANNER_DEFAULT_TIMEOUT       20000  // 20 Seconds
+#define EL_PLUGIN_SCANNER_FILE_TIMEOUT          60000  // 1 Minute
+#define EL_PLUGIN_PATH_WATCH_INTERVAL           5000   // 5 Seconds
 
 namespace Element {
 
 static const char* pluginListKey() { return Settings::pluginListKey; }
+/* the catalog is per architecture like the settings key it replaces */
+static File pluginCatalogFile() { return DataPath::applicationDataDir().getChildFile (String (pluginListKey()) + ".dat"); }
 /* noop. prevent OS error dialogs from child process */ 
 static void pluginScannerSlaveCrashHandler (void*) { }
 
-class PluginScannerMaster : public kv::ChildProcessMaster,
-                            public AsyncUpdater
+/* Scanner messages are "type:payload". Returns the type and puts the
+   rest in payload, which may be binary */
+static String splitScannerMessage (const MemoryBlock& mb, MemoryBlock& payload)
+{
+    const auto* const data = static_cast<const char*> (mb.getData());
+    const auto size = mb.getSize();
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (data[i] == ':')
+        {
+            payload = MemoryBlock (data + i + 1, size - i - 1);
+            return String::fromUTF8 (data, (int) i);
+        }
+    }
+
+    payload.setSize (0);
+    return String::fromUTF8 (data, (int) size);
+}
+
+static MemoryBlock createScannerMessage (const String& type, const String& message)
+{
+    String data = type; data << ":" << message;
+    return MemoryBlock (data.toRawUTF8(), data.getNumBytesAsUTF8());
+}
+
+/** Runs a pool of scanner processes. The first process lists the plugin
+    files which are new or changed since the last scan, then every process
+    takes one file at a time from the queue. A process that crashes or takes
+    too long on a file is replaced and only that file gets blacklisted.
+    Plugins found are added to the known list as each file finishes and the
+    results are kept in the scan cache.
+ */
+class PluginScannerMaster : public AsyncUpdater,
+                            private Timer
 {
 public:
     explicit PluginScannerMaster (PluginScanner& o) : owner(o) { }
-    ~PluginScannerMaster() { }
+    ~PluginScannerMaster()
+    {
+        cancel();
+    }
     
-    bool startScanning (const StringArray& names = StringArray())
+    bool startScanning (const StringArray& names, int numWorkersToUse, int timeout)
     {
         if (isRunning())
             return true;
         
+        cancel();
+        formatNames     = names;
+        fileTimeout     = timeout > 0 ? timeout : EL_PLUGIN_SCANNER_FILE_TIMEOUT;
+        numWorkers      = numWorkersToUse > 0 ? numWorkersToUse : SystemStats::getNumCpus();
+        numWorkers      = jmax (1, numWorkers);
+        listed          = false;
+        numFinished     = 0;
+        nextJob         = 0;
+        jobs.clearQuick();
+        cache.load (PluginScanCache::getDefaultFile());
+
+        workers.add (nullptr);
+        if (! launchWorker (0))
+        {
+            cancel();
+            return false;
+        }
+
         {
             ScopedLock sl (lock);
-            slaveState  = "waiting";
-            running     = false;
-            formatNames = names;
+            running = true;
         }
-        
-        const bool res = launchScanner();
-        
+
+        startTimer (250);
+        return true;
+    }
+
+    void cancel()
+    {
+        stopTimer();
+        cancelPendingUpdate();
+        if (listed)
+            saveCache();
+
+        for (auto* worker : workers)
+            if (worker != nullptr && worker->ready)
+                worker->sendMessageToSlave (MemoryBlock ("quit", 4));
+        workers.clear();
+        jobs.clearQuick();
+
+        ScopedLock sl (lock);
+        events.clearQuick();
+        running = false;
+    }
+
+    /** Called from the worker connection threads */
+    void post (int serial, const MemoryBlock& message)
+    {
         {
             ScopedLock sl (lock);
-            running = res;
+            events.add ({ serial, message });
         }
-        
-        return res;
+
+        triggerAsyncUpdate();
     }
-    
-    void handleMessageFromSlave (const MemoryBlock& mb) override
+
+    void handleAsyncUpdate() override
     {
-        const auto data (mb.toString());
-        const auto type (data.upToFirstOccurrenceOf (":", false, false));
-        const auto message (data.fromFirstOccurrenceOf (":", false, false));
-        
-        if (type == "state")
+        Array<Event> pending;
         {
             ScopedLock sl (lock);
-            const String lastState = slaveState;
-            slaveState = message;
-            if (lastState != slaveState)
+            pending.swapWith (events);
+        }
+
+        for (const auto& event : pending)
+            handleEvent (event);
+
+        dispatchJobs();
+
+        // stops early if no process could be launched
+        if (listed && (nextJob >= jobs.size() || ! hasWorkers()) && ! hasBusyWorkers())
+            finish();
+    }
+
+    float getProgress() const
+    {
+        return jobs.isEmpty() ? -1.f : (float) numFinished / (float) jobs.size();
+    }
+    
+    bool isRunning() const
+    {
+        ScopedLock sl (lock);
+        return running;
+    }
+
+    Array<PluginScanner::WorkerStatus> getWorkerStatus() const
+    {
+        Array<PluginScanner::WorkerStatus> status;
+        const auto now = Time::getMillisecondCounter();
+        for (int i = 0; i < workers.size(); ++i)
+        {
+            PluginScanner::WorkerStatus s;
+            s.index = i;
+            if (auto* worker = workers.getUnchecked (i))
             {
-                ScopedUnlock sul (lock);
-                triggerAsyncUpdate();
+                s.running       = worker->ready;
+                s.format        = worker->format;
+                s.file          = worker->file;
+                s.seconds       = worker->file.isEmpty() ? 0.0 : 0.001 * (double) (now - worker->started);
+                s.numScanned    = worker->numScanned;
+                s.numFailed     = worker->numFailed;
             }
+            status.add (s);
         }
-        else if (type == "name")
+        return status;
+    }
+    
+private:
+    PluginScanner& owner;
+
+    class Worker : public kv::ChildProcessMaster
+    {
+    public:
+        Worker (PluginScannerMaster& m, int s) : master (m), serial (s) { }
+        ~Worker() { }
+
+        void handleMessageFromSlave (const MemoryBlock& mb) override
         {
-            owner.listeners.call (&PluginScanner::Listener::audioPluginScanStarted, message.trim());
-            ScopedLock sl (lock);
-            pluginBeingScanned = message.trim();
+            master.post (serial, mb);
         }
-        else if (type == "progress")
+
+        void handleConnectionLost() override
         {
-            float newProgress = (float) var (message);
-            owner.listeners.call (&PluginScanner::Listener::audioPluginScanProgress, newProgress);
-            ScopedLock sl (lock);
-            progress = newProgress;
+            master.post (serial, MemoryBlock (EL_PLUGIN_SCANNER_LOST_ID ":", 5));
         }
+
+        PluginScannerMaster& master;
+        const int serial;
+        bool ready = false;
+        String format, file;
+        uint32 started = 0;
+        int numScanned = 0, numFailed = 0;
+    };
+
+    struct Event
+    {
+        int serial;
+        MemoryBlock message;
+    };
+
+    struct Job
+    {
+        String format, file;
+    };
+
+    CriticalSection lock;
+    bool running = false;
+    Array<Event> events;
+
+    OwnedArray<Worker> workers;
+    int nextSerial  = 0;
+    int numWorkers  = 1;
+    int fileTimeout = EL_PLUGIN_SCANNER_FILE_TIMEOUT;
+    StringArray formatNames;
+
+    Array<Job> jobs;
+    int nextJob     = 0;
+    int numFinished = 0;
+    bool listed     = false;
+    PluginScanCache cache;
+
+    void saveCache()
+    {
+        cache.removeMissingFiles();
+        cache.save (PluginScanCache::getDefaultFile());
     }
-    
-    void handleConnectionLost() override
+
+    bool launchWorker (int index)
     {
-        // this probably will happen when a plugin crashes.
+        std::unique_ptr<Worker> worker (new Worker (*this, ++nextSerial));
+        if (auto* old = workers.getUnchecked (index))
         {
-            ScopedLock sl (lock);
-            running = false;
+            worker->numScanned = old->numScanned;
+            worker->numFailed  = old->numFailed;
         }
-        
-        triggerAsyncUpdate();
+
+        const bool launched = worker->launchSlaveProcess (
+            File::getSpecialLocation (File::invokedExecutableFile),
+            EL_PLUGIN_SCANNER_PROCESS_ID, EL_PLUGIN_SCANNER_DEFAULT_TIMEOUT, 0);
+        workers.set (index, launched ? worker.release() : nullptr, true);
+        return launched;
     }
-    
-    void handleAsyncUpdate() override
+
+    Worker* findWorker (int serial) const
     {
-        const auto state = getSlaveState();
-        if (state == "ready" && isRunning())
+        for (auto* worker : workers)
+            if (worker != nullptr && worker->serial == serial)
+                return worker;
+        return nullptr;
+    }
+
+    bool hasBusyWorkers() const
+    {
+        for (auto* worker : workers)
+            if (worker != nullptr && worker->file.isNotEmpty())
+                return true;
+        return false;
+    }
+
+    bool hasWorkers() const
+    {
+        for (auto* worker : workers)
+            if (worker != nullptr)
+                return true;
+        return false;
+    }
+
+    void handleEvent (const Event& event)
+    {
+        auto* worker = findWorker (event.serial);
+        if (worker == nullptr)
+            return; // from a process that was already replaced
+
+        MemoryBlock payload;
+        const auto type = splitScannerMessage (event.message, payload);
+
+        if (type == "state")
         {
-            String msg = "scan:"; msg << formatNames.joinIntoString(",");
-            MemoryBlock mb (msg.toRawUTF8(), msg.length());
-            sendMessageToSlave (mb);
+            if (payload.toString() == EL_PLUGIN_SCANNER_READY_ID)
+            {
+                worker->ready = true;
+                if (! listed && worker == workers.getFirst())
+                    worker->sendMessageToSlave (createScannerMessage (EL_PLUGIN_SCANNER_LIST_ID,
+                                                                      formatNames.joinIntoString (",")));
+            }
         }
-        else if (state == "scanning")
+        else if (type == EL_PLUGIN_SCANNER_CACHED_ID)
         {
-            if (! isRunning())
+            // unchanged files whose plugins were missing from the list
+            MemoryInputStream input (payload, false);
+            const auto cached = ValueTree::readFromStream (input);
+            for (int i = 0; i < cached.getNumChildren(); ++i)
             {
-                DBG("[EL] a plugin crashed or timed out during scan");
-                updateListAndLaunchSlave();
+                String format, file;
+                PluginScanCache::Entry entry;
+                if (! PluginScanCache::restoreEntry (cached.getChild (i), format, file, entry))
+                    continue;
+                cache.record (format, file, entry.fingerprint, entry.status, entry.types);
+                for (const auto& desc : entry.types)
+                    owner.list.addType (desc);
             }
-            else
+        }
+        else if (type == EL_PLUGIN_SCANNER_FILES_ID)
+        {
+            for (const auto& line : StringArray::fromLines (payload.toString()))
             {
-                DBG("[EL] scanning... and running....");
+                const auto format = line.upToFirstOccurrenceOf ("\t", false, false);
+                const auto file   = line.fromFirstOccurrenceOf ("\t", false, false);
+                if (format.isNotEmpty() && file.isNotEmpty())
+                    jobs.add ({ format, file });
+            }
+
+            listed = true;
+            DBG("[EL] scanning " << jobs.size() << " plugin files");
+            for (int i = workers.size(); i < jmin (numWorkers, jobs.size()); ++i)
+            {
+                workers.add (nullptr);
+                launchWorker (i);
             }
         }
-		else if (state == "finished")
-		{
-			DBG("[EL] slave finished scanning");
-			{
-				ScopedLock sl(lock);
-				running = false;
-				slaveState = "idle";
-			}
-            owner.listeners.call (&PluginScanner::Listener::audioPluginScanFinished);
-			
-        }
-        else if (state == "waiting")
-        {
-            if (! isRunning())
+        else if (type == EL_PLUGIN_SCANNER_TYPES_ID)
+        {
+            MemoryInputStream input (payload, false);
+            const auto types = ValueTree::readFromStream (input);
+            Array<PluginDescription> found;
+            for (int i = 0; i < types.getNumChildren(); ++i)
+            {
+                std::unique_ptr<XmlElement> xml (types.getChild(i).createXml());
+                PluginDescription desc;
+                if (xml != nullptr && desc.loadFromXml (*xml))
+                {
+                    owner.list.addType (desc);
+                    found.add (desc);
+                }
+            }
+
+            if (worker->file.isNotEmpty())
             {
-                DBG("[EL] waiting for plugin scanner");
-                updateListAndLaunchSlave();
+                PluginScanCache::Fingerprint fingerprint;
+                fingerprint.size     = types.getProperty ("size");
+                fingerprint.modified = types.getProperty ("modified");
+                fingerprint.hash     = types.getProperty ("hash").toString();
+                cache.record (worker->format, worker->file, fingerprint,
+                              PluginScanCache::Scanned, found);
+                if (found.isEmpty())
+                    owner.failedIdentifiers.addIfNotAlreadyThere (worker->file);
             }
+            ++worker->numScanned;
+            finishJob (*worker);
         }
-		else if (slaveState == "quitting")
-		{
-			return;
-		}
-        else
+        else if (type == EL_PLUGIN_SCANNER_LOST_ID)
         {
-            DBG("[EL] invalid slave state: " << state);
+            const int index = workers.indexOf (worker);
+            if (worker->file.isNotEmpty())
+            {
+                DBG("[EL] plugin crashed during scan: " << worker->file);
+                failJob (*worker);
+            }
+            else if (! listed && index == 0)
+            {
+                DBG("[EL] plugin scanner lost while listing files");
+                listed = true;
+            }
+
+            if (nextJob < jobs.size() || ! listed)
+                launchWorker (index);
+            else
+                workers.set (index, nullptr, true);
         }
     }
-    
-    const String getSlaveState() const
+
+    void dispatchJobs()
     {
-        ScopedLock sl (lock);
-        return slaveState;
+        for (auto* worker : workers)
+        {
+            if (nextJob >= jobs.size())
+                break;
+            if (worker == nullptr || ! worker->ready || worker->file.isNotEmpty())
+                continue;
+
+            const auto& job = jobs.getReference (nextJob++);
+            worker->format  = job.format;
+            worker->file    = job.file;
+            worker->started = Time::getMillisecondCounter();
+            worker->sendMessageToSlave (createScannerMessage (EL_PLUGIN_SCANNER_FILE_ID,
+                                                              job.format + "\t" + job.file));
+            owner.listeners.call (&PluginScanner::Listener::audioPluginScanStarted, job.file);
+        }
     }
-    
-    float getProgress() const
+
+    void finishJob (Worker& worker)
     {
-        ScopedLock sl (lock);
-        return progress;
+        worker.format = worker.file = String();
+        ++numFinished;
+        owner.listeners.call (&PluginScanner::Listener::audioPluginScanProgress, getProgress());
     }
-    
-    bool isRunning() const
+
+    void failJob (Worker& worker)
     {
-        ScopedLock sl (lock);
-        return running;
+        cache.record (worker.format, worker.file,
+                      PluginScanCache::Fingerprint::forFile (worker.file, false),
+                      PluginScanCache::Blacklisted, {});
+        owner.list.addToBlacklist (worker.file);
+        owner.failedIdentifiers.addIfNotAlreadyThere (worker.file);
+        ++worker.numFailed;
+        finishJob (worker);
     }
-    
-    bool sendQuitMessage()
+
+    void timerCallback() override
     {
-        if (isRunning())
-            return sendMessageToSlave (MemoryBlock ("quit", 4));
-        return false;
-    }
-    
-private:
-    PluginScanner& owner;
+        const auto now = Time::getMillisecondCounter();
+        bool changed = false;
 
-    CriticalSection lock;
-    bool running    = false;
-    float progress  = 0.f;
-    String slaveState;
-    StringArray formatNames;
-    StringArray faileFiles;
-    
-    String pluginBeingScanned;
+        for (int i = 0; i < workers.size(); ++i)
+        {
+            auto* worker = workers.getUnchecked (i);
+            if (worker == nullptr || worker->file.isEmpty())
+                continue;
+            if (now - worker->started < (uint32) fileTimeout)
+                continue;
+
+            DBG("[EL] plugin timed out during scan: " << worker->file);
+            failJob (*worker);
+            launchWorker (i);
+            changed = true;
+        }
 
-    void updateListAndLaunchSlave()
-    {
-        if (auto xml = XmlDocument::parse (PluginScanner::getSlavePluginListFile()))
-            owner.list.recreateFromXml (*xml);
-        
-        const bool res = launchScanner();
-        ScopedLock sl (lock);
-        running = res;
-    }
-    
-    void resetScannerVariables()
-    {
-        ScopedLock sl (lock);
-        pluginBeingScanned = String();
-        progress = -1.f;
+        if (changed)
+            triggerAsyncUpdate();
     }
-    
-    bool launchScanner (const int timeout = EL_PLUGIN_SCANNER_DEFAULT_TIMEOUT, const int flags = 0)
+
+    void finish()
     {
-        resetScannerVariables();
-        return launchSlaveProcess (File::getSpecialLocation (File::invokedExecutableFile),
-                                   EL_PLUGIN_SCANNER_PROCESS_ID, timeout, flags);
+        DBG("[EL] plugin scan finished");
+        stopTimer();
+        for (auto* worker : workers)
+            if (worker != nullptr && worker->ready)
+                worker->sendMessageToSlave (MemoryBlock ("quit", 4));
+        workers.clear();
+        saveCache();
+
+        const auto file = PluginScanner::getSlavePluginListFile();
+        file.getParentDirectory().createDirectory();
+        if (auto xml = owner.list.createXml())
+            xml->writeToFile (file, String());
+
+        {
+            ScopedLock sl (lock);
+            running = false;
+        }
+
+        // listeners may delete this scanner
+        owner.listeners.call (&PluginScanner::Listener::audioPluginScanFinished);
     }
 };
 
+/** The child process side of the scanner. Lists plugin files or finds the
+    plugins in a single file when the master asks */
 class PluginScannerSlave : public kv::ChildProcessSlave, public AsyncUpdater
 {
 public:
     PluginScannerSlave()
     {
-        scanFile = PluginScanner::getSlavePluginListFile();
         SystemStats::setApplicationCrashHandler (pluginScannerSlaveCrashHandler);
     }
     
@@ -240,9 +511,8 @@ public:
     
     void handleMessageFromMaster (const MemoryBlock& mb) override
     {
-        const auto data (mb.toString());
-        const auto type (data.upToFirstOccurrenceOf (":", false, false));
-        const auto message (data.fromFirstOccurrenceOf (":", false, false));
+        MemoryBlock payload;
+        const auto type = splitScannerMessage (mb, payload);
         
         if (type == "quit")
         {
@@ -250,74 +520,36 @@ public:
             return;
         }
         
-        if (type == "scan")
         {
-            const auto formats (StringArray::fromTokens (message.trim(), ",", "'"));
-            formatsToScan = formats;
-            triggerAsyncUpdate();
+            ScopedLock sl (lock);
+            tasks.add ({ type, payload.toString() });
         }
+
+        triggerAsyncUpdate();
     }
     
     void handleAsyncUpdate() override
     {
-        if (! scanFile.existsAsFile())
+        Array<Task> pending;
         {
-            sendState ("scanning");
-            sendState ("finished");
-            return;
+            ScopedLock sl (lock);
+            pending.swapWith (tasks);
         }
-        
-        updateScanFileWithSettings();
-        
-        sendState ("scanning");
-        
-        for (const auto& format : formatsToScan)
-            scanFor (format);
-        
-        settings->saveIfNeeded();
-        sendState ("finished");
 
-       #if JUCE_LINUX
-        // workaround to get the background process to quit
-        handleConnectionLost();
-       #endif
-    }
-    
-    void updateScanFileWithSettings()
-    {
-        if (! plugins)
-            return;
-        
-        auto& list = plugins->getKnownPlugins();
-        const auto types = list.getTypes();
-        for (const auto& type : types)
-            pluginList.addType (type);
-        
-        for (const auto& file : list.getBlacklistedFiles())
-            pluginList.addToBlacklist (file);
-        
-        writePluginListNow();
+        for (const auto& task : pending)
+        {
+            if (task.type == EL_PLUGIN_SCANNER_LIST_ID)
+                listFiles (StringArray::fromTokens (task.message.trim(), ",", "'"));
+            else if (task.type == EL_PLUGIN_SCANNER_FILE_ID)
+                scanFile (task.message.upToFirstOccurrenceOf ("\t", false, false),
+                          task.message.fromFirstOccurrenceOf ("\t", false, false));
+        }
     }
     
     void handleConnectionMade() override
     {
-        settings    = new Settings();
-        plugins     = new PluginManager();
-        
-        if (! scanFile.existsAsFile())
-            scanFile.create();
-        
-        if (auto xml = XmlDocument::parse (scanFile))
-            pluginList.recreateFromXml (*xml);
-        
-        // This must happen before user settings, PluginManager will delete the deadman file
-        // when restoring user plugins
-        PluginDirectoryScanner::applyBlacklistingsFromDeadMansPedal (
-            pluginList, plugins->getDeadAudioPluginsFile());
-        
+        plugins = new PluginManager();
         plugins->addDefaultFormats();
-        plugins->restoreUserPlugins (*settings);
-        
         sendState (EL_PLUGIN_SCANNER_READY_ID);
     }
     
@@ -325,33 +557,19 @@ public:
     {
         settings    = nullptr;
         plugins     = nullptr;
-        scanner     = nullptr;
         exit (0);
     }
 
 private:
+    struct Task
+    {
+        String type, message;
+    };
+
+    CriticalSection lock;
+    Array<Task> tasks;
     ScopedPointer<Settings> settings;
     ScopedPointer<PluginManager> plugins;
-    ScopedPointer<PluginDirectoryScanner> scanner;
-    String fileOrIdentifier;
-    KnownPluginList pluginList;
-    StringArray filesToSkip;
-    File scanFile;
-    StringArray formatsToScan;
-    
-    void applyDeadPlugins()
-    {
-        PluginDirectoryScanner::applyBlacklistingsFromDeadMansPedal (
-            pluginList, plugins->getDeadAudioPluginsFile());
-    }
-    
-    bool writePluginListNow()
-    {
-        applyDeadPlugins();
-        if (auto xml = pluginList.createXml())
-            return xml->writeToFile (scanFile, String());
-        return false;
-    }
     
     bool sendState (const String& state)
     {
@@ -360,53 +578,102 @@ private:
     
     bool sendString (const String& type, const String& message)
     {
-		String data = type; data << ":" << message.trim();
-		MemoryBlock mb (data.toRawUTF8(), data.getNumBytesAsUTF8());
-        return sendMessageToMaster (mb);
+        return sendMessageToMaster (createScannerMessage (type, message.trim()));
     }
-    
-    bool doNextScan()
+
+    /** Sends the files in the user's search paths which are new or changed
+        since the last scan, one "format<tab>file" per line. Cache entries for
+        unchanged files the known list is missing are sent first */
+    void listFiles (const StringArray& formats)
     {
-        const auto nextFile = scanner->getNextPluginFileThatWillBeScanned();
-        sendString ("name", nextFile);
-        for (const auto& file : scanner->getFailedFiles())
-            pluginList.addToBlacklist (file);
+        if (plugins == nullptr)
+            return;
 
-        if (scanner->scanNextFile (true, fileOrIdentifier))
+        if (settings == nullptr)
         {
-            writePluginListNow();
-            return true;
+            settings = new Settings();
+            plugins->restoreUserPlugins (*settings);
         }
-        
-        return false;
+
+        auto& known = plugins->getKnownPlugins();
+        const auto blacklisted = known.getBlacklistedFiles();
+        std::map<String, Array<PluginDescription>> knownTypes;
+        for (const auto& type : known.getTypes())
+            knownTypes[type.fileOrIdentifier].add (type);
+
+        PluginScanCache cache;
+        cache.load (PluginScanCache::getDefaultFile());
+        ValueTree cached (EL_PLUGIN_SCANNER_CACHED_ID);
+        String files;
+
+        for (const auto& formatName : formats)
+        {
+            auto* format = plugins->getAudioPluginFormat (formatName);
+            if (format == nullptr)
+                continue;
+
+            const auto key = String (settings->lastPluginScanPathPrefix) + format->getName();
+            FileSearchPath path (settings->getUserSettings()->getValue (key));
+            for (const auto& file : format->searchPathsForPlugins (path, true, false))
+            {
+                if (blacklisted.contains (file))
+                    continue;
+
+                const auto* entry = cache.find (formatName, file);
+                if (entry != nullptr && entry->status == PluginScanCache::Scanned
+                    && cache.isUpToDate (formatName, file))
+                {
+                    if (! entry->types.isEmpty() && knownTypes.find (file) == knownTypes.end())
+                        cached.appendChild (PluginScanCache::createValueTree (formatName, file, *entry), nullptr);
+                    continue;
+                }
+
+                if (entry == nullptr && known.isListingUpToDate (file, *format))
+                {
+                    // not cached yet, fingerprint what the list already has
+                    PluginScanCache::Entry seed;
+                    seed.fingerprint = PluginScanCache::Fingerprint::forFile (file, false);
+                    seed.types = knownTypes[file];
+                    if (seed.fingerprint.isValid())
+                        cached.appendChild (PluginScanCache::createValueTree (formatName, file, seed), nullptr);
+                    continue;
+                }
+
+                files << format->getName() << "\t" << file << "\n";
+            }
+        }
+
+        if (cached.getNumChildren() > 0)
+            sendTree (EL_PLUGIN_SCANNER_CACHED_ID, cached);
+        sendString (EL_PLUGIN_SCANNER_FILES_ID, files);
     }
-    
-    void scanFor (const String& formatName)
+
+    void scanFile (const String& formatName, const String& file)
     {
-        if (plugins == nullptr || settings == nullptr)
-            return;
-        if (auto* format = plugins->getAudioPluginFormat (formatName))
-            scanFor (*format);
+        ValueTree types (EL_PLUGIN_SCANNER_TYPES_ID);
+        const auto fingerprint = PluginScanCache::Fingerprint::forFile (file, true);
+        types.setProperty ("size", fingerprint.size, nullptr)
+             .setProperty ("modified", fingerprint.modified, nullptr)
+             .setProperty ("hash", fingerprint.hash, nullptr);
+
+        if (auto* format = plugins != nullptr ? plugins->getAudioPluginFormat (formatName) : nullptr)
+        {
+            OwnedArray<PluginDescription> found;
+            format->findAllTypesForFile (found, file);
+            for (const auto* desc : found)
+                if (auto xml = std::unique_ptr<XmlElement> (desc->createXml()))
+                    types.appendChild (ValueTree::fromXml (*xml), nullptr);
+        }
+
+        sendTree (EL_PLUGIN_SCANNER_TYPES_ID, types);
     }
-    
-    void scanFor (AudioPluginFormat& format)
+
+    bool sendTree (const String& type, const ValueTree& tree)
     {
-        if (plugins == nullptr || settings == nullptr)
-            return;
-        
-        const auto key = String(settings->lastPluginScanPathPrefix) + format.getName();
-        FileSearchPath path (settings->getUserSettings()->getValue (key));
-        scanner = new PluginDirectoryScanner (pluginList, format, path, true,
-                                              plugins->getDeadAudioPluginsFile(),
-                                              false);
-        
-        while (doNextScan())
-            sendString ("progress", String (scanner->getProgress()));
-        
-        writePluginListNow();
-        #if JUCE_LINUX
-        Thread::sleep (1000);
-        #endif
+        MemoryOutputStream message;
+        message << type << ":";
+        tree.writeToStream (message);
+        return sendMessageToMaster (message.getMemoryBlock());
     }
 };
 
@@ -423,14 +690,31 @@ void PluginScanner::cancel()
 {
     if (master)
     {
-        master->cancelPendingUpdate();
-        master->sendQuitMessage();
+        master->cancel();
 		master.reset();
     }
 }
 
 bool PluginScanner::isScanning() const { return master && master->isRunning(); }
 
+void PluginScanner::setNumWorkers (int newNumWorkers)   { numWorkers = newNumWorkers; }
+int PluginScanner::getNumWorkers() const
+{
+    return numWorkers > 0 ? numWorkers : SystemStats::getNumCpus();
+}
+
+void PluginScanner::setFileTimeout (int milliseconds)   { fileTimeout = milliseconds; }
+
+float PluginScanner::getProgress() const
+{
+    return master ? master->getProgress() : -1.f;
+}
+
+Array<PluginScanner::WorkerStatus> PluginScanner::getWorkerStatus() const
+{
+    return master ? master->getWorkerStatus() : Array<WorkerStatus>();
+}
+
 void PluginScanner::scanForAudioPlugins (const juce::String &formatName)
 {
     scanForAudioPlugins (StringArray ({ formatName }));
@@ -440,11 +724,12 @@ void PluginScanner::scanForAudioPlugins (const StringArray& formats)
 {
     cancel();
     getSlavePluginListFile().deleteFile();
+    failedIdentifiers.clearQuick();
 	if (master == nullptr)
 		master.reset (new PluginScannerMaster (*this));
 	if (master->isRunning())
 		return;
-    master->startScanning (formats);
+    master->startScanning (formats, numWorkers, fileTimeout);
 }
 
 void PluginScanner::timerCallback()
@@ -539,18 +824,119 @@ private:
     }
 };
 
+// MARK: Plugin Path Watcher
+
+/** Polls the user's plugin search paths and starts a background scan when
+    a directory in them is added, removed or modified. The scan cache keeps
+    that scan to the files which actually changed. Only directories are
+    walked, since adding or replacing a plugin touches its parent */
+class PluginPathWatcher : private Thread,
+                          private AsyncUpdater
+{
+public:
+    explicit PluginPathWatcher (PluginManager& o) : Thread ("elppw"), owner (o) { }
+
+    ~PluginPathWatcher()
+    {
+        stop();
+    }
+
+    void start (PropertiesFile* props)
+    {
+        stop();
+        if (props == nullptr)
+            return;
+
+        paths.clear();
+        for (const auto& f : Util::getSupportedAudioPluginFormats())
+        {
+            const auto key = String (Settings::lastPluginScanPathPrefix) + f;
+            FileSearchPath path (props->getValue (key));
+            for (int i = 0; i < path.getNumPaths(); ++i)
+                paths.addIfNotAlreadyThere (path[i]);
+        }
+
+        if (! paths.isEmpty())
+            startThread (1);
+    }
+
+    void stop()
+    {
+        signalThreadShouldExit();
+        notify();
+        stopThread (2000);
+        cancelPendingUpdate();
+    }
+
+    bool isWatching() const { return isThreadRunning(); }
+
+private:
+    PluginManager& owner;
+    Array<File> paths;
+
+    // unsigned so the hash wraps instead of overflowing
+    uint64 createFingerprint()
+    {
+        uint64 fingerprint = 0;
+        for (const auto& dir : paths)
+        {
+            if (threadShouldExit())
+                break;
+            fingerprint = fingerprint * 31 + (uint64) dir.getLastModificationTime().toMilliseconds();
+            for (const auto& entry : RangedDirectoryIterator (dir, true, "*", File::findDirectories))
+            {
+                if (threadShouldExit())
+                    break;
+                fingerprint = fingerprint * 31 + (uint64) entry.getModificationTime().toMilliseconds()
+                                               + (uint64) entry.getFile().getFullPathName().hashCode64();
+            }
+        }
+        return fingerprint;
+    }
+
+    void run() override
+    {
+        auto last = createFingerprint();
+        while (! threadShouldExit())
+        {
+            wait (EL_PLUGIN_PATH_WATCH_INTERVAL);
+            if (threadShouldExit())
+                break;
+
+            const auto current = createFingerprint();
+            if (current != last && ! threadShouldExit())
+            {
+                last = current;
+                triggerAsyncUpdate();
+            }
+        }
+    }
+
+    void handleAsyncUpdate() override
+    {
+        DBG("[EL] plugin search paths changed");
+        owner.scanAudioPlugins();
+    }
+};
+
 // MARK: Plugin Manager
     
-class PluginManager::Private : public PluginScanner::Listener
+class PluginManager::Private : public PluginScanner::Listener,
+                               public ChangeListener
 {
 public:
 	Private (PluginManager& o)
-        : owner(o)
+        : owner(o), watcher (o)
 	{
+        pool = std::make_shared<PluginInstancePool> (formats);
 		deadAudioPlugins = DataPath::applicationDataDir().getChildFile(EL_DEAD_AUDIO_PLUGINS_FILENAME);
+        allPlugins.addChangeListener (this);
 	}
 
-	~Private() {  }
+	~Private()
+    {
+        allPlugins.removeChangeListener (this);
+    }
 
 	/** returns true if anything changed in the plugin list */
 	bool updateBlacklistedAudioPlugins()
@@ -575,20 +961,62 @@ public:
 
     void getUnverifiedPlugins (const String& format, OwnedArray<PluginDescription>& plugs)
     {
+        restoreListIfNeeded();
         unverified.getPlugins (plugs, format, allPlugins);
     }
 
+    /** Decodes the catalog into the known list the first time the list is
+        used. Lookups during startup and session loads go to the catalog */
+    void restoreListIfNeeded()
+    {
+        if (! listPending)
+            return;
+
+        listPending = false;
+        catalog.restore (allPlugins);
+        owner.scanInternalPlugins();
+        updateBlacklistedAudioPlugins();
+        writeCatalog();
+    }
+
+    /** Writes the known list to the catalog if it changed, then maps it */
+    bool writeCatalog()
+    {
+        // the catalog is what the list would be restored from
+        if (listPending)
+            return catalog.isOpen();
+        if (catalog.isOpen() && catalog.getListHash() == PluginCatalog::createHash (allPlugins))
+            return true;
+
+        const auto file = pluginCatalogFile();
+        catalog.close(); // can't replace a mapped file on windows
+        const bool ok = PluginCatalog::write (allPlugins, file);
+        catalog.open (file);
+        return ok;
+    }
+
+    /** Keeps the catalog in step with the known list once it's in use */
+    void changeListenerCallback (ChangeBroadcaster*) override
+    {
+        if (catalog.isOpen())
+            writeCatalog();
+    }
+
 private:
 	friend class PluginManager;
 	PluginManager& owner;
 	AudioPluginFormatManager formats;
 	KnownPluginList allPlugins;
+    PluginCatalog catalog;
+    bool listPending = false;
 	File deadAudioPlugins;
     UnverifiedPlugins unverified;
     NodeFactory nodes;
 	double sampleRate = 44100.0;
 	int    blockSize = 512;
+    std::shared_ptr<PluginInstancePool> pool;
 	std::unique_ptr<PluginScanner> scanner;
+    PluginPathWatcher watcher;
 
 	void scanAudioPlugins (const StringArray& names)
 	{
@@ -605,6 +1033,7 @@ private:
 				if (formats.getFormat(i)->getName() != "Element" && formats.getFormat(i)->canScanForPlugins())
 					formatsToScan.add(formats.getFormat(i)->getName());
 
+		restoreListIfNeeded();
 		scanner = std::make_unique<PluginScanner> (allPlugins);
 		scanner->addListener (this);
 		scanner->scanForAudioPlugins (formatsToScan);
@@ -697,7 +1126,7 @@ void PluginManager::addFormat (AudioPluginFormat* fmt)
 void PluginManager::addToKnownPlugins (const PluginDescription& desc)
 {
     auto* const format = getAudioPluginFormat (desc.pluginFormatName);
-    auto& list = priv->allPlugins;
+    auto& list = getKnownPlugins();
     if (format && nullptr == list.getTypeForFile (desc.fileOrIdentifier))
     {
         OwnedArray<PluginDescription> dummy;
@@ -745,20 +1174,49 @@ bool PluginManager::isScanningAudioPlugins()
 
 AudioPluginInstance* PluginManager::createAudioPlugin (const PluginDescription& desc, String& errorMsg)
 {
-    return getAudioPluginFormats().createPluginInstance (
-        desc, priv->sampleRate, priv->blockSize, errorMsg).release();
+    if (auto instance = priv->pool->take (desc))
+        return instance.release();
+
+    auto instance = getAudioPluginFormats().createPluginInstance (
+        desc, priv->sampleRate, priv->blockSize, errorMsg);
+    if (instance != nullptr)
+        priv->pool->instanceCreated (*instance);
+    return instance.release();
 }
 
 NodeObject* PluginManager::createGraphNode (const PluginDescription& desc, String& errorMsg)
+{
+    return createGraphNode (desc, errorMsg, false);
+}
+
+NodeObject* PluginManager::createGraphNode (const PluginDescription& desc, String& errorMsg, bool sandboxed)
 {
     errorMsg.clear();
+
+    if (sandboxed && PluginSandbox::canSandbox (desc))
+    {
+        auto* const plugin = PluginSandbox::createInstance (desc, priv->sampleRate, priv->blockSize, errorMsg);
+        return plugin != nullptr ? priv->nodes.wrap (plugin) : nullptr;
+    }
     
     if (auto* const plugin = createAudioPlugin (desc, errorMsg))
     {
         if (auto* const sub = dynamic_cast<SubGraphProcessor*> (plugin))
             sub->initController (*this);
         plugin->enableAllBuses();
-        return priv->nodes.wrap (plugin);
+        auto* node = priv->nodes.wrap (plugin);
+        if (auto* apn = dynamic_cast<AudioProcessorNode*> (node))
+        {
+            if (PluginInstancePool::canPool (desc))
+            {
+                std::weak_ptr<PluginInstancePool> pool = priv->pool;
+                apn->setRecycler ([pool] (std::unique_ptr<AudioProcessor> processor) {
+                    if (auto p = pool.lock())
+                        p->recycle (std::move (processor));
+                });
+            }
+        }
+        return node;
     }
 
     if (errorMsg.isNotEmpty() && desc.pluginFormatName != EL_INTERNAL_FORMAT_NAME)
@@ -809,48 +1267,68 @@ AudioPluginFormat* PluginManager::getAudioPluginFormat (const String& name) cons
     return nullptr;
 }
 
-KnownPluginList& PluginManager::getKnownPlugins() { return priv->allPlugins; }
-const KnownPluginList& PluginManager::getKnownPlugins() const { return priv->allPlugins; }
+KnownPluginList& PluginManager::getKnownPlugins()
+{
+    priv->restoreListIfNeeded();
+    return priv->allPlugins;
+}
+
+const KnownPluginList& PluginManager::getKnownPlugins() const
+{
+    priv->restoreListIfNeeded();
+    return priv->allPlugins;
+}
 const File& PluginManager::getDeadAudioPluginsFile() const { return priv->deadAudioPlugins; }
 
 void PluginManager::saveUserPlugins (ApplicationProperties& settings)
 {
     setPropertiesFile (settings.getUserSettings());
-    if (auto elm = priv->allPlugins.createXml())
-    {
-        props->setValue (pluginListKey(), elm.get());
-        props->saveIfNeeded();
-    }
+    priv->writeCatalog();
 }
 
 void PluginManager::restoreUserPlugins (ApplicationProperties& settings)
 {
     setPropertiesFile (settings.getUserSettings());
     if (props == nullptr) return;
-    if (auto xml = props->getXmlValue (pluginListKey()))
+
+    if (priv->catalog.open (pluginCatalogFile()))
+    {
+        // decoded when the list is first used, see getKnownPlugins()
+        priv->listPending = true;
+    }
+    else if (auto xml = props->getXmlValue (pluginListKey()))
+    {
+        // list from before the catalog, move it over
 		restoreUserPlugins (*xml);
+        if (priv->catalog.isOpen())
+            props->removeValue (pluginListKey());
+    }
+
     settings.saveIfNeeded();
 }
 
 void PluginManager::restoreUserPlugins (const XmlElement& xml)
 {
+    priv->listPending = false;
 	priv->allPlugins.recreateFromXml (xml);
     scanInternalPlugins();
     priv->updateBlacklistedAudioPlugins();
     if (props == nullptr)
         return;
 
-    if (auto e = priv->allPlugins.createXml())
-    {
-        props->setValue (pluginListKey(), e.get());
-        props->saveIfNeeded();
-    }
+    priv->writeCatalog();
 }
 
 void PluginManager::setPlayConfig (double sampleRate, int blockSize)
 {
     priv->sampleRate = sampleRate;
     priv->blockSize  = blockSize;
+    priv->pool->setPlayConfig (sampleRate, blockSize);
+}
+
+PluginInstancePool& PluginManager::getInstancePool()
+{
+    return *priv->pool;
 }
 
 void PluginManager::scanAudioPlugins (const StringArray& names)
@@ -910,6 +1388,19 @@ void PluginManager::scanInternalPlugins()
     }
 }
 
+void PluginManager::setWatchingPluginPaths (bool shouldWatch)
+{
+    if (shouldWatch)
+        priv->watcher.start (props);
+    else
+        priv->watcher.stop();
+}
+
+bool PluginManager::isWatchingPluginPaths() const
+{
+    return priv->watcher.isWatching();
+}
+
 void PluginManager::getUnverifiedPlugins (const String& formatName, OwnedArray<PluginDescription>& plugins)
 {
     priv->getUnverifiedPlugins (formatName, plugins);
@@ -958,17 +1449,46 @@ PluginDescription PluginManager::findDescriptionFor (const Node& node) const
     const String identifierString (node.getProperty (Tags::pluginIdentifierString).toString());
     bool wasFound = false;
 
+    // the catalog follows the known list, so it is only bypassed when the
+    // list didn't come from one. Pending list changes are written first
+    priv->allPlugins.dispatchPendingMessages();
+    const auto& catalog = priv->catalog;
+    const bool useCatalog = catalog.isOpen();
+
     if (identifierString.isNotEmpty())
     {
-        // fastest, find by identifer string in known plugins
-        if (const auto type = getKnownPlugins().getTypeForIdentifierString (
-            node.getProperty (Tags::pluginIdentifierString).toString()))
+        // fastest, find by identifer string in the catalog's hash index
+        if (useCatalog)
+        {
+            wasFound = catalog.getTypeForIdentifierString (identifierString, desc);
+        }
+        else if (const auto type = getKnownPlugins().getTypeForIdentifierString (identifierString))
         {
             desc = *type;
             wasFound = true;
         }
     }
 
+    if (! wasFound)
+    {
+        // match the saved uid and file, still without loading the plugin
+        PluginDescription saved;
+        node.getPluginDescription (saved);
+        const auto types = useCatalog ? catalog.getTypesForUid (saved.uid)
+                                      : getKnownPlugins().getTypes();
+        for (const auto& type : types)
+        {
+            if (type.uid == saved.uid
+                && type.pluginFormatName == saved.pluginFormatName
+                && type.fileOrIdentifier == saved.fileOrIdentifier)
+            {
+                desc = type;
+                wasFound = true;
+                break;
+            }
+        }
+    }
+
     if (! wasFound)
     {
         // Manually load and search
@@ -29,6 +29,7 @@ class NodeObject;
 class Node;
 class PluginScannerMaster;
 class PluginScanner;
+class PluginInstancePool;
 
 class PluginManager : public ChangeBroadcaster
 {
@@ -45,7 +46,8 @@ public:
     /** Get the dead mans pedal file */
     const File& getDeadAudioPluginsFile() const;
 
-    /** Access to the main known plugins list */
+    /** Access to the main known plugins list. After restoring from the plugin
+        catalog, the list is filled from it the first time this is called */
     KnownPluginList& getKnownPlugins();
     const KnownPluginList& getKnownPlugins() const;
 
@@ -91,14 +93,21 @@ public:
 	    is not suitable for use in loading plugins */
 	String getCurrentlyScannedPluginName() const;
 
+    /** Watches the user's plugin search paths and scans new or changed
+        files in the background when they change */
+    void setWatchingPluginPaths (bool shouldWatch);
+
+    /** Returns true if the plugin search paths are being watched */
+    bool isWatchingPluginPaths() const;
+
     /** Looks for new or updated internal/element plugins */
     void scanInternalPlugins();
     
     /** Save the known plugins to user settings */
     void saveUserPlugins (ApplicationProperties&);
     
-    /** Restore user plugins. Will also scan internal plugins so they don't get removed
-        by accident */
+    /** Restore user plugins. This only maps the plugin catalog, the known list
+        is decoded, and internal plugins scanned, when it is first used */
     void restoreUserPlugins (ApplicationProperties&);
 
     /** Restore user plugins. Will also scan internal plugins so they don't get removed
@@ -108,9 +117,15 @@ public:
     AudioPluginInstance* createAudioPlugin (const PluginDescription& desc, String& errorMsg);
     NodeObject* createGraphNode (const PluginDescription& desc, String& errorMsg);
 
+    /** Creates a node, optionally running its plugin in a sandbox process */
+    NodeObject* createGraphNode (const PluginDescription& desc, String& errorMsg, bool sandboxed);
+
     /** Set the play config used when instantiating plugins */
     void setPlayConfig (double sampleRate, int blockSize);
 
+    /** Returns the pool of idle plugin instances used when creating nodes */
+    PluginInstancePool& getInstancePool();
+
     /** Give a properties file to be used when settings aren't available. FIXME */
     void setPropertiesFile (PropertiesFile* pf) { props = pf; }
     
@@ -143,6 +158,20 @@ public:
     PluginScanner (KnownPluginList&);
     ~PluginScanner();
     
+    /** The state of one scanner process */
+    struct WorkerStatus
+    {
+        int index           = 0;
+        bool running        = false;
+        String format;
+        /** The file being scanned, empty when idle */
+        String file;
+        /** Seconds spent on the current file */
+        double seconds      = 0.0;
+        int numScanned      = 0;
+        int numFailed       = 0;
+    };
+
     class Listener
     {
     public:
@@ -167,6 +196,23 @@ public:
 
     /** is scanning */
     bool isScanning() const;
+
+    /** Sets how many scanner processes to run. Zero or less uses one per
+        CPU core. Takes effect on the next scan */
+    void setNumWorkers (int numWorkers);
+
+    /** Returns how many scanner processes a scan will use */
+    int getNumWorkers() const;
+
+    /** Sets how long a single file may take before its process is killed
+        and the file blacklisted. Zero or less uses the default */
+    void setFileTimeout (int milliseconds);
+
+    /** Returns the fraction of files scanned, or -1 while listing files */
+    float getProgress() const;
+
+    /** Returns what each scanner process is doing */
+    Array<WorkerStatus> getWorkerStatus() const;
     
     /** Add a listener */
     void addListener (Listener* listener)       { listeners.add (listener); }
@@ -184,6 +230,8 @@ private:
     ListenerList<Listener> listeners;
     StringArray failedIdentifiers;
     KnownPluginList& list;
+    int numWorkers  = 0;
+    int fileTimeout = 0;
     void timerCallback() override;
 };
 
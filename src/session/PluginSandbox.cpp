@@ -0,0 +1,1261 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/nodes/NodeTypes.h"
+#include "session/PluginManager.h"
+#include "session/PluginSandbox.h"
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <cerrno>
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+ #if JUCE_LINUX
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+ #else
+  #include <semaphore.h>
+ #endif
+#endif
+
+#define EL_PLUGIN_SANDBOX_MAGIC             0x454c5342  // "ELSB"
+#define EL_PLUGIN_SANDBOX_VERSION           1
+#define EL_PLUGIN_SANDBOX_LAUNCH_TIMEOUT    20000  // 20 Seconds
+#define EL_PLUGIN_SANDBOX_LOAD_TIMEOUT      30000  // 30 Seconds
+#define EL_PLUGIN_SANDBOX_STATE_TIMEOUT     2000   // 2 Seconds
+#define EL_PLUGIN_SANDBOX_STATE_INTERVAL    5000   // 5 Seconds
+#define EL_PLUGIN_SANDBOX_MAX_RESTARTS      5
+
+namespace Element {
+
+/* noop. prevent OS error dialogs from child process */
+static void pluginSandboxSlaveCrashHandler (void*) { }
+
+static MemoryBlock createSandboxMessage (const ValueTree& tree)
+{
+    MemoryOutputStream stream;
+    tree.writeToStream (stream);
+    return stream.getMemoryBlock();
+}
+
+/* MIDI is stored as (sample, size) int32 pairs followed by the bytes.
+   Whatever doesn't fit is dropped */
+static int writeSandboxMidi (const MidiBuffer& midi, uint8* dest, int capacity, int numSamples)
+{
+    int size = 0;
+    for (const auto msg : midi)
+    {
+        const int needed = 8 + msg.numBytes;
+        if (size + needed > capacity)
+            break;
+        const int32 event[2] = { jlimit (0, jmax (0, numSamples - 1), msg.samplePosition), msg.numBytes };
+        memcpy (dest + size, event, 8);
+        memcpy (dest + size + 8, msg.data, (size_t) msg.numBytes);
+        size += needed;
+    }
+    return size;
+}
+
+static void readSandboxMidi (const uint8* src, int size, MidiBuffer& midi)
+{
+    for (int pos = 0; pos + 8 <= size;)
+    {
+        int32 event[2];
+        memcpy (event, src + pos, 8);
+        if (event[1] <= 0 || pos + 8 + event[1] > size)
+            break;
+        midi.addEvent (src + pos + 8, event[1], event[0]);
+        pos += 8 + event[1];
+    }
+}
+
+static size_t alignSandboxSize (size_t size) { return (size + 63) & ~(size_t) 63; }
+
+/* Removes samples from the front of a host side queue. The events after
+   them move up. temp must have room for the events */
+static void removeFromSandboxQueue (AudioSampleBuffer& queue, MidiBuffer& events,
+                                    MidiBuffer& temp, int& numQueued, int count)
+{
+    count = jmin (count, numQueued);
+    if (count <= 0)
+        return;
+
+    numQueued -= count;
+    for (int ch = 0; ch < queue.getNumChannels(); ++ch)
+    {
+        auto* const data = queue.getWritePointer (ch);
+        memmove (data, data + count, sizeof (float) * (size_t) numQueued);
+    }
+
+    temp.clear();
+    temp.addEvents (events, count, -1, -count);
+    events.swapWith (temp);
+}
+
+//=============================================================================
+struct SandboxTransport::Header
+{
+    uint32 magic;
+    uint32 version;
+    int32 numChannels;
+    int32 maxBlockSize;
+    int32 midiCapacity;
+
+    // written by the host before publishing requestSeq
+    int32 numSamples;
+    int32 midiInSize;
+    int64 requestTicks;
+
+    // written by the sandbox before publishing doneSeq
+    int32 midiOutSize;
+    int64 doneTicks;
+
+    std::atomic<uint32> requestSeq;
+    std::atomic<uint32> doneSeq;
+    /* bumped on every wakeup, the futex word on linux */
+    std::atomic<uint32> signal;
+};
+
+static_assert (std::atomic<uint32>::is_always_lock_free,
+    "sandbox transport needs lock free atomics in shared memory");
+
+static size_t getSandboxMemorySize (size_t headerSize, int channels, int blockSize, int capacity)
+{
+    return alignSandboxSize (headerSize)
+        + 2 * alignSandboxSize (sizeof (float) * (size_t) (channels * blockSize))
+        + 2 * alignSandboxSize ((size_t) capacity);
+}
+
+//=============================================================================
+class SandboxTransport::Region
+{
+public:
+    Region() = default;
+    ~Region() { close(); }
+
+    bool create (const String& newName, size_t newSize)   { return map (newName, newSize, true); }
+    bool open (const String& newName)                     { return map (newName, 0, false); }
+
+    void* getData() const noexcept  { return data; }
+    size_t getSize() const noexcept { return size; }
+
+    void close()
+    {
+        if (data == nullptr)
+            return;
+       #if JUCE_WINDOWS
+        UnmapViewOfFile (data);
+        CloseHandle (handle);
+        handle = nullptr;
+       #else
+        munmap (data, size);
+        if (owner)
+            shm_unlink (name.toRawUTF8());
+       #endif
+        data = nullptr;
+        size = 0;
+    }
+
+private:
+    String name;
+    void* data = nullptr;
+    size_t size = 0;
+    bool owner = false;
+   #if JUCE_WINDOWS
+    HANDLE handle = nullptr;
+   #endif
+
+    bool map (const String& newName, size_t newSize, bool create)
+    {
+        close();
+        name = newName;
+        owner = create;
+
+       #if JUCE_WINDOWS
+        const auto path = String ("Local\\") + name.substring (1);
+        handle = create
+            ? CreateFileMappingW (INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                  (DWORD) ((uint64) newSize >> 32), (DWORD) newSize, path.toWideCharPointer())
+            : OpenFileMappingW (FILE_MAP_ALL_ACCESS, FALSE, path.toWideCharPointer());
+        if (handle == nullptr)
+            return false;
+        data = MapViewOfFile (handle, FILE_MAP_ALL_ACCESS, 0, 0, newSize);
+        if (data == nullptr)
+        {
+            CloseHandle (handle);
+            handle = nullptr;
+            return false;
+        }
+
+        MEMORY_BASIC_INFORMATION info;
+        size = VirtualQuery (data, &info, sizeof (info)) != 0 ? (size_t) info.RegionSize : newSize;
+       #else
+        const int fd = shm_open (name.toRawUTF8(), create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR, 0600);
+        if (fd < 0)
+            return false;
+
+        if (create)
+        {
+            if (ftruncate (fd, (off_t) newSize) != 0)
+            {
+                ::close (fd);
+                shm_unlink (name.toRawUTF8());
+                return false;
+            }
+        }
+        else
+        {
+            struct stat info;
+            newSize = fstat (fd, &info) == 0 ? (size_t) info.st_size : 0;
+        }
+
+        void* mapped = newSize > 0 ? mmap (nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                                   : MAP_FAILED;
+        ::close (fd);
+        if (mapped == MAP_FAILED)
+        {
+            if (create)
+                shm_unlink (name.toRawUTF8());
+            return false;
+        }
+
+        data = mapped;
+        size = newSize;
+       #endif
+        return true;
+    }
+};
+
+//=============================================================================
+class SandboxTransport::Signal
+{
+public:
+    Signal() = default;
+    ~Signal() { close(); }
+
+    bool create (const String& name, std::atomic<uint32>& word) { return open (name, word, true); }
+    bool open (const String& name, std::atomic<uint32>& word)   { return open (name, word, false); }
+
+    void close()
+    {
+       #if JUCE_WINDOWS
+        if (event != nullptr)
+            CloseHandle (event);
+        event = nullptr;
+       #elif ! JUCE_LINUX
+        if (semaphore != SEM_FAILED)
+        {
+            sem_close (semaphore);
+            if (owner)
+                sem_unlink (semaphoreName.toRawUTF8());
+        }
+        semaphore = SEM_FAILED;
+       #endif
+        word = nullptr;
+    }
+
+    void notify()
+    {
+        if (word == nullptr)
+            return;
+        word->fetch_add (1, std::memory_order_release);
+       #if JUCE_WINDOWS
+        SetEvent (event);
+       #elif JUCE_LINUX
+        syscall (SYS_futex, reinterpret_cast<uint32*> (word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+       #else
+        sem_post (semaphore);
+       #endif
+    }
+
+    /* returns when notified after the word held ticket */
+    void wait (uint32 ticket)
+    {
+        if (word == nullptr)
+            return;
+       #if JUCE_WINDOWS
+        if (word->load (std::memory_order_acquire) == ticket)
+            WaitForSingleObject (event, INFINITE);
+       #elif JUCE_LINUX
+        syscall (SYS_futex, reinterpret_cast<uint32*> (word), FUTEX_WAIT, ticket, nullptr, nullptr, 0);
+       #else
+        if (word->load (std::memory_order_acquire) == ticket)
+            while (sem_wait (semaphore) != 0 && errno == EINTR) {}
+       #endif
+    }
+
+private:
+    std::atomic<uint32>* word = nullptr;
+   #if JUCE_WINDOWS
+    HANDLE event = nullptr;
+   #elif ! JUCE_LINUX
+    sem_t* semaphore = SEM_FAILED;
+    String semaphoreName;
+    bool owner = false;
+   #endif
+
+    bool open (const String& name, std::atomic<uint32>& newWord, bool create)
+    {
+        close();
+       #if JUCE_WINDOWS
+        const auto path = String ("Local\\") + name.substring (1) + "s";
+        event = create ? CreateEventW (nullptr, FALSE, FALSE, path.toWideCharPointer())
+                       : OpenEventW (EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, path.toWideCharPointer());
+        if (event == nullptr)
+            return false;
+       #elif ! JUCE_LINUX
+        semaphoreName = name + "s";
+        owner = create;
+        semaphore = create ? sem_open (semaphoreName.toRawUTF8(), O_CREAT | O_EXCL, 0600, 0)
+                           : sem_open (semaphoreName.toRawUTF8(), 0);
+        if (semaphore == SEM_FAILED)
+            return false;
+       #else
+        ignoreUnused (name, create);
+       #endif
+        word = &newWord;
+        return true;
+    }
+};
+
+//=============================================================================
+SandboxTransport::SandboxTransport()
+    : region (new Region()), signal (new Signal()) { }
+
+SandboxTransport::~SandboxTransport()
+{
+    close();
+}
+
+bool SandboxTransport::create (int channels, int blockSize, int capacity)
+{
+    close();
+    if (channels < 0 || blockSize <= 0 || capacity < 0)
+        return false;
+
+    String newName ("/elsb");
+    newName << String::toHexString (Random::getSystemRandom().nextInt64()).paddedLeft ('0', 16);
+    if (! region->create (newName, getSandboxMemorySize (sizeof (Header), channels, blockSize, capacity)))
+        return false;
+
+    header = new (region->getData()) Header();
+    header->magic           = EL_PLUGIN_SANDBOX_MAGIC;
+    header->version         = EL_PLUGIN_SANDBOX_VERSION;
+    header->numChannels     = channels;
+    header->maxBlockSize    = blockSize;
+    header->midiCapacity    = capacity;
+    header->numSamples      = 0;
+    header->midiInSize      = header->midiOutSize = 0;
+    header->requestTicks    = header->doneTicks = 0;
+    header->requestSeq.store (0);
+    header->doneSeq.store (0);
+    header->signal.store (0);
+
+    if (! signal->create (newName, header->signal) || ! map (channels, blockSize, capacity))
+    {
+        close();
+        return false;
+    }
+
+    name = newName;
+    return true;
+}
+
+bool SandboxTransport::open (const String& newName)
+{
+    close();
+    if (! region->open (newName) || region->getSize() < sizeof (Header))
+    {
+        close();
+        return false;
+    }
+
+    header = static_cast<Header*> (region->getData());
+    if (header->magic != EL_PLUGIN_SANDBOX_MAGIC || header->version != EL_PLUGIN_SANDBOX_VERSION ||
+        region->getSize() < getSandboxMemorySize (sizeof (Header), header->numChannels, header->maxBlockSize, header->midiCapacity) ||
+        ! signal->open (newName, header->signal) ||
+        ! map (header->numChannels, header->maxBlockSize, header->midiCapacity))
+    {
+        close();
+        return false;
+    }
+
+    scratch.setSize (jmax (1, numChannels), maxBlockSize);
+    scratchMidi.ensureSize ((size_t) midiCapacity * 2);
+    name = newName;
+    return true;
+}
+
+bool SandboxTransport::map (int channels, int blockSize, int capacity)
+{
+    auto* const base = static_cast<uint8*> (region->getData());
+    const auto audioSize = alignSandboxSize (sizeof (float) * (size_t) (channels * blockSize));
+    size_t offset = alignSandboxSize (sizeof (Header));
+    audioIn  = reinterpret_cast<float*> (base + offset);  offset += audioSize;
+    audioOut = reinterpret_cast<float*> (base + offset);  offset += audioSize;
+    midiIn   = base + offset;                             offset += alignSandboxSize ((size_t) capacity);
+    midiOut  = base + offset;
+
+    numChannels  = channels;
+    maxBlockSize = blockSize;
+    midiCapacity = capacity;
+    issued = served = 0;
+
+    // a block can wait behind one in flight, and results wait one latency
+    inQueue.setSize (jmax (1, channels), 2 * blockSize);
+    outQueue.setSize (jmax (1, channels), 3 * blockSize);
+    for (auto* events : { &inEvents, &outEvents, &resultEvents, &tempEvents })
+    {
+        events->clear();
+        events->ensureSize ((size_t) capacity * 3);
+    }
+    numIn = numOut = numSent = 0;
+    hostPosition = inStart = outStart = sentStart = 0;
+    return true;
+}
+
+void SandboxTransport::close()
+{
+    signal->close();
+    region->close();
+    header = nullptr;
+    audioIn = audioOut = nullptr;
+    midiIn = midiOut = nullptr;
+    numChannels = maxBlockSize = midiCapacity = 0;
+    issued = served = 0;
+    numIn = numOut = numSent = 0;
+    name = String();
+}
+
+bool SandboxTransport::exchange (AudioSampleBuffer& audio, MidiBuffer& midi)
+{
+    if (header == nullptr)
+    {
+        audio.clear();
+        midi.clear();
+        return false;
+    }
+
+    const int numSamples = jmin (audio.getNumSamples(), maxBlockSize);
+    const int channels   = jmin (audio.getNumChannels(), numChannels);
+
+    if (numSent > 0 && header->doneSeq.load (std::memory_order_acquire) == issued)
+        receiveResult();
+
+    // queue the input. if the sandbox fell too far behind the oldest goes,
+    // its output will be silent
+    const int excess = numIn + numSamples - inQueue.getNumSamples();
+    if (excess > 0)
+    {
+        removeFromSandboxQueue (inQueue, inEvents, tempEvents, numIn, excess);
+        inStart += excess;
+        ++numMissed;
+    }
+
+    for (int ch = 0; ch < inQueue.getNumChannels(); ++ch)
+    {
+        if (ch < channels)
+            inQueue.copyFrom (ch, numIn, audio, ch, 0, numSamples);
+        else
+            inQueue.clear (ch, numIn, numSamples);
+    }
+
+    inEvents.addEvents (midi, 0, numSamples, numIn);
+    numIn += numSamples;
+    midi.clear();
+
+    if (numSent == 0)
+        sendRequest();
+
+    // return what was processed for the samples one latency earlier
+    const int64 wanted = hostPosition - maxBlockSize;
+    if (outStart < wanted)
+    {
+        const int stale = (int) jmin ((int64) numOut, wanted - outStart);
+        removeFromSandboxQueue (outQueue, outEvents, tempEvents, numOut, stale);
+        outStart = numOut > 0 ? outStart + stale : wanted;
+    }
+
+    const int leading  = (int) jlimit ((int64) 0, (int64) numSamples, outStart - wanted);
+    const int numReady = jmin (numOut, numSamples - leading);
+    for (int ch = 0; ch < audio.getNumChannels(); ++ch)
+    {
+        if (ch < channels && numReady > 0)
+        {
+            audio.clear (ch, 0, leading);
+            audio.copyFrom (ch, leading, outQueue, ch, 0, numReady);
+            audio.clear (ch, leading + numReady, audio.getNumSamples() - leading - numReady);
+        }
+        else
+        {
+            audio.clear (ch, 0, audio.getNumSamples());
+        }
+    }
+
+    midi.addEvents (outEvents, 0, numReady, leading);
+    removeFromSandboxQueue (outQueue, outEvents, tempEvents, numOut, numReady);
+    outStart += numReady;
+
+    // samples before the start are silent anyway
+    const int numExpected = (int) jlimit ((int64) 0, (int64) numSamples, wanted + numSamples);
+    if (numReady < numExpected)
+        ++numMissed;
+
+    hostPosition += numSamples;
+    return numReady > 0;
+}
+
+void SandboxTransport::receiveResult()
+{
+    resultEvents.clear();
+    readSandboxMidi (midiOut, header->midiOutSize, resultEvents);
+
+    // results for samples already returned as silence are dropped, gaps
+    // left by dropped input are filled with silence
+    int64 position = sentStart;
+    int count = numSent, skip = 0;
+    const int64 queueEnd = outStart + numOut;
+    if (position < queueEnd)
+    {
+        skip = (int) jmin ((int64) count, queueEnd - position);
+        position += skip;
+        count -= skip;
+    }
+
+    int gap = (int) jlimit ((int64) 0, (int64) outQueue.getNumSamples(), position - queueEnd);
+    const int excess = numOut + gap + count - outQueue.getNumSamples();
+    if (excess > numOut)
+    {
+        removeFromSandboxQueue (outQueue, outEvents, tempEvents, numOut, numOut);
+        outStart = position;
+        gap = 0;
+    }
+    else if (excess > 0)
+    {
+        removeFromSandboxQueue (outQueue, outEvents, tempEvents, numOut, excess);
+        outStart += excess;
+    }
+
+    for (int ch = 0; ch < outQueue.getNumChannels(); ++ch)
+    {
+        outQueue.clear (ch, numOut, gap);
+        if (count > 0)
+            FloatVectorOperations::copy (outQueue.getWritePointer (ch, numOut + gap),
+                                         audioOut + ch * maxBlockSize + skip, count);
+    }
+
+    outEvents.addEvents (resultEvents, skip, count, numOut + gap - skip);
+    numOut += gap + count;
+    numSent = 0;
+
+    const auto ticks = jmax ((int64) 0, header->doneTicks - header->requestTicks);
+    totalTicks += ticks;
+    if (ticks > maxTicks.load())
+        maxTicks = ticks;
+    ++numBlocks;
+}
+
+void SandboxTransport::sendRequest()
+{
+    if (numIn <= 0)
+        return;
+
+    numSent   = jmin (numIn, maxBlockSize);
+    sentStart = inStart;
+    for (int ch = 0; ch < numChannels; ++ch)
+        FloatVectorOperations::copy (audioIn + ch * maxBlockSize, inQueue.getReadPointer (ch), numSent);
+
+    tempEvents.clear();
+    tempEvents.addEvents (inEvents, 0, numSent, 0);
+    header->midiInSize = writeSandboxMidi (tempEvents, midiIn, midiCapacity, numSent);
+    removeFromSandboxQueue (inQueue, inEvents, tempEvents, numIn, numSent);
+    inStart += numSent;
+
+    header->numSamples   = numSent;
+    header->requestTicks = Time::getHighResolutionTicks();
+    if (++issued == 0)
+        ++issued;
+    header->requestSeq.store (issued, std::memory_order_release);
+    signal->notify();
+}
+
+bool SandboxTransport::isReady() const
+{
+    return header != nullptr && (issued == 0 || header->doneSeq.load (std::memory_order_acquire) == issued);
+}
+
+bool SandboxTransport::serve (const Processor& process)
+{
+    if (header == nullptr)
+        return false;
+
+    const uint32 ticket = header->signal.load (std::memory_order_acquire);
+    uint32 request = header->requestSeq.load (std::memory_order_acquire);
+    if (request == 0 || request == served)
+    {
+        signal->wait (ticket);
+        request = header->requestSeq.load (std::memory_order_acquire);
+        if (request == 0 || request == served)
+            return false;
+    }
+
+    const int numSamples = jlimit (0, maxBlockSize, (int) header->numSamples);
+    scratch.setSize (jmax (1, numChannels), numSamples, false, false, true);
+    for (int ch = 0; ch < numChannels; ++ch)
+        scratch.copyFrom (ch, 0, audioIn + ch * maxBlockSize, numSamples);
+
+    scratchMidi.clear();
+    readSandboxMidi (midiIn, jmin (midiCapacity, (int) header->midiInSize), scratchMidi);
+
+    process (scratch, scratchMidi);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        FloatVectorOperations::copy (audioOut + ch * maxBlockSize, scratch.getReadPointer (ch), numSamples);
+    header->midiOutSize = writeSandboxMidi (scratchMidi, midiOut, midiCapacity, numSamples);
+    header->doneTicks   = Time::getHighResolutionTicks();
+    header->doneSeq.store (request, std::memory_order_release);
+    served = request;
+    return true;
+}
+
+void SandboxTransport::wake()
+{
+    signal->notify();
+}
+
+SandboxStats SandboxTransport::getStats() const
+{
+    SandboxStats stats;
+    stats.numBlocks = numBlocks.load();
+    stats.numMissed = numMissed.load();
+    const double ticksPerUs = (double) Time::getHighResolutionTicksPerSecond() / 1000000.0;
+    if (stats.numBlocks > 0)
+        stats.averageRoundTripUs = (double) totalTicks.load() / (double) stats.numBlocks / ticksPerUs;
+    stats.maxRoundTripUs = (double) maxTicks.load() / ticksPerUs;
+    return stats;
+}
+
+void SandboxTransport::resetStats()
+{
+    numBlocks = numMissed = 0;
+    totalTicks = maxTicks = 0;
+}
+
+//=============================================================================
+class SandboxProcess : public kv::ChildProcessMaster
+{
+public:
+    SandboxProcess() = default;
+
+    ~SandboxProcess()
+    {
+        closing = 1;
+        if (lost.get() == 0)
+            sendMessageToSlave (createSandboxMessage (ValueTree ("quit")));
+    }
+
+    /** Called from the connection thread when the child goes away */
+    std::function<void()> onLost;
+
+    /** Called from the connection thread with periodic state snapshots */
+    std::function<void (const MemoryBlock&)> onState;
+
+    bool launch()
+    {
+        return launchSlaveProcess (File::getSpecialLocation (File::invokedExecutableFile),
+                                   EL_PLUGIN_SANDBOX_PROCESS_ID, EL_PLUGIN_SANDBOX_LAUNCH_TIMEOUT, 0);
+    }
+
+    bool isAlive() const { return lost.get() == 0; }
+
+    /** Sends a request and waits for its reply. Returns an invalid tree if
+        none came in time */
+    ValueTree call (ValueTree request, int timeoutMs)
+    {
+        const int serial = ++nextSerial;
+        request.setProperty ("serial", serial, nullptr);
+        {
+            ScopedLock sl (lock);
+            waiting = serial;
+            reply = ValueTree();
+            replied.reset();
+        }
+
+        if (isAlive() && sendMessageToSlave (createSandboxMessage (request)))
+            replied.wait (timeoutMs);
+
+        ScopedLock sl (lock);
+        waiting = 0;
+        return reply;
+    }
+
+    /** Sends a request without waiting */
+    bool post (const ValueTree& request)
+    {
+        return isAlive() && sendMessageToSlave (createSandboxMessage (request));
+    }
+
+    void handleMessageFromSlave (const MemoryBlock& mb) override
+    {
+        const auto tree = ValueTree::readFromData (mb.getData(), mb.getSize());
+        if (! tree.isValid())
+            return;
+
+        if (! tree.hasProperty ("serial"))
+        {
+            if (tree.hasType ("state") && onState)
+                if (auto* data = tree.getProperty ("data").getBinaryData())
+                    onState (*data);
+            return;
+        }
+
+        ScopedLock sl (lock);
+        if ((int) tree.getProperty ("serial") == waiting)
+        {
+            reply = tree;
+            replied.signal();
+        }
+    }
+
+    void handleConnectionLost() override
+    {
+        lost = 1;
+        replied.signal();
+        if (closing.get() == 0 && onLost)
+            onLost();
+    }
+
+private:
+    CriticalSection lock;
+    WaitableEvent replied;
+    ValueTree reply;
+    int waiting = 0;
+    int nextSerial = 0;
+    Atomic<int> lost { 0 }, closing { 0 };
+};
+
+/* Launches a sandbox and loads a plugin in it. info gets the plugin's
+   channels, latency and so on */
+static std::unique_ptr<SandboxProcess> launchSandbox (const PluginDescription& desc, const MemoryBlock& state,
+                                                      double sampleRate, int blockSize,
+                                                      ValueTree& info, String& errorMsg)
+{
+    std::unique_ptr<SandboxProcess> process (new SandboxProcess());
+    if (! process->launch())
+    {
+        errorMsg = "could not launch sandbox process";
+        return nullptr;
+    }
+
+    ValueTree request ("load");
+    if (auto xml = desc.createXml())
+        request.setProperty ("plugin", xml->toString(), nullptr);
+    request.setProperty ("sampleRate", sampleRate, nullptr)
+           .setProperty ("blockSize", blockSize, nullptr);
+    if (state.getSize() > 0)
+        request.setProperty ("state", var (state), nullptr);
+
+    info = process->call (request, EL_PLUGIN_SANDBOX_LOAD_TIMEOUT);
+    if (! info.isValid() || info.hasProperty ("error"))
+    {
+        errorMsg = desc.name;
+        errorMsg << ": " << (info.isValid() ? info.getProperty ("error").toString()
+                                            : String ("sandbox did not respond"));
+        return nullptr;
+    }
+
+    return process;
+}
+
+//=============================================================================
+class SandboxedPluginInstance : public AudioPluginInstance,
+                                private AsyncUpdater,
+                                private Timer
+{
+public:
+    SandboxedPluginInstance (const PluginDescription& d, std::unique_ptr<SandboxProcess> p,
+                             const ValueTree& info)
+        : AudioPluginInstance (createBuses (info)),
+          desc (d),
+          process (std::move (p)),
+          pluginLatency (info.getProperty ("latency", 0)),
+          tailSeconds (info.getProperty ("tail", 0.0)),
+          midiIn (info.getProperty ("acceptsMidi", false)),
+          midiOut (info.getProperty ("producesMidi", false))
+    {
+        attach();
+        startTimer (EL_PLUGIN_SANDBOX_STATE_INTERVAL);
+    }
+
+    ~SandboxedPluginInstance()
+    {
+        stopTimer();
+        cancelPendingUpdate();
+        {
+            const SpinLock::ScopedLockType sl (renderLock);
+            running = false;
+        }
+        process = nullptr;
+        transport.close();
+    }
+
+    static BusesProperties createBuses (const ValueTree& info)
+    {
+        BusesProperties buses;
+        const int numIns  = info.getProperty ("numInputs", 0);
+        const int numOuts = info.getProperty ("numOutputs", 0);
+        if (numIns > 0)
+            buses = buses.withInput ("Input", AudioChannelSet::discreteChannels (numIns), true);
+        if (numOuts > 0)
+            buses = buses.withOutput ("Output", AudioChannelSet::discreteChannels (numOuts), true);
+        return buses;
+    }
+
+    bool prepareSandbox (double sampleRate, int blockSize, String& errorMsg)
+    {
+        if (process == nullptr || ! process->isAlive())
+        {
+            errorMsg = "sandbox process is not running";
+            return false;
+        }
+
+        {
+            const SpinLock::ScopedLockType sl (renderLock);
+            running = false;
+        }
+
+        // the child keeps its own mapping of the old block until it
+        // opens the new one, so it can be replaced right away
+        const int numChannels = jmax (getTotalNumInputChannels(), getTotalNumOutputChannels());
+        if (! transport.create (numChannels, blockSize))
+        {
+            errorMsg = "could not create shared memory";
+            return false;
+        }
+
+        ValueTree request ("prepare");
+        request.setProperty ("sampleRate", sampleRate, nullptr)
+               .setProperty ("blockSize", blockSize, nullptr)
+               .setProperty ("memory", transport.getName(), nullptr);
+        const auto reply = process->call (request, EL_PLUGIN_SANDBOX_LOAD_TIMEOUT);
+        if (! reply.isValid() || reply.hasProperty ("error"))
+        {
+            errorMsg = reply.isValid() ? reply.getProperty ("error").toString()
+                                       : String ("sandbox did not respond");
+            return false;
+        }
+
+        pluginLatency = reply.getProperty ("latency", 0);
+        preparedRate  = sampleRate;
+        preparedBlock = blockSize;
+        setLatencySamples (pluginLatency + blockSize);
+
+        const SpinLock::ScopedLockType sl (renderLock);
+        running = true;
+        return true;
+    }
+
+    SandboxStats getStats() const
+    {
+        auto stats = transport.getStats();
+        stats.numRestarts = numRestarts;
+        return stats;
+    }
+
+    //=========================================================================
+    void fillInPluginDescription (PluginDescription& d) const override { d = desc; }
+    const String getName() const override { return desc.name; }
+
+    void prepareToPlay (double sampleRate, int blockSize) override
+    {
+        if (running && sampleRate == preparedRate && blockSize <= preparedBlock)
+            return;
+        String errorMsg;
+        if (! prepareSandbox (sampleRate, blockSize, errorMsg))
+            DBG("[EL] sandbox: " << desc.name << ": " << errorMsg);
+    }
+
+    void releaseResources() override { }
+
+    void processBlock (AudioSampleBuffer& audio, MidiBuffer& midi) override
+    {
+        const SpinLock::ScopedTryLockType sl (renderLock);
+        if (! sl.isLocked() || ! running)
+        {
+            audio.clear();
+            midi.clear();
+            return;
+        }
+
+        transport.exchange (audio, midi);
+    }
+
+    double getTailLengthSeconds() const override    { return tailSeconds; }
+    bool acceptsMidi() const override               { return midiIn; }
+    bool producesMidi() const override              { return midiOut; }
+    bool hasEditor() const override                 { return false; }
+    AudioProcessorEditor* createEditor() override   { return nullptr; }
+
+    int getNumPrograms() override                           { return 1; }
+    int getCurrentProgram() override                        { return 0; }
+    void setCurrentProgram (int) override                   { }
+    const String getProgramName (int) override              { return String(); }
+    void changeProgramName (int, const String&) override    { }
+
+    void getStateInformation (MemoryBlock& block) override
+    {
+        if (process != nullptr && process->isAlive())
+        {
+            const auto reply = process->call (ValueTree ("getState"), EL_PLUGIN_SANDBOX_STATE_TIMEOUT);
+            if (auto* data = reply.getProperty ("data").getBinaryData())
+                setLastState (*data);
+        }
+
+        ScopedLock sl (stateLock);
+        block = lastState;
+    }
+
+    void setStateInformation (const void* data, int size) override
+    {
+        setLastState (MemoryBlock (data, (size_t) size));
+        if (process != nullptr)
+        {
+            ValueTree request ("setState");
+            request.setProperty ("data", var (data, (size_t) size), nullptr);
+            process->post (request);
+        }
+    }
+
+private:
+    const PluginDescription desc;
+    std::unique_ptr<SandboxProcess> process;
+    SandboxTransport transport;
+    SpinLock renderLock;
+    bool running = false;
+
+    int pluginLatency = 0;
+    double tailSeconds = 0.0;
+    bool midiIn = false, midiOut = false;
+    double preparedRate = 0.0;
+    int preparedBlock = 0;
+    int numRestarts = 0;
+
+    CriticalSection stateLock;
+    MemoryBlock lastState;
+
+    void setLastState (const MemoryBlock& state)
+    {
+        ScopedLock sl (stateLock);
+        lastState = state;
+    }
+
+    void attach()
+    {
+        process->onLost = [this]() { triggerAsyncUpdate(); };
+        process->onState = [this] (const MemoryBlock& state) { setLastState (state); };
+    }
+
+    /** Relaunches a crashed sandbox with the last state the host saw */
+    void handleAsyncUpdate() override
+    {
+        {
+            const SpinLock::ScopedLockType sl (renderLock);
+            running = false;
+        }
+
+        if (numRestarts >= EL_PLUGIN_SANDBOX_MAX_RESTARTS)
+        {
+            DBG("[EL] sandbox: " << desc.name << " crashed too often. giving up");
+            return;
+        }
+
+        ++numRestarts;
+        DBG("[EL] sandbox: " << desc.name << " crashed. restarting");
+
+        MemoryBlock state;
+        {
+            ScopedLock sl (stateLock);
+            state = lastState;
+        }
+
+        String errorMsg;
+        ValueTree info;
+        process = launchSandbox (desc, state, getSampleRate(), getBlockSize(), info, errorMsg);
+        if (process == nullptr)
+        {
+            DBG("[EL] sandbox: " << errorMsg);
+            return;
+        }
+
+        attach();
+        if (preparedBlock > 0 && ! prepareSandbox (preparedRate, preparedBlock, errorMsg))
+            DBG("[EL] sandbox: " << errorMsg);
+    }
+
+    /** Asks for a state snapshot so a restart doesn't lose much */
+    void timerCallback() override
+    {
+        if (process != nullptr && process->isAlive())
+            process->post (ValueTree ("state"));
+    }
+};
+
+//=============================================================================
+class PluginSandboxSlave : public kv::ChildProcessSlave,
+                           public AsyncUpdater,
+                           private Thread
+{
+public:
+    PluginSandboxSlave()
+        : Thread ("Element Plugin Sandbox")
+    {
+        SystemStats::setApplicationCrashHandler (pluginSandboxSlaveCrashHandler);
+        processor = [this] (AudioSampleBuffer& audio, MidiBuffer& midi) {
+            ScopedNoDenormals denormals;
+            plugin->processBlock (audio, midi);
+        };
+    }
+
+    ~PluginSandboxSlave()
+    {
+        stopProcessing();
+    }
+
+    void handleMessageFromMaster (const MemoryBlock& mb) override
+    {
+        const auto tree = ValueTree::readFromData (mb.getData(), mb.getSize());
+        if (tree.hasType ("quit"))
+        {
+            handleConnectionLost();
+            return;
+        }
+
+        {
+            ScopedLock sl (lock);
+            requests.add (tree);
+        }
+
+        triggerAsyncUpdate();
+    }
+
+    void handleAsyncUpdate() override
+    {
+        Array<ValueTree> pending;
+        {
+            ScopedLock sl (lock);
+            pending.swapWith (requests);
+        }
+
+        for (const auto& request : pending)
+        {
+            ValueTree reply (request.getType());
+            if (request.hasType ("load"))
+                load (request, reply);
+            else if (request.hasType ("prepare"))
+                prepare (request, reply);
+            else if (request.hasType ("release"))
+                release();
+            else if (request.hasType ("getState") || request.hasType ("state"))
+                getState (reply);
+            else if (request.hasType ("setState"))
+                setState (request);
+
+            if (request.hasProperty ("serial"))
+                reply.setProperty ("serial", request.getProperty ("serial"), nullptr);
+            if (request.hasProperty ("serial") || request.hasType ("state"))
+                sendMessageToMaster (createSandboxMessage (reply));
+        }
+    }
+
+    void handleConnectionMade() override
+    {
+        plugins.reset (new PluginManager());
+        plugins->addDefaultFormats();
+    }
+
+    void handleConnectionLost() override
+    {
+        stopProcessing();
+        plugin = nullptr;
+        plugins = nullptr;
+        exit (0);
+    }
+
+private:
+    CriticalSection lock;
+    Array<ValueTree> requests;
+    std::unique_ptr<PluginManager> plugins;
+    std::unique_ptr<AudioPluginInstance> plugin;
+    SandboxTransport transport;
+    SandboxTransport::Processor processor;
+
+    void run() override
+    {
+        while (! threadShouldExit())
+            transport.serve (processor);
+    }
+
+    void stopProcessing()
+    {
+        signalThreadShouldExit();
+        transport.wake();
+        stopThread (1000);
+    }
+
+    void load (const ValueTree& request, ValueTree& reply)
+    {
+        PluginDescription desc;
+        std::unique_ptr<XmlElement> xml (XmlDocument::parse (request.getProperty ("plugin").toString()));
+        if (plugins == nullptr || xml == nullptr || ! desc.loadFromXml (*xml))
+        {
+            reply.setProperty ("error", "invalid plugin description", nullptr);
+            return;
+        }
+
+        release();
+        String errorMsg;
+        plugin = plugins->getAudioPluginFormats().createPluginInstance (
+            desc, request.getProperty ("sampleRate", 44100.0), request.getProperty ("blockSize", 512), errorMsg);
+        if (plugin == nullptr)
+        {
+            reply.setProperty ("error", errorMsg.isNotEmpty() ? errorMsg : String ("could not create plugin"), nullptr);
+            return;
+        }
+
+        plugin->enableAllBuses();
+        if (auto* state = request.getProperty ("state").getBinaryData())
+            if (state->getSize() > 0)
+                plugin->setStateInformation (state->getData(), (int) state->getSize());
+
+        reply.setProperty ("numInputs",    plugin->getTotalNumInputChannels(), nullptr)
+             .setProperty ("numOutputs",   plugin->getTotalNumOutputChannels(), nullptr)
+             .setProperty ("acceptsMidi",  plugin->acceptsMidi(), nullptr)
+             .setProperty ("producesMidi", plugin->producesMidi(), nullptr)
+             .setProperty ("latency",      plugin->getLatencySamples(), nullptr)
+             .setProperty ("tail",         plugin->getTailLengthSeconds(), nullptr);
+    }
+
+    void prepare (const ValueTree& request, ValueTree& reply)
+    {
+        if (plugin == nullptr)
+        {
+            reply.setProperty ("error", "no plugin loaded", nullptr);
+            return;
+        }
+
+        release();
+        const double sampleRate = request.getProperty ("sampleRate", 44100.0);
+        const int blockSize     = request.getProperty ("blockSize", 512);
+        plugin->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin->prepareToPlay (sampleRate, blockSize);
+
+        if (! transport.open (request.getProperty ("memory").toString()))
+        {
+            reply.setProperty ("error", "could not open shared memory", nullptr);
+            return;
+        }
+
+        reply.setProperty ("latency", plugin->getLatencySamples(), nullptr);
+        startThread (10);
+    }
+
+    void release()
+    {
+        stopProcessing();
+        transport.close();
+        if (plugin != nullptr)
+            plugin->releaseResources();
+    }
+
+    void getState (ValueTree& reply)
+    {
+        if (plugin == nullptr)
+            return;
+        MemoryBlock state;
+        plugin->getStateInformation (state);
+        reply.setProperty ("data", var (state), nullptr);
+    }
+
+    void setState (const ValueTree& request)
+    {
+        if (plugin != nullptr)
+            if (auto* state = request.getProperty ("data").getBinaryData())
+                plugin->setStateInformation (state->getData(), (int) state->getSize());
+    }
+};
+
+//=============================================================================
+bool PluginSandbox::canSandbox (const PluginDescription& desc)
+{
+    return desc.pluginFormatName != EL_INTERNAL_FORMAT_NAME
+        && desc.pluginFormatName != "Internal";
+}
+
+AudioPluginInstance* PluginSandbox::createInstance (const PluginDescription& desc, double sampleRate,
+                                                    int blockSize, String& errorMsg)
+{
+    if (! canSandbox (desc))
+    {
+        errorMsg = desc.name + ": can't run in a sandbox";
+        return nullptr;
+    }
+
+    ValueTree info;
+    auto process = launchSandbox (desc, MemoryBlock(), sampleRate, blockSize, info, errorMsg);
+    if (process == nullptr)
+        return nullptr;
+
+    std::unique_ptr<SandboxedPluginInstance> instance (
+        new SandboxedPluginInstance (desc, std::move (process), info));
+    instance->setRateAndBufferSizeDetails (sampleRate, blockSize);
+
+    // prepare now so the latency is known when the node is created
+    if (! instance->prepareSandbox (sampleRate, blockSize, errorMsg))
+    {
+        errorMsg = desc.name + ": " + errorMsg;
+        return nullptr;
+    }
+
+    return instance.release();
+}
+
+bool PluginSandbox::isSandboxed (const AudioProcessor& processor)
+{
+    return dynamic_cast<const SandboxedPluginInstance*> (&processor) != nullptr;
+}
+
+SandboxStats PluginSandbox::getStats (const AudioProcessor& processor)
+{
+    if (auto* instance = dynamic_cast<const SandboxedPluginInstance*> (&processor))
+        return instance->getStats();
+    return {};
+}
+
+kv::ChildProcessSlave* PluginSandbox::createSlave()
+{
+    return new PluginSandboxSlave();
+}
+
+}
@@ -0,0 +1,159 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+#define EL_PLUGIN_SANDBOX_PROCESS_ID    "pspelsb"
+
+namespace Element {
+
+/** Round trip timings of a sandbox transport */
+struct SandboxStats
+{
+    /** Blocks that came back from the sandbox */
+    int64 numBlocks         = 0;
+    /** Blocks returned with silence in them because the sandbox fell behind */
+    int64 numMissed         = 0;
+    /** Time from handing a block over until the sandbox finished it */
+    double averageRoundTripUs = 0.0;
+    double maxRoundTripUs   = 0.0;
+    /** Times the sandbox process was restarted after a crash */
+    int numRestarts         = 0;
+};
+
+/** Moves audio and MIDI between the engine and a sandboxed plugin through
+    shared memory.
+
+    The host side calls exchange() from the audio thread. Its input is
+    queued and handed over when the sandbox is free, and output comes back
+    exactly maxBlockSize samples later whatever the host's block sizes, so
+    the audio thread never waits on another process. The sandbox side
+    blocks in serve() until a block arrives. On Linux the wakeup is a futex
+    in the shared block, elsewhere a named semaphore or event.
+ */
+class SandboxTransport
+{
+public:
+    using Processor = std::function<void (AudioSampleBuffer&, MidiBuffer&)>;
+
+    SandboxTransport();
+    ~SandboxTransport();
+
+    /** Creates a new shared block. Used by the host */
+    bool create (int numChannels, int maxBlockSize, int midiCapacity = 8192);
+
+    /** Opens a block another process created. Used by the sandbox */
+    bool open (const String& name);
+
+    /** Unmaps the block. The creator also removes it */
+    void close();
+
+    bool isOpen() const noexcept            { return header != nullptr; }
+    const String& getName() const noexcept  { return name; }
+    int getNumChannels() const noexcept     { return numChannels; }
+    int getMaxBlockSize() const noexcept    { return maxBlockSize; }
+
+    /** Host side. Queues this block for the sandbox and replaces it with
+        the output for the samples maxBlockSize earlier. Never blocks.
+        Returns false if none of the output came from the sandbox.
+     */
+    bool exchange (AudioSampleBuffer& audio, MidiBuffer& midi);
+
+    /** Host side. Returns true if the sandbox finished the last block, so
+        the next exchange() won't be dropped */
+    bool isReady() const;
+
+    /** Sandbox side. Waits for a block and processes it. Returns false if
+        woken without one.
+     */
+    bool serve (const Processor& process);
+
+    /** Wakes a thread waiting in serve() */
+    void wake();
+
+    SandboxStats getStats() const;
+    void resetStats();
+
+private:
+    class Region;
+    class Signal;
+    struct Header;
+    std::unique_ptr<Region> region;
+    std::unique_ptr<Signal> signal;
+    Header* header = nullptr;
+    String name;
+    int numChannels = 0, maxBlockSize = 0, midiCapacity = 0;
+    float* audioIn = nullptr;
+    float* audioOut = nullptr;
+    uint8* midiIn = nullptr;
+    uint8* midiOut = nullptr;
+
+    uint32 issued = 0, served = 0;
+    AudioSampleBuffer scratch;
+    MidiBuffer scratchMidi;
+
+    // host side queues. event times are relative to the front of each
+    AudioSampleBuffer inQueue, outQueue;
+    MidiBuffer inEvents, outEvents, resultEvents, tempEvents;
+    int numIn = 0, numOut = 0, numSent = 0;
+    int64 hostPosition = 0, inStart = 0, outStart = 0, sentStart = 0;
+
+    std::atomic<int64> numBlocks { 0 }, numMissed { 0 };
+    std::atomic<int64> totalTicks { 0 }, maxTicks { 0 };
+
+    bool map (int channels, int blockSize, int capacity);
+    void receiveResult();
+    void sendRequest();
+    JUCE_DECLARE_NON_COPYABLE (SandboxTransport)
+};
+
+/** Runs plugins in a child process so a crashing plugin doesn't take the
+    engine down with it.
+
+    The instance it creates is a stand-in for the real plugin: state calls
+    are forwarded to the child over the child process connection and audio
+    goes through a SandboxTransport. Its latency is the plugin's plus the
+    prepared block size. If the child dies it is relaunched and the last state the host
+    saw is restored. Sandboxed plugins don't show editors or expose
+    parameters yet.
+ */
+struct PluginSandbox
+{
+    /** Returns true if a plugin can run in a sandbox. Element's own nodes can't */
+    static bool canSandbox (const PluginDescription&);
+
+    /** Launches a sandbox process and loads a plugin in it. Returns nullptr
+        and sets errorMsg if that didn't work.
+     */
+    static AudioPluginInstance* createInstance (const PluginDescription&, double sampleRate,
+                                                int blockSize, String& errorMsg);
+
+    /** Returns true if a processor is running in a sandbox */
+    static bool isSandboxed (const AudioProcessor&);
+
+    /** Returns round trip timings of a sandboxed processor */
+    static SandboxStats getStats (const AudioProcessor&);
+
+    /** Creates the child process side, used in start up */
+    static kv::ChildProcessSlave* createSlave();
+};
+
+}
@@ -0,0 +1,211 @@
+/*
+    This file is part of Element
+    Copyright (C) 2014-2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/PluginScanCache.h"
+#include "DataPath.h"
+
+#define EL_PLUGIN_SCAN_CACHE_FILENAME   "PluginScanCache.dat"
+#define EL_PLUGIN_SCAN_CACHE_VERSION    1
+
+namespace Element {
+
+static File fileForIdentifier (const String& fileOrIdentifier)
+{
+    return File::isAbsolutePath (fileOrIdentifier) ? File (fileOrIdentifier) : File();
+}
+
+PluginScanCache::Fingerprint PluginScanCache::Fingerprint::forFile (const String& fileOrIdentifier, bool withHash)
+{
+    Fingerprint fp;
+    const auto file = fileForIdentifier (fileOrIdentifier);
+    if (file == File() || ! file.exists())
+        return fp;
+
+    if (! file.isDirectory())
+    {
+        fp.size     = file.getSize();
+        fp.modified = file.getLastModificationTime().toMilliseconds();
+        if (withHash)
+            fp.hash = MD5 (file).toHexString();
+        return fp;
+    }
+
+    // bundles: sum the sizes, take the newest time and hash each file's hash
+    MemoryOutputStream hashes;
+    Array<File> children;
+    for (const auto& entry : RangedDirectoryIterator (file, true, "*", File::findFiles))
+        children.add (entry.getFile());
+    children.sort();
+
+    fp.modified = file.getLastModificationTime().toMilliseconds();
+    for (const auto& child : children)
+    {
+        fp.size    += child.getSize();
+        fp.modified = jmax (fp.modified, child.getLastModificationTime().toMilliseconds());
+        if (withHash)
+            hashes << child.getRelativePathFrom (file) << MD5 (child).toHexString();
+    }
+
+    if (withHash)
+        fp.hash = MD5 (hashes.getMemoryBlock()).toHexString();
+    return fp;
+}
+
+File PluginScanCache::getDefaultFile()
+{
+    return DataPath::applicationDataDir().getChildFile (EL_PLUGIN_SCAN_CACHE_FILENAME);
+}
+
+String PluginScanCache::keyFor (const String& format, const String& file)
+{
+    return format + "\t" + file;
+}
+
+void PluginScanCache::record (const String& format, const String& file,
+                              const Fingerprint& fingerprint, Status status,
+                              const Array<PluginDescription>& types)
+{
+    Entry entry;
+    entry.fingerprint   = fingerprint;
+    entry.status        = status;
+    entry.types         = types;
+    entries[keyFor (format, file)] = entry;
+}
+
+const PluginScanCache::Entry* PluginScanCache::find (const String& format, const String& file) const
+{
+    const auto iter = entries.find (keyFor (format, file));
+    return iter != entries.end() ? &iter->second : nullptr;
+}
+
+bool PluginScanCache::isUpToDate (const String& format, const String& file) const
+{
+    const auto* entry = find (format, file);
+    if (entry == nullptr || ! entry->fingerprint.isValid())
+        return false;
+
+    const auto& cached = entry->fingerprint;
+    const auto current = Fingerprint::forFile (file, false);
+    if (! current.isValid() || current.size != cached.size)
+        return false;
+    if (current.modified == cached.modified)
+        return true;
+
+    // touched or reinstalled, check if the contents actually changed
+    return cached.hash.isNotEmpty() && Fingerprint::forFile (file, true).hash == cached.hash;
+}
+
+void PluginScanCache::removeMissingFiles()
+{
+    for (auto iter = entries.begin(); iter != entries.end();)
+    {
+        const auto file = fileForIdentifier (iter->first.fromFirstOccurrenceOf ("\t", false, false));
+        if (file != File() && ! file.exists())
+            iter = entries.erase (iter);
+        else
+            ++iter;
+    }
+}
+
+ValueTree PluginScanCache::createValueTree (const String& format, const String& file, const Entry& entry)
+{
+    ValueTree tree ("entry");
+    tree.setProperty ("format",     format, nullptr)
+        .setProperty ("file",       file, nullptr)
+        .setProperty ("size",       entry.fingerprint.size, nullptr)
+        .setProperty ("modified",   entry.fingerprint.modified, nullptr)
+        .setProperty ("hash",       entry.fingerprint.hash, nullptr)
+        .setProperty ("status",     static_cast<int> (entry.status), nullptr);
+
+    for (const auto& type : entry.types)
+        if (auto xml = std::unique_ptr<XmlElement> (type.createXml()))
+            tree.appendChild (ValueTree::fromXml (*xml), nullptr);
+
+    return tree;
+}
+
+bool PluginScanCache::restoreEntry (const ValueTree& tree, String& format, String& file, Entry& entry)
+{
+    if (! tree.hasType ("entry"))
+        return false;
+
+    format  = tree.getProperty ("format").toString();
+    file    = tree.getProperty ("file").toString();
+    entry.fingerprint.size      = tree.getProperty ("size");
+    entry.fingerprint.modified  = tree.getProperty ("modified");
+    entry.fingerprint.hash      = tree.getProperty ("hash").toString();
+    entry.status = static_cast<Status> (jlimit (0, (int) Blacklisted, (int) tree.getProperty ("status")));
+
+    entry.types.clearQuick();
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+    {
+        std::unique_ptr<XmlElement> xml (tree.getChild(i).createXml());
+        PluginDescription desc;
+        if (xml != nullptr && desc.loadFromXml (*xml))
+            entry.types.add (desc);
+    }
+
+    return format.isNotEmpty() && file.isNotEmpty();
+}
+
+bool PluginScanCache::load (const File& file)
+{
+    entries.clear();
+    FileInputStream input (file);
+    if (! input.openedOk())
+        return false;
+
+    const auto tree = ValueTree::readFromStream (input);
+    if (! tree.hasType ("pluginScanCache") || (int) tree.getProperty ("version") != EL_PLUGIN_SCAN_CACHE_VERSION)
+        return false;
+
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+    {
+        String format, path;
+        Entry entry;
+        if (restoreEntry (tree.getChild (i), format, path, entry))
+            entries[keyFor (format, path)] = entry;
+    }
+
+    return true;
+}
+
+bool PluginScanCache::save (const File& file) const
+{
+    ValueTree tree ("pluginScanCache");
+    tree.setProperty ("version", EL_PLUGIN_SCAN_CACHE_VERSION, nullptr);
+    for (const auto& item : entries)
+    {
+        tree.appendChild (createValueTree (item.first.upToFirstOccurrenceOf ("\t", false, false),
+                                           item.first.fromFirstOccurrenceOf ("\t", false, false),
+                                           item.second), nullptr);
+    }
+
+    TemporaryFile temp (file);
+    {
+        FileOutputStream output (temp.getFile());
+        if (! output.openedOk())
+            return false;
+        tree.writeToStream (output);
+    }
+
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+}
@@ -0,0 +1,108 @@
+/*
+    This file is part of Element
+    Copyright (C) 2014-2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** Remembers what scanning each plugin file found, keyed by the file's
+    size, modification time and a hash of its contents. Rescans use it to
+    skip files which haven't changed since they were last scanned.
+
+    Identifiers which aren't files, like AudioUnit and LV2 URIs, can't be
+    fingerprinted and are never considered up to date.
+ */
+class PluginScanCache
+{
+public:
+    enum Status
+    {
+        Scanned = 0,    ///< scanned ok, possibly without finding plugins
+        Blacklisted     ///< crashed or timed out the scanner
+    };
+
+    struct Fingerprint
+    {
+        int64 size      = 0;
+        int64 modified  = 0;
+        /** MD5 of the contents, empty if it wasn't computed */
+        String hash;
+
+        bool isValid() const noexcept { return modified != 0; }
+
+        /** Reads a fingerprint from disk. Bundles are fingerprinted by
+            every file they contain. Hashing reads the whole file so is
+            optional */
+        static Fingerprint forFile (const String& fileOrIdentifier, bool withHash);
+    };
+
+    struct Entry
+    {
+        Fingerprint fingerprint;
+        Status status = Scanned;
+        Array<PluginDescription> types;
+    };
+
+    PluginScanCache() = default;
+    ~PluginScanCache() = default;
+
+    /** Returns the default cache file in the app data dir */
+    static File getDefaultFile();
+
+    /** Replaces the contents with a cache file. Returns false if the file
+        couldn't be read */
+    bool load (const File& file);
+
+    /** Writes the cache to a file */
+    bool save (const File& file) const;
+
+    /** Records the result of scanning a file */
+    void record (const String& format, const String& file,
+                 const Fingerprint& fingerprint, Status status,
+                 const Array<PluginDescription>& types);
+
+    /** Returns the entry for a file, or nullptr */
+    const Entry* find (const String& format, const String& file) const;
+
+    /** Returns true if a file hasn't changed since it was recorded. When
+        only the modification time differs and the entry has a hash, the
+        file is hashed to decide */
+    bool isUpToDate (const String& format, const String& file) const;
+
+    /** Forgets entries for files which no longer exist */
+    void removeMissingFiles();
+
+    /** Forgets everything */
+    void clear()                        { entries.clear(); }
+
+    int size() const noexcept           { return (int) entries.size(); }
+
+    /** Writes entries to and reads them from ValueTrees, used to pass them
+        between the scanner processes */
+    static ValueTree createValueTree (const String& format, const String& file, const Entry& entry);
+    static bool restoreEntry (const ValueTree& tree, String& format, String& file, Entry& entry);
+
+private:
+    std::map<String, Entry> entries;
+    static String keyFor (const String& format, const String& file);
+};
+
+}
@@ -0,0 +1,425 @@
+/*
+    This file is part of Element
+    Copyright (C) 2014-2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/BinaryModel.h"
+#include "session/Presets.h"
+#include "DataPath.h"
+
+#define EL_PRESET_INDEX_FILENAME    "PresetIndex.dat"
+#define EL_PRESET_INDEX_VERSION     1
+
+namespace Element {
+
+// how often the watcher looks for added, removed or changed presets
+static constexpr int presetWatchIntervalMs = 5000;
+
+/** Adds the lower case words in text to an array */
+static void addWords (const String& text, StringArray& words)
+{
+    String word;
+    for (auto p = text.getCharPointer(); ! p.isEmpty();)
+    {
+        const auto c = p.getAndAdvance();
+        if (CharacterFunctions::isLetterOrDigit (c))
+        {
+            word += CharacterFunctions::toLowerCase (c);
+        }
+        else if (word.isNotEmpty())
+        {
+            words.addIfNotAlreadyThere (word);
+            word.clear();
+        }
+    }
+
+    if (word.isNotEmpty())
+        words.addIfNotAlreadyThere (word);
+}
+
+/** The words a preset can be found by */
+static StringArray getSearchWords (const PresetDescription& preset)
+{
+    StringArray words;
+    addWords (preset.name, words);
+    for (const auto& tag : preset.tags)
+        addWords (tag, words);
+    addWords (preset.format, words);
+    // plugin paths would add every folder name, only the file name is useful
+    addWords (File::isAbsolutePath (preset.identifier)
+        ? File (preset.identifier).getFileNameWithoutExtension()
+        : preset.identifier, words);
+    return words;
+}
+
+//=============================================================================
+bool PresetDescription::read (const File& file, const File& presetsDir, PresetDescription& result)
+{
+    String name, tags;
+
+    if (BinaryModel::isBinaryModel (file))
+    {
+        // only the properties are decoded, the plugin state stays on disk
+        BinaryModel model (file);
+        const auto root = model.getRoot();
+        auto node = root;
+        if (root.hasType (Tags::session))
+        {
+            const auto graphs = root.getChildWithName (Tags::graphs);
+            node = graphs.getChild (graphs.getProperty (Tags::active, 0));
+        }
+        else if (! root.hasType (Tags::node))
+        {
+            node = root.getChildWithName (Tags::node);
+            name = root.getProperty (Tags::name, file.getFileNameWithoutExtension()).toString();
+            tags = root.getProperty ("tags").toString();
+        }
+
+        if (! node.isValid() || ! node.hasType (Tags::node))
+            return false;
+        if (name.isEmpty())
+            name = node.getProperty (Tags::name).toString();
+        if (tags.isEmpty())
+            tags = node.getProperty ("tags").toString();
+        result.format       = node.getProperty (Tags::format).toString();
+        result.identifier   = node.getProperty (Tags::identifier).toString();
+    }
+    else
+    {
+        const Node node (Node::parse (file), false);
+        if (! node.isValid())
+            return false;
+        name                = node.getName();
+        tags                = node.getProperty ("tags").toString();
+        result.format       = node.getFormat();
+        result.identifier   = node.getIdentifier();
+    }
+
+    if (result.format.isEmpty() || result.identifier.isEmpty())
+        return false;
+
+    result.file = file;
+    result.name = name.isNotEmpty() ? name : file.getFileNameWithoutExtension();
+    result.tags.clear();
+    result.tags.addTokens (tags, ",", "\"");
+    if (file.isAChildOf (presetsDir))
+        result.tags.addTokens (file.getParentDirectory().getRelativePathFrom (presetsDir),
+                               File::getSeparatorString(), "");
+    result.tags.trim();
+    result.tags.removeString (".");
+    result.tags.removeEmptyStrings();
+    result.tags.removeDuplicates (true);
+    return true;
+}
+
+//=============================================================================
+PresetCollection::PresetCollection()
+    : PresetCollection (DataPath().getRootDir().getChildFile ("Presets"), getDefaultIndexFile())
+{
+}
+
+PresetCollection::PresetCollection (const File& dir, const File& index)
+    : Thread ("Preset Index"),
+      presetsDir (dir),
+      indexFile (index)
+{
+    scanFinished.signal();
+    loadIndex();
+}
+
+PresetCollection::~PresetCollection()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread (5000);
+    cancelPendingUpdate();
+}
+
+File PresetCollection::getDefaultIndexFile()
+{
+    return DataPath::applicationDataDir().getChildFile (EL_PRESET_INDEX_FILENAME);
+}
+
+void PresetCollection::clear()
+{
+    OwnedArray<PresetDescription> none;
+    setPresets (none);
+}
+
+int PresetCollection::size() const
+{
+    ScopedLock sl (lock);
+    return presets.size();
+}
+
+void PresetCollection::getPresetsFor (const Node& node, OwnedArray<PresetDescription>& results) const
+{
+    const auto identifier = node.getIdentifier().toString();
+    const auto format = node.getFormat().toString();
+    SortByName sorter;
+    ScopedLock sl (lock);
+    for (const auto* const preset : presets)
+        if (preset->identifier == identifier && preset->format == format)
+            results.addSorted (sorter, new PresetDescription (*preset));
+}
+
+void PresetCollection::search (const String& query, OwnedArray<PresetDescription>& results,
+                               int maxResults) const
+{
+    StringArray terms;
+    addWords (query, terms);
+    if (terms.isEmpty())
+        return;
+
+    ScopedLock sl (lock);
+    SortedSet<int> matches;
+    for (int i = 0; i < terms.size(); ++i)
+    {
+        // words are sorted, so the ones a term starts are next to each other
+        const auto& term = terms.getReference (i);
+        SortedSet<int> termMatches;
+        for (auto iter = words.lower_bound (term); iter != words.end() && iter->first.startsWith (term); ++iter)
+            for (const auto index : iter->second)
+                termMatches.add (index);
+
+        if (i == 0)
+        {
+            matches.swapWith (termMatches);
+        }
+        else
+        {
+            for (int j = matches.size(); --j >= 0;)
+                if (! termMatches.contains (matches.getUnchecked (j)))
+                    matches.remove (j);
+        }
+
+        if (matches.isEmpty())
+            return;
+    }
+
+    SortByName sorter;
+    for (const auto index : matches)
+        results.addSorted (sorter, new PresetDescription (*presets.getUnchecked (index)));
+    if (maxResults >= 0 && results.size() > maxResults)
+        results.removeLast (results.size() - maxResults);
+}
+
+void PresetCollection::refresh()
+{
+    {
+        ScopedLock sl (scanLock);
+        scanPending = true;
+        scanFinished.reset();
+    }
+
+    if (isThreadRunning())
+        notify();
+    else
+        startThread (3);
+}
+
+bool PresetCollection::isScanning() const
+{
+    return ! scanFinished.wait (0);
+}
+
+bool PresetCollection::waitForScan (int timeoutMs)
+{
+    return scanFinished.wait (timeoutMs);
+}
+
+//=============================================================================
+void PresetCollection::loadIndex()
+{
+    const auto tree = BinaryModel::readFromFile (indexFile);
+    if (! tree.hasType ("presetIndex") || (int) tree.getProperty ("version") != EL_PRESET_INDEX_VERSION)
+        return;
+
+    OwnedArray<PresetDescription> loaded;
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+    {
+        const auto data = tree.getChild (i);
+        std::unique_ptr<PresetDescription> preset (new PresetDescription());
+        preset->file        = File (data.getProperty (Tags::file).toString());
+        preset->name        = data.getProperty (Tags::name).toString();
+        preset->format      = data.getProperty (Tags::format).toString();
+        preset->identifier  = data.getProperty (Tags::identifier).toString();
+        preset->size        = (int64) data.getProperty ("size", 0);
+        preset->modified    = (int64) data.getProperty ("modified", 0);
+        preset->tags.addTokens (data.getProperty ("tags").toString(), "\n", "");
+        preset->tags.removeEmptyStrings();
+        if (preset->file.getFullPathName().isNotEmpty())
+            loaded.add (preset.release());
+    }
+
+    setPresets (loaded);
+}
+
+void PresetCollection::saveIndex() const
+{
+    ValueTree tree ("presetIndex");
+    tree.setProperty ("version", EL_PRESET_INDEX_VERSION, nullptr);
+
+    {
+        ScopedLock sl (lock);
+        for (const auto* const preset : presets)
+        {
+            ValueTree data ("preset");
+            data.setProperty (Tags::file, preset->file.getFullPathName(), nullptr)
+                .setProperty (Tags::name, preset->name, nullptr)
+                .setProperty (Tags::format, preset->format, nullptr)
+                .setProperty (Tags::identifier, preset->identifier, nullptr)
+                .setProperty ("tags", preset->tags.joinIntoString ("\n"), nullptr)
+                .setProperty ("size", preset->size, nullptr)
+                .setProperty ("modified", preset->modified, nullptr);
+            tree.appendChild (data, nullptr);
+        }
+    }
+
+    indexFile.getParentDirectory().createDirectory();
+    if (! BinaryModel::writeToFile (tree, indexFile))
+    {
+        DBG("[EL] could not write preset index: " << indexFile.getFullPathName());
+    }
+}
+
+bool PresetCollection::scan()
+{
+    std::map<String, PresetDescription> indexed;
+    {
+        ScopedLock sl (lock);
+        for (const auto* const preset : presets)
+            indexed[preset->file.getFullPathName()] = *preset;
+    }
+
+    OwnedArray<PresetDescription> found;
+    std::map<String, int64> notPresets;
+    bool changed = false;
+
+    if (presetsDir.isDirectory())
+    {
+        DirectoryIterator iter (presetsDir, true, EL_PRESET_FILE_EXTENSIONS);
+        bool isDirectory = false;
+        int64 size = 0;
+        Time modTime;
+
+        while (iter.next (&isDirectory, nullptr, &size, &modTime, nullptr, nullptr))
+        {
+            if (threadShouldExit())
+                return false;
+            if (isDirectory)
+                continue;
+
+            const auto file = iter.getFile();
+            const auto path = file.getFullPathName();
+            const auto modified = modTime.toMilliseconds();
+
+            // unchanged files aren't opened
+            auto existing = indexed.find (path);
+            if (existing != indexed.end())
+            {
+                if (existing->second.size == size && existing->second.modified == modified)
+                {
+                    found.add (new PresetDescription (existing->second));
+                    indexed.erase (existing);
+                    continue;
+                }
+
+                indexed.erase (existing);
+            }
+            else
+            {
+                auto other = skipped.find (path);
+                if (other != skipped.end() && other->second == modified)
+                {
+                    notPresets[path] = modified;
+                    continue;
+                }
+            }
+
+            changed = true;
+            std::unique_ptr<PresetDescription> preset (new PresetDescription());
+            if (PresetDescription::read (file, presetsDir, *preset))
+            {
+                preset->size        = size;
+                preset->modified    = modified;
+                found.add (preset.release());
+            }
+            else
+            {
+                notPresets[path] = modified;
+            }
+        }
+    }
+
+    skipped.swap (notPresets);
+
+    // anything left was deleted
+    if (! indexed.empty())
+        changed = true;
+
+    if (changed)
+    {
+        setPresets (found);
+        saveIndex();
+        triggerAsyncUpdate();
+    }
+
+    return changed;
+}
+
+void PresetCollection::setPresets (OwnedArray<PresetDescription>& newPresets)
+{
+    std::map<String, Array<int>> newWords;
+    for (int i = 0; i < newPresets.size(); ++i)
+        for (const auto& word : getSearchWords (*newPresets.getUnchecked (i)))
+            newWords[word].add (i);
+
+    newPresets.minimiseStorageOverheads();
+    ScopedLock sl (lock);
+    presets.swapWith (newPresets);
+    words.swap (newWords);
+}
+
+void PresetCollection::run()
+{
+    while (! threadShouldExit())
+    {
+        {
+            ScopedLock sl (scanLock);
+            scanPending = false;
+        }
+
+        scan();
+
+        {
+            ScopedLock sl (scanLock);
+            if (! scanPending)
+                scanFinished.signal();
+        }
+
+        wait (presetWatchIntervalMs);
+    }
+}
+
+void PresetCollection::handleAsyncUpdate()
+{
+    if (onChanged)
+        onChanged();
+}
+
+}
@@ -29,10 +29,28 @@ struct PresetDescription
     String name;
     String identifier;
     String format;
+    /** The preset's "tags" property plus the folders it is in under Presets */
+    StringArray tags;
     File file;
+    int64 size      = 0;
+    int64 modified  = 0;
+
+    /** Reads a preset's description without decoding its plugin state.
+        Returns false if the file isn't a preset */
+    static bool read (const File& file, const File& presetsDir, PresetDescription& result);
 };
 
-class PresetCollection
+/** An index of the presets in the user data path.
+
+    The index is saved in the app data dir and loaded on construction, so
+    it is available without touching the preset files. A background thread
+    keeps it current: it watches the presets directory and only parses
+    files which were added or changed since they were indexed. Plugin
+    states are never read here, use Node::parse() on a preset's file when
+    it is applied.
+ */
+class PresetCollection : private Thread,
+                         private AsyncUpdater
 {
 public:
     struct SortByName
@@ -49,59 +67,67 @@ public:
         }
     };
 
-    PresetCollection() { }
-    ~PresetCollection() { }
+    /** Indexes the Presets folder of the user data path */
+    PresetCollection();
 
-    inline void clear()
-    {
-        presets.clear();
-    }
+    /** Indexes a directory, saving the index to a file */
+    PresetCollection (const File& presetsDir, const File& indexFile);
 
-    inline void getPresetsFor (const Node& node, OwnedArray<PresetDescription>& results) const
-    {
-        SortByName sorter;
-        for (const auto* const preset : presets)
-            if (preset->identifier == node.getIdentifier().toString() && preset->format == node.getFormat().toString())
-                results.addSorted (sorter, new PresetDescription (*preset));
-    }
+    ~PresetCollection();
+
+    /** Returns the default index file in the app data dir */
+    static File getDefaultIndexFile();
+
+    /** Forgets every preset. The next scan indexes them again */
+    void clear();
+
+    /** Returns the number of presets indexed */
+    int size() const;
+
+    /** Gets the presets for a node's plugin, sorted by name */
+    void getPresetsFor (const Node& node, OwnedArray<PresetDescription>& results) const;
+
+    /** Finds presets matching a query, sorted by name. Every word in the
+        query must start a word of a preset's name, tags, format or plugin
+        identifier, so "gra pia" finds "Grand Piano".
+     */
+    void search (const String& query, OwnedArray<PresetDescription>& results,
+                 int maxResults = -1) const;
 
     inline void addPresetFor (const Node& node, const String& name)
     {
         jassertfalse;
     }
 
-    inline void refresh()
-    {
-        clear();
-        
-        StringArray files; path.findPresetFiles (files);
-        for (const auto& filename : files)
-        {
-            const File file (filename);
-            const Node node (Node::parse (file), false);
-            if (node.isValid())
-            {
-                std::unique_ptr<PresetDescription> item;
-                item.reset (new PresetDescription());
-                item->file          = file;
-                item->name          = node.getName();
-                if (item->name.isEmpty())
-                    item->name = file.getFileNameWithoutExtension();
-                item->format        = node.getFormat();
-                item->identifier    = node.getIdentifier();
-                if (item->format.isEmpty() || item->identifier.isEmpty())
-                    continue;
-
-                presets.add (item.release());
-            }
-        }
+    /** Rescans the presets directory in the background. Starts watching
+        it if this is the first call */
+    void refresh();
 
-        presets.minimiseStorageOverheads();
-    }
+    /** Returns true while a scan is running or waiting to run */
+    bool isScanning() const;
+
+    /** Waits until a pending scan finished. Returns false on timeout */
+    bool waitForScan (int timeoutMs);
+
+    /** Called on the message thread after a scan changed the index */
+    std::function<void()> onChanged;
 
 private:
-    DataPath path;
+    const File presetsDir, indexFile;
+    CriticalSection lock;
     OwnedArray<PresetDescription> presets;
+    std::map<String, Array<int>> words;
+    std::map<String, int64> skipped;
+    CriticalSection scanLock;
+    bool scanPending = false;
+    WaitableEvent scanFinished { true };
+
+    void loadIndex();
+    void saveIndex() const;
+    bool scan();
+    void setPresets (OwnedArray<PresetDescription>& newPresets);
+    void run() override;
+    void handleAsyncUpdate() override;
 };
 
 }
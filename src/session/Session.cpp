@@ -24,7 +24,9 @@
 #include "MediaManager.h"
 #include "Globals.h"
 
+#include "session/BinaryModel.h"
 #include "session/Session.h"
+#include "session/SessionArchive.h"
 
 namespace Element {
 
@@ -119,6 +121,7 @@ namespace Element {
     {
         ValueTree saveData = objectData.createCopy();
         Node::sanitizeProperties (saveData, true);
+        Node::expandStates (saveData);
         return saveData.createXml();
     }
 
@@ -182,7 +185,7 @@ namespace Element {
     void Session::valueTreePropertyChanged (ValueTree& tree, const Identifier& property)
     {
         if (property == Tags::object ||
-            (tree.hasType(Tags::node) && (property == Tags::state || property == Tags::updater)))
+            (tree.hasType(Tags::node) && (property == Tags::state || property == Tags::programState || property == Tags::updater)))
         {
             return;
         }
@@ -246,10 +249,10 @@ namespace Element {
     void Session::valueTreeParentChanged (ValueTree& tree) { }
     void Session::valueTreeRedirected (ValueTree& tree) { }
     
-    void Session::saveGraphState()
+    void Session::saveGraphState (bool changedOnly)
     {
         for (int i = 0; i < getNumGraphs(); ++i)
-            getGraph(i).savePluginState();
+            getGraph(i).savePluginState (changedOnly);
     }
 
     void Session::restoreGraphState()
@@ -308,30 +311,46 @@ namespace Element {
     {
         ValueTree saveData = objectData.createCopy();
         Node::sanitizeProperties (saveData, true);
-        TemporaryFile tempFile (file);
+        return BinaryModel::writeToFile (saveData, file);
+    }
+
+    ValueTree Session::readFromFile (const File& file, bool lazyStates)
+    {
+        if (BinaryModel::isBinaryModel (file))
+            return BinaryModel::readFromFile (file, lazyStates);
 
-        if (auto fos = std::unique_ptr<FileOutputStream> (tempFile.getFile().createOutputStream()))
+        ValueTree data;
+        if (SessionArchive::isArchive (file))
         {
-            {
-                GZIPCompressorOutputStream gzip (*fos, 9);
-                saveData.writeToStream (gzip);
-            }
-            fos.reset();
-            return tempFile.overwriteTargetFileWithTemporary();
+            SessionArchive archive;
+            archive.setLazyStates (lazyStates);
+            archive.read (file, data);
+            return data;
         }
 
-        return false;
-    }
+        FileInputStream input (file);
+        if (! input.openedOk())
+            return data;
 
-    ValueTree Session::readFromFile (const File& file)
-    {
-        ValueTree data;
-        FileInputStream fi (file);
-        
+        // XML, or a gzipped or plain binary tree from older versions
+        uint8 start[3] = { 0, 0, 0 };
+        input.read (start, 3);
+        input.setPosition (0);
+        const bool hasBOM = start[0] == 0xef && start[1] == 0xbb && start[2] == 0xbf;
+        if (hasBOM || CharacterFunctions::isWhitespace ((char) start[0]) || start[0] == '<')
+        {
+            if (auto xml = XmlDocument::parse (file))
+                data = ValueTree::fromXml (*xml);
+        }
+        else if (start[0] == 0x1f && start[1] == 0x8b)
         {
-            GZIPDecompressorInputStream gzip (fi);
+            GZIPDecompressorInputStream gzip (input);
             data = ValueTree::readFromStream (gzip);
         }
+        else
+        {
+            data = ValueTree::readFromStream (input);
+        }
 
         return data;
     }
@@ -79,7 +79,9 @@ namespace Element {
 
         std::unique_ptr<XmlElement> createXml();
         
-        void saveGraphState();
+        /** Saves node states to the model. If changedOnly is true only nodes
+            that changed since they were last saved are captured */
+        void saveGraphState (bool changedOnly = false);
         void restoreGraphState();
         
         inline int getNumControllerDevices() const { return getControllerDevicesValueTree().getNumChildren(); }
@@ -117,7 +119,11 @@ namespace Element {
 
         /** Writes an encoded file */
         bool writeToFile (const File&) const;
-        static ValueTree readFromFile (const File&);
+
+        /** Reads a session, graph or preset file in any format Element writes.
+            If lazyStates is true, compressed plugin states are left that way
+            until a node is restored */
+        static ValueTree readFromFile (const File&, bool lazyStates = false);
         
         Value getActiveGraphIndexObject (bool syncUpdate = false) const
         { 
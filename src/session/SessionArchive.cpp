@@ -0,0 +1,415 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/BinaryModel.h"
+#include "session/Node.h"
+#include "session/SessionArchive.h"
+
+#define EL_SESSION_ARCHIVE_MAGIC            "ELSA"
+// version 1 has a gzipped ValueTree index, version 2 a binary model
+#define EL_SESSION_ARCHIVE_VERSION          2
+#define EL_SESSION_ARCHIVE_HEADER_SIZE      24
+#define EL_SESSION_ARCHIVE_CHUNK_PREFIX     "chunk:"
+// states are rewritten on every save, so favor speed over size
+#define EL_SESSION_ARCHIVE_COMPRESSION      3
+// rewrite the file when more than this much, and more than half of it, is dead
+#define EL_SESSION_ARCHIVE_MIN_GARBAGE      (4 * 1024 * 1024)
+
+namespace Element {
+
+struct SessionArchiveChunk
+{
+    int64 offset    = 0;
+    int64 size      = 0;
+    int64 rawSize   = 0;
+};
+
+using SessionArchiveChunkMap = std::map<String, SessionArchiveChunk>;
+
+/* A state to store, either plain or still compressed from lazy loading */
+struct SessionArchiveState
+{
+    MemoryBlock data;
+    CompressedState::Ptr compressed;
+    int64 getSize() const { return compressed != nullptr ? compressed->getSize() : (int64) data.getSize(); }
+};
+
+using SessionArchiveStateMap = std::map<String, SessionArchiveState>;
+
+/* header: magic, version, index offset and index size */
+static void writeArchiveHeader (OutputStream& output, int64 indexOffset, int64 indexSize)
+{
+    output.write (EL_SESSION_ARCHIVE_MAGIC, 4);
+    output.writeInt (EL_SESSION_ARCHIVE_VERSION);
+    output.writeInt64 (indexOffset);
+    output.writeInt64 (indexSize);
+}
+
+static bool readArchiveHeader (InputStream& input, int& version, int64& indexOffset, int64& indexSize)
+{
+    char magic[4];
+    if (input.read (magic, 4) != 4 || memcmp (magic, EL_SESSION_ARCHIVE_MAGIC, 4) != 0)
+        return false;
+    version = input.readInt();
+    if (version < 1 || version > EL_SESSION_ARCHIVE_VERSION)
+        return false;
+    indexOffset = input.readInt64();
+    indexSize   = input.readInt64();
+    return indexOffset >= EL_SESSION_ARCHIVE_HEADER_SIZE && indexSize > 0
+        && indexOffset + indexSize <= input.getTotalLength();
+}
+
+static MemoryBlock compressArchiveData (const void* data, size_t size)
+{
+    MemoryOutputStream output;
+    {
+        GZIPCompressorOutputStream gzip (output, EL_SESSION_ARCHIVE_COMPRESSION);
+        gzip.write (data, size);
+    }
+    return output.getMemoryBlock();
+}
+
+static ValueTree readArchiveIndex (InputStream& input, int version, int64 offset, int64 size)
+{
+    if (version == 1)
+    {
+        SubregionStream region (&input, offset, size, false);
+        GZIPDecompressorInputStream gzip (region);
+        return ValueTree::readFromStream (gzip);
+    }
+
+    MemoryBlock index;
+    if (! input.setPosition (offset) || input.readIntoMemoryBlock (index, (ssize_t) size) != (size_t) size)
+        return {};
+    return BinaryModel::read (index.getData(), index.getSize());
+}
+
+static MemoryBlock createArchiveIndex (const ValueTree& model, const SessionArchiveChunkMap& chunks)
+{
+    ValueTree index ("archive");
+    index.setProperty ("version", EL_SESSION_ARCHIVE_VERSION, nullptr);
+    for (const auto& c : chunks)
+    {
+        ValueTree chunk ("chunk");
+        chunk.setProperty ("hash",    c.first, nullptr)
+             .setProperty ("offset",  c.second.offset, nullptr)
+             .setProperty ("size",    c.second.size, nullptr)
+             .setProperty ("rawSize", c.second.rawSize, nullptr);
+        index.appendChild (chunk, nullptr);
+    }
+
+    ValueTree modelData ("model");
+    modelData.appendChild (model, nullptr);
+    index.appendChild (modelData, nullptr);
+
+    MemoryOutputStream output;
+    BinaryModel::write (index, output);
+    return output.getMemoryBlock();
+}
+
+static void readChunkTable (const ValueTree& index, SessionArchiveChunkMap& chunks)
+{
+    for (int i = 0; i < index.getNumChildren(); ++i)
+    {
+        const auto child = index.getChild (i);
+        if (! child.hasType ("chunk"))
+            continue;
+        SessionArchiveChunk chunk;
+        chunk.offset  = (int64) child.getProperty ("offset");
+        chunk.size    = (int64) child.getProperty ("size");
+        chunk.rawSize = (int64) child.getProperty ("rawSize");
+        chunks[child.getProperty ("hash").toString()] = chunk;
+    }
+}
+
+static bool isValidChunk (InputStream& input, const SessionArchiveChunk& chunk)
+{
+    return chunk.offset >= EL_SESSION_ARCHIVE_HEADER_SIZE && chunk.size > 0
+        && chunk.offset + chunk.size <= input.getTotalLength()
+        && CompressedState::isPlausibleSize (chunk.rawSize, chunk.size);
+}
+
+static bool readArchiveChunk (InputStream& input, const SessionArchiveChunk& chunk, MemoryBlock& data)
+{
+    if (! isValidChunk (input, chunk))
+        return false;
+
+    SubregionStream region (&input, chunk.offset, chunk.size, false);
+    GZIPDecompressorInputStream gzip (region);
+    data.setSize ((size_t) chunk.rawSize);
+    if (gzip.read (data.getData(), (int) chunk.rawSize) == (int) chunk.rawSize)
+        return true;
+    data.reset();
+    return false;
+}
+
+/* Reads a chunk without decompressing it */
+static CompressedState::Ptr readCompressedChunk (InputStream& input, const String& hash,
+                                                 const SessionArchiveChunk& chunk)
+{
+    MemoryBlock data;
+    if (! isValidChunk (input, chunk) || ! input.setPosition (chunk.offset) ||
+        input.readIntoMemoryBlock (data, (ssize_t) chunk.size) != (size_t) chunk.size)
+        return nullptr;
+    return new CompressedState (std::move (data), chunk.rawSize, hash);
+}
+
+/* Replaces node states with chunk references and collects the data by hash.
+   States still compressed from a lazy read already know their hash */
+static void extractStates (ValueTree tree, SessionArchiveStateMap& states)
+{
+    if (tree.hasType (Tags::node))
+    {
+        for (const auto& property : { Tags::state, Tags::programState })
+        {
+            if (! tree.hasProperty (property))
+                continue;
+
+            SessionArchiveState state;
+            String hash;
+            state.compressed = CompressedState::fromVar (tree.getProperty (property));
+            if (state.compressed != nullptr && state.compressed->getHash().isNotEmpty())
+            {
+                hash = state.compressed->getHash();
+            }
+            else
+            {
+                state.compressed = nullptr;
+                if (! Node::getStateData (tree.getProperty (property), state.data))
+                    continue;
+                hash = MD5 (state.data).toHexString();
+            }
+
+            tree.setProperty (property, EL_SESSION_ARCHIVE_CHUNK_PREFIX + hash, nullptr);
+            if (states.find (hash) == states.end())
+                states[hash] = std::move (state);
+        }
+    }
+
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+        extractStates (tree.getChild (i), states);
+}
+
+/* Puts states back in place of chunk references */
+static void restoreStates (ValueTree tree, const SessionArchiveChunkMap& chunks, InputStream& input,
+                           std::map<String, var>& states, bool lazy)
+{
+    if (tree.hasType (Tags::node))
+    {
+        for (const auto& property : { Tags::state, Tags::programState })
+        {
+            const auto value = tree.getProperty (property).toString();
+            if (! value.startsWith (EL_SESSION_ARCHIVE_CHUNK_PREFIX))
+                continue;
+
+            const auto hash = value.substring (String (EL_SESSION_ARCHIVE_CHUNK_PREFIX).length());
+            auto state = states.find (hash);
+            if (state == states.end())
+            {
+                var value;
+                MemoryBlock data;
+                const auto chunk = chunks.find (hash);
+                if (chunk != chunks.end() && lazy)
+                {
+                    if (auto compressed = readCompressedChunk (input, hash, chunk->second))
+                        value = var (compressed.get());
+                }
+                else if (chunk != chunks.end() && readArchiveChunk (input, chunk->second, data))
+                {
+                    value = var (data);
+                }
+
+                if (value.isVoid())
+                {
+                    DBG("[EL] session archive: missing state chunk " << hash);
+                    tree.removeProperty (property, nullptr);
+                    continue;
+                }
+
+                state = states.insert ({ hash, value }).first;
+            }
+
+            tree.setProperty (property, state->second, nullptr);
+        }
+    }
+
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+        restoreStates (tree.getChild (i), chunks, input, states, lazy);
+}
+
+//=============================================================================
+bool SessionArchive::isArchive (const File& file)
+{
+    FileInputStream input (file);
+    char magic[4];
+    return input.openedOk() && input.read (magic, 4) == 4
+        && memcmp (magic, EL_SESSION_ARCHIVE_MAGIC, 4) == 0;
+}
+
+Result SessionArchive::write (const ValueTree& session, const File& file)
+{
+    numWritten = numReused = 0;
+    compacted = false;
+    if (! session.isValid())
+        return Result::fail ("Invalid session data");
+
+    ValueTree model = session.createCopy();
+    Node::sanitizeProperties (model, true);
+    SessionArchiveStateMap states;
+    extractStates (model, states);
+
+    // chunks already in the file don't need writing again
+    SessionArchiveChunkMap existing;
+    int64 fileSize = 0;
+    bool canAppend = false;
+    {
+        FileInputStream input (file);
+        int version = 0;
+        int64 indexOffset = 0, indexSize = 0;
+        if (input.openedOk() && readArchiveHeader (input, version, indexOffset, indexSize))
+        {
+            readChunkTable (readArchiveIndex (input, version, indexOffset, indexSize), existing);
+            fileSize  = input.getTotalLength();
+            canAppend = true;
+        }
+    }
+
+    SessionArchiveChunkMap chunks;
+    std::map<String, MemoryBlock> pending;
+    int64 liveBytes = 0, newBytes = 0;
+    for (const auto& state : states)
+    {
+        const auto found = existing.find (state.first);
+        if (found != existing.end())
+        {
+            chunks[state.first] = found->second;
+            liveBytes += found->second.size;
+            ++numReused;
+        }
+        else
+        {
+            // lazily loaded states are still compressed
+            const auto data = state.second.compressed != nullptr
+                ? state.second.compressed->getCompressedData()
+                : compressArchiveData (state.second.data.getData(), state.second.data.getSize());
+            newBytes += (int64) data.getSize();
+            pending[state.first] = data;
+        }
+    }
+
+    numWritten = (int) pending.size();
+    const int64 garbage = fileSize - EL_SESSION_ARCHIVE_HEADER_SIZE - liveBytes;
+    compacted = atomic || ! canAppend || garbage > jmax ((int64) EL_SESSION_ARCHIVE_MIN_GARBAGE, liveBytes + newBytes);
+
+    auto writeNewChunks = [&] (OutputStream& output)
+    {
+        for (const auto& data : pending)
+        {
+            SessionArchiveChunk chunk;
+            chunk.offset  = output.getPosition();
+            chunk.size    = (int64) data.second.getSize();
+            chunk.rawSize = states[data.first].getSize();
+            output.write (data.second.getData(), data.second.getSize());
+            chunks[data.first] = chunk;
+        }
+    };
+
+    if (! compacted)
+    {
+        // append new chunks and an index, then point the header at them.
+        // if this fails half way the header still points at the old index
+        FileOutputStream output (file);
+        if (output.failedToOpen())
+            return Result::fail ("Could not open session file");
+
+        writeNewChunks (output);
+        const auto index = createArchiveIndex (model, chunks);
+        const int64 indexOffset = output.getPosition();
+        output.write (index.getData(), index.getSize());
+        output.flush();
+
+        if (! output.setPosition (0))
+            return Result::fail ("Error writing session file");
+        writeArchiveHeader (output, indexOffset, (int64) index.getSize());
+        output.flush();
+        return output.getStatus().wasOk() ? Result::ok() : Result::fail ("Error writing session file");
+    }
+
+    // write everything that's still referenced to a new file
+    TemporaryFile tempFile (file);
+    {
+        FileOutputStream output (tempFile.getFile());
+        if (output.failedToOpen())
+            return Result::fail ("Could not create session file");
+
+        writeArchiveHeader (output, 0, 0);
+
+        if (numReused > 0)
+        {
+            FileInputStream input (file);
+            for (auto& c : chunks)
+            {
+                if (! input.setPosition (c.second.offset))
+                    return Result::fail ("Error reading session file");
+                c.second.offset = output.getPosition();
+                if (output.writeFromInputStream (input, c.second.size) != c.second.size)
+                    return Result::fail ("Error reading session file");
+            }
+        }
+
+        writeNewChunks (output);
+        const auto index = createArchiveIndex (model, chunks);
+        const int64 indexOffset = output.getPosition();
+        output.write (index.getData(), index.getSize());
+        output.setPosition (0);
+        writeArchiveHeader (output, indexOffset, (int64) index.getSize());
+        output.flush();
+        if (output.getStatus().failed())
+            return Result::fail ("Error writing session file");
+    }
+
+    return tempFile.overwriteTargetFileWithTemporary()
+        ? Result::ok() : Result::fail ("Error writing session file");
+}
+
+Result SessionArchive::read (const File& file, ValueTree& session)
+{
+    FileInputStream input (file);
+    int version = 0;
+    int64 indexOffset = 0, indexSize = 0;
+    if (! input.openedOk() || ! readArchiveHeader (input, version, indexOffset, indexSize))
+        return Result::fail ("Not a valid session file");
+
+    auto index = readArchiveIndex (input, version, indexOffset, indexSize);
+    auto modelData = index.getChildWithName ("model");
+    auto model = modelData.getChild (0);
+    if (! model.isValid())
+        return Result::fail ("Not a valid session file");
+    modelData.removeChild (model, nullptr);
+
+    SessionArchiveChunkMap chunks;
+    readChunkTable (index, chunks);
+    std::map<String, var> states;
+    restoreStates (model, chunks, input, states, lazyStates);
+
+    session = model;
+    return Result::ok();
+}
+
+}
@@ -0,0 +1,78 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** A session file that keeps plugin states as compressed binary chunks.
+
+    Every node's state and program state is pulled out of the model,
+    compressed and stored once per distinct content, keyed by its MD5. The
+    model refers to chunks by hash and is written as a binary model in an
+    index at the end of the file.
+
+    Saving over an existing archive appends only chunks it doesn't have yet
+    plus a new index, then points the header at it. When too much of the
+    file is unreferenced the archive is rewritten without the dead chunks.
+ */
+class SessionArchive
+{
+public:
+    SessionArchive() = default;
+    ~SessionArchive() = default;
+
+    /** Returns true if a file is a session archive */
+    static bool isArchive (const File& file);
+
+    /** Writes a session model */
+    Result write (const ValueTree& session, const File& file);
+
+    /** Reads a session model. States come back as binary properties */
+    Result read (const File& file, ValueTree& session);
+
+    /** Chunks the last write added to the file */
+    int getNumChunksWritten() const noexcept    { return numWritten; }
+
+    /** Chunks the last write found already in the file */
+    int getNumChunksReused() const noexcept     { return numReused; }
+
+    /** Returns true if the last write rewrote the whole file */
+    bool wasCompacted() const noexcept          { return compacted; }
+
+    /** When set, every write rewrites the file through a temporary one which
+        then replaces it, so a crash can't leave a partly written file. Chunks
+        already in the file are copied, not compressed again */
+    void setAtomic (bool shouldBeAtomic) noexcept { atomic = shouldBeAtomic; }
+
+    /** When set, read() leaves states compressed as CompressedState objects
+        so they are only decompressed when a node is restored */
+    void setLazyStates (bool lazy) noexcept     { lazyStates = lazy; }
+
+private:
+    int numWritten = 0;
+    int numReused  = 0;
+    bool compacted = false;
+    bool atomic    = false;
+    bool lazyStates = false;
+};
+
+}
@@ -0,0 +1,127 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/SessionArchive.h"
+#include "session/SessionWriter.h"
+
+namespace Element {
+
+SessionWriter::SessionWriter()
+    : Thread ("Element Session Writer")
+{
+    idle.signal();
+}
+
+SessionWriter::~SessionWriter()
+{
+    // let a write that already started finish so the file is left whole
+    signalThreadShouldExit();
+    notify();
+    stopThread (-1);
+    cancelPendingUpdate();
+}
+
+void SessionWriter::write (const ValueTree& session, const File& file, bool atomic)
+{
+    std::unique_ptr<Job> job (new Job());
+    job->model  = session.createCopy();
+    job->file   = file;
+    job->atomic = atomic;
+
+    {
+        ScopedLock sl (lock);
+        pending.swap (job);
+        idle.reset();
+    }
+
+    if (! isThreadRunning())
+        startThread (3);
+    notify();
+}
+
+bool SessionWriter::isBusy() const
+{
+    ScopedLock sl (lock);
+    return writing || pending != nullptr;
+}
+
+bool SessionWriter::waitUntilIdle (int timeoutMs)
+{
+    return idle.wait (timeoutMs);
+}
+
+Result SessionWriter::getLastResult() const
+{
+    ScopedLock sl (lock);
+    return lastResult;
+}
+
+void SessionWriter::run()
+{
+    while (! threadShouldExit())
+    {
+        std::unique_ptr<Job> job;
+        {
+            ScopedLock sl (lock);
+            job.swap (pending);
+            writing = job != nullptr;
+            if (job == nullptr)
+                idle.signal();
+        }
+
+        if (job == nullptr)
+        {
+            wait (-1);
+            continue;
+        }
+
+        SessionArchive archive;
+        archive.setAtomic (job->atomic);
+        const auto result = archive.write (job->model, job->file);
+
+        {
+            ScopedLock sl (lock);
+            writing    = false;
+            lastFile   = job->file;
+            lastResult = result;
+        }
+
+        triggerAsyncUpdate();
+    }
+
+    ScopedLock sl (lock);
+    pending = nullptr;
+    idle.signal();
+}
+
+void SessionWriter::handleAsyncUpdate()
+{
+    File file;
+    Result result (Result::ok());
+    {
+        ScopedLock sl (lock);
+        file   = lastFile;
+        result = lastResult;
+    }
+
+    if (onWritten)
+        onWritten (file, result);
+}
+
+}
@@ -0,0 +1,75 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** Writes session archives on a background thread.
+
+    write() copies the model on the calling thread, which only takes as long
+    as copying memory, and hands the copy to the writer thread which pulls
+    the states out, compresses and writes them. If a write is asked for while
+    another is still running, only the newest one waiting is kept.
+ */
+class SessionWriter : private Thread,
+                      private AsyncUpdater
+{
+public:
+    SessionWriter();
+    ~SessionWriter();
+
+    /** Queues a copy of the session model to be written to a file */
+    void write (const ValueTree& session, const File& file, bool atomic = true);
+
+    /** Returns true if a write is running or waiting */
+    bool isBusy() const;
+
+    /** Waits for queued writes to finish. Returns false if it timed out */
+    bool waitUntilIdle (int timeoutMs = -1);
+
+    /** Result of the last write that finished */
+    Result getLastResult() const;
+
+    /** Called on the message thread when a write finished */
+    std::function<void (const File&, const Result&)> onWritten;
+
+private:
+    struct Job
+    {
+        ValueTree model;
+        File file;
+        bool atomic = true;
+    };
+
+    CriticalSection lock;
+    std::unique_ptr<Job> pending;
+    bool writing = false;
+    File lastFile;
+    Result lastResult { Result::ok() };
+    WaitableEvent idle { true };
+
+    void run() override;
+    void handleAsyncUpdate() override;
+    JUCE_DECLARE_NON_COPYABLE (SessionWriter)
+};
+
+}
@@ -0,0 +1,250 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "session/BinaryModel.h"
+#include "session/Node.h"
+#include "session/SessionArchive.h"
+
+namespace Element {
+
+class BinaryModelTest : public UnitTestBase
+{
+public:
+    BinaryModelTest() : UnitTestBase ("Binary Model", "session", "binaryModel") { }
+
+    void runTest() override
+    {
+        testValues();
+        testSubtrees();
+        testLazyStates();
+        testArchiveStates();
+        testFiles();
+        testConvert();
+        testLoadTimes();
+    }
+
+private:
+    static MemoryBlock encode (const ValueTree& tree)
+    {
+        MemoryOutputStream output;
+        BinaryModel::write (tree, output);
+        return output.getMemoryBlock();
+    }
+
+    static ValueTree roundTrip (const ValueTree& tree, bool lazyStates = false)
+    {
+        const auto data = encode (tree);
+        return BinaryModel::read (data.getData(), data.getSize(), lazyStates);
+    }
+
+    void testValues()
+    {
+        beginTest ("values");
+        ValueTree tree ("test");
+        Array<var> array;
+        array.add (1); array.add ("two"); array.add (3.5);
+        tree.setProperty ("int", -1234, nullptr)
+            .setProperty ("int64", (int64) 1 << 40, nullptr)
+            .setProperty ("double", 0.125, nullptr)
+            .setProperty ("true", true, nullptr)
+            .setProperty ("false", false, nullptr)
+            .setProperty ("string", "hello", nullptr)
+            .setProperty ("number", "42", nullptr)
+            .setProperty ("padded", "007", nullptr)
+            .setProperty ("binary", var (createState (1, 100, 8)), nullptr)
+            .setProperty ("large", var (createState (2, 65536, 8)), nullptr)
+            .setProperty ("array", array, nullptr);
+        tree.appendChild (ValueTree ("child").setProperty ("string", "hello", nullptr), nullptr);
+
+        const auto copy = roundTrip (tree);
+        expect (copy.isEquivalentTo (tree));
+        expectEquals ((int) copy.getProperty ("int"), -1234);
+        expect (copy.getProperty ("int64") == var ((int64) 1 << 40));
+        expectEquals ((double) copy.getProperty ("double"), 0.125);
+        expect (copy.getProperty ("number").isInt());
+        expect (copy.getProperty ("padded").isString());
+        expect (*copy.getProperty ("large").getBinaryData() == createState (2, 65536, 8));
+        expectEquals (copy.getProperty ("array").size(), 3);
+
+        // large blocks are compressed
+        expect (encode (tree).getSize() < 65536);
+
+        const char garbage[] = "ELBM\x01\x00\x00\x00\xff\xff";
+        expect (! BinaryModel::read (garbage, sizeof (garbage)).isValid());
+        expect (! BinaryModel::read ("<session/>", 10).isValid());
+    }
+
+    void testSubtrees()
+    {
+        beginTest ("subtrees");
+        ValueTree session (Tags::session);
+        auto graphs = session.getOrCreateChildWithName (Tags::graphs, nullptr);
+        graphs.setProperty (Tags::active, 1, nullptr);
+        for (int i = 0; i < 3; ++i)
+            graphs.appendChild (Node::createGraph ("Graph " + String (i + 1)).getValueTree(), nullptr);
+
+        const auto data = encode (session);
+        BinaryModel model (data.getData(), data.getSize());
+        expect (model.isValid());
+        const auto root = model.getRoot();
+        expect (root.hasType (Tags::session));
+        const auto graphsTree = root.getChildWithName (Tags::graphs);
+        expectEquals (graphsTree.getNumChildren(), 3);
+        expectEquals ((int) graphsTree.getProperty (Tags::active), 1);
+        const auto graph = graphsTree.getChild (1).createValueTree();
+        expectEquals (graph.getProperty (Tags::name).toString(), String ("Graph 2"));
+        expect (graph.isEquivalentTo (graphs.getChild (1)));
+        expect (! graphsTree.getChild (3).isValid());
+    }
+
+    void testLazyStates()
+    {
+        beginTest ("lazy states");
+        const auto state = createState (3, 32768, 8);
+        ValueTree node (Tags::node);
+        node.setProperty (Tags::state, var (state), nullptr);
+
+        const auto lazy = roundTrip (node, true);
+        auto* compressed = CompressedState::fromVar (lazy.getProperty (Tags::state));
+        expect (compressed != nullptr);
+        MemoryBlock data;
+        expect (Node::getStateData (lazy.getProperty (Tags::state), data));
+        expect (data == state);
+
+        // written again without decompressing
+        const auto again = roundTrip (lazy);
+        expect (*again.getProperty (Tags::state).getBinaryData() == state);
+
+        auto expanded = lazy.createCopy();
+        Node::expandStates (expanded);
+        expect (*expanded.getProperty (Tags::state).getBinaryData() == state);
+
+        // a corrupt size fails instead of allocating for it
+        CompressedState corrupt (compressed->getCompressedData(), (int64) 1 << 40);
+        expect (! corrupt.decompress (data));
+        expect (! CompressedState::isPlausibleSize (0, 100));
+        expect (! CompressedState::isPlausibleSize (100 * 1024 * 1024, 100));
+        expect (CompressedState::isPlausibleSize (compressed->getSize(),
+                                                  (int64) compressed->getCompressedData().getSize()));
+    }
+
+    void testArchiveStates()
+    {
+        beginTest ("archive lazy states");
+        TemporaryFile first (".els"), second (".els");
+        const auto state = createState (4, 65536, 8);
+        ValueTree session (Tags::session);
+        auto graph = Node::createGraph ("Graph").getValueTree();
+        session.getOrCreateChildWithName (Tags::graphs, nullptr).appendChild (graph, nullptr);
+        ValueTree node (Tags::node);
+        node.setProperty (Tags::state, var (state), nullptr);
+        graph.getChildWithName (Tags::nodes).appendChild (node, nullptr);
+        expect (SessionArchive().write (session, first.getFile()).wasOk());
+
+        SessionArchive archive;
+        archive.setLazyStates (true);
+        ValueTree loaded;
+        expect (archive.read (first.getFile(), loaded).wasOk());
+        const auto loadedState = loaded.getChildWithName (Tags::graphs).getChild (0)
+                                       .getChildWithName (Tags::nodes).getChild (0)
+                                       .getProperty (Tags::state);
+        expect (CompressedState::fromVar (loadedState) != nullptr);
+
+        // saving the lazy model elsewhere copies the compressed chunk
+        expect (archive.write (loaded, second.getFile()).wasOk());
+        ValueTree reloaded;
+        expect (SessionArchive().read (second.getFile(), reloaded).wasOk());
+        MemoryBlock data;
+        expect (Node::getStateData (reloaded.getChildWithName (Tags::graphs).getChild (0)
+                                            .getChildWithName (Tags::nodes).getChild (0)
+                                            .getProperty (Tags::state), data));
+        expect (data == state);
+    }
+
+    Array<File> findModelFiles()
+    {
+        Array<File> files;
+        const auto dir = getDataDir();
+        files.addArray (dir.getChildFile ("Sessions").findChildFiles (File::findFiles, false, "*.els"));
+        files.addArray (dir.getChildFile ("Graphs").findChildFiles (File::findFiles, false, "*.elg"));
+        return files;
+    }
+
+    void testFiles()
+    {
+        beginTest ("data files round trip");
+        for (const auto& file : findModelFiles())
+        {
+            const auto xmlTree = Session::readFromFile (file);
+            expect (xmlTree.isValid(), file.getFileName());
+            expect (roundTrip (xmlTree).isEquivalentTo (xmlTree), file.getFileName());
+        }
+    }
+
+    void testConvert()
+    {
+        beginTest ("convert");
+        const auto source = getDataDir().getChildFile ("Graphs/DefaultGraph.elg");
+        TemporaryFile binary (".elg"), xml (".xml");
+        expect (BinaryModel::convert (source, binary.getFile()).wasOk());
+        expect (BinaryModel::isBinaryModel (binary.getFile()));
+        expect (BinaryModel::convert (binary.getFile(), xml.getFile()).wasOk());
+        expect (! BinaryModel::isBinaryModel (xml.getFile()));
+
+        const auto original = Session::readFromFile (source);
+        expect (Session::readFromFile (binary.getFile()).isEquivalentTo (original));
+        expect (Session::readFromFile (xml.getFile()).isEquivalentTo (original));
+        expect (Node::parse (binary.getFile()).isEquivalentTo (Node::parse (source)));
+    }
+
+    void testLoadTimes()
+    {
+        beginTest ("load times");
+        const int iterations = 20;
+        for (const auto& file : findModelFiles())
+        {
+            TemporaryFile binary (file.getFileExtension());
+            expect (BinaryModel::writeToFile (Session::readFromFile (file), binary.getFile()));
+
+            auto time = [iterations] (std::function<ValueTree()> load) {
+                const auto start = Time::getHighResolutionTicks();
+                for (int i = 0; i < iterations; ++i)
+                    load();
+                return Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start)
+                    * 1000.0 / iterations;
+            };
+
+            const auto xmlMs = time ([&file] {
+                auto xml = XmlDocument::parse (file);
+                return xml != nullptr ? ValueTree::fromXml (*xml) : ValueTree();
+            });
+            const auto binaryMs = time ([&binary] {
+                return BinaryModel::readFromFile (binary.getFile());
+            });
+
+            logMessage (file.getFileName() + ": xml " + String (xmlMs, 3) + " ms, binary "
+                        + String (binaryMs, 3) + " ms, " + String (file.getSize()) + " -> "
+                        + String (binary.getFile().getSize()) + " bytes");
+        }
+    }
+};
+
+static BinaryModelTest sBinaryModelTest;
+
+}
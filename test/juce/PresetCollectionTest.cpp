@@ -0,0 +1,189 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "session/BinaryModel.h"
+#include "session/Presets.h"
+
+namespace Element {
+
+class PresetCollectionTest : public UnitTestBase
+{
+public:
+    PresetCollectionTest() : UnitTestBase ("Preset Collection", "session", "presets") { }
+
+    void initialise() override
+    {
+        dir = File::createTempFile ("presets");
+        dir.createDirectory();
+        presetsDir = dir.getChildFile ("Presets");
+        presetsDir.createDirectory();
+        indexFile = dir.getChildFile ("PresetIndex.dat");
+    }
+
+    void shutdown() override
+    {
+        dir.deleteRecursively();
+    }
+
+    void runTest() override
+    {
+        testScan();
+        testSearch();
+        testPersistence();
+        testChanges();
+    }
+
+private:
+    File dir, presetsDir, indexFile;
+
+    static ValueTree createNode (const String& identifier, const String& tags = String())
+    {
+        ValueTree node (Tags::node);
+        MemoryBlock state (1024 * 64);
+        state.fillWith (7);
+        node.setProperty (Tags::format, "VST3", nullptr)
+            .setProperty (Tags::identifier, identifier, nullptr)
+            .setProperty (Tags::state, var (state), nullptr);
+        if (tags.isNotEmpty())
+            node.setProperty ("tags", tags, nullptr);
+        return node;
+    }
+
+    void writePreset (const String& path, const String& name, const String& identifier,
+                      const String& tags = String())
+    {
+        ValueTree preset (Tags::preset);
+        preset.setProperty (Tags::name, name, nullptr);
+        preset.appendChild (createNode (identifier, tags), nullptr);
+        const auto file = presetsDir.getChildFile (path);
+        file.getParentDirectory().createDirectory();
+        expect (BinaryModel::writeToFile (preset, file));
+    }
+
+    void scan (PresetCollection& presets)
+    {
+        presets.refresh();
+        expect (presets.waitForScan (5000));
+        expect (! presets.isScanning());
+    }
+
+    void testScan()
+    {
+        beginTest ("scan");
+        writePreset ("Grand Piano.elpreset", "Grand Piano", "/plugins/Piano.vst3", "keys, acoustic");
+        writePreset ("Pads/Warm Pad.elpreset", "Warm Pad", "/plugins/Synth.vst3");
+        writePreset ("Pads/Glass Pad.elpreset", "Glass Pad", "/plugins/Synth.vst3");
+
+        // an XML preset from older versions
+        ValueTree legacy (Tags::preset);
+        legacy.setProperty (Tags::name, "Bright Piano", nullptr);
+        legacy.appendChild (createNode ("/plugins/Piano.vst3"), nullptr);
+        if (auto xml = legacy.createXml())
+            xml->writeTo (presetsDir.getChildFile ("Bright Piano.elpreset"));
+
+        presetsDir.getChildFile ("Broken.elpreset").replaceWithText ("not a preset");
+
+        PresetCollection presets (presetsDir, indexFile);
+        expectEquals (presets.size(), 0);
+        scan (presets);
+        expectEquals (presets.size(), 4);
+
+        OwnedArray<PresetDescription> results;
+        Node node (Tags::node);
+        node.setProperty (Tags::format, "VST3");
+        node.setProperty (Tags::identifier, "/plugins/Synth.vst3");
+        presets.getPresetsFor (node, results);
+        expectEquals (results.size(), 2);
+        expectEquals (results[0]->name, String ("Glass Pad"));
+        expect (results[0]->tags.contains ("Pads"));
+    }
+
+    void testSearch()
+    {
+        beginTest ("search");
+        PresetCollection presets (presetsDir, indexFile);
+        scan (presets);
+
+        OwnedArray<PresetDescription> results;
+        presets.search ("pia", results);
+        expectEquals (results.size(), 2);
+        expectEquals (results[0]->name, String ("Bright Piano"));
+
+        results.clear();
+        presets.search ("gra PIA", results);
+        expectEquals (results.size(), 1);
+        expectEquals (results[0]->name, String ("Grand Piano"));
+
+        results.clear();
+        presets.search ("acoustic", results);
+        expectEquals (results.size(), 1);
+
+        results.clear();
+        presets.search ("pads", results);
+        expectEquals (results.size(), 2);
+
+        results.clear();
+        presets.search ("synth", results, 1);
+        expectEquals (results.size(), 1);
+
+        results.clear();
+        presets.search ("organ", results);
+        expect (results.isEmpty());
+    }
+
+    void testPersistence()
+    {
+        beginTest ("persistence");
+        expect (indexFile.existsAsFile());
+        PresetCollection presets (presetsDir, indexFile);
+        // available before any scan
+        expectEquals (presets.size(), 4);
+        OwnedArray<PresetDescription> results;
+        presets.search ("warm", results);
+        expectEquals (results.size(), 1);
+    }
+
+    void testChanges()
+    {
+        beginTest ("changes");
+        PresetCollection presets (presetsDir, indexFile);
+        scan (presets);
+
+        presetsDir.getChildFile ("Pads/Glass Pad.elpreset").deleteFile();
+        writePreset ("Strings.elpreset", "Strings", "/plugins/Synth.vst3");
+        scan (presets);
+        expectEquals (presets.size(), 4);
+
+        OwnedArray<PresetDescription> results;
+        presets.search ("glass", results);
+        expect (results.isEmpty());
+        presets.search ("strings", results);
+        expectEquals (results.size(), 1);
+
+        // applying a preset reads its state
+        const auto data = Node::parse (results[0]->file);
+        MemoryBlock state;
+        expect (Node::getStateData (data.getProperty (Tags::state), state));
+        expectEquals ((int) state.getSize(), 1024 * 64);
+    }
+};
+
+static PresetCollectionTest sPresetCollectionTest;
+
+}
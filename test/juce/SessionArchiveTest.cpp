@@ -0,0 +1,149 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "session/Node.h"
+#include "session/SessionArchive.h"
+
+namespace Element {
+
+class SessionArchiveTest : public UnitTestBase
+{
+public:
+    SessionArchiveTest() : UnitTestBase ("Session Archive", "session", "archive") { }
+
+    void runTest() override
+    {
+        testRoundTrip();
+        testIncremental();
+        testCompaction();
+        testLegacyStates();
+    }
+
+private:
+    static MemoryBlock getState (const ValueTree& session, int index)
+    {
+        MemoryBlock data;
+        const auto nodes = session.getChildWithName (Tags::graphs).getChild (0).getChildWithName (Tags::nodes);
+        Node::getStateData (nodes.getChild (index).getProperty (Tags::state), data);
+        return data;
+    }
+
+    void testRoundTrip()
+    {
+        beginTest ("round trip");
+        TemporaryFile temp (".els");
+        const auto file = temp.getFile();
+        const auto first = createState (1, 4096);
+        const auto second = createState (2, 100);
+
+        SessionArchive archive;
+        expect (archive.write (createSession ("Archive Test", { first, second, first }), file).wasOk());
+        expect (SessionArchive::isArchive (file));
+        expect (archive.wasCompacted());
+        expectEquals (archive.getNumChunksWritten(), 2);
+
+        ValueTree session;
+        expect (archive.read (file, session).wasOk());
+        expect (session.hasType (Tags::session));
+        expectEquals (session.getProperty (Tags::name).toString(), String ("Archive Test"));
+        expect (getState (session, 0) == first);
+        expect (getState (session, 1) == second);
+        expect (getState (session, 2) == first);
+        expect (session.getChildWithName (Tags::graphs).getChild (0)
+                       .getChildWithName (Tags::nodes).getChild (0)
+                       .getProperty (Tags::state).isBinaryData());
+    }
+
+    void testIncremental()
+    {
+        beginTest ("incremental");
+        TemporaryFile temp (".els");
+        const auto file = temp.getFile();
+        const auto first = createState (1, 65536);
+        const auto second = createState (2, 65536);
+
+        SessionArchive archive;
+        expect (archive.write (createSession ("Archive Test", { first, second }), file).wasOk());
+        const auto size = file.getSize();
+
+        // nothing changed, only a new index is written
+        expect (archive.write (createSession ("Archive Test", { first, second }), file).wasOk());
+        expectEquals (archive.getNumChunksWritten(), 0);
+        expectEquals (archive.getNumChunksReused(), 2);
+        expect (! archive.wasCompacted());
+        expect (file.getSize() - size < 1024);
+
+        const auto changed = createState (3, 65536);
+        expect (archive.write (createSession ("Archive Test", { first, changed }), file).wasOk());
+        expectEquals (archive.getNumChunksWritten(), 1);
+        expectEquals (archive.getNumChunksReused(), 1);
+
+        ValueTree session;
+        expect (archive.read (file, session).wasOk());
+        expect (getState (session, 0) == first);
+        expect (getState (session, 1) == changed);
+    }
+
+    void testCompaction()
+    {
+        beginTest ("compaction");
+        TemporaryFile temp (".els");
+        const auto file = temp.getFile();
+        const size_t size = 3 * 1024 * 1024;
+
+        SessionArchive archive;
+        expect (archive.write (createSession ("Archive Test", { createState (1, size) }), file).wasOk());
+        expect (archive.write (createSession ("Archive Test", { createState (2, size) }), file).wasOk());
+        expect (! archive.wasCompacted());
+
+        const auto last = createState (3, size);
+        expect (archive.write (createSession ("Archive Test", { last }), file).wasOk());
+        expect (archive.wasCompacted());
+        expect (file.getSize() < (int64) size * 2);
+
+        ValueTree session;
+        expect (archive.read (file, session).wasOk());
+        expect (getState (session, 0) == last);
+    }
+
+    void testLegacyStates()
+    {
+        beginTest ("base64 states");
+        TemporaryFile temp (".els");
+        const auto state = createState (4, 512);
+        auto session = createSession ("Archive Test", { state });
+        session.getChildWithName (Tags::graphs).getChild (0).getChildWithName (Tags::nodes)
+               .getChild (0).setProperty (Tags::state, state.toBase64Encoding(), nullptr);
+
+        SessionArchive archive;
+        expect (archive.write (session, temp.getFile()).wasOk());
+        ValueTree loaded;
+        expect (archive.read (temp.getFile(), loaded).wasOk());
+        expect (getState (loaded, 0) == state);
+
+        File xmlFile (temp.getFile().withFileExtension ("xml"));
+        xmlFile.replaceWithText ("<session/>");
+        expect (! SessionArchive::isArchive (xmlFile));
+        xmlFile.deleteFile();
+    }
+};
+
+static SessionArchiveTest sSessionArchiveTest;
+
+}
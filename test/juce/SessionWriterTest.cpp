@@ -0,0 +1,134 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/nodes/AudioProcessorNode.h"
+#include "session/Node.h"
+#include "session/SessionArchive.h"
+#include "session/SessionWriter.h"
+
+namespace Element {
+
+class SessionWriterTest : public UnitTestBase
+{
+public:
+    SessionWriterTest() : UnitTestBase ("Session Writer", "session", "writer") { }
+
+    void runTest() override
+    {
+        testWrite();
+        testNewestWins();
+        testDirtyTracking();
+        testEditorChanges();
+    }
+
+private:
+    void testWrite()
+    {
+        beginTest ("write");
+        TemporaryFile temp (".els");
+        auto session = createSession ("Writer Test", { MemoryBlock (1024, true) });
+
+        SessionWriter writer;
+        writer.write (session, temp.getFile());
+        // later changes don't reach the copy being written
+        session.setProperty (Tags::name, "Changed", nullptr);
+        expect (writer.waitUntilIdle (5000));
+        expect (! writer.isBusy());
+        expect (writer.getLastResult().wasOk());
+
+        ValueTree loaded;
+        expect (SessionArchive().read (temp.getFile(), loaded).wasOk());
+        expectEquals (loaded.getProperty (Tags::name).toString(), String ("Writer Test"));
+    }
+
+    void testNewestWins()
+    {
+        beginTest ("newest wins");
+        TemporaryFile temp (".els");
+        SessionWriter writer;
+        for (int i = 0; i < 20; ++i)
+            writer.write (createSession (String (i), { MemoryBlock (64 * 1024, true) }), temp.getFile());
+        expect (writer.waitUntilIdle (10000));
+
+        ValueTree loaded;
+        expect (SessionArchive().read (temp.getFile(), loaded).wasOk());
+        expectEquals (loaded.getProperty (Tags::name).toString(), String ("19"));
+    }
+
+    void testDirtyTracking()
+    {
+        beginTest ("dirty tracking");
+        GraphProcessor graph;
+        NodeObjectPtr node = graph.addNode (new AudioProcessorNode (0, new VolumeProcessor (-30.0, 12.0)));
+        expect (node->isStateDirty());
+        node->markStateSaved();
+        expect (! node->isStateDirty());
+
+        auto* param = node->getAudioProcessor()->getParameters()[0];
+        param->setValueNotifyingHost (1.f - param->getValue());
+        expect (node->isStateDirty());
+
+        node->markStateSaved();
+        expect (! node->isStateDirty());
+        node->markStateDirty();
+        expect (node->isStateDirty());
+
+        node = nullptr;
+        graph.clear();
+    }
+
+    void testEditorChanges()
+    {
+        beginTest ("editor changes");
+        GraphProcessor graph;
+        NodeObjectPtr object = graph.addNode (new AudioProcessorNode (0, new VolumeProcessor (-30.0, 12.0)));
+        graph.prepareToPlay (44100.0, 512);
+        Node node (Tags::node);
+        node.getValueTree().setProperty (Tags::object, object.get(), nullptr);
+
+        auto* proc = object->getAudioProcessor();
+        std::unique_ptr<AudioProcessorEditor> editor (proc->createEditorIfNeeded());
+        expect (editor != nullptr);
+        node.savePluginState (true);
+
+        // a change the plugin doesn't report, made while the editor is open
+        auto* param = proc->getParameters()[0];
+        param->setValue (1.f - param->getValue());
+        MemoryBlock changed;
+        proc->getStateInformation (changed);
+
+        proc->editorBeingDeleted (editor.get());
+        editor.reset();
+        expect (object->isStateDirty());
+
+        node.savePluginState (true);
+        const auto* saved = node.getValueTree().getProperty (Tags::state).getBinaryData();
+        expect (saved != nullptr && *saved == changed);
+        expect (! object->isStateDirty());
+
+        graph.releaseResources();
+        node.getValueTree().removeProperty (Tags::object, nullptr);
+        object = nullptr;
+        graph.clear();
+    }
+};
+
+static SessionWriterTest sSessionWriterTest;
+
+}
@@ -34,7 +34,7 @@
 #include "engine/nodes/SubGraphProcessor.h"
 #include "engine/nodes/VolumeProcessor.h"
 
-#include "session/PluginManager.h"
+#include "session/Node.h"
 #include "session/PluginManager.h"
 #include "session/Session.h"
 #include "Globals.h"
@@ -112,6 +112,34 @@ protected:
     Globals& getWorld() { initializeWorld(); return *world; }
     AppController& getAppController() { initializeWorld(); return *app; }
 
+    /** Returns seeded random bytes to use as a plugin state. Bytes below a
+        small range compress like most real states do */
+    static MemoryBlock createState (int seed, size_t size, int range = 256)
+    {
+        MemoryBlock block (size);
+        Random random (seed);
+        for (size_t i = 0; i < size; ++i)
+            block[i] = (char) random.nextInt (range);
+        return block;
+    }
+
+    /** Returns a session with one graph and a node for each state */
+    static ValueTree createSession (const String& name, const Array<MemoryBlock>& states)
+    {
+        ValueTree session (Tags::session);
+        session.setProperty (Tags::name, name, nullptr);
+        auto graph = Node::createGraph ("Graph").getValueTree();
+        session.getOrCreateChildWithName (Tags::graphs, nullptr).appendChild (graph, nullptr);
+        auto nodes = graph.getChildWithName (Tags::nodes);
+        for (const auto& state : states)
+        {
+            ValueTree node (Tags::node);
+            node.setProperty (Tags::state, var (state), nullptr);
+            nodes.appendChild (node, nullptr);
+        }
+        return session;
+    }
+
 private:
     const String slug;
     std::unique_ptr<Globals> world;
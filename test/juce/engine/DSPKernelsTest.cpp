@@ -0,0 +1,245 @@
+/*
+    This file is part of Element
+    Copyright (C) 2018-2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/DSPKernels.h"
+
+namespace Element {
+
+class DSPKernelsTest : public UnitTestBase
+{
+public:
+    DSPKernelsTest() : UnitTestBase ("DSP Kernels", "engine", "dspKernels") { }
+    virtual ~DSPKernelsTest() { }
+
+    void runTest() override
+    {
+        testRamp();
+        testFilters();
+        testSmoothedGain();
+        testParameterRamps();
+        testDelayLine();
+        testFollower();
+        testOscillator();
+        testShapers();
+    }
+
+private:
+    enum { blockSize = 512 };
+    const double sampleRate = 48000.0;
+    HeapBlock<float> block { (size_t) blockSize, true };
+
+    float renderSine (DSP::Oscillator& osc)
+    {
+        osc.setWaveform (DSP::Oscillator::sine);
+        osc.render (block, blockSize);
+        return block[blockSize - 1];
+    }
+
+    float getPeak() const
+    {
+        return FloatVectorOperations::findMaximum (block.get(), blockSize);
+    }
+
+    void testRamp()
+    {
+        beginTest ("add with ramp");
+        float src[4] = { 1.f, 1.f, 1.f, 1.f };
+        float dst[4] = { 1.f, 1.f, 1.f, 1.f };
+        DSP::addWithRamp (dst, src, 4, 0.f, 1.f);
+        expectWithinAbsoluteError (dst[0], 1.f,   0.0001f);
+        expectWithinAbsoluteError (dst[1], 1.25f, 0.0001f);
+        expectWithinAbsoluteError (dst[3], 1.75f, 0.0001f);
+
+        DSP::addWithRamp (dst, src, 4, 0.5f, 0.5f);
+        expectWithinAbsoluteError (dst[0], 1.5f,  0.0001f);
+        expectWithinAbsoluteError (dst[3], 2.25f, 0.0001f);
+    }
+
+    void testFilters()
+    {
+        beginTest ("filters");
+        DSP::Oscillator osc;
+        osc.setFrequency (sampleRate, 1000.0);
+
+        DSP::Biquad lowPass, highPass;
+        lowPass.setCoefficients (DSP::BiquadCoefficients::make (
+            DSP::BiquadCoefficients::lowPass, sampleRate, 100.0));
+        highPass.setCoefficients (DSP::BiquadCoefficients::make (
+            DSP::BiquadCoefficients::highPass, sampleRate, 100.0));
+
+        for (int i = 0; i < 8; ++i) { renderSine (osc); lowPass.process (block, blockSize, 0); }
+        expectLessThan (getPeak(), 0.02f);
+        for (int i = 0; i < 8; ++i) { renderSine (osc); highPass.process (block, blockSize, 1); }
+        expectGreaterThan (getPeak(), 0.98f);
+
+        DSP::StateVariableFilter svf;
+        svf.setParameters (sampleRate, 100.0);
+        for (int i = 0; i < 8; ++i) { renderSine (osc); svf.process (block, blockSize, 0); }
+        expectLessThan (getPeak(), 0.02f);
+        svf.reset();
+        svf.setMode (DSP::StateVariableFilter::highPass);
+        for (int i = 0; i < 8; ++i) { renderSine (osc); svf.process (block, blockSize, 0); }
+        expectGreaterThan (getPeak(), 0.98f);
+    }
+
+    void testSmoothedGain()
+    {
+        beginTest ("smoothed gain");
+        DSP::SmoothedGain gain;
+        gain.prepare (sampleRate, 100.0 / sampleRate);
+        gain.setCurrentAndTarget (0.f);
+        gain.setTarget (1.f);
+
+        float* channels[] = { block.get() };
+        FloatVectorOperations::fill (block, 1.f, blockSize);
+        gain.process (channels, 1, 50);
+        expectEquals (block[0], 0.f);
+        expectWithinAbsoluteError (gain.getCurrent(), 0.5f, 1.0e-6f);
+        expect (gain.isSmoothing());
+
+        gain.process (channels, 1, blockSize);
+        expect (! gain.isSmoothing());
+        expectEquals (gain.getCurrent(), 1.f);
+        expectEquals (block[blockSize - 1], 1.f);
+    }
+
+    void testParameterRamps()
+    {
+        beginTest ("parameter ramps");
+        DSP::ParameterRamps ramps;
+        ramps.setNumParameters (2);
+        ramps.prepare (sampleRate);
+        ramps.setSmoothingTime (1, 300.0 / sampleRate);
+        ramps.reset (0, 0.f);
+        ramps.reset (1, 0.f);
+
+        float targets[] = { 0.f, 0.f };
+        ramps.advance (targets, 100);
+        expectEquals (ramps.getRamp (0).length, 0);
+        expectEquals (ramps.getRamp (1).length, 0);
+
+        // without smoothing a change is spread over its block
+        targets[0] = targets[1] = 1.f;
+        ramps.advance (targets, 100);
+        expectEquals (ramps.getRamp (0).start, 0.f);
+        expectEquals (ramps.getRamp (0).end, 1.f);
+        expectEquals (ramps.getRamp (0).length, 100);
+        expectWithinAbsoluteError (ramps.getValue (0, 50), 0.5f, 1.0e-6f);
+        expectEquals (ramps.getValue (0, 100), 1.f);
+
+        // smoothed over three blocks
+        expectWithinAbsoluteError (ramps.getRamp (1).end, 1.f / 3.f, 1.0e-6f);
+        ramps.advance (targets, 100);
+        ramps.advance (targets, 150);
+        expectEquals (ramps.getRamp (1).end, 1.f);
+        expectEquals (ramps.getRamp (1).length, 100);
+        expectEquals (ramps.getRamp (0).length, 0);
+
+        FloatVectorOperations::fill (block, 1.f, blockSize);
+        targets[0] = 0.5f;
+        ramps.advance (targets, 100);
+        ramps.applyGain (0, block, 100, false);
+        expectEquals (block[0], 1.f);
+        expectWithinAbsoluteError (block[50], 0.75f, 1.0e-6f);
+
+        // decibels ramp between the gains at either end
+        FloatVectorOperations::fill (block, 1.f, blockSize);
+        ramps.reset (0, 0.f);
+        targets[0] = -6.f;
+        ramps.advance (targets, 100);
+        ramps.applyGain (0, block, 200, true);
+        expectEquals (block[0], 1.f);
+        expectWithinAbsoluteError (block[150], Decibels::decibelsToGain (-6.f), 1.0e-6f);
+    }
+
+    void testDelayLine()
+    {
+        beginTest ("delay line");
+        DSP::DelayLine delay (100, 2);
+        delay.setDelay (10.f);
+        delay.setFeedback (0.5f);
+
+        FloatVectorOperations::clear (block, blockSize);
+        block[0] = 1.f;
+        delay.process (block, blockSize, 1);
+        expectEquals (block[0], 0.f);
+        expectEquals (block[10], 1.f);
+        expectEquals (block[20], 0.5f);
+
+        delay.setDelay (2.5f);
+        delay.setFeedback (0.f);
+        delay.reset();
+        FloatVectorOperations::clear (block, blockSize);
+        block[0] = 1.f;
+        delay.process (block, blockSize, 0);
+        expectEquals (block[2], 0.5f);
+        expectEquals (block[3], 0.5f);
+    }
+
+    void testFollower()
+    {
+        beginTest ("envelope follower");
+        DSP::EnvelopeFollower follower;
+        follower.prepare (sampleRate, 0.0, 1.0);
+        FloatVectorOperations::fill (block, -0.5f, blockSize);
+        expectEquals (follower.process (block, nullptr, blockSize, 3), 0.5f);
+        FloatVectorOperations::clear (block, blockSize);
+        const float released = follower.process (block, nullptr, blockSize, 3);
+        expect (released < 0.5f && released > 0.49f);
+        expectEquals (follower.getEnvelope (0), 0.f);
+    }
+
+    void testOscillator()
+    {
+        beginTest ("oscillator");
+        DSP::Oscillator osc;
+        osc.setFrequency (sampleRate, 1000.0);
+        renderSine (osc);
+        expectWithinAbsoluteError (block[12], 1.f, 1.0e-6f);
+
+        for (const auto waveform : { DSP::Oscillator::saw, DSP::Oscillator::square, DSP::Oscillator::triangle })
+        {
+            osc.setWaveform (waveform);
+            osc.render (block, blockSize, 0.5f);
+            const auto range = FloatVectorOperations::findMinAndMax (block.get(), blockSize);
+            expect (range.getStart() >= -0.55f && range.getEnd() <= 0.55f);
+            expect (range.getEnd() > 0.4f);
+        }
+    }
+
+    void testShapers()
+    {
+        beginTest ("waveshapers");
+        FloatVectorOperations::fill (block, 2.f, blockSize);
+        DSP::hardClip (block, blockSize);
+        expectEquals (block[0], 1.f);
+
+        FloatVectorOperations::fill (block, 0.25f, blockSize);
+        DSP::softClip (block, blockSize, 4.f);
+        expectEquals (block[0], 1.f);
+
+        FloatVectorOperations::fill (block, 0.f, blockSize);
+        DSP::tanhShape (block, blockSize, 10.f);
+        expectEquals (block[0], 0.f);
+    }
+};
+
+static DSPKernelsTest sDSPKernelsTest;
+
+}
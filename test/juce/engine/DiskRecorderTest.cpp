@@ -0,0 +1,193 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/DiskRecorder.h"
+
+namespace Element {
+
+class DiskRecorderTest : public UnitTestBase
+{
+public:
+    DiskRecorderTest() : UnitTestBase ("Disk Recorder", "engine", "diskRecorder") { }
+
+    void runTest() override
+    {
+        directory = File::getSpecialLocation (File::tempDirectory)
+            .getChildFile ("ElementDiskRecorderTest").getNonexistentSibling();
+        testArming();
+        testTake();
+        testThroughput();
+        directory.deleteRecursively();
+    }
+
+private:
+    File directory;
+
+    std::unique_ptr<AudioFormatReader> createReader (const File& file)
+    {
+        WavAudioFormat wav;
+        return std::unique_ptr<AudioFormatReader> (
+            wav.createReaderFor (new FileInputStream (file), true));
+    }
+
+    void testArming()
+    {
+        beginTest ("arming");
+        DiskRecorder recorder;
+        recorder.setDirectory (directory);
+        expect (! recorder.armChannels (DiskRecorder::GraphOutputs, 0, 0, "Empty"));
+        expect (! recorder.armChannels (DiskRecorder::NodeOutputs, 0, 2, "Node"));
+        expect (! recorder.armNode (nullptr, "Node"));
+        expect (recorder.armChannels (DiskRecorder::GraphInputs, 0, 2, "Input"));
+        expectEquals (recorder.getNumTracks(), 1);
+        expectEquals (recorder.getTrack(0)->getNumChannels(), 2);
+
+        recorder.prepare (48000.0, 256);
+        recorder.beginBlock (true, 256);
+        expect (recorder.isRecording());
+        expect (! recorder.armChannels (DiskRecorder::GraphOutputs, 0, 2, "Output"));
+        expect (! recorder.disarmAll());
+        recorder.endBlock();
+        recorder.beginBlock (false, 256);
+        expect (recorder.waitUntilIdle (5000));
+
+        expect (recorder.disarmAll());
+        expectEquals (recorder.getNumTracks(), 0);
+        recorder.release();
+    }
+
+    void testTake()
+    {
+        beginTest ("take");
+        const int blockSize = 512, numBlocks = 100;
+        DiskRecorder recorder;
+        recorder.setDirectory (directory);
+        expect (recorder.armChannels (DiskRecorder::GraphInputs, 1, 2, "Input"));
+        expect (recorder.armChannels (DiskRecorder::GraphOutputs, 0, 2, "Output"));
+        recorder.prepare (44100.0, blockSize);
+
+        // not recording yet, nothing is captured
+        AudioSampleBuffer buffer (3, blockSize);
+        recorder.beginBlock (false, blockSize);
+        expect (! recorder.isCapturing());
+        recorder.endBlock();
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            for (int ch = 0; ch < 3; ++ch)
+                FloatVectorOperations::fill (buffer.getWritePointer (ch), 0.1f * (float) (ch + 1), blockSize);
+            recorder.beginBlock (true, blockSize);
+            expect (recorder.isCapturing());
+            // outputs are never pushed, they are padded with silence
+            recorder.pushChannels (DiskRecorder::GraphInputs, buffer, blockSize);
+            recorder.endBlock();
+        }
+
+        recorder.beginBlock (false, blockSize);
+        expect (recorder.waitUntilIdle (5000));
+
+        const auto stats = recorder.getStats();
+        expectEquals (stats.numTracks, 2);
+        expectEquals (stats.numChannels, 4);
+        expectEquals (stats.framesWritten, (int64) (blockSize * numBlocks));
+        expectEquals (stats.numOverruns, (int64) 0);
+        expect (! stats.recording);
+
+        const auto inputFile = recorder.getTrack(0)->getFile();
+        const auto outputFile = recorder.getTrack(1)->getFile();
+        expect (inputFile.existsAsFile() && outputFile.existsAsFile());
+        expect (inputFile != outputFile);
+        expect (inputFile.getFileName().endsWith (" Input.wav"));
+
+        if (auto reader = createReader (inputFile))
+        {
+            expectEquals ((int) reader->numChannels, 2);
+            expectEquals (reader->lengthInSamples, (int64) (blockSize * numBlocks));
+            expectEquals (reader->sampleRate, 44100.0);
+            AudioSampleBuffer read (2, 64);
+            reader->read (&read, 0, 64, 1000, true, true);
+            expectWithinAbsoluteError (read.getSample (0, 0), 0.2f, 0.0001f);
+            expectWithinAbsoluteError (read.getSample (1, 63), 0.3f, 0.0001f);
+        }
+        else
+        {
+            expect (false, "couldn't read the input take");
+        }
+
+        if (auto reader = createReader (outputFile))
+        {
+            expectEquals (reader->lengthInSamples, (int64) (blockSize * numBlocks));
+            AudioSampleBuffer read (2, blockSize);
+            reader->read (&read, 0, blockSize, 0, true, true);
+            expectEquals (read.getMagnitude (0, blockSize), 0.f);
+        }
+        else
+        {
+            expect (false, "couldn't read the output take");
+        }
+
+        recorder.release();
+    }
+
+    void testThroughput()
+    {
+        beginTest ("64 channels at 96kHz");
+        const double sampleRate = 96000.0;
+        const int blockSize = 256, numChannels = 64, seconds = 3;
+        DiskRecorder recorder;
+        recorder.setDirectory (directory);
+        for (int i = 0; i < numChannels / 8; ++i)
+            expect (recorder.armChannels (DiskRecorder::GraphInputs, i * 8, 8, "Bus " + String (i + 1)));
+        recorder.prepare (sampleRate, blockSize);
+
+        AudioSampleBuffer buffer (numChannels, blockSize);
+        Random random;
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                buffer.setSample (ch, i, random.nextFloat() * 2.f - 1.f);
+
+        // pace the blocks like an audio device would
+        const int numBlocks = roundToInt (sampleRate * seconds / blockSize);
+        const double blockMs = 1000.0 * blockSize / sampleRate;
+        const auto started = Time::getMillisecondCounterHiRes();
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            recorder.beginBlock (true, blockSize);
+            recorder.pushChannels (DiskRecorder::GraphInputs, buffer, blockSize);
+            recorder.endBlock();
+            while (Time::getMillisecondCounterHiRes() - started < blockMs * (i + 1))
+                Thread::yield();
+        }
+
+        const auto stats = recorder.getStats();
+        recorder.beginBlock (false, blockSize);
+        expect (recorder.waitUntilIdle (30000));
+        expectEquals (recorder.getStats().framesWritten, (int64) numBlocks * blockSize);
+        expectEquals (stats.numOverruns, (int64) 0);
+        expectEquals (stats.numChannels, numChannels);
+        expect (stats.bufferHeadroom > 0.0);
+        logMessage ("disk recorder: " + String (stats.throughputMBps, 2) + " MB/s, "
+                    + String (stats.bufferHeadroom * 100.0, 1) + "% lowest buffer headroom");
+        recorder.release();
+    }
+};
+
+static DiskRecorderTest sDiskRecorderTest;
+
+}
@@ -0,0 +1,201 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "controllers/GraphManager.h"
+#include "scripting/ScriptBenchmark.h"
+#include "session/GraphBuilder.h"
+
+using namespace Element;
+
+static const String sBenchmarkScript = R"(
+    return {
+        nodes = {
+            a = { identifier = "element.volume.stereo" },
+            b = { identifier = "element.volume.stereo", name = "Second" }
+        },
+        connections = {
+            { "a", 0, "b", 0, type = "audio" },
+            { "a", 1, "b", 1, type = "audio" }
+        }
+    }
+)";
+
+//=============================================================================
+class GraphBuilderTest : public UnitTestBase
+{
+public:
+    GraphBuilderTest() : UnitTestBase ("Graph Builder", "engine", "graphBuilder") { }
+
+    void initialise() override
+    {
+        initializeWorld();
+        getWorld().getPluginManager().setPlayConfig (44100.0, 512);
+    }
+
+    void shutdown() override
+    {
+        shutdownWorld();
+    }
+
+    void runTest() override
+    {
+        testBuild();
+        testProfiling();
+        testProfilingMidiChain();
+        testBenchmark();
+    }
+
+private:
+    void testBuild()
+    {
+        beginTest ("build");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, 512);
+        graph.prepareToPlay (44100.0, 512);
+        GraphManager manager (graph, getWorld().getPluginManager());
+        manager.setNodeModel (Node::createGraph ("Test"));
+
+        GraphBuilder builder;
+        const int first  = builder.addNode ("Element", "element.volume.stereo");
+        const int second = builder.addNode ("Element", "element.volume.stereo", "Second");
+        const int third  = builder.addNode ("Element", "element.volume.stereo");
+        const int bad    = builder.addNode ("Element", "element.notANode");
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            builder.connectChannels (PortType::Audio, first, ch, second, ch);
+            builder.connectChannels (PortType::Audio, second, ch, third, ch);
+        }
+        builder.connect (bad, 0, third, 0);
+
+        const auto nodes = builder.build (manager);
+        expect (! manager.isBatching());
+        expectEquals (nodes.size(), 4);
+        expect (nodes[first].isValid() && nodes[second].isValid() && nodes[third].isValid());
+        expect (! nodes[bad].isValid());
+        expectEquals (nodes[second].getName(), String ("Second"));
+        expectEquals (builder.getErrors().size(), 2);
+
+        expectEquals (manager.getNumNodes(), 3);
+        expectEquals (manager.getNumConnections(), 4);
+        expectEquals (manager.getGraphModel().getArcsValueTree().getNumChildren(), 4);
+
+        // nodes already in the graph can be connected too
+        GraphBuilder more;
+        const int existing = more.addExistingNode (nodes[third]);
+        const int fourth = more.addNode ("Element", "element.volume.stereo");
+        more.connectChannels (PortType::Audio, existing, 0, fourth, 0);
+        more.build (manager);
+        expect (more.getErrors().isEmpty());
+        expectEquals (manager.getNumConnections(), 5);
+        expectEquals (manager.getGraphModel().getArcsValueTree().getNumChildren(), 5);
+
+        manager.clear();
+        graph.releaseResources();
+    }
+
+    void testProfiling()
+    {
+        beginTest ("profiling");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, 512);
+        graph.prepareToPlay (44100.0, 512);
+        GraphManager manager (graph, getWorld().getPluginManager());
+        manager.setNodeModel (Node::createGraph ("Test"));
+
+        GraphBuilder builder;
+        builder.addNode ("Element", "element.volume.stereo");
+        builder.build (manager);
+        graph.handleUpdateNowIfNeeded();
+
+        AudioSampleBuffer audio (2, 512);
+        MidiBuffer midi;
+        NodeObjectPtr node = graph.getNode (0);
+        graph.processBlock (audio, midi);
+        expectEquals (node->getNumRenders(), (int64) 0);
+
+        graph.setProfilingEnabled (true);
+        for (int i = 0; i < 4; ++i)
+            graph.processBlock (audio, midi);
+        expectEquals (node->getNumRenders(), (int64) 4);
+        expect (node->getRenderTicks() > 0);
+        node->resetRenderTime();
+        expectEquals (node->getNumRenders(), (int64) 0);
+
+        node = nullptr;
+        manager.clear();
+        graph.releaseResources();
+    }
+
+    void testProfilingMidiChain()
+    {
+        beginTest ("profiling midi chain");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, 512);
+        graph.prepareToPlay (44100.0, 512);
+        GraphManager manager (graph, getWorld().getPluginManager());
+        manager.setNodeModel (Node::createGraph ("Test"));
+
+        // MIDI-only nodes back to back render in one chain
+        GraphBuilder builder;
+        const int first  = builder.addNode ("Element", "element.midiChannelMap");
+        const int second = builder.addNode ("Element", "element.programChangeMap");
+        builder.connectChannels (PortType::Midi, first, 0, second, 0);
+        builder.build (manager);
+        expect (builder.getErrors().isEmpty());
+        graph.handleUpdateNowIfNeeded();
+        expectEquals (graph.getNumNodes(), 2);
+
+        AudioSampleBuffer audio (2, 512);
+        MidiBuffer midi;
+        graph.setProfilingEnabled (true);
+        for (int i = 0; i < 4; ++i)
+            graph.processBlock (audio, midi);
+
+        // every node in the chain is timed on its own
+        for (int i = 0; i < graph.getNumNodes(); ++i)
+        {
+            NodeObjectPtr node = graph.getNode (i);
+            expectEquals (node->getNumRenders(), (int64) 4);
+            expect (node->getRenderTicks() > 0);
+        }
+
+        manager.clear();
+        graph.releaseResources();
+    }
+
+    void testBenchmark()
+    {
+        beginTest ("benchmark");
+        ScriptBenchmark benchmark (getWorld());
+        ScriptBenchmark::Options options;
+        options.numBlocks = 16;
+
+        expect (benchmark.run (sBenchmarkScript, options).wasOk());
+        expect (benchmark.getErrors().isEmpty());
+        expectEquals (benchmark.getNodeTimings().size(), 2);
+        for (const auto& timing : benchmark.getNodeTimings())
+            expectEquals (timing.numBlocks, (int64) options.numBlocks);
+        expect (benchmark.createReport().contains ("Second"));
+
+        expect (benchmark.run (String ("return 1"), options).failed());
+        expect (benchmark.run (String ("this is not lua"), options).failed());
+    }
+};
+
+static GraphBuilderTest sGraphBuilderTest;
@@ -0,0 +1,143 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/MidiClock.h"
+
+namespace Element {
+
+class MidiClockMasterTest : public UnitTestBase
+{
+public:
+    MidiClockMasterTest() : UnitTestBase ("MidiClockMaster", "engine", "midiClockMaster") { }
+    virtual ~MidiClockMasterTest() { }
+
+    void runTest() override
+    {
+        testNoDrift();
+        testStartAndRelocate();
+        testLatencyCompensation();
+    }
+
+private:
+    static int countClocks (const MidiBuffer& midi)
+    {
+        int count = 0;
+        for (auto m : midi)
+            if (m.getMessage().isMidiClock())
+                ++count;
+        return count;
+    }
+
+    void testNoDrift()
+    {
+        beginTest ("no drift");
+        MidiClockMaster clock;
+        MidiClockMaster::Output output;
+        clock.setTempo (127.0);
+        clock.setSampleRate (44100.0);
+
+        // 127 bpm at 44.1k doesn't divide evenly into samples per clock
+        const int blockSize = 441;
+        int64 position = 0;
+        int clocks = 0;
+        for (int i = 0; i < 6000; ++i)
+        {
+            MidiBuffer midi;
+            clock.sync (true, position);
+            clock.render (midi, blockSize, output);
+            clock.advance (blockSize);
+            clocks += countClocks (midi);
+            position += blockSize;
+        }
+
+        // 60 seconds at 127 bpm and 24 clocks per beat, counting from zero
+        expectEquals (clocks, 127 * 24);
+    }
+
+    void testStartAndRelocate()
+    {
+        beginTest ("start and relocate");
+        MidiClockMaster clock;
+        MidiClockMaster::Output output;
+        clock.setTempo (120.0);
+        clock.setSampleRate (48000.0);
+
+        MidiBuffer midi;
+        clock.sync (true, 0);
+        clock.render (midi, 512, output);
+        clock.advance (512);
+
+        MidiBuffer::Iterator iter (midi);
+        MidiMessage msg; int frame = 0;
+        expect (iter.getNextEvent (msg, frame));
+        expect (msg.isMidiStart() && frame == 0);
+        expect (iter.getNextEvent (msg, frame));
+        expect (msg.isMidiClock() && frame == 0);
+
+        // jump to beat 4 at 120 bpm
+        midi.clear();
+        clock.sync (true, 96000);
+        clock.render (midi, 512, output);
+        clock.advance (512);
+
+        MidiBuffer::Iterator iter2 (midi);
+        expect (iter2.getNextEvent (msg, frame));
+        expect (msg.isMidiStop());
+        expect (iter2.getNextEvent (msg, frame));
+        expect (msg.isSongPositionPointer());
+        expectEquals (msg.getSongPositionPointerMidiBeat(), 16);
+        expect (iter2.getNextEvent (msg, frame));
+        expect (msg.isMidiContinue());
+    }
+
+    void testLatencyCompensation()
+    {
+        beginTest ("latency compensation");
+        MidiClockMaster clock;
+        MidiClockMaster::Output direct, delayed (100);
+        clock.setTempo (120.0);
+        clock.setSampleRate (48000.0);
+
+        // 1000 samples per clock at 120 bpm and 48k
+        int directFrame = -1, delayedFrame = -1;
+        int64 position = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            MidiBuffer a, b;
+            clock.sync (true, position);
+            clock.render (a, 512, direct);
+            clock.render (b, 512, delayed);
+            clock.advance (512);
+
+            for (auto m : a)
+                if (m.getMessage().isMidiClock() && m.samplePosition > 0)
+                    directFrame = static_cast<int> (position) + m.samplePosition;
+            for (auto m : b)
+                if (m.getMessage().isMidiClock() && m.samplePosition > 0)
+                    delayedFrame = static_cast<int> (position) + m.samplePosition;
+            position += 512;
+        }
+
+        expectEquals (directFrame - delayedFrame, 100);
+    }
+};
+
+static MidiClockMasterTest sMidiClockMasterTest;
+
+}
@@ -0,0 +1,115 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/nodes/MidiMonitorNode.h"
+
+namespace Element {
+
+class MidiMonitorNodeTest : public UnitTestBase
+{
+public:
+    MidiMonitorNodeTest()
+        : UnitTestBase ("Midi Monitor Node", "nodes", "midiMonitor") { }
+
+    void initialise() override
+    {
+        MessageManager::getInstance();
+    }
+
+    void runTest() override
+    {
+        testKeyRange();
+        testNoteRange();
+    }
+
+private:
+    static void addNotes (MidiBuffer& midi)
+    {
+        midi.clear();
+        for (int note : { 59, 60, 72, 73 })
+            midi.addEvent (MidiMessage::noteOn (1, note, 1.f), note - 59);
+    }
+
+    /** Logged messages arrive on the monitor's timer */
+    static int getNumLogged (MidiMonitorNode& monitor)
+    {
+        MessageManager::getInstance()->runDispatchLoopUntil (100);
+        return monitor.getNumLogged();
+    }
+
+    void testKeyRange()
+    {
+        beginTest ("key range");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (0, 2, 44100.0, 512);
+        graph.prepareToPlay (44100.0, 512);
+
+        NodeObjectPtr midiIn = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::midiInputNode));
+        NodeObjectPtr node = graph.addNode (new MidiMonitorNode());
+        expect (graph.connectChannels (PortType::Midi, midiIn->nodeId, 0, node->nodeId, 0));
+        graph.handleUpdateNowIfNeeded();
+
+        auto* monitor = dynamic_cast<MidiMonitorNode*> (node.get());
+        expect (monitor != nullptr);
+
+        AudioSampleBuffer audio (2, 512);
+        MidiBuffer midi;
+        addNotes (midi);
+        graph.processBlock (audio, midi);
+        expectEquals (getNumLogged (*monitor), 4);
+
+        // notes outside the node's key range never reach it
+        monitor->clearMessages();
+        node->setKeyRange (60, 72);
+        addNotes (midi);
+        graph.processBlock (audio, midi);
+        expectEquals (getNumLogged (*monitor), 2);
+
+        midiIn = nullptr;
+        node = nullptr;
+        graph.releaseResources();
+        graph.clear();
+    }
+
+    void testNoteRange()
+    {
+        beginTest ("note range");
+        MidiMonitorNode monitor;
+        monitor.prepareToRender (44100.0, 512);
+        monitor.setNoteRange (72, 60);
+        expect (monitor.getNoteRange() == Range<int> (60, 72));
+
+        AudioSampleBuffer audio (0, 512);
+        MidiBuffer midi;
+        addNotes (midi);
+        midi.addEvent (MidiMessage::controllerEvent (1, 7, 100), 10);
+        MidiBuffer* buffers[] = { &midi };
+        MidiPipe pipe (buffers, 1);
+        monitor.render (audio, pipe);
+
+        // the controller isn't a note, it passes
+        expectEquals (getNumLogged (monitor), 3);
+        monitor.releaseResources();
+    }
+};
+
+static MidiMonitorNodeTest sMidiMonitorNodeTest;
+
+}
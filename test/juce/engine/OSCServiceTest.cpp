@@ -0,0 +1,107 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/OSCService.h"
+
+namespace Element {
+
+class OSCServiceTest : public UnitTestBase
+{
+public:
+    OSCServiceTest() : UnitTestBase ("OSCService", "engine", "oscService") { }
+    virtual ~OSCServiceTest() { }
+
+    void runTest() override
+    {
+        testTimeTags();
+        testEventQueue();
+        testSharedPorts();
+        testReleasedPorts();
+    }
+
+private:
+    void testTimeTags()
+    {
+        beginTest ("time tags");
+        const double now = OSCService::getWallClockMillis();
+        const auto tag = OSCService::toTimeTag (now);
+        expect (! tag.isImmediately());
+        expectWithinAbsoluteError (OSCService::toMillis (tag), now, 0.001);
+        const auto time = Time::getCurrentTime();
+        expectWithinAbsoluteError (OSCService::toMillis (OSCTimeTag (time)),
+                                   (double) time.toMilliseconds(), 1.0);
+    }
+
+    void testEventQueue()
+    {
+        beginTest ("event queue");
+        OSCService::EventQueue queue (4);
+        OSCService::MidiEvent event;
+        event.size = 3;
+
+        int numPushed = 0;
+        while (queue.push (event))
+            ++numPushed;
+        expect (numPushed > 0 && numPushed < 4);
+
+        int numPopped = 0;
+        while (queue.pop (event))
+            ++numPopped;
+        expectEquals (numPopped, numPushed);
+    }
+
+    void testSharedPorts()
+    {
+        beginTest ("shared ports");
+        SharedResourcePointer<OSCService> service;
+        auto a = service->getPort (9931);
+        auto b = service->getPort (9931);
+        expect (a != nullptr);
+        expect (a == b);
+    }
+
+    void testReleasedPorts()
+    {
+        beginTest ("released ports");
+        SharedResourcePointer<OSCService> service;
+        auto port = service->getPort (9932);
+        expect (port != nullptr);
+        // the service holds one reference of its own
+        expectEquals (port->getReferenceCount(), 2);
+
+        service->releaseUnused();
+        expectEquals (port->getReferenceCount(), 2);
+
+        OSCService::Port* const released = port.get();
+        port = nullptr;
+        expectEquals (released->getReferenceCount(), 1);
+        service->releaseUnused();
+
+        // the port binds again once released
+        port = service->getPort (9932);
+        expect (port != nullptr);
+        expectEquals (port->getReferenceCount(), 2);
+        port = nullptr;
+        service->releaseUnused();
+    }
+};
+
+static OSCServiceTest sOSCServiceTest;
+
+}
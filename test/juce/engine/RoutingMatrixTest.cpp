@@ -0,0 +1,76 @@
+/*
+    This file is part of Element
+    Copyright (C) 2018-2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/RoutingMatrix.h"
+
+namespace Element {
+
+class RoutingMatrixTest : public UnitTestBase
+{
+public:
+    RoutingMatrixTest() : UnitTestBase ("Routing Matrix", "engine", "routingMatrix") { }
+    virtual ~RoutingMatrixTest() { }
+
+    void runTest() override
+    {
+        testSparseSources();
+        testExchange();
+    }
+
+private:
+    void testSparseSources()
+    {
+        beginTest ("sparse sources");
+        MatrixState state (4, 3);
+        state.set (3, 0, true);
+        state.set (1, 0, true);
+        state.set (2, 2, true);
+
+        RoutingMatrix matrix (state);
+        expect (matrix.getNumSources() == 4 && matrix.getNumDestinations() == 3);
+        expect (matrix.getNumSourcesFor (0) == 2);
+        expect (matrix.getSourcesFor (0)[0] == 1 && matrix.getSourcesFor (0)[1] == 3);
+        expect (matrix.getNumSourcesFor (1) == 0);
+        expect (matrix.getNumSourcesFor (2) == 1 && matrix.getSourcesFor (2)[0] == 2);
+        expect (matrix.isConnected (2, 2) && ! matrix.isConnected (2, 1));
+    }
+
+    void testExchange()
+    {
+        beginTest ("exchange");
+        RoutingMatrix::Exchange exchange;
+        expect (exchange.acquire() == nullptr);
+
+        MatrixState state (2, 2);
+        exchange.publish (std::unique_ptr<RoutingMatrix> (new RoutingMatrix (state)));
+        state.set (0, 1, true);
+        exchange.publish (std::unique_ptr<RoutingMatrix> (new RoutingMatrix (state)));
+
+        std::unique_ptr<RoutingMatrix> acquired (exchange.acquire());
+        expect (acquired != nullptr && acquired->isConnected (0, 1));
+        expect (exchange.acquire() == nullptr);
+
+        exchange.retire (acquired.release());
+        exchange.collectGarbage();
+    }
+};
+
+static RoutingMatrixTest sRoutingMatrixTest;
+
+}
@@ -0,0 +1,162 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/VoiceAllocator.h"
+
+using namespace Element;
+
+//=============================================================================
+class VoiceAllocatorTest : public UnitTestBase,
+                           private VoiceAllocator::Listener
+{
+public:
+    VoiceAllocatorTest() : UnitTestBase ("Voice Allocator", "engine", "voiceAllocator") { }
+
+    void runTest() override
+    {
+        testAllocation();
+        testStealing();
+        testSustain();
+        testMPE();
+    }
+
+private:
+    VoiceAllocator voices;
+    int lastStarted = -1, lastStopped = -1;
+    bool lastStolen = false;
+
+    void voiceStarted (int voice, bool stolen) override
+    {
+        lastStarted = voice;
+        lastStolen = stolen;
+    }
+
+    void voiceStopped (int voice) override { lastStopped = voice; }
+
+    void send (const MidiMessage& msg)
+    {
+        lastStarted = lastStopped = -1;
+        voices.handleMessage (msg.getRawData(), msg.getRawDataSize(), *this);
+    }
+
+    void testAllocation()
+    {
+        beginTest ("allocation");
+        voices.setNumVoices (2);
+        voices.setMPEEnabled (false);
+
+        send (MidiMessage::noteOn (1, 60, (uint8) 127));
+        expectEquals (lastStarted, 0);
+        expect (! lastStolen);
+        expectEquals (voices.getVoice (0).note, 60);
+        expectEquals (voices.getVoice (0).velocity, 1.f);
+
+        send (MidiMessage::noteOn (1, 64, (uint8) 64));
+        expectEquals (lastStarted, 1);
+
+        // note off leaves the voice active until finished
+        send (MidiMessage::noteOff (1, 60));
+        expectEquals (lastStopped, 0);
+        expect (voices.getVoice (0).active);
+        expect (! voices.getVoice (0).held);
+        voices.finish (0);
+        expect (! voices.getVoice (0).active);
+
+        send (MidiMessage::noteOn (1, 67, (uint8) 100));
+        expectEquals (lastStarted, 0);
+
+        // a repeated note restarts its voice
+        send (MidiMessage::noteOn (1, 64, (uint8) 100));
+        expectEquals (lastStarted, 1);
+        expect (lastStolen);
+    }
+
+    void testStealing()
+    {
+        beginTest ("stealing");
+        voices.setNumVoices (2);
+
+        send (MidiMessage::noteOn (1, 60, (uint8) 100));
+        send (MidiMessage::noteOn (1, 62, (uint8) 100));
+        send (MidiMessage::noteOn (1, 64, (uint8) 100));
+        expectEquals (lastStarted, 0);
+        expect (lastStolen);
+        expectEquals (voices.getVoice (0).note, 64);
+
+        // released voices go before held ones
+        send (MidiMessage::noteOff (1, 64));
+        send (MidiMessage::noteOn (1, 65, (uint8) 100));
+        expectEquals (lastStarted, 0);
+        expectEquals (voices.getVoice (1).note, 62);
+    }
+
+    void testSustain()
+    {
+        beginTest ("sustain");
+        voices.setNumVoices (4);
+
+        send (MidiMessage::controllerEvent (1, 64, 127));
+        send (MidiMessage::noteOn (1, 60, (uint8) 100));
+        send (MidiMessage::noteOff (1, 60));
+        expectEquals (lastStopped, -1);
+        expect (voices.getVoice (0).sustained);
+
+        send (MidiMessage::controllerEvent (1, 64, 0));
+        expectEquals (lastStopped, 0);
+        expect (! voices.getVoice (0).sustained);
+
+        send (MidiMessage::noteOn (2, 60, (uint8) 100));
+        send (MidiMessage::allNotesOff (2));
+        expectEquals (lastStopped, 1);
+    }
+
+    void testMPE()
+    {
+        beginTest ("mpe");
+        voices.setNumVoices (4);
+        voices.setMPEEnabled (true);
+
+        send (MidiMessage::noteOn (2, 60, (uint8) 100));
+        send (MidiMessage::noteOn (3, 64, (uint8) 100));
+        send (MidiMessage::pitchWheel (2, 16383));
+        expectWithinAbsoluteError (voices.getBend (0), 1.f, 1.0e-6f);
+        expectEquals (voices.getBend (1), 0.f);
+
+        // the master channel applies to every voice
+        send (MidiMessage::pitchWheel (1, 0));
+        expectEquals (voices.getBend (1), -1.f);
+        expectWithinAbsoluteError (voices.getBend (0), 0.f, 1.0e-6f);
+
+        send (MidiMessage::channelPressureChange (3, 127));
+        expectEquals (voices.getPressure (1), 1.f);
+        expectEquals (voices.getPressure (0), 0.f);
+
+        send (MidiMessage::controllerEvent (2, 74, 0));
+        expectEquals (voices.getTimbre (0), 0.f);
+        expectEquals (voices.getTimbre (1), 0.5f);
+
+        send (MidiMessage::controllerEvent (1, 64, 127));
+        send (MidiMessage::noteOff (3, 64));
+        expect (voices.getVoice (1).sustained);
+        send (MidiMessage::controllerEvent (1, 64, 0));
+        expectEquals (lastStopped, 1);
+    }
+};
+
+static VoiceAllocatorTest sVoiceAllocatorTest;
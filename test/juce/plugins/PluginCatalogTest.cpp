@@ -0,0 +1,166 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "session/PluginCatalog.h"
+
+namespace Element {
+
+class PluginCatalogTest : public UnitTestBase
+{
+public:
+    PluginCatalogTest() : UnitTestBase ("Plugin Catalog", "plugins", "catalog") { }
+
+    void runTest() override
+    {
+        testEmpty();
+        testLookups();
+        testRestore();
+        testInvalid();
+    }
+
+private:
+    static PluginDescription createType (int index, const String& format, const String& manufacturer)
+    {
+        PluginDescription desc;
+        desc.name               = "Plugin " + String (index);
+        desc.descriptiveName    = desc.name;
+        desc.pluginFormatName   = format;
+        desc.category           = "Effect";
+        desc.manufacturerName   = manufacturer;
+        desc.version            = "1.0." + String (index);
+        desc.fileOrIdentifier   = "/plugins/plugin" + String (index) + "." + format.toLowerCase();
+        desc.lastFileModTime    = Time (1000000 + index);
+        desc.uid                = 100 + (index % 10);
+        desc.isInstrument       = index % 2 == 0;
+        desc.numInputChannels   = 2;
+        desc.numOutputChannels  = index % 3;
+        return desc;
+    }
+
+    static void fill (KnownPluginList& list, int numTypes)
+    {
+        for (int i = 0; i < numTypes; ++i)
+            list.addType (createType (i, i % 3 == 0 ? "VST" : "VST3", i % 2 == 0 ? "Kushview" : "Other"));
+        list.addToBlacklist ("/plugins/crashes.vst3");
+        list.addToBlacklist ("/plugins/hangs.vst");
+    }
+
+    void testEmpty()
+    {
+        beginTest ("empty");
+        TemporaryFile file (".dat");
+        KnownPluginList list;
+        expect (PluginCatalog::write (list, file.getFile()));
+
+        PluginCatalog catalog;
+        expect (catalog.open (file.getFile()));
+        expectEquals (catalog.getNumTypes(), 0);
+        PluginDescription desc;
+        expect (! catalog.getTypeForIdentifierString ("VST3-Plugin-1234-5678", desc));
+        expect (catalog.getBlacklistedFiles().isEmpty());
+        expect (catalog.getTypesForUid (100).isEmpty());
+    }
+
+    void testLookups()
+    {
+        beginTest ("lookups");
+        TemporaryFile file (".dat");
+        KnownPluginList list;
+        fill (list, 100);
+        expect (PluginCatalog::write (list, file.getFile()));
+
+        PluginCatalog catalog;
+        expect (catalog.open (file.getFile()));
+        expectEquals (catalog.getNumTypes(), 100);
+        expectEquals (catalog.getListHash(), PluginCatalog::createHash (list));
+
+        for (const auto& type : list.getTypes())
+        {
+            PluginDescription found;
+            expect (catalog.getTypeForIdentifierString (type.createIdentifierString(), found));
+            expect (found.isDuplicateOf (type));
+            expectEquals (found.name, type.name);
+            expectEquals (found.manufacturerName, type.manufacturerName);
+            expectEquals (found.version, type.version);
+            expect (found.lastFileModTime == type.lastFileModTime);
+            expect (found.isInstrument == type.isInstrument);
+            expectEquals (found.numOutputChannels, type.numOutputChannels);
+        }
+
+        PluginDescription missing;
+        expect (! catalog.getTypeForIdentifierString ("VST3-Missing-1-2", missing));
+
+        expectEquals (catalog.getTypesForUid (105).size(), 10);
+        expectEquals (catalog.getTypesForFormat ("VST").size(), 34);
+        expectEquals (catalog.getTypesForFormat ("VST3").size(), 66);
+        expectEquals (catalog.getTypesForFormat ("LV2").size(), 0);
+        expectEquals (catalog.getTypesForManufacturer ("Kushview").size(), 50);
+        for (const auto& type : catalog.getTypesForManufacturer ("Other"))
+            expectEquals (type.manufacturerName, String ("Other"));
+
+        const auto blacklisted = catalog.getBlacklistedFiles();
+        expectEquals (blacklisted.size(), 2);
+        expect (blacklisted.contains ("/plugins/hangs.vst"));
+    }
+
+    void testRestore()
+    {
+        beginTest ("restore");
+        TemporaryFile file (".dat");
+        KnownPluginList list;
+        fill (list, 20);
+        expect (PluginCatalog::write (list, file.getFile()));
+
+        PluginCatalog catalog;
+        expect (catalog.open (file.getFile()));
+        KnownPluginList restored;
+        restored.addType (createType (1000, "LV2", "Gone"));
+        catalog.restore (restored);
+        expectEquals (restored.getNumTypes(), 20);
+        expectEquals (restored.getBlacklistedFiles().size(), 2);
+        expectEquals (PluginCatalog::createHash (restored), PluginCatalog::createHash (list));
+        expectEquals (restored.getTypes().getFirst().name, list.getTypes().getFirst().name);
+
+        // rewriting over a catalog that was mapped
+        restored.removeFromBlacklist ("/plugins/hangs.vst");
+        expect (PluginCatalog::createHash (restored) != catalog.getListHash());
+        catalog.close();
+        expect (PluginCatalog::write (restored, file.getFile()));
+        expect (catalog.open (file.getFile()));
+        expectEquals (catalog.getBlacklistedFiles().size(), 1);
+    }
+
+    void testInvalid()
+    {
+        beginTest ("invalid");
+        TemporaryFile file (".dat");
+        PluginCatalog catalog;
+        expect (! catalog.open (file.getFile()));
+        file.getFile().replaceWithText ("<?xml version=\"1.0\"?><KNOWNPLUGINS/>");
+        expect (! catalog.open (file.getFile()));
+        expect (! catalog.isOpen());
+        PluginDescription desc;
+        expect (! catalog.getTypeForIdentifierString ("anything", desc));
+        expect (catalog.getTypesForFormat ("VST3").isEmpty());
+    }
+};
+
+static PluginCatalogTest sPluginCatalogTest;
+
+}
@@ -0,0 +1,182 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "session/PluginInstancePool.h"
+
+namespace Element {
+
+/** A plugin whose state is a single integer */
+class PoolTestPlugin : public AudioPluginInstance
+{
+public:
+    explicit PoolTestPlugin (int uid) : pluginUid (uid) { }
+
+    void fillInPluginDescription (PluginDescription& d) const override
+    {
+        d.name              = "Pool Test " + String (pluginUid);
+        d.pluginFormatName  = "Test";
+        d.fileOrIdentifier  = "test.pool." + String (pluginUid);
+        d.uid               = pluginUid;
+    }
+
+    const String getName() const override               { return "Pool Test"; }
+    void prepareToPlay (double, int) override           { prepared = true; }
+    void releaseResources() override                    { prepared = false; }
+    void processBlock (AudioBuffer<float>&, MidiBuffer&) override { }
+    double getTailLengthSeconds() const override        { return 0.0; }
+    bool acceptsMidi() const override                   { return false; }
+    bool producesMidi() const override                  { return false; }
+    AudioProcessorEditor* createEditor() override       { return nullptr; }
+    bool hasEditor() const override                     { return false; }
+    int getNumPrograms() override                       { return 1; }
+    int getCurrentProgram() override                    { return 0; }
+    void setCurrentProgram (int) override               { }
+    const String getProgramName (int) override          { return {}; }
+    void changeProgramName (int, const String&) override { }
+
+    void getStateInformation (MemoryBlock& block) override
+    {
+        MemoryOutputStream (block, false).writeInt (value);
+    }
+
+    void setStateInformation (const void* data, int size) override
+    {
+        MemoryInputStream input (data, (size_t) size, false);
+        value = input.readInt();
+    }
+
+    const int pluginUid;
+    int value = 0;
+    bool prepared = false;
+};
+
+class PluginInstancePoolTest : public UnitTestBase
+{
+public:
+    PluginInstancePoolTest() : UnitTestBase ("Plugin Instance Pool", "plugins", "instancePool") { }
+
+    void runTest() override
+    {
+        testCanPool();
+        testRecycle();
+        testLimits();
+        testPlayConfig();
+    }
+
+private:
+    AudioPluginFormatManager formats;
+
+    static PluginDescription describe (int uid)
+    {
+        return PoolTestPlugin (uid).getPluginDescription();
+    }
+
+    std::unique_ptr<AudioPluginInstance> create (PluginInstancePool& pool, int uid, int value)
+    {
+        std::unique_ptr<PoolTestPlugin> plugin (new PoolTestPlugin (uid));
+        plugin->value = value;
+        pool.instanceCreated (*plugin);
+        return std::unique_ptr<AudioPluginInstance> (plugin.release());
+    }
+
+    void testCanPool()
+    {
+        beginTest ("can pool");
+        expect (PluginInstancePool::canPool (describe (1)));
+        PluginDescription desc;
+        desc.pluginFormatName = "Element";
+        expect (! PluginInstancePool::canPool (desc));
+        desc.pluginFormatName = "Internal";
+        expect (! PluginInstancePool::canPool (desc));
+    }
+
+    void testRecycle()
+    {
+        beginTest ("recycle");
+        auto pool = std::make_shared<PluginInstancePool> (formats);
+        pool->setNumRecentToWarm (0);
+        expect (pool->take (describe (1)) == nullptr);
+
+        auto instance = create (*pool, 1, 42);
+        auto* plugin = dynamic_cast<PoolTestPlugin*> (instance.get());
+        plugin->value = 7;
+        plugin->prepareToPlay (44100.0, 512);
+        pool->recycle (std::move (instance));
+        expectEquals (pool->getNumIdle(), 0);
+        pool->resetReturnedInstances();
+        expectEquals (pool->getNumIdle(), 1);
+        expectEquals (pool->getNumIdle (describe (1)), 1);
+        expectEquals (pool->getNumIdle (describe (2)), 0);
+
+        // reset to the state it was created with
+        expectEquals (plugin->value, 42);
+        expect (! plugin->prepared);
+
+        instance = pool->take (describe (1));
+        expect (instance.get() == plugin);
+        expectEquals (pool->getNumIdle(), 0);
+
+        // plugins never created outside the pool have no defaults to reset to
+        pool->recycle (std::unique_ptr<AudioProcessor> (new PoolTestPlugin (3)));
+        pool->resetReturnedInstances();
+        expectEquals (pool->getNumIdle(), 0);
+    }
+
+    void testLimits()
+    {
+        beginTest ("limits");
+        auto pool = std::make_shared<PluginInstancePool> (formats);
+        pool->setNumRecentToWarm (0);
+        pool->setLimits (2, 3);
+
+        for (int i = 0; i < 3; ++i)
+            pool->recycle (create (*pool, 1, i));
+        pool->resetReturnedInstances();
+        expectEquals (pool->getNumIdle (describe (1)), 2);
+
+        for (int i = 0; i < 2; ++i)
+            pool->recycle (create (*pool, 2, i));
+        pool->resetReturnedInstances();
+        expectEquals (pool->getNumIdle (describe (2)), 1);
+        expectEquals (pool->getNumIdle(), 3);
+
+        pool->clear();
+        expectEquals (pool->getNumIdle(), 0);
+    }
+
+    void testPlayConfig()
+    {
+        beginTest ("play config");
+        auto pool = std::make_shared<PluginInstancePool> (formats);
+        pool->setNumRecentToWarm (0);
+        pool->setPlayConfig (44100.0, 512);
+        pool->recycle (create (*pool, 1, 0));
+        pool->resetReturnedInstances();
+        expectEquals (pool->getNumIdle(), 1);
+
+        pool->setPlayConfig (44100.0, 512);
+        expectEquals (pool->getNumIdle(), 1);
+        pool->setPlayConfig (48000.0, 512);
+        expectEquals (pool->getNumIdle(), 0);
+    }
+};
+
+static PluginInstancePoolTest sPluginInstancePoolTest;
+
+}
@@ -0,0 +1,202 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "session/PluginSandbox.h"
+
+namespace Element {
+
+/** Serves a transport on its own thread, halving the audio */
+class SandboxServeThread : public Thread
+{
+public:
+    explicit SandboxServeThread (SandboxTransport& t)
+        : Thread ("sandbox test"), transport (t) { }
+
+    ~SandboxServeThread()
+    {
+        signalThreadShouldExit();
+        transport.wake();
+        stopThread (1000);
+    }
+
+    void run() override
+    {
+        const SandboxTransport::Processor process = [] (AudioSampleBuffer& audio, MidiBuffer&) {
+            audio.applyGain (0.5f);
+        };
+
+        while (! threadShouldExit())
+            transport.serve (process);
+    }
+
+private:
+    SandboxTransport& transport;
+};
+
+class PluginSandboxTest : public UnitTestBase
+{
+public:
+    PluginSandboxTest() : UnitTestBase ("Plugin Sandbox", "plugins", "sandbox") { }
+
+    void runTest() override
+    {
+        testCanSandbox();
+        testTransport();
+        testVaryingBlockSizes();
+        testRoundTrip();
+    }
+
+private:
+    static void waitUntilReady (const SandboxTransport& transport)
+    {
+        const auto started = Time::getMillisecondCounter();
+        while (! transport.isReady() && Time::getMillisecondCounter() - started < 2000)
+            Thread::yield();
+    }
+
+    void testCanSandbox()
+    {
+        beginTest ("can sandbox");
+        PluginDescription desc;
+        desc.pluginFormatName = "VST3";
+        expect (PluginSandbox::canSandbox (desc));
+        desc.pluginFormatName = "Element";
+        expect (! PluginSandbox::canSandbox (desc));
+        desc.pluginFormatName = "Internal";
+        expect (! PluginSandbox::canSandbox (desc));
+    }
+
+    void testTransport()
+    {
+        beginTest ("transport");
+        SandboxTransport host, sandbox;
+        expect (host.create (2, 64));
+        expect (sandbox.open (host.getName()));
+        expectEquals (sandbox.getNumChannels(), 2);
+        expectEquals (sandbox.getMaxBlockSize(), 64);
+        SandboxTransport missing;
+        expect (! missing.open ("/elsbmissing"));
+
+        SandboxServeThread thread (sandbox);
+        thread.startThread();
+
+        AudioSampleBuffer audio (2, 64);
+        MidiBuffer midi;
+
+        // the first block has nothing to return yet
+        for (int ch = 0; ch < 2; ++ch)
+            FloatVectorOperations::fill (audio.getWritePointer (ch), 1.f, 64);
+        midi.addEvent (MidiMessage::noteOn (1, 60, 1.f), 10);
+        expect (! host.exchange (audio, midi));
+        expectEquals (audio.getMagnitude (0, 64), 0.f);
+        expect (midi.isEmpty());
+
+        // the second returns the first, one block late
+        waitUntilReady (host);
+        for (int ch = 0; ch < 2; ++ch)
+            FloatVectorOperations::fill (audio.getWritePointer (ch), 0.25f, 64);
+        expect (host.exchange (audio, midi));
+        expectWithinAbsoluteError (audio.getSample (0, 0), 0.5f, 0.0001f);
+        expectWithinAbsoluteError (audio.getSample (1, 63), 0.5f, 0.0001f);
+        expectEquals (midi.getNumEvents(), 1);
+        expectEquals (midi.getFirstEventTime(), 10);
+
+        waitUntilReady (host);
+        expect (host.exchange (audio, midi));
+        expectWithinAbsoluteError (audio.getSample (0, 0), 0.125f, 0.0001f);
+        expect (midi.isEmpty());
+
+        const auto stats = host.getStats();
+        expectEquals (stats.numBlocks, (int64) 2);
+        expect (stats.averageRoundTripUs > 0.0);
+    }
+
+    void testVaryingBlockSizes()
+    {
+        beginTest ("varying block sizes");
+        const int latency = 64;
+        SandboxTransport host, sandbox;
+        expect (host.create (2, latency));
+        expect (sandbox.open (host.getName()));
+        SandboxServeThread thread (sandbox);
+        thread.startThread();
+
+        // every sample comes back halved, exactly one latency later
+        const int sizes[] = { 64, 17, 1, 50, 64, 33, 8, 64, 2, 63 };
+        AudioSampleBuffer audio (2, latency);
+        MidiBuffer midi;
+        int64 position = 0;
+        int numWrong = 0;
+
+        for (int i = 0; i < 200; ++i)
+        {
+            const int numSamples = sizes [i % numElementsInArray (sizes)];
+            audio.setSize (2, numSamples, false, false, true);
+            for (int ch = 0; ch < 2; ++ch)
+                for (int j = 0; j < numSamples; ++j)
+                    audio.setSample (ch, j, (float) ((position + j) % 1000 + 1));
+
+            waitUntilReady (host);
+            host.exchange (audio, midi);
+
+            for (int j = 0; j < numSamples; ++j)
+            {
+                const int64 source = position + j - latency;
+                const float expected = source < 0 ? 0.f : 0.5f * (float) (source % 1000 + 1);
+                if (audio.getSample (0, j) != expected || audio.getSample (1, j) != expected)
+                    ++numWrong;
+            }
+
+            position += numSamples;
+        }
+
+        expectEquals (numWrong, 0);
+        expectEquals (host.getStats().numMissed, (int64) 0);
+    }
+
+    void testRoundTrip()
+    {
+        beginTest ("round trip");
+        SandboxTransport host, sandbox;
+        expect (host.create (2, 256));
+        expect (sandbox.open (host.getName()));
+        SandboxServeThread thread (sandbox);
+        thread.startThread (10);
+
+        AudioSampleBuffer audio (2, 256);
+        MidiBuffer midi;
+        const int numBlocks = 2000;
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            waitUntilReady (host);
+            audio.clear();
+            host.exchange (audio, midi);
+        }
+
+        const auto stats = host.getStats();
+        expectEquals (stats.numBlocks, (int64) numBlocks - 1);
+        expectEquals (stats.numMissed, (int64) 0);
+        logMessage ("sandbox round trip: " + String (stats.averageRoundTripUs, 2) + " us average, "
+                    + String (stats.maxRoundTripUs, 2) + " us max");
+    }
+};
+
+static PluginSandboxTest sPluginSandboxTest;
+
+}
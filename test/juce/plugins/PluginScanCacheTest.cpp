@@ -0,0 +1,141 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "session/PluginScanCache.h"
+
+namespace Element {
+
+class PluginScanCacheTest : public UnitTestBase
+{
+public:
+    PluginScanCacheTest() : UnitTestBase ("Plugin Scan Cache", "plugins", "scanCache") { }
+
+    void runTest() override
+    {
+        testFingerprint();
+        testUpToDate();
+        testSaveLoad();
+    }
+
+private:
+    static PluginDescription createDescription (const String& file)
+    {
+        PluginDescription desc;
+        desc.name               = "Test Plugin";
+        desc.pluginFormatName   = "VST3";
+        desc.fileOrIdentifier   = file;
+        desc.uid                = 1234;
+        return desc;
+    }
+
+    void testFingerprint()
+    {
+        beginTest ("fingerprint");
+        TemporaryFile temp (".vst3");
+        temp.getFile().replaceWithText ("plugin binary");
+
+        auto fp = PluginScanCache::Fingerprint::forFile (temp.getFile().getFullPathName(), false);
+        expect (fp.isValid());
+        expectEquals (fp.size, temp.getFile().getSize());
+        expect (fp.hash.isEmpty());
+
+        fp = PluginScanCache::Fingerprint::forFile (temp.getFile().getFullPathName(), true);
+        expectEquals (fp.hash, MD5 (temp.getFile()).toHexString());
+
+        expect (! PluginScanCache::Fingerprint::forFile ("AudioUnit:Synths/aumu,samp,appl", true).isValid());
+    }
+
+    void testUpToDate()
+    {
+        beginTest ("up to date");
+        TemporaryFile temp (".vst3");
+        const auto file = temp.getFile();
+        const auto path = file.getFullPathName();
+        file.replaceWithText ("plugin binary");
+
+        PluginScanCache cache;
+        expect (! cache.isUpToDate ("VST3", path));
+        cache.record ("VST3", path, PluginScanCache::Fingerprint::forFile (path, true),
+                      PluginScanCache::Scanned, { createDescription (path) });
+        expect (cache.isUpToDate ("VST3", path));
+        expect (! cache.isUpToDate ("VST", path));
+
+        // touched but same contents
+        file.setLastModificationTime (file.getLastModificationTime() + RelativeTime::seconds (10));
+        expect (cache.isUpToDate ("VST3", path));
+
+        // same size, different contents
+        file.replaceWithText ("plugin BINARY");
+        file.setLastModificationTime (file.getLastModificationTime() + RelativeTime::seconds (20));
+        expect (! cache.isUpToDate ("VST3", path));
+
+        // fingerprinted without a hash, any time change means changed
+        cache.record ("VST3", path, PluginScanCache::Fingerprint::forFile (path, false),
+                      PluginScanCache::Blacklisted, {});
+        expect (cache.isUpToDate ("VST3", path));
+        file.setLastModificationTime (file.getLastModificationTime() + RelativeTime::seconds (30));
+        expect (! cache.isUpToDate ("VST3", path));
+
+        file.deleteFile();
+        expect (! cache.isUpToDate ("VST3", path));
+        cache.removeMissingFiles();
+        expectEquals (cache.size(), 0);
+    }
+
+    void testSaveLoad()
+    {
+        beginTest ("save and load");
+        TemporaryFile plugin (".vst3");
+        TemporaryFile cacheFile (".dat");
+        const auto path = plugin.getFile().getFullPathName();
+        plugin.getFile().replaceWithText ("plugin binary");
+
+        PluginScanCache cache;
+        cache.record ("VST3", path, PluginScanCache::Fingerprint::forFile (path, true),
+                      PluginScanCache::Scanned, { createDescription (path) });
+        cache.record ("AudioUnit", "AudioUnit:Synths/aumu,samp,appl", {},
+                      PluginScanCache::Blacklisted, {});
+        expect (cache.save (cacheFile.getFile()));
+
+        PluginScanCache loaded;
+        expect (loaded.load (cacheFile.getFile()));
+        expectEquals (loaded.size(), 2);
+        expect (loaded.isUpToDate ("VST3", path));
+
+        const auto* entry = loaded.find ("VST3", path);
+        expect (entry != nullptr);
+        if (entry != nullptr)
+        {
+            expect (entry->status == PluginScanCache::Scanned);
+            expectEquals (entry->types.size(), 1);
+            expectEquals (entry->types.getFirst().name, String ("Test Plugin"));
+            expectEquals (entry->types.getFirst().uid, 1234);
+        }
+
+        entry = loaded.find ("AudioUnit", "AudioUnit:Synths/aumu,samp,appl");
+        expect (entry != nullptr && entry->status == PluginScanCache::Blacklisted);
+
+        expect (! loaded.load (File()));
+        expectEquals (loaded.size(), 0);
+    }
+};
+
+static PluginScanCacheTest sPluginScanCacheTest;
+
+}
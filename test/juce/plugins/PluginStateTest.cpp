@@ -0,0 +1,175 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "plugins/PluginState.h"
+#include "session/Node.h"
+
+namespace Element {
+
+class PluginStateTest : public UnitTestBase
+{
+public:
+    PluginStateTest() : UnitTestBase ("Plugin State", "plugins", "pluginState") { }
+
+    void runTest() override
+    {
+        testRoundTrip();
+        testLegacyXml();
+        testLayoutHash();
+        testReloadChangedNodes();
+        testSaveTimes();
+    }
+
+private:
+    static ValueTree createSession (int numNodes, int seed = 0)
+    {
+        Array<MemoryBlock> states;
+        for (int i = 0; i < numNodes; ++i)
+            states.add (createState (seed + i, 8192, 16));
+
+        auto session = UnitTestBase::createSession ("Plugin State Test", states);
+        session.setProperty ("pluginEditorBounds", "0 0 640 360", nullptr);
+        for (int i = 0; i < numNodes; ++i)
+            getNode (session, i).setProperty (Tags::uuid, Uuid().toString(), nullptr)
+                                .setProperty (Tags::name, "Node " + String (i), nullptr)
+                                .setProperty (Tags::gain, 1.0, nullptr);
+        return session;
+    }
+
+    static ValueTree getNode (const ValueTree& session, int index)
+    {
+        return session.getChildWithName (Tags::graphs).getChild (0)
+                      .getChildWithName (Tags::nodes).getChild (index);
+    }
+
+    void testRoundTrip()
+    {
+        beginTest ("round trip");
+        const auto session = createSession (4);
+        MemoryBlock data, again;
+        expect (PluginState::write (session, data));
+        expect (PluginState::isPluginState (data.getData(), data.getSize()));
+        expect (PluginState::write (session, again));
+        const auto hash = PluginState::getHash (data.getData(), data.getSize());
+        expectEquals (hash.length(), 32);
+        expectEquals (PluginState::getHash (again.getData(), again.getSize()), hash);
+
+        auto loaded = PluginState::read (data.getData(), data.getSize());
+        expect (loaded.hasType (Tags::session));
+        MemoryBlock state;
+        expect (Node::getStateData (getNode (loaded, 2).getProperty (Tags::state), state));
+        expect (state == createState (2, 8192, 16));
+
+        getNode (loaded, 1).setProperty (Tags::gain, 0.5, nullptr);
+        MemoryBlock changed;
+        expect (PluginState::write (loaded, changed));
+        expect (PluginState::getHash (changed.getData(), changed.getSize()) != hash);
+
+        // a damaged chunk isn't loaded
+        static_cast<char*> (data.getData())[data.getSize() - 1] ^= 0x5a;
+        expect (! PluginState::read (data.getData(), data.getSize()).isValid());
+    }
+
+    void testLegacyXml()
+    {
+        beginTest ("legacy xml");
+        const auto session = createSession (2);
+        MemoryBlock data;
+        if (auto xml = session.createXml())
+            AudioProcessor::copyXmlToBinary (*xml, data);
+        expect (! PluginState::isPluginState (data.getData(), data.getSize()));
+        expect (PluginState::getHash (data.getData(), data.getSize()).isEmpty());
+        const auto loaded = PluginState::read (data.getData(), data.getSize());
+        expect (loaded.hasType (Tags::session));
+        MemoryBlock state;
+        expect (Node::getStateData (getNode (loaded, 1).getProperty (Tags::state), state));
+        expect (state == createState (1, 8192, 16));
+    }
+
+    void testLayoutHash()
+    {
+        beginTest ("layout hash");
+        const auto session = createSession (3);
+        const auto withSettings = PluginState::getLayoutHash (session, true);
+        const auto layout = PluginState::getLayoutHash (session, false);
+
+        auto copy = session.createCopy();
+        getNode (copy, 0).setProperty (Tags::state, var (createState (10, 8192, 16)), nullptr);
+        copy.setProperty ("pluginEditorBounds", "0 0 800 600", nullptr);
+        expectEquals (PluginState::getLayoutHash (copy, true), withSettings);
+
+        getNode (copy, 1).setProperty (Tags::gain, 0.25, nullptr);
+        expect (PluginState::getLayoutHash (copy, true) != withSettings);
+        expectEquals (PluginState::getLayoutHash (copy, false), layout);
+
+        getNode (copy, 2).setProperty (Tags::name, "Renamed", nullptr);
+        expect (PluginState::getLayoutHash (copy, false) != layout);
+
+        // property order doesn't matter
+        auto reordered = session.createCopy();
+        auto node = getNode (reordered, 0);
+        const auto name = node.getProperty (Tags::name);
+        node.removeProperty (Tags::name, nullptr);
+        node.setProperty (Tags::name, name, nullptr);
+        expectEquals (PluginState::getLayoutHash (reordered, true), withSettings);
+    }
+
+    void testReloadChangedNodes()
+    {
+        beginTest ("reload changed nodes");
+        const auto session = createSession (4);
+        auto newSession = session.createCopy();
+        getNode (newSession, 1).setProperty (Tags::state, var (createState (20, 8192, 16)), nullptr);
+        getNode (newSession, 3).setProperty (Tags::gain, 0.5, nullptr);
+
+        expectEquals (PluginState::reloadChangedNodes (session, newSession), 2);
+        MemoryBlock state;
+        expect (Node::getStateData (getNode (session, 1).getProperty (Tags::state), state));
+        expect (state == createState (20, 8192, 16));
+        expectEquals ((double) getNode (session, 3).getProperty (Tags::gain), 0.5);
+        expectEquals (PluginState::reloadChangedNodes (session, newSession), 0);
+    }
+
+    void testSaveTimes()
+    {
+        beginTest ("save times");
+        const auto session = createSession (32);
+        const int iterations = 20;
+        MemoryBlock xmlData, chunkData;
+
+        auto start = Time::getHighResolutionTicks();
+        for (int i = 0; i < iterations; ++i)
+            if (auto xml = session.createXml())
+                AudioProcessor::copyXmlToBinary (*xml, xmlData);
+        const auto xmlMs = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1000.0 / iterations;
+
+        start = Time::getHighResolutionTicks();
+        for (int i = 0; i < iterations; ++i)
+            PluginState::write (session, chunkData);
+        const auto chunkMs = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1000.0 / iterations;
+
+        expect (chunkData.getSize() < xmlData.getSize());
+        logMessage ("plugin state: xml " + String (xmlMs, 3) + " ms " + String (xmlData.getSize())
+                    + " bytes, chunk " + String (chunkMs, 3) + " ms " + String (chunkData.getSize()) + " bytes");
+    }
+};
+
+static PluginStateTest sPluginStateTest;
+
+}
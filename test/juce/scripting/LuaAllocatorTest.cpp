@@ -0,0 +1,97 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "LuaUnitTest.h"
+#include "Tests.h"
+#include "sol/sol.hpp"
+#include "scripting/LuaAllocator.h"
+
+using namespace Element;
+
+static const String sAllocatingScript = R"(
+    function allocate_some()
+        local t = {}
+        for i = 1, 100 do t[i] = { i, tostring (i) } end
+        return #t
+    end
+)";
+
+//=============================================================================
+class LuaAllocatorTest : public UnitTestBase
+{
+public:
+    LuaAllocatorTest() : UnitTestBase ("Lua Allocator", "scripting", "luaAllocator") { }
+
+    void runTest() override
+    {
+        testBlockCounters();
+        testBudget();
+    }
+
+private:
+    void testBlockCounters()
+    {
+        beginTest ("block counters");
+        LuaAllocator allocator;
+        {
+            sol::state lua (sol::default_at_panic, LuaAllocator::alloc, &allocator);
+            LuaAllocator::setupCollector (lua);
+            lua.open_libraries (sol::lib::base);
+            lua.script (sAllocatingScript.toRawUTF8());
+            sol::function allocateSome = lua["allocate_some"];
+
+            allocator.beginBlock();
+            allocator.endBlock();
+            expect (allocator.getStats().blockAllocations == 0);
+
+            allocator.beginBlock();
+            allocateSome();
+            allocator.collectGarbage (lua, 1.0);
+            allocator.endBlock();
+
+            const auto stats = allocator.getStats();
+            expect (stats.blockAllocations >= 200);
+            expect (stats.peakBlockAllocations == stats.blockAllocations);
+            expect (stats.bytesInUse > 0 && stats.bytesInUse <= stats.budget);
+            expect (stats.failedAllocations == 0);
+        }
+    }
+
+    void testBudget()
+    {
+        beginTest ("budget");
+        LuaAllocator allocator (256 * 1024);
+        {
+            sol::state lua (sol::default_at_panic, LuaAllocator::alloc, &allocator);
+            LuaAllocator::setupCollector (lua);
+            lua.open_libraries (sol::lib::base, sol::lib::string);
+
+            auto result = lua.safe_script ("local s = string.rep ('x', 1024 * 1024)",
+                                           sol::script_pass_on_error);
+            expect (! result.valid());
+
+            allocator.beginBlock();
+            allocator.endBlock();
+            const auto stats = allocator.getStats();
+            expect (stats.failedAllocations > 0);
+            expect (stats.peakBytesInUse <= stats.budget);
+        }
+    }
+};
+
+static LuaAllocatorTest sLuaAllocatorTest;
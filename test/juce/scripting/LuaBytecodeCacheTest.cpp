@@ -0,0 +1,174 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "sol/sol.hpp"
+#include "scripting/LuaBindings.h"
+#include "scripting/LuaBytecodeCache.h"
+
+using namespace Element;
+
+static const String sChunk = R"(
+    local a, b = ...
+    return (a or 1) + (b or 2)
+)";
+
+//=============================================================================
+class LuaBytecodeCacheTest : public UnitTestBase
+{
+public:
+    LuaBytecodeCacheTest() : UnitTestBase ("Lua Bytecode Cache", "scripting", "luaBytecodeCache") { }
+
+    void runTest() override
+    {
+        testSharedAcrossStates();
+        testErrors();
+        testEviction();
+        testValidated();
+        testModules();
+    }
+
+private:
+    int callChunk (lua_State* L, LuaBytecodeCache& cache, const String& code, const char* name)
+    {
+        if (cache.load (L, code, name) != LUA_OK)
+        {
+            lua_pop (L, 1);
+            return -1;
+        }
+
+        lua_pushinteger (L, 3);
+        lua_pushinteger (L, 4);
+        lua_call (L, 2, 1);
+        const int result = (int) lua_tointeger (L, -1);
+        lua_pop (L, 1);
+        return result;
+    }
+
+    void testSharedAcrossStates()
+    {
+        beginTest ("shared across states");
+        LuaBytecodeCache cache;
+        sol::state a, b;
+        a.open_libraries (sol::lib::base);
+        b.open_libraries (sol::lib::base);
+
+        expect (callChunk (a, cache, sChunk, "=chunk") == 7);
+        expect (cache.getStats().misses == 1);
+        expect (cache.getStats().hits == 0);
+        expect (cache.getStats().numEntries == 1);
+
+        expect (callChunk (b, cache, sChunk, "=chunk") == 7);
+        expect (callChunk (a, cache, sChunk, "=chunk") == 7);
+        expect (cache.getStats().hits == 2);
+        expect (cache.getStats().numEntries == 1);
+        expect (cache.getStats().numBytes > 0);
+
+        // a different chunk name is a different entry
+        expect (callChunk (b, cache, sChunk, "=other") == 7);
+        expect (cache.getStats().numEntries == 2);
+    }
+
+    void testErrors()
+    {
+        beginTest ("errors");
+        LuaBytecodeCache cache;
+        sol::state lua;
+
+        expect (cache.load (lua, "this is not lua", "=bad") == LUA_ERRSYNTAX);
+        expect (String (lua_tostring (lua, -1)).startsWith ("bad:"));
+        lua_pop (lua.lua_state(), 1);
+        expect (cache.getStats().numEntries == 0);
+
+        // runtime errors keep their line numbers
+        const String code = "local x = 1\nerror ('failed')\n";
+        for (int i = 0; i < 2; ++i)
+        {
+            expect (cache.load (lua, code, "=runtime") == LUA_OK);
+            expect (lua_pcall (lua, 0, 0, 0) == LUA_ERRRUN);
+            expect (String (lua_tostring (lua, -1)) == "runtime:2: failed");
+            lua_pop (lua.lua_state(), 1);
+        }
+
+        expect (cache.getStats().hits == 1);
+    }
+
+    void testEviction()
+    {
+        beginTest ("eviction");
+        LuaBytecodeCache cache;
+        cache.setMaxEntries (2);
+        sol::state lua;
+
+        callChunk (lua, cache, "return 1", "=a");
+        callChunk (lua, cache, "return 2", "=b");
+        callChunk (lua, cache, "return 1", "=a");
+        callChunk (lua, cache, "return 3", "=c");
+        expect (cache.getStats().numEntries == 2);
+
+        // b was used least recently
+        const auto misses = cache.getStats().misses;
+        expect (callChunk (lua, cache, "return 1", "=a") == 1);
+        expect (cache.getStats().misses == misses);
+        expect (callChunk (lua, cache, "return 2", "=b") == 2);
+        expect (cache.getStats().misses == misses + 1);
+
+        cache.clear();
+        expect (cache.getStats().numEntries == 0);
+    }
+
+    void testValidated()
+    {
+        beginTest ("validated");
+        LuaBytecodeCache cache;
+        expect (! cache.isValidated (sChunk, "node"));
+        cache.setValidated (sChunk, "node");
+        expect (cache.isValidated (sChunk, "node"));
+        expect (! cache.isValidated (sChunk, "other"));
+        expect (! cache.isValidated (sChunk + " ", "node"));
+        cache.clear();
+        expect (! cache.isValidated (sChunk, "node"));
+    }
+
+    void testModules()
+    {
+        beginTest ("modules");
+        const auto dir = File::getSpecialLocation (File::tempDirectory)
+            .getChildFile ("LuaBytecodeCacheTest");
+        dir.createDirectory();
+        const auto file = dir.getChildFile ("cachedmod.lua");
+        file.replaceWithText ("#!/usr/bin/env lua\nreturn { value = 42 }\n");
+
+        SharedResourcePointer<LuaBytecodeCache> cache;
+        const auto hits = cache->getStats().hits;
+        for (int i = 0; i < 2; ++i)
+        {
+            sol::state lua;
+            Lua::initializeState (lua);
+            lua["package"]["path"] = (dir.getFullPathName() + "/?.lua").toStdString();
+            sol::table mod = lua.script ("return require ('cachedmod')");
+            expect (mod.get_or ("value", 0) == 42);
+        }
+
+        // the second state loaded the module's bytecode
+        expect (cache->getStats().hits == hits + 1);
+        dir.deleteRecursively();
+    }
+};
+
+static LuaBytecodeCacheTest sLuaBytecodeCacheTest;
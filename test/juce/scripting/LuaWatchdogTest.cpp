@@ -0,0 +1,110 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "LuaUnitTest.h"
+#include "Tests.h"
+#include "sol/sol.hpp"
+#include "scripting/LuaWatchdog.h"
+
+using namespace Element;
+
+static const String sRunawayScript = R"(
+function render (runaway)
+    local x = 0
+    if runaway then
+        while true do x = x + 1 end
+    end
+    return x
+end
+
+function fail()
+    error ("broken")
+end
+)";
+
+//=============================================================================
+class LuaWatchdogTest : public UnitTestBase
+{
+public:
+    LuaWatchdogTest() : UnitTestBase ("Lua Watchdog", "scripting", "luaWatchdog") { }
+
+    void runTest() override
+    {
+        LuaWatchdog watchdog;
+        sol::state lua;
+        watchdog.attach (lua);
+        lua.script (sRunawayScript.toRawUTF8());
+
+        beginTest ("within budget");
+        expect (watchdog.beginBlock (512, 44100.0));
+        expect (renderBlock (lua, false));
+        expect (! watchdog.endBlock());
+
+        beginTest ("overrun aborts the call");
+        for (int i = 0; i < LuaWatchdog::defaultMaxOverruns; ++i)
+        {
+            expect (watchdog.beginBlock (512, 44100.0));
+            expect (! renderBlock (lua, true));
+            expect (watchdog.endBlock());
+        }
+
+        beginTest ("repeated overruns suspend");
+        const auto stats = watchdog.getStats();
+        expect (stats.suspended);
+        expect (stats.overruns == LuaWatchdog::defaultMaxOverruns);
+        expect (stats.location.endsWith (":5"), stats.location);
+        expect (! watchdog.beginBlock (512, 44100.0));
+
+        beginTest ("resume");
+        watchdog.resume();
+        expect (watchdog.beginBlock (512, 44100.0));
+        expect (renderBlock (lua, false));
+        expect (! watchdog.endBlock());
+
+        beginTest ("errors are reported");
+        lua_getglobal (lua, "fail");
+        expect (lua_pcall (lua, 0, 0, 0) != LUA_OK);
+        LuaWatchdog::reportError (lua);
+        expectEquals (lua_gettop (lua), 0);
+        const auto errorStats = watchdog.getStats();
+        expectEquals (errorStats.errors, (int64) 1);
+        expect (errorStats.lastError.contains ("broken"), errorStats.lastError);
+
+        beginTest ("errors without a watchdog");
+        sol::state plain;
+        plain.script (sRunawayScript.toRawUTF8());
+        lua_getglobal (plain, "fail");
+        expect (lua_pcall (plain, 0, 0, 0) != LUA_OK);
+        LuaWatchdog::reportError (plain);
+        expectEquals (lua_gettop (plain), 0);
+        expectEquals (watchdog.getStats().errors, (int64) 1);
+    }
+
+private:
+    static bool renderBlock (lua_State* L, bool runaway)
+    {
+        lua_getglobal (L, "render");
+        lua_pushboolean (L, runaway);
+        if (lua_pcall (L, 1, 0, 0) == LUA_OK)
+            return true;
+        lua_pop (L, 1);
+        return false;
+    }
+};
+
+static LuaWatchdogTest sLuaWatchdogTest;
@@ -0,0 +1,98 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "scripting/ScriptHotSwap.h"
+
+using namespace Element;
+
+namespace {
+
+/** Outputs a constant, counts how many are alive */
+struct ConstantContext
+{
+    explicit ConstantContext (float v) : value (v) { ++numAlive; }
+    ~ConstantContext() { --numAlive; }
+
+    bool render (AudioSampleBuffer& audio, MidiPipe&) noexcept
+    {
+        for (int ch = 0; ch < audio.getNumChannels(); ++ch)
+            FloatVectorOperations::fill (audio.getWritePointer (ch), value, audio.getNumSamples());
+        return true;
+    }
+
+    const float value;
+    static int numAlive;
+};
+
+int ConstantContext::numAlive = 0;
+
+}
+
+//=============================================================================
+class ScriptHotSwapTest : public UnitTestBase
+{
+public:
+    ScriptHotSwapTest() : UnitTestBase ("Script Hot Swap", "scripting", "scriptHotSwap") { }
+
+    void runTest() override
+    {
+        const double sampleRate = 48000.0;
+        const int fadeLength = 480;
+
+        AudioSampleBuffer audio (2, 512);
+        MidiBuffer midiBuffer;
+        MidiBuffer* midiBuffers[] = { &midiBuffer };
+        MidiPipe midi (midiBuffers, 1);
+
+        {
+            ScriptHotSwap<ConstantContext> swap (std::make_unique<ConstantContext> (0.f));
+            swap.prepare (sampleRate, 512, 2);
+
+            beginTest ("renders the initial context");
+            expect (swap.render (audio, midi));
+            expectEquals (audio.getSample (1, 100), 0.f);
+
+            beginTest ("crossfades to an installed context");
+            swap.install (std::make_unique<ConstantContext> (1.f));
+            expectEquals (swap.getLatest()->value, 1.f);
+            expect (swap.render (audio, midi));
+            expectEquals (audio.getSample (0, 0), 0.f);
+            expectWithinAbsoluteError (audio.getSample (0, fadeLength / 2), 0.5f, 0.001f);
+            expectEquals (audio.getSample (1, fadeLength), 1.f);
+            expectEquals (audio.getSample (1, 511), 1.f);
+
+            beginTest ("old contexts are deleted off the audio thread");
+            expectEquals (ConstantContext::numAlive, 2);
+            swap.install (std::make_unique<ConstantContext> (2.f));
+            expectEquals (ConstantContext::numAlive, 2);
+
+            beginTest ("prepare switches immediately");
+            swap.release();
+            swap.prepare (sampleRate, 512, 2);
+            expectEquals (ConstantContext::numAlive, 1);
+            expect (swap.render (audio, midi));
+            expectEquals (audio.getSample (0, 0), 2.f);
+        }
+
+        beginTest ("everything is deleted");
+        expectEquals (ConstantContext::numAlive, 0);
+    }
+};
+
+static ScriptHotSwapTest sScriptHotSwapTest;
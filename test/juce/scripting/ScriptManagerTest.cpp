@@ -16,9 +16,6 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
-// FIXME: Local lua paths in release build
-#if JUCE_DEBUG
-
 #include "Tests.h"
 #include "scripting/ScriptManager.h"
 #include "scripting/LuaBindings.h"
@@ -26,6 +23,17 @@
 
 using namespace Element;
 
+static String makeScript (const String& name, const String& kind)
+{
+    String script;
+    script << "--- " << name << juce::newLine
+           << "-- @script " << name << juce::newLine
+           << "-- @kind " << kind << juce::newLine
+           << juce::newLine
+           << "return {}" << juce::newLine;
+    return script;
+}
+
 //=============================================================================
 class ScriptManagerTest : public UnitTestBase
 {
@@ -35,13 +43,63 @@ public:
 
     void runTest() override
     {
+        // FIXME: Local lua paths in release build
+       #if JUCE_DEBUG
         beginTest ("scanDefaultLocation");
         ScriptManager scripts;
         scripts.scanDefaultLocation();
         expect (scripts.getNumScripts() == 6, 
                 String("Wrong number of default scripts: ") + String (scripts.getNumScripts()));
+       #endif
+
+        testIncrementalScan();
+    }
+
+private:
+    void testIncrementalScan()
+    {
+        beginTest ("incremental scan");
+        const auto dir = File::getSpecialLocation (File::tempDirectory)
+            .getNonexistentChildFile ("ScriptManagerTest", "");
+        dir.getChildFile ("sub").createDirectory();
+        const auto indexFile = dir.getChildFile ("index.xml");
+        dir.getChildFile ("a.lua").replaceWithText (makeScript ("a", "el.DSP"));
+        dir.getChildFile ("sub/b.lua").replaceWithText (makeScript ("b", "el.DSPUI"));
+        dir.getChildFile ("c.lua").replaceWithText ("return {}");
+
+        {
+            ScriptManager scripts;
+            scripts.setIndexFile (indexFile);
+            scripts.scanDirectory (dir);
+            expectEquals (scripts.getNumFilesParsed(), 3);
+            expectEquals (scripts.getNumScripts(), 2);
+            expectEquals (scripts.getScriptsDSP().size(), 1);
+            expect (scripts.getScriptsDSP().getReference(0).name == "a");
+            expect (indexFile.existsAsFile());
+
+            scripts.scanDirectory (dir);
+            expectEquals (scripts.getNumFilesParsed(), 0);
+            expectEquals (scripts.getNumScripts(), 2);
+        }
+
+        {
+            // a new manager picks up where the index left off
+            ScriptManager scripts;
+            scripts.setIndexFile (indexFile);
+            scripts.scanDirectory (dir);
+            expectEquals (scripts.getNumFilesParsed(), 0);
+            expectEquals (scripts.getNumScripts(), 2);
+
+            dir.getChildFile ("c.lua").replaceWithText (makeScript ("c", "el.DSP"));
+            dir.getChildFile ("sub/b.lua").deleteFile();
+            scripts.scanDirectory (dir);
+            expectEquals (scripts.getNumFilesParsed(), 1);
+            expectEquals (scripts.getNumScripts(), 2);
+            expectEquals (scripts.getScriptsDSP().size(), 2);
+        }
+
+        dir.deleteRecursively();
     }
 };
 
 static ScriptManagerTest sScriptManagerTest;
-#endif
@@ -18,6 +18,7 @@
 
 #include "LuaUnitTest.h"
 #include "scripting/DSPScript.h"
+#include "scripting/LuaWatchdog.h"
 #include "scripting/Script.h"
 
 using namespace Element;
@@ -31,6 +32,27 @@ static const String sExceptionError = R"(
     obj:nil_function()
 )";
 
+static const String sRunawayVoices = R"(
+local function voice()
+    return {
+        render = function (self, a, params)
+            if self.note > 60 then
+                while true do end
+            end
+            return true
+        end
+    }
+end
+
+return {
+    type        = 'DSP',
+    layout      = function() return { audio = { 0, 2 }, midi = { 1, 0 } } end,
+    parameters  = function() return {} end,
+    polyphony   = 4,
+    voice       = voice
+}
+)";
+
 static const String sAnonymous = R"(
     local msg = "anon"
     testvalue = msg
@@ -232,3 +254,51 @@ public:
 };
 
 static DSPScriptTest sDSPScriptTest;
+
+//=============================================================================
+class DSPScriptVoicesTest : public LuaUnitTest
+{
+public:
+    DSPScriptVoicesTest()
+        : LuaUnitTest ("DSP Script Voices", "Script", "voices") { }
+
+    void runTest() override
+    {
+        beginTest ("runaway voices");
+        watchdog.attach (lua);
+        auto script = std::make_unique<Script> (lua, sRunawayVoices);
+        expect (! script->hasError(), script->getErrorMessage());
+        if (script->hasError())
+            return;
+
+        sol::table table = script->call();
+        DSPScript dsp (table);
+        expect (dsp.isValid());
+        if (! dsp.isValid())
+            return;
+        dsp.init();
+        dsp.prepare (44100.0, 512);
+
+        // the second and third voice loop forever, the third must not
+        // run after the watchdog aborted the second
+        MidiBuffer buffer;
+        for (int note = 60; note < 63; ++note)
+            buffer.addEvent (MidiMessage::noteOn (1, note, 1.f), 0);
+        MidiBuffer* buffers[] = { &buffer };
+        MidiPipe midi (buffers, 1);
+        AudioSampleBuffer audio (2, 512);
+
+        expect (watchdog.beginBlock (512, 44100.0));
+        dsp.process (audio, midi);
+        expect (watchdog.endBlock());
+        expect (watchdog.getStats().overruns == 1);
+
+        dsp.release();
+    }
+
+private:
+    // outlives the state, which is deleted in shutdown()
+    LuaWatchdog watchdog;
+};
+
+static DSPScriptVoicesTest sDSPScriptVoicesTest;
@@ -131,6 +131,7 @@ def check_mac (self):
 def check_linux (self):
     self.check(lib='pthread', mandatory=True)
     self.check(lib='dl', uselib_store='DL', mandatory=True)
+    self.check(lib='rt', uselib_store='RT', mandatory=True)
     
     self.check_cxx(lib='readline', uselib_store='READLINE', mandatory=False)
     self.define ('LUA_USE_READLINE',  bool(self.env.LIB_READLINE))